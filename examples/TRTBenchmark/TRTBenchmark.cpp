@@ -0,0 +1,895 @@
+//=====================================================================================================================
+//
+//   TRTBenchmark.cpp
+//
+//   Benchmark suite for TinyRT.  Builds each of TinyRT's acceleration structures over each of the sample models, and
+//     measures raycasting throughput for several ray workloads (primary, random, shadow, ambient occlusion, and
+//     path traced bounces).  Results are printed, and written to a JSON file for comparison between runs.
+//
+//   Usage:  TRTBenchmark [-o results.json] [-t threads] [-r resolution] [-n random_rays] [-s] 
+//                        [-p none|nodes|all|auto] [-c copies] [model.ply ...]
+//
+//   With -s, traversal statistics (node visits, intersection tests, and so on) are collected for each workload.
+//     Counting adds some overhead, so the timings from such runs should not be compared with those from runs without it
+//
+//   With -p, the AABBTree and QuadAABBTree traversals prefetch the nodes (and with 'all', the leaf triangles) which are 
+//     pushed onto the traversal stack.  'auto' prefetches only for structures larger than TRT_PREFETCH_MIN_BYTES.
+//     With -c, each model is replicated on a grid, to produce structures which are larger than the cache.
+//
+//   This is plain C++ and OpenMP.  On Linux, run 'make' in this directory to build it
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS // make VC++ stop complaining about old 'unsecure' methods
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+
+#include "PlyLoad.h"
+#include "Timer.h"
+#include "TinyRT.h"
+using namespace TinyRT;
+
+
+typedef TinyRT::BasicMesh<Vec3f,uint32> Mesh;
+
+static const uint32 NO_HIT = 0xffffffff;
+
+/// Prefetch policy used by the BVH traversals
+enum PrefetchMode
+{
+    PREFETCH_NONE,
+    PREFETCH_NODES,     ///< NodePrefetch
+    PREFETCH_ALL,       ///< NodeAndObjectPrefetch
+    PREFETCH_AUTO       ///< NodeAndObjectPrefetch if ShouldPrefetch says so, otherwise none
+};
+
+static const char* PREFETCH_MODE_NAMES[] = { "none", "nodes", "all", "auto" };
+
+/// KD tree traversal algorithm
+enum KDTraversalMode
+{
+    KD_STACK,           ///< RaycastKDTree
+    KD_RESTART,         ///< RaycastKDTreeRestart
+    KD_SHORT_STACK,     ///< RaycastKDTreeShortStack, with KD_SHORT_STACK_SIZE entries
+    KD_ROPES,           ///< RaycastKDTreeRopes
+    KD_SIMD             ///< RaycastKDTreeSimd
+};
+
+static const int KD_SHORT_STACK_SIZE = 4;
+
+
+//=====================================================================================================================
+/// \brief A small xorshift random number generator
+///
+///  rand() is not thread-safe, and its sequence differs between C libraries.  The workloads need to be identical on
+///   every platform and for every thread count, so each thread (or each pixel) gets its own generator.
+//=====================================================================================================================
+class Random
+{
+public:
+
+    inline Random( uint32 nSeed ) : m_nState( nSeed*0x9E3779B9 + 0x7F4A7C15 )
+    {
+        if( !m_nState )
+            m_nState = 1;
+    };
+
+    inline uint32 Next()
+    {
+        m_nState ^= m_nState << 13;
+        m_nState ^= m_nState >> 17;
+        m_nState ^= m_nState << 5;
+        return m_nState;
+    };
+
+    /// Returns a float in [0,1)
+    inline float NextFloat() { return ( Next() >> 8 ) * ( 1.0f / 16777216.0f ); };
+
+private:
+
+    uint32 m_nState;
+};
+
+
+//=====================================================================================================================
+/// \brief Base class for the acceleration structures under test
+//=====================================================================================================================
+class Scene
+{
+public:
+
+    inline Scene( const char* pStructure, const char* pBuilder ) 
+        : m_pStructure( pStructure ), m_pBuilder( pBuilder ), m_pMesh( NULL ), m_ePrefetch( PREFETCH_NONE ) {};
+
+    virtual ~Scene() {};
+
+    /// Builds the structure over a mesh.  The mesh may be re-ordered
+    virtual void Build( Mesh* pMesh ) = 0;
+
+    /// \brief Finds the first hit along a ray.  May be called from multiple threads at once, each with its own scratch memory
+    /// If pStats is non-NULL, traversal statistics are added to it
+    virtual void Trace( Ray& rRay, TriangleRayHit& rHit, ScratchMemory& rScratch, TraversalStats* pStats ) = 0;
+
+    /// Returns the memory used by the structure (not including the mesh)
+    virtual void GetMemoryUsage( size_t& rnBytesUsed, size_t& rnBytesAllocated ) const = 0;
+
+    inline const char* GetStructureName() const { return m_pStructure; };
+    inline const char* GetBuilderName() const { return m_pBuilder; };
+    inline const Mesh* GetMesh() const { return m_pMesh; };
+
+    /// Selects the prefetch policy.  Must be called before 'Build', which resolves PREFETCH_AUTO
+    inline void SetPrefetchMode( PrefetchMode eMode ) { m_ePrefetch = eMode; };
+
+    /// Returns the prefetch policy which the traversal actually uses
+    inline PrefetchMode GetPrefetchMode() const { return m_ePrefetch; };
+
+protected:
+
+    /// Replaces PREFETCH_AUTO with the policy appropriate for a given tree
+    template< class Tree_T >
+    inline void ResolvePrefetchMode( const Tree_T* pTree )
+    {
+        if( m_ePrefetch == PREFETCH_AUTO )
+            m_ePrefetch = ShouldPrefetch( pTree ) ? PREFETCH_ALL : PREFETCH_NONE;
+    };
+
+    const char* m_pStructure;
+    const char* m_pBuilder;
+    Mesh* m_pMesh;
+    PrefetchMode m_ePrefetch;
+};
+
+
+template< class Builder_T >
+class AABBTreeScene : public Scene
+{
+public:
+
+    inline AABBTreeScene( const char* pBuilder, const Builder_T& rBuilder ) : Scene( "AABBTree", pBuilder ), m_builder( rBuilder ) {};
+
+    virtual void Build( Mesh* pMesh ) { m_pMesh = pMesh; m_tree.Build( pMesh, m_builder ); ResolvePrefetchMode( &m_tree ); };
+
+    virtual void Trace( Ray& rRay, TriangleRayHit& rHit, ScratchMemory& rScratch, TraversalStats* pStats )
+    {
+        switch( m_ePrefetch )
+        {
+        case PREFETCH_NODES: TracePrefetched<NodePrefetch>( rRay, rHit, rScratch, pStats ); break;
+        case PREFETCH_ALL:   TracePrefetched<NodeAndObjectPrefetch>( rRay, rHit, rScratch, pStats ); break;
+        default:             TracePrefetched<NullPrefetch>( rRay, rHit, rScratch, pStats ); break;
+        }
+    };
+
+    virtual void GetMemoryUsage( size_t& rnBytesUsed, size_t& rnBytesAllocated ) const { m_tree.GetMemoryUsage( rnBytesUsed, rnBytesAllocated ); };
+
+private:
+
+    template< class Prefetch_T >
+    inline void TracePrefetched( Ray& rRay, TriangleRayHit& rHit, ScratchMemory& rScratch, TraversalStats* pStats )
+    {
+        if( pStats )
+            RaycastBVHPrefetched<Prefetch_T>( &m_tree, m_pMesh, rRay, rHit, m_tree.GetRoot(), rScratch, *pStats );
+        else
+            RaycastBVHPrefetched<Prefetch_T>( &m_tree, m_pMesh, rRay, rHit, m_tree.GetRoot(), rScratch );
+    };
+
+    Builder_T m_builder;
+    AABBTree<Mesh> m_tree;
+};
+
+
+template< class Builder_T >
+class QuadAABBTreeScene : public Scene
+{
+public:
+
+    inline QuadAABBTreeScene( const char* pBuilder, const Builder_T& rBuilder ) : Scene( "QuadAABBTree", pBuilder ), m_builder( rBuilder ) {};
+
+    virtual void Build( Mesh* pMesh ) { m_pMesh = pMesh; m_tree.Build( pMesh, m_builder ); ResolvePrefetchMode( &m_tree ); };
+
+    virtual void Trace( Ray& rRay, TriangleRayHit& rHit, ScratchMemory& rScratch, TraversalStats* pStats )
+    {
+        switch( m_ePrefetch )
+        {
+        case PREFETCH_NODES: TracePrefetched<NodePrefetch>( rRay, rHit, rScratch, pStats ); break;
+        case PREFETCH_ALL:   TracePrefetched<NodeAndObjectPrefetch>( rRay, rHit, rScratch, pStats ); break;
+        default:             TracePrefetched<NullPrefetch>( rRay, rHit, rScratch, pStats ); break;
+        }
+    };
+
+    virtual void GetMemoryUsage( size_t& rnBytesUsed, size_t& rnBytesAllocated ) const { m_tree.GetMemoryUsage( rnBytesUsed, rnBytesAllocated ); };
+
+private:
+
+    template< class Prefetch_T >
+    inline void TracePrefetched( Ray& rRay, TriangleRayHit& rHit, ScratchMemory& rScratch, TraversalStats* pStats )
+    {
+        if( pStats )
+            RaycastMultiBVHPrefetched<Prefetch_T>( &m_tree, m_pMesh, rRay, rHit, m_tree.GetRoot(), rScratch, *pStats );
+        else
+            RaycastMultiBVHPrefetched<Prefetch_T>( &m_tree, m_pMesh, rRay, rHit, m_tree.GetRoot(), rScratch );
+    };
+
+    Builder_T m_builder;
+    QuadAABBTree<Mesh> m_tree;
+};
+
+
+class KDTreeScene : public Scene
+{
+public:
+
+    inline KDTreeScene( float fISectCost, KDTraversalMode eTraversal, const char* pName ) 
+        : Scene( "KDTree", pName ), m_builder( fISectCost ), m_eTraversal( eTraversal ) {};
+
+    // the KD traversal does not take a prefetch policy
+    virtual void Build( Mesh* pMesh ) 
+    { 
+        m_pMesh = pMesh; 
+        m_tree.Build( pMesh, m_builder ); 
+        if( m_eTraversal == KD_ROPES )
+            m_ropes.Build( &m_tree );
+        m_ePrefetch = PREFETCH_NONE; 
+    };
+
+    virtual void Trace( Ray& rRay, TriangleRayHit& rHit, ScratchMemory& rScratch, TraversalStats* pStats )
+    {
+        if( pStats )
+            TraceWithStats( rRay, rHit, rScratch, *pStats );
+        else
+            TraceWithStats( rRay, rHit, rScratch, m_nullStats );
+    };
+
+    virtual void GetMemoryUsage( size_t& rnBytesUsed, size_t& rnBytesAllocated ) const 
+    { 
+        m_tree.GetMemoryUsage( rnBytesUsed, rnBytesAllocated ); 
+        if( m_eTraversal == KD_ROPES )
+        {
+            size_t nRopesUsed, nRopesAllocated;
+            m_ropes.GetMemoryUsage( nRopesUsed, nRopesAllocated );
+            rnBytesUsed += nRopesUsed;
+            rnBytesAllocated += nRopesAllocated;
+        }
+    };
+
+private:
+
+    template< class Stats_T >
+    inline void TraceWithStats( Ray& rRay, TriangleRayHit& rHit, ScratchMemory& rScratch, Stats_T& rStats )
+    {
+        typedef DirectMapMailbox<uint32> Mailbox;
+        switch( m_eTraversal )
+        {
+        case KD_RESTART:     RaycastKDTreeRestart<Mailbox>( &m_tree, m_pMesh, rRay, rHit, m_tree.GetRoot(), rStats ); break;
+        case KD_SHORT_STACK: RaycastKDTreeShortStack<KD_SHORT_STACK_SIZE,Mailbox>( &m_tree, m_pMesh, rRay, rHit, m_tree.GetRoot(), rStats ); break;
+        case KD_ROPES:       RaycastKDTreeRopes<Mailbox>( &m_tree, &m_ropes, m_pMesh, rRay, rHit, rStats ); break;
+        case KD_SIMD:        RaycastKDTreeSimd<Mailbox>( &m_tree, m_pMesh, rRay, rHit, m_tree.GetRoot(), rScratch, rStats ); break;
+        default:             RaycastKDTree<Mailbox>( &m_tree, m_pMesh, rRay, rHit, m_tree.GetRoot(), rScratch, rStats ); break;
+        }
+    };
+
+    SahKDTreeBuilder<Mesh, Mesh::Clipper> m_builder;
+    KDTraversalMode m_eTraversal;
+    KDTree<Mesh> m_tree;
+    KDTreeRopes< KDTree<Mesh> > m_ropes;    ///< Only built for KD_ROPES
+    NullTraversalStats m_nullStats;
+};
+
+
+class BIHTreeScene : public Scene
+{
+public:
+
+    inline BIHTreeScene( uint32 nMaxLeafObjects ) : Scene( "BIHTree", "Median" ), m_builder( nMaxLeafObjects ) {};
+
+    // the BIH traversal does not take a prefetch policy
+    virtual void Build( Mesh* pMesh ) { m_pMesh = pMesh; m_tree.Build( pMesh, m_builder ); m_ePrefetch = PREFETCH_NONE; };
+
+    virtual void Trace( Ray& rRay, TriangleRayHit& rHit, ScratchMemory& rScratch, TraversalStats* pStats )
+    {
+        if( pStats )
+            RaycastBIHTree( &m_tree, m_pMesh, rRay, rHit, m_tree.GetRoot(), rScratch, *pStats );
+        else
+            RaycastBIHTree( &m_tree, m_pMesh, rRay, rHit, m_tree.GetRoot(), rScratch );
+    };
+
+    virtual void GetMemoryUsage( size_t& rnBytesUsed, size_t& rnBytesAllocated ) const { m_tree.GetMemoryUsage( rnBytesUsed, rnBytesAllocated ); };
+
+private:
+
+    BIHTreeBuilder<Mesh> m_builder;
+    BIHTree<Mesh> m_tree;
+};
+
+
+class UniformGridScene : public Scene
+{
+public:
+
+    inline UniformGridScene( float fLambda ) : Scene( "UniformGrid", "Lambda" ), m_fLambda( fLambda ) {};
+
+    // the grid traversal does not take a prefetch policy
+    virtual void Build( Mesh* pMesh ) { m_pMesh = pMesh; m_grid.Build( pMesh, m_fLambda ); m_ePrefetch = PREFETCH_NONE; };
+
+    virtual void Trace( Ray& rRay, TriangleRayHit& rHit, ScratchMemory&, TraversalStats* pStats )
+    {
+        if( pStats )
+            RaycastUniformGrid< DirectMapMailbox<uint32,16> >( &m_grid, m_pMesh, rRay, rHit, *pStats );
+        else
+            RaycastUniformGrid< DirectMapMailbox<uint32,16> >( &m_grid, m_pMesh, rRay, rHit );
+    };
+
+    virtual void GetMemoryUsage( size_t& rnBytesUsed, size_t& rnBytesAllocated ) const { m_grid.GetMemoryUsage( rnBytesUsed, rnBytesAllocated ); };
+
+private:
+
+    float m_fLambda;
+    UniformGrid<Mesh> m_grid;
+};
+
+
+/// Creates one of each structure/builder combination
+void CreateScenes( std::vector<Scene*>& rScenes )
+{
+    rScenes.push_back( new AABBTreeScene< MedianCutAABBTreeBuilder<Mesh> >( "MedianCut", MedianCutAABBTreeBuilder<Mesh>( 2 ) ) );
+    rScenes.push_back( new AABBTreeScene< SahAABBTreeBuilder<Mesh, ConstantCost<uint32> > >( "SAH", SahAABBTreeBuilder<Mesh, ConstantCost<uint32> >( 1.0f ) ) );
+    rScenes.push_back( new QuadAABBTreeScene< SahAABBTreeBuilder<Mesh> >( "SAH", SahAABBTreeBuilder<Mesh>( 1.0f ) ) );
+    rScenes.push_back( new QuadAABBTreeScene< SahAABBTreeBuilder<Mesh> >( "SAH-4Way", SahAABBTreeBuilder<Mesh>( 1.0f, true ) ) );
+    rScenes.push_back( new QuadAABBTreeScene< AABBTreeCollapser< MedianCutAABBTreeBuilder<Mesh> > >( "MedianCut", 
+                           AABBTreeCollapser< MedianCutAABBTreeBuilder<Mesh> >( MedianCutAABBTreeBuilder<Mesh>( 2 ) ) ) );
+    rScenes.push_back( new KDTreeScene( 3.0f, KD_STACK, "SAH" ) );
+    rScenes.push_back( new KDTreeScene( 3.0f, KD_RESTART, "SAH-Restart" ) );
+    rScenes.push_back( new KDTreeScene( 3.0f, KD_SHORT_STACK, "SAH-Short4" ) );
+    rScenes.push_back( new KDTreeScene( 3.0f, KD_ROPES, "SAH-Ropes" ) );
+    rScenes.push_back( new KDTreeScene( 3.0f, KD_SIMD, "SAH-SIMD" ) );
+    rScenes.push_back( new BIHTreeScene( 2 ) );
+    rScenes.push_back( new UniformGridScene( 100.0f ) );
+}
+
+
+//=====================================================================================================================
+//  Workloads
+//=====================================================================================================================
+
+struct Options
+{
+    uint32 nThreads;
+    uint32 nResolution;     ///< Width and height of the image used for primary rays (and paths)
+    uint32 nRandomRays;
+    uint32 nAOSamples;      ///< Number of AO rays per primary hit
+    uint32 nMaxBounces;     ///< Maximum number of bounces per path
+    bool bStats;            ///< Collect traversal statistics
+    PrefetchMode ePrefetch; ///< Prefetch policy for the BVH traversals
+    uint32 nCopies;         ///< Number of copies of each model to place in the scene
+};
+
+struct WorkloadResult
+{
+    const char* pName;
+    uint32 nRays;
+    uint32 nHits;
+    double fMicroSeconds;
+    TraversalStats stats;   ///< Only filled in if Options::bStats is set
+};
+
+/// Scene-dependent quantities which the workloads are derived from
+struct SceneFrame
+{
+    AxisAlignedBox box;
+    float fDiagonal;
+    float fEpsilon;         ///< Distance by which secondary ray origins are offset from surfaces
+    Vec3f vLight;           ///< Point light position for shadow rays
+};
+
+void GetSceneFrame( const Mesh* pMesh, SceneFrame& rFrame )
+{
+    pMesh->GetAABB( rFrame.box );
+    Vec3f vExtent = rFrame.box.Max() - rFrame.box.Min();
+    Vec3f vCenter = ( rFrame.box.Max() + rFrame.box.Min() ) * 0.5f;
+
+    rFrame.fDiagonal = Length3( vExtent );
+    rFrame.fEpsilon = 1e-4f * rFrame.fDiagonal;
+    rFrame.vLight = Vec3f( vCenter.x + 0.25f*vExtent.x, rFrame.box.Max().y + 0.5f*vExtent.y, vCenter.z + 0.25f*vExtent.z );
+}
+
+/// Computes the position and geometric normal at a ray hit.  The normal faces towards the ray origin
+void GetHitFrame( const Mesh* pMesh, const Ray& rRay, const TriangleRayHit& rHit, Vec3f& rPosition, Vec3f& rNormal )
+{
+    rPosition = rRay.Origin() + rRay.Direction()*rRay.MaxDistance();
+
+    const Vec3f& v0 = pMesh->VertexPosition( pMesh->Index( rHit.nTriIdx, 0 ) );
+    const Vec3f& v1 = pMesh->VertexPosition( pMesh->Index( rHit.nTriIdx, 1 ) );
+    const Vec3f& v2 = pMesh->VertexPosition( pMesh->Index( rHit.nTriIdx, 2 ) );
+    Vec3f vN = Cross3( v1-v0, v2-v0 );
+
+    // degenerate triangles can be hit too, in which case we just bounce straight back
+    float fLength = Length3( vN );
+    rNormal = ( fLength > 0.0f ) ? vN / fLength : -Normalize3( rRay.Direction() );
+    if( Dot3( rNormal, rRay.Direction() ) > 0.0f )
+        rNormal = -rNormal;
+}
+
+/// Returns a cosine-distributed direction on the hemisphere around a unit normal
+Vec3f SampleHemisphere( const Vec3f& rNormal, Random& rRandom )
+{
+    float u1 = rRandom.NextFloat();
+    float u2 = rRandom.NextFloat();
+    float r = sqrt( u1 );
+    float fPhi = 6.2831853f * u2;
+
+    Vec3f vT = ( fabs( rNormal.x ) > 0.5f ) ? Vec3f( 0, 1, 0 ) : Vec3f( 1, 0, 0 );
+    Vec3f vB1 = Normalize3( Cross3( rNormal, vT ) );
+    Vec3f vB2 = Cross3( rNormal, vB1 );
+    return vB1*( r*cos( fPhi ) ) + vB2*( r*sin( fPhi ) ) + rNormal*sqrt( std::max( 0.0f, 1.0f - u1 ) );
+}
+
+/// Generates the primary rays for a pinhole camera placed outside the scene, looking at its center
+void GeneratePrimaryRays( const SceneFrame& rFrame, const Options& rOpts, std::vector<Ray>& rRays )
+{
+    Vec3f vCenter = ( rFrame.box.Max() + rFrame.box.Min() ) * 0.5f;
+    Vec3f vEye = vCenter + Normalize3( Vec3f( 0.55f, 0.35f, 1.0f ) ) * ( 0.8f*rFrame.fDiagonal );
+    PerspectiveCamera cam( vEye, vCenter - vEye, Vec3f( 0, 1, 0 ), 60.0f, 1.0f );
+
+    uint32 nRes = rOpts.nResolution;
+    rRays.clear();
+    rRays.reserve( nRes*nRes );
+    for( uint32 y=0; y<nRes; y++ )
+    {
+        for( uint32 x=0; x<nRes; x++ )
+        {
+            Vec2f vNDC( ( x + 0.5f ) / nRes, ( y + 0.5f ) / nRes );
+            rRays.push_back( Ray( vEye, cam.GetRayDirectionNDC( vNDC ) ) );
+        }
+    }
+}
+
+/// Generates rays between random pairs of points in the scene's bounding box, as TRTRenderTest's random ray test does
+void GenerateRandomRays( const SceneFrame& rFrame, const Options& rOpts, std::vector<Ray>& rRays )
+{
+    Random rng( 0 );
+    rRays.clear();
+    rRays.reserve( rOpts.nRandomRays );
+    for( uint32 i=0; i<rOpts.nRandomRays; i++ )
+    {
+        Vec3f v[2];
+        for( int k=0; k<2; k++ )
+        {
+            for( int j=0; j<3; j++ )
+                v[k][j] = Lerp( rFrame.box.Min()[j], rFrame.box.Max()[j], rng.NextFloat() );
+        }
+        rRays.push_back( Ray( v[0], v[1]-v[0] ) );
+    }
+}
+
+/// Generates one shadow ray towards the light from each hit point.  The rays end at the light
+void GenerateShadowRays( const Mesh* pMesh, const SceneFrame& rFrame, const std::vector<Ray>& rPrimary,
+                         const std::vector<TriangleRayHit>& rHits, std::vector<Ray>& rRays )
+{
+    rRays.clear();
+    for( size_t i=0; i<rPrimary.size(); i++ )
+    {
+        if( rHits[i].nTriIdx == NO_HIT )
+            continue;
+
+        Vec3f vP, vN;
+        GetHitFrame( pMesh, rPrimary[i], rHits[i], vP, vN );
+        vP += vN*rFrame.fEpsilon;
+
+        Ray r( vP, rFrame.vLight - vP );
+        r.SetMaxDistance( 1.0f );
+        rRays.push_back( r );
+    }
+}
+
+/// Generates short, cosine-distributed occlusion rays around each hit point
+void GenerateAORays( const Mesh* pMesh, const SceneFrame& rFrame, const Options& rOpts, const std::vector<Ray>& rPrimary,
+                     const std::vector<TriangleRayHit>& rHits, std::vector<Ray>& rRays )
+{
+    Random rng( 1 );
+    rRays.clear();
+    for( size_t i=0; i<rPrimary.size(); i++ )
+    {
+        if( rHits[i].nTriIdx == NO_HIT )
+            continue;
+
+        Vec3f vP, vN;
+        GetHitFrame( pMesh, rPrimary[i], rHits[i], vP, vN );
+        vP += vN*rFrame.fEpsilon;
+
+        for( uint32 j=0; j<rOpts.nAOSamples; j++ )
+        {
+            Ray r( vP, SampleHemisphere( vN, rng ) );
+            r.SetMaxDistance( 0.05f*rFrame.fDiagonal );
+            rRays.push_back( r );
+        }
+    }
+}
+
+/// Traces a set of independent rays.  The rays are clipped to their hits
+WorkloadResult TraceRays( const char* pName, Scene* pScene, const Options& rOpts, std::vector<Ray>& rRays, std::vector<TriangleRayHit>& rHits )
+{
+    int nRays = static_cast<int>( rRays.size() );
+    rHits.resize( rRays.size() );
+    int nHits = 0;
+
+    WorkloadResult result;
+    Timer tm;
+
+    #pragma omp parallel num_threads(rOpts.nThreads) reduction(+:nHits)
+    {
+        ScratchMemory scratch;
+        TraversalStats stats;
+        TraversalStats* pStats = rOpts.bStats ? &stats : NULL;
+
+        #pragma omp for schedule(dynamic,1024)
+        for( int i=0; i<nRays; i++ )
+        {
+            rHits[i].nTriIdx = NO_HIT;
+            pScene->Trace( rRays[i], rHits[i], scratch, pStats );
+            if( rHits[i].nTriIdx != NO_HIT )
+                nHits++;
+        }
+
+        #pragma omp critical
+        result.stats.Accumulate( stats );
+    }
+
+    result.pName = pName;
+    result.fMicroSeconds = static_cast<double>( tm.TickMicroSeconds() );
+    result.nRays = static_cast<uint32>( nRays );
+    result.nHits = static_cast<uint32>( nHits );
+    return result;
+}
+
+/// \brief Traces diffuse paths from each pixel, bouncing until the path leaves the scene or reaches the bounce limit
+/// The bounce rays depend on the previous hits, so ray generation is included in the time
+WorkloadResult TracePaths( Scene* pScene, const SceneFrame& rFrame, const Options& rOpts, const std::vector<Ray>& rPrimary )
+{
+    const Mesh* pMesh = pScene->GetMesh();
+    int nPaths = static_cast<int>( rPrimary.size() );
+    int nRays = 0;
+    int nHits = 0;
+
+    WorkloadResult result;
+    Timer tm;
+
+    #pragma omp parallel num_threads(rOpts.nThreads) reduction(+:nRays,nHits)
+    {
+        ScratchMemory scratch;
+        TraversalStats stats;
+        TraversalStats* pStats = rOpts.bStats ? &stats : NULL;
+
+        #pragma omp for schedule(dynamic,256)
+        for( int i=0; i<nPaths; i++ )
+        {
+            Random rng( static_cast<uint32>( i ) );
+            Ray r = rPrimary[i];
+            for( uint32 nBounce=0; nBounce <= rOpts.nMaxBounces; nBounce++ )
+            {
+                TriangleRayHit hit;
+                hit.nTriIdx = NO_HIT;
+                pScene->Trace( r, hit, scratch, pStats );
+                nRays++;
+                if( hit.nTriIdx == NO_HIT )
+                    break;
+                nHits++;
+
+                Vec3f vP, vN;
+                GetHitFrame( pMesh, r, hit, vP, vN );
+                r = Ray( vP + vN*rFrame.fEpsilon, SampleHemisphere( vN, rng ) );
+            }
+        }
+
+        #pragma omp critical
+        result.stats.Accumulate( stats );
+    }
+
+    result.pName = "path";
+    result.fMicroSeconds = static_cast<double>( tm.TickMicroSeconds() );
+    result.nRays = static_cast<uint32>( nRays );
+    result.nHits = static_cast<uint32>( nHits );
+    return result;
+}
+
+
+//=====================================================================================================================
+//  Reporting
+//=====================================================================================================================
+
+struct SceneResult
+{
+    std::string model;
+    uint32 nTriangles;
+    const char* pStructure;
+    const char* pBuilder;
+    const char* pPrefetch;
+    double fBuildMilliSeconds;
+    size_t nMemoryUsed;
+    size_t nMemoryAllocated;
+    std::vector<WorkloadResult> workloads;
+};
+
+inline double RaysPerSecond( const WorkloadResult& r ) { return r.fMicroSeconds > 0 ? r.nRays / ( r.fMicroSeconds * 1e-6 ) : 0; };
+inline double NanoSecondsPerRay( const WorkloadResult& r ) { return r.nRays ? ( r.fMicroSeconds * 1000.0 ) / r.nRays : 0; };
+inline double PerRay( uint64 nCount, const TraversalStats& s ) { return s.nRays ? static_cast<double>( nCount ) / s.nRays : 0; };
+
+void PrintSceneResult( const SceneResult& r, const Options& rOpts )
+{
+    printf("%-14s %-12s %-12s build: %9.2f ms  memory: %8u KB  prefetch: %s\n", r.model.c_str(), r.pStructure, r.pBuilder,
+           r.fBuildMilliSeconds, static_cast<uint32>( r.nMemoryUsed / 1024 ), r.pPrefetch );
+    for( size_t i=0; i<r.workloads.size(); i++ )
+    {
+        const WorkloadResult& w = r.workloads[i];
+        printf("    %-8s rays: %9u  hits: %9u  Mrays/s: %8.3f  ns/ray: %9.1f\n", w.pName, w.nRays, w.nHits,
+               RaysPerSecond( w ) / 1e6, NanoSecondsPerRay( w ) );
+
+        if( rOpts.bStats )
+        {
+            const TraversalStats& s = w.stats;
+            printf("             per ray:  inner: %7.2f  leaf: %7.2f  box: %7.2f  prim: %7.2f  mailbox: %7.2f   max stack: %u\n",
+                   PerRay( s.nInnerNodes, s ), PerRay( s.nLeafs, s ), PerRay( s.nBoxTests, s ), PerRay( s.nPrimitiveTests, s ),
+                   PerRay( s.nMailboxRejections, s ), s.nMaxStackDepth );
+        }
+    }
+}
+
+void WriteJsonString( FILE* fp, const char* pString )
+{
+    fputc( '"', fp );
+    for( ; *pString; pString++ )
+    {
+        if( *pString == '"' || *pString == '\\' )
+            fputc( '\\', fp );
+        fputc( *pString, fp );
+    }
+    fputc( '"', fp );
+}
+
+bool WriteJson( const char* pFileName, const Options& rOpts, const std::vector<SceneResult>& rResults )
+{
+    FILE* fp = fopen( pFileName, "w" );
+    if( !fp )
+        return false;
+
+    fprintf( fp, "{\n  \"threads\": %u,\n  \"resolution\": %u,\n  \"copies\": %u,\n  \"results\": [\n", rOpts.nThreads, rOpts.nResolution, rOpts.nCopies );
+    for( size_t i=0; i<rResults.size(); i++ )
+    {
+        const SceneResult& r = rResults[i];
+        fprintf( fp, "    {\n      \"model\": " );
+        WriteJsonString( fp, r.model.c_str() );
+        fprintf( fp, ",\n      \"triangles\": %u,\n      \"structure\": \"%s\",\n      \"builder\": \"%s\",\n      \"prefetch\": \"%s\",\n", 
+                 r.nTriangles, r.pStructure, r.pBuilder, r.pPrefetch );
+        fprintf( fp, "      \"build_ms\": %.3f,\n      \"memory_used_bytes\": %lu,\n      \"memory_allocated_bytes\": %lu,\n      \"workloads\": [\n",
+                 r.fBuildMilliSeconds, static_cast<unsigned long>( r.nMemoryUsed ), static_cast<unsigned long>( r.nMemoryAllocated ) );
+
+        for( size_t j=0; j<r.workloads.size(); j++ )
+        {
+            const WorkloadResult& w = r.workloads[j];
+            fprintf( fp, "        { \"name\": \"%s\", \"rays\": %u, \"hits\": %u, \"time_us\": %.0f, \"rays_per_second\": %.1f, \"ns_per_ray\": %.2f",
+                     w.pName, w.nRays, w.nHits, w.fMicroSeconds, RaysPerSecond( w ), NanoSecondsPerRay( w ) );
+
+            if( rOpts.bStats )
+            {
+                const TraversalStats& s = w.stats;
+                fprintf( fp, ",\n          \"stats\": { \"inner_nodes\": %.0f, \"leafs\": %.0f, \"box_tests\": %.0f, \"primitive_tests\": %.0f, "
+                             "\"mailbox_rejections\": %.0f, \"max_stack_depth\": %u }",
+                         static_cast<double>( s.nInnerNodes ), static_cast<double>( s.nLeafs ), static_cast<double>( s.nBoxTests ),
+                         static_cast<double>( s.nPrimitiveTests ), static_cast<double>( s.nMailboxRejections ), s.nMaxStackDepth );
+            }
+            fprintf( fp, " }%s\n", ( j+1 < r.workloads.size() ) ? "," : "" );
+        }
+
+        fprintf( fp, "      ]\n    }%s\n", ( i+1 < rResults.size() ) ? "," : "" );
+    }
+    fprintf( fp, "  ]\n}\n" );
+
+    return fclose( fp ) == 0;
+}
+
+
+//=====================================================================================================================
+//  Driver
+//=====================================================================================================================
+
+/// Replaces a mesh with copies of itself, laid out on a square grid in the XZ plane
+void ReplicateMesh( std::vector<Vec3f>& rVertices, std::vector<uint32>& rIndices, uint32 nCopies )
+{
+    AxisAlignedBox box( rVertices[0], rVertices[0] );
+    for( size_t i=1; i<rVertices.size(); i++ )
+        box.Expand( rVertices[i] );
+    Vec3f vSpacing = ( box.Max() - box.Min() ) * 1.1f;
+
+    uint32 nColumns = static_cast<uint32>( ceil( sqrt( static_cast<double>( nCopies ) ) ) );
+    size_t nVertices = rVertices.size();
+    size_t nIndices = rIndices.size();
+    rVertices.reserve( nVertices*nCopies );
+    rIndices.reserve( nIndices*nCopies );
+
+    for( uint32 c=1; c<nCopies; c++ )
+    {
+        Vec3f vOffset( vSpacing.x * ( c % nColumns ), 0, vSpacing.z * ( c / nColumns ) );
+        uint32 nBase = static_cast<uint32>( rVertices.size() );
+        for( size_t i=0; i<nVertices; i++ )
+            rVertices.push_back( rVertices[i] + vOffset );
+        for( size_t i=0; i<nIndices; i++ )
+            rIndices.push_back( rIndices[i] + nBase );
+    }
+}
+
+/// Runs every structure and workload over one model
+bool BenchmarkModel( const char* pFileName, const Options& rOpts, std::vector<SceneResult>& rResults )
+{
+    std::vector<Vec3f> vertices;
+    std::vector<uint32> indices;
+    if( !LoadPlyMesh( pFileName, vertices, indices, true ) || vertices.empty() || indices.empty() )
+    {
+        printf("Failure loading mesh: '%s'\n", pFileName );
+        return false;
+    }
+
+    if( rOpts.nCopies > 1 )
+        ReplicateMesh( vertices, indices, rOpts.nCopies );
+
+    // report models by file name only, so that results can be compared between machines
+    const char* pModelName = pFileName + strlen( pFileName );
+    while( pModelName != pFileName && pModelName[-1] != '/' && pModelName[-1] != '\\' )
+        pModelName--;
+
+    std::string modelName( pModelName );
+    if( rOpts.nCopies > 1 )
+    {
+        char suffix[16];
+        sprintf( suffix, " x%u", rOpts.nCopies );
+        modelName += suffix;
+    }
+
+    std::vector<Scene*> scenes;
+    CreateScenes( scenes );
+
+    for( size_t s=0; s<scenes.size(); s++ )
+    {
+        Scene* pScene = scenes[s];
+
+        // the builds re-order the triangles, so each structure gets its own copy of the index buffer
+        std::vector<uint32> sceneIndices( indices );
+        Mesh mesh( &vertices[0], &sceneIndices[0], static_cast<uint32>( vertices.size() ), static_cast<uint32>( sceneIndices.size()/3 ) );
+
+        SceneResult result;
+        result.model = modelName;
+        result.nTriangles = mesh.GetObjectCount();
+        result.pStructure = pScene->GetStructureName();
+        result.pBuilder = pScene->GetBuilderName();
+
+        Timer tm;
+        pScene->SetPrefetchMode( rOpts.ePrefetch );
+        pScene->Build( &mesh );
+        result.fBuildMilliSeconds = tm.TickMicroSeconds() / 1000.0;
+        result.pPrefetch = PREFETCH_MODE_NAMES[ pScene->GetPrefetchMode() ];
+        pScene->GetMemoryUsage( result.nMemoryUsed, result.nMemoryAllocated );
+
+        SceneFrame frame;
+        GetSceneFrame( &mesh, frame );
+
+        std::vector<Ray> primary, rays;
+        std::vector<TriangleRayHit> primaryHits, hits;
+
+        GeneratePrimaryRays( frame, rOpts, primary );
+        std::vector<Ray> primaryClipped( primary );
+        result.workloads.push_back( TraceRays( "primary", pScene, rOpts, primaryClipped, primaryHits ) );
+
+        GenerateRandomRays( frame, rOpts, rays );
+        result.workloads.push_back( TraceRays( "random", pScene, rOpts, rays, hits ) );
+
+        GenerateShadowRays( &mesh, frame, primaryClipped, primaryHits, rays );
+        result.workloads.push_back( TraceRays( "shadow", pScene, rOpts, rays, hits ) );
+
+        GenerateAORays( &mesh, frame, rOpts, primaryClipped, primaryHits, rays );
+        result.workloads.push_back( TraceRays( "ao", pScene, rOpts, rays, hits ) );
+
+        result.workloads.push_back( TracePaths( pScene, frame, rOpts, primary ) );
+
+        PrintSceneResult( result, rOpts );
+        rResults.push_back( result );
+
+        // the structure refers to this iteration's mesh, so it must go before the mesh does
+        delete pScene;
+    }
+
+    return true;
+}
+
+
+bool ParsePrefetchMode( const char* pName, PrefetchMode& rMode )
+{
+    for( int i=0; i<4; i++ )
+    {
+        if( !strcmp( pName, PREFETCH_MODE_NAMES[i] ) )
+        {
+            rMode = static_cast<PrefetchMode>( i );
+            return true;
+        }
+    }
+    return false;
+}
+
+int main( int argc, char* argv[] )
+{
+    const char* DEFAULT_MODELS[] =
+    {
+        "../models/ben.ply",
+        "../models/bunny.ply",
+        "../models/elephant.ply",
+        "../models/horse.ply",
+        "../models/sponza.ply",
+        "../models/toasters.ply",
+    };
+
+    Options opts;
+    opts.nThreads = GetParallelThreadCount();
+    opts.nResolution = 512;
+    opts.nRandomRays = 1000000;
+    opts.nAOSamples = 4;
+    opts.nMaxBounces = 3;
+    opts.bStats = false;
+    opts.ePrefetch = PREFETCH_NONE;
+    opts.nCopies = 1;
+
+    const char* pOutputFile = "TRTBenchmark.json";
+    std::vector<const char*> models;
+
+    for( int i=1; i<argc; i++ )
+    {
+        bool bHasValue = ( i+1 < argc );
+        if( !strcmp( argv[i], "-o" ) && bHasValue )
+            pOutputFile = argv[++i];
+        else if( !strcmp( argv[i], "-t" ) && bHasValue )
+            opts.nThreads = std::max( atoi( argv[++i] ), 1 );
+        else if( !strcmp( argv[i], "-r" ) && bHasValue )
+            opts.nResolution = std::max( atoi( argv[++i] ), 1 );
+        else if( !strcmp( argv[i], "-n" ) && bHasValue )
+            opts.nRandomRays = std::max( atoi( argv[++i] ), 0 );
+        else if( !strcmp( argv[i], "-s" ) )
+            opts.bStats = true;
+        else if( !strcmp( argv[i], "-p" ) && bHasValue && ParsePrefetchMode( argv[i+1], opts.ePrefetch ) )
+            i++;
+        else if( !strcmp( argv[i], "-c" ) && bHasValue )
+            opts.nCopies = std::max( atoi( argv[++i] ), 1 );
+        else if( argv[i][0] == '-' )
+        {
+            printf("Usage: %s [-o results.json] [-t threads] [-r resolution] [-n random_rays] [-s] [-p none|nodes|all|auto] [-c copies] [model.ply ...]\n", argv[0] );
+            return 1;
+        }
+        else
+            models.push_back( argv[i] );
+    }
+
+    if( models.empty() )
+        models.insert( models.end(), DEFAULT_MODELS, DEFAULT_MODELS + sizeof(DEFAULT_MODELS)/sizeof(DEFAULT_MODELS[0]) );
+
+    printf("Threads: %u  Resolution: %u x %u  Random rays: %u  Prefetch: %s  Copies: %u\n", opts.nThreads, opts.nResolution, opts.nResolution, 
+           opts.nRandomRays, PREFETCH_MODE_NAMES[opts.ePrefetch], opts.nCopies );
+
+    std::vector<SceneResult> results;
+    for( size_t i=0; i<models.size(); i++ )
+        BenchmarkModel( models[i], opts, results );
+
+    if( !WriteJson( pOutputFile, opts, results ) )
+    {
+        printf("Failure writing results: '%s'\n", pOutputFile );
+        return 1;
+    }
+
+    printf("Results written to: '%s'\n", pOutputFile );
+    return results.empty() ? 1 : 0;
+}
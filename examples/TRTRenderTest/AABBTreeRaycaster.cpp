@@ -76,10 +76,14 @@ AABBTreeRaycaster::~AABBTreeRaycaster()
 //
 //=====================================================================================================================
 
-void AABBTreeRaycaster::RaycastFirstHit( Ray& rRay, TriangleRayHit& rHitInfo )
+void AABBTreeRaycaster::RaycastFirstHit( Ray& rRay, TriangleRayHit& rHitInfo, ScratchMemory& rScratch )
 {
-    static ScratchMemory memory;
-    RaycastBVH( m_pBVH, GetMesh(), rRay, rHitInfo, m_pBVH->GetRoot(), memory );
+    RaycastBVH( m_pBVH, GetMesh(), rRay, rHitInfo, m_pBVH->GetRoot(), rScratch );
+}
+
+void AABBTreeRaycaster::RaycastFirstHit( Ray& rRay, TriangleRayHit& rHitInfo, ScratchMemory& rScratch, TraversalStats& rStats )
+{
+    RaycastBVH( m_pBVH, GetMesh(), rRay, rHitInfo, m_pBVH->GetRoot(), rScratch, rStats );
 }
 
 
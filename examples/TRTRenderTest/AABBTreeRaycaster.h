@@ -29,7 +29,9 @@ public:
 
     ~AABBTreeRaycaster( );
 
-    virtual void RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo ) ;
+    virtual void RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo, TinyRT::ScratchMemory& rScratch ) ;
+
+    virtual void RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo, TinyRT::ScratchMemory& rScratch, TinyRT::TraversalStats& rStats ) ;
 
 private:
 
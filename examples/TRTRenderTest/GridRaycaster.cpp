@@ -38,11 +38,16 @@ GridRaycaster::~GridRaycaster()
 //
 //=====================================================================================================================
 
-void GridRaycaster::RaycastFirstHit( Ray& rRay, TriangleRayHit& rHitInfo )
+void GridRaycaster::RaycastFirstHit( Ray& rRay, TriangleRayHit& rHitInfo, ScratchMemory& )
 {
     RaycastUniformGrid<MailboxType>( m_pGrid, GetMesh(), rRay, rHitInfo );
 }
 
+void GridRaycaster::RaycastFirstHit( Ray& rRay, TriangleRayHit& rHitInfo, ScratchMemory&, TraversalStats& rStats )
+{
+    RaycastUniformGrid<MailboxType>( m_pGrid, GetMesh(), rRay, rHitInfo, rStats );
+}
+
 float GridRaycaster::ComputeCost( float fISectCost ) const
 {
     return GetUniformGridSAHCost( fISectCost, m_pGrid );
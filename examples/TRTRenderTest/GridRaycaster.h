@@ -28,7 +28,9 @@ public:
 
     virtual ~GridRaycaster();
 
-    virtual void RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo ) ;
+    virtual void RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo, TinyRT::ScratchMemory& rScratch ) ;
+
+    virtual void RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo, TinyRT::ScratchMemory& rScratch, TinyRT::TraversalStats& rStats ) ;
     
     virtual float ComputeCost( float fISectCost ) const ;
 
@@ -39,7 +41,8 @@ private:
     UniformGrid<TestMesh>* m_pGrid;
 
     //typedef NullMailbox MailboxType;
-    typedef DirectMapMailbox<uint32,16> MailboxType;
+    //typedef DirectMapMailbox<uint32,16> MailboxType;
+    typedef RayStampMailbox<uint32> MailboxType;
     //typedef FifoMailbox<uint32,8> MailboxType;
     //typedef SimdFifoMailbox<8> MailboxType;
 
@@ -39,11 +39,16 @@ KDTreeRaycaster::~KDTreeRaycaster()
 //
 //=====================================================================================================================
 
-void KDTreeRaycaster::RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo )
+void KDTreeRaycaster::RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo, TinyRT::ScratchMemory& rScratch )
 {
     typedef DirectMapMailbox<TestMesh::obj_id> Mailbox_T;
-    static ScratchMemory scratch;
-    RaycastKDTree<Mailbox_T>( m_pTree, GetMesh(), rRay, rHitInfo, m_pTree->GetRoot(), scratch );
+    RaycastKDTree<Mailbox_T>( m_pTree, GetMesh(), rRay, rHitInfo, m_pTree->GetRoot(), rScratch );
+}
+
+void KDTreeRaycaster::RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo, TinyRT::ScratchMemory& rScratch, TinyRT::TraversalStats& rStats )
+{
+    typedef DirectMapMailbox<TestMesh::obj_id> Mailbox_T;
+    RaycastKDTree<Mailbox_T>( m_pTree, GetMesh(), rRay, rHitInfo, m_pTree->GetRoot(), rScratch, rStats );
 }
 
 
@@ -27,7 +27,9 @@ public:
 
     ~KDTreeRaycaster( );
 
-    virtual void RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo ) ;
+    virtual void RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo, TinyRT::ScratchMemory& rScratch ) ;
+
+    virtual void RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo, TinyRT::ScratchMemory& rScratch, TinyRT::TraversalStats& rStats ) ;
 
 private:
 
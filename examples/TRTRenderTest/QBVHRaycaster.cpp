@@ -35,10 +35,14 @@ QBVHRaycaster::~QBVHRaycaster()
 //
 //=====================================================================================================================
 
-void QBVHRaycaster::RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo )
+void QBVHRaycaster::RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo, TinyRT::ScratchMemory& rScratch )
 {
-    static TinyRT::ScratchMemory s;
-    RaycastMultiBVH( m_pTree, GetMesh(), rRay, rHitInfo, m_pTree->GetRoot(), s);
+    RaycastMultiBVH( m_pTree, GetMesh(), rRay, rHitInfo, m_pTree->GetRoot(), rScratch );
+}
+
+void QBVHRaycaster::RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo, TinyRT::ScratchMemory& rScratch, TinyRT::TraversalStats& rStats )
+{
+    RaycastMultiBVH( m_pTree, GetMesh(), rRay, rHitInfo, m_pTree->GetRoot(), rScratch, rStats );
 }
 
 //=====================================================================================================================
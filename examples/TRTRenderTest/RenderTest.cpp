@@ -18,6 +18,89 @@
 #include "TestUtils.h"
 #include "Timer.h"
 
+//=====================================================================================================================
+/// \brief Distributes image tiles between threads
+///
+///  The tiles are split into one contiguous range per thread.  Threads claim tiles from their own range by atomically
+///   incrementing its counter, and steal from the other ranges once their own is exhausted.  The counters are padded to
+///   separate cache lines, so that threads working on their own ranges do not contend.
+//=====================================================================================================================
+class TileQueue
+{
+public:
+
+    TileQueue( uint32 nTiles, uint32 nWorkers ) : m_ranges( nWorkers )
+    {
+        for( uint32 i=0; i<nWorkers; i++ )
+        {
+            m_ranges[i].nNext = static_cast<int32>( ( nTiles*i ) / nWorkers );
+            m_ranges[i].nEnd  = static_cast<int32>( ( nTiles*(i+1) ) / nWorkers );
+        }
+    };
+
+    /// Claims a tile for a particular worker.  Returns false if there are no tiles left
+    bool NextTile( uint32 nWorker, uint32& rTile )
+    {
+        uint32 nWorkers = static_cast<uint32>( m_ranges.size() );
+        for( uint32 i=0; i<nWorkers; i++ )
+        {
+            Range& rRange = m_ranges[ (nWorker+i) % nWorkers ];
+            if( rRange.nNext >= rRange.nEnd )
+                continue;
+
+            int32 nTile = AtomicAdd( &rRange.nNext, 1 );
+            if( nTile < rRange.nEnd )
+            {
+                rTile = static_cast<uint32>( nTile );
+                return true;
+            }
+        }
+        return false;
+    };
+
+private:
+
+    struct Range
+    {
+        volatile int32 nNext;
+        int32 nEnd;
+        uint8 pad[ TRT_CACHE_LINE_SIZE - 2*sizeof(int32) ];
+    };
+
+    std::vector<Range> m_ranges;
+};
+
+//=====================================================================================================================
+/// Computes a ray rate in millions of rays per second
+//=====================================================================================================================
+static float GetMRaysPerSecond( uint32 nRays, uint32 nMilliseconds )
+{
+    return ( nRays / 1000.0f ) / std::max( nMilliseconds, 1u );
+}
+
+//=====================================================================================================================
+/// Returns the value at a particular fraction of a sorted array (nearest rank)
+//=====================================================================================================================
+static uint32 GetPercentile( const std::vector<uint32>& rSorted, float fFraction )
+{
+    size_t nIndex = static_cast<size_t>( fFraction * rSorted.size() );
+    return rSorted[ std::min( nIndex, rSorted.size()-1 ) ];
+}
+
+//=====================================================================================================================
+/// Maps a value in [0,1] to a heatmap color, ranging from blue, through cyan, green, and yellow, to red
+//=====================================================================================================================
+static void GetHeatColor( float f, float rgb[3] )
+{
+    static const float RAMP[5][3] = { {0,0,1}, {0,1,1}, {0,1,0}, {1,1,0}, {1,0,0} };
+
+    float fPos = std::max( 0.0f, std::min( f, 1.0f ) ) * 4.0f;
+    int i = std::min( static_cast<int>( fPos ), 3 );
+    float t = fPos - i;
+    for( int k=0; k<3; k++ )
+        rgb[k] = RAMP[i][k] + ( RAMP[i+1][k] - RAMP[i][k] )*t;
+}
+
 //=====================================================================================================================
 //
 //         Constructors/Destructors
@@ -46,10 +129,16 @@ void RenderTest::Run( )
     // make sure all tests are deterministic
     srand(0);
 
-    int TILE_SIZE = m_opts.nTileSize;
     int SIZE = m_opts.nImageSize;
     PPMImage image(SIZE,SIZE);
 
+    uint32 nThreads = ( m_opts.nThreads != 0 ) ? m_opts.nThreads : GetParallelThreadCount();
+
+    // per-pixel costs for the heatmap
+    std::vector<uint32> costs;
+    if( m_opts.eHeatmap != HEATMAP_NONE )
+        costs.resize( SIZE*SIZE );
+
     Timer tm;
     
     Vec3f vPosition;
@@ -63,6 +152,8 @@ void RenderTest::Run( )
     uint32 nTime=0;
     uint32 nFrames=0;
 
+    printf("Rendering with %u thread(s)\n", nThreads );
+
     while( m_pViewpoints->GetViewpoint( &vPosition, &vLookAt, &fFOV ) )
     {
         printf("Viewpoint %u of %u...", i++, nViewpoints );
@@ -70,59 +161,16 @@ void RenderTest::Run( )
 
         TinyRT::PerspectiveCamera cam( vPosition, vLookAt-vPosition, Vec3f(0,1,0), fFOV, 1 );
 
-
         tm.Reset();
-        for( int y = 0; y<SIZE; y += TILE_SIZE )
-        {
-            for( int x = 0; x < SIZE; x += TILE_SIZE  )
-            {
-                for( int xi = x; xi < x + TILE_SIZE; xi++ )
-                {
-                    for( int yi = y; yi < y + TILE_SIZE; yi++ )
-                    {
-                        float s = (float) xi / (float) SIZE;
-                        float t = (float) yi / (float) SIZE;
-
-                        TinyRT::TriangleRayHit triHit;
-                        triHit.nTriIdx = 0xffffffff;
-                        triHit.vUVCoords = Vec2f(0,0);
-
-                        
-                        const Vec3f& vOrigin = cam.GetPosition();
-                        Vec3f vDir = cam.GetRayDirectionNDC( Vec2f(s,t) );
-                        
-                        Ray ray( vOrigin, vDir );
-                        m_pRaycaster->RaycastFirstHit( ray, triHit );
-
-                        if( triHit.nTriIdx == 0xffffffff )
-                        {
-                            image.SetPixel( xi, yi, 0,0,0 );
-                        }
-                        else
-                        {
-                            // compute face normal and do N.V shading
-                            TestMesh* pMesh = m_pRaycaster->GetMesh();
-                            Vec3f v0 = pMesh->VertexPosition( pMesh->Index( triHit.nTriIdx, 0 ) );
-                            Vec3f v1 = pMesh->VertexPosition( pMesh->Index( triHit.nTriIdx, 1 ) );
-                            Vec3f v2 = pMesh->VertexPosition( pMesh->Index( triHit.nTriIdx, 2 ) );
-                            Vec3f vNormal = Normalize3( Cross3( v2-v0, v1-v0 ) );
-                            
-                            Vec3f vHit = vOrigin + vDir*ray.MaxDistance();
-                            Vec3f vV = Normalize3( vHit - vOrigin );
-
-                            float f = fabs( Dot3( vV, vNormal ) );
-                            image.SetPixel( xi, yi, f,f,f );
-                        }
-                    }
-                }
-            }
-        }
+        RenderImage( cam, image, costs.empty() ? NULL : &costs[0], nThreads );
 
         uint32 nThisFrameTime = tm.Tick();
         nTime += nThisFrameTime;
         nFrames++;
 
-        printf("Render took: %u ms\n", nThisFrameTime );
+        printf("Render took: %u ms (%.2f Mrays/s)\n", nThisFrameTime, GetMRaysPerSecond( SIZE*SIZE, nThisFrameTime ) );
+        if( !costs.empty() )
+            ReportHeatmap( costs, i-1 );
         fflush( stdout );
 
         // dump images if asked
@@ -207,11 +255,50 @@ void RenderTest::Run( )
         }
     }
 
-    printf("Avg time: %ums\n", nTime / nFrames );
+    printf("Avg time: %ums (%.2f Mrays/s)\n", nTime / nFrames, GetMRaysPerSecond( nFrames*SIZE*SIZE, nTime ) );
 
     m_pViewpoints->Reset();
 }
 
+//=====================================================================================================================
+//=====================================================================================================================
+void RenderTest::RunScalingTest( )
+{
+    int SIZE = m_opts.nImageSize;
+    PPMImage image(SIZE,SIZE);
+
+    Vec3f vPosition;
+    Vec3f vLookAt;
+    float fFOV;
+
+    Timer tm;
+    float fBaseRate = 0;
+    uint32 nMaxThreads = ( m_opts.nThreads != 0 ) ? m_opts.nThreads : GetParallelThreadCount();
+
+    for( uint32 nThreads = 1; nThreads <= nMaxThreads; nThreads = ( nThreads*2 <= nMaxThreads || nThreads == nMaxThreads ) ? nThreads*2 : nMaxThreads )
+    {
+        uint32 nTime = 0;
+        uint32 nRays = 0;
+        while( m_pViewpoints->GetViewpoint( &vPosition, &vLookAt, &fFOV ) )
+        {
+            TinyRT::PerspectiveCamera cam( vPosition, vLookAt-vPosition, Vec3f(0,1,0), fFOV, 1 );
+
+            tm.Reset();
+            RenderImage( cam, image, NULL, nThreads );
+            nTime += tm.Tick();
+            nRays += SIZE*SIZE;
+        }
+        m_pViewpoints->Reset();
+
+        float fRate = GetMRaysPerSecond( nRays, nTime );
+        if( nThreads == 1 )
+            fBaseRate = fRate;
+
+        printf("Threads: %2u  Mrays/s: %8.2f  Speedup: %.2fx\n", nThreads, fRate, ( fBaseRate > 0 ) ? fRate / fBaseRate : 0.0f );
+        fflush( stdout );
+    }
+}
+
 //=====================================================================================================================
 //
 //           Protected Methods
@@ -223,3 +310,132 @@ void RenderTest::Run( )
 //            Private Methods
 //
 //=====================================================================================================================
+
+//=====================================================================================================================
+//=====================================================================================================================
+void RenderTest::ReportHeatmap( const std::vector<uint32>& rCosts, uint32 nViewpoint )
+{
+    std::vector<uint32> sorted( rCosts );
+    std::sort( sorted.begin(), sorted.end() );
+
+    uint32 nP99 = GetPercentile( sorted, 0.99f );
+    printf("    %s per pixel:  p50: %u  p90: %u  p99: %u  max: %u\n", 
+           ( m_opts.eHeatmap == HEATMAP_NODE_VISITS ) ? "Node visits" : "Triangle tests",
+           GetPercentile( sorted, 0.5f ), GetPercentile( sorted, 0.9f ), nP99, sorted.back() );
+
+    if( m_opts.dumpFilePrefix == "" )
+        return;
+
+    int SIZE = m_opts.nImageSize;
+    float fScale = 1.0f / ( ( m_opts.nHeatmapScale != 0 ) ? m_opts.nHeatmapScale : std::max( nP99, 1u ) );
+
+    PPMImage heatmap( SIZE, SIZE );
+    for( int y=0; y<SIZE; y++ )
+    {
+        for( int x=0; x<SIZE; x++ )
+        {
+            float rgb[3];
+            GetHeatColor( rCosts[ y*SIZE + x ] * fScale, rgb );
+            heatmap.SetPixel( x, y, rgb[0], rgb[1], rgb[2] );
+        }
+    }
+
+    char filename[1000];
+    sprintf( filename, "%s_%06d_HEAT.ppm", m_opts.dumpFilePrefix.c_str(), nViewpoint );
+    if( !heatmap.SaveFile( filename ) )
+    {
+        printf("ERROR WRITING IMAGE TO: %s", filename );
+    }
+}
+
+//=====================================================================================================================
+/// Renders an image using a pool of threads.  The tiles are divided into a contiguous range per thread.  Each thread
+///  claims tiles from its own range, and when it runs out, it steals tiles from the other ranges.  This keeps the
+///  threads working on coherent regions of the image, while still balancing the load.
+//=====================================================================================================================
+void RenderTest::RenderImage( const PerspectiveCamera& rCam, PPMImage& rImage, uint32* pCosts, uint32 nThreads )
+{
+#ifndef _OPENMP
+    nThreads = 1;
+#endif
+
+    uint32 nTilesX = ( m_opts.nImageSize + m_opts.nTileSize - 1 ) / m_opts.nTileSize;
+    uint32 nTiles  = nTilesX*nTilesX;
+
+    TileQueue queue( nTiles, nThreads );
+
+    #pragma omp parallel num_threads(nThreads)
+    {
+        // each thread needs its own scratch memory
+        ScratchMemory scratch;
+        uint32 nWorker = GetParallelThreadIndex();
+
+        uint32 nTile;
+        while( queue.NextTile( nWorker, nTile ) )
+            RenderTile( rCam, rImage, pCosts, nTile % nTilesX, nTile / nTilesX, scratch );
+    }
+}
+
+//=====================================================================================================================
+//=====================================================================================================================
+void RenderTest::RenderTile( const PerspectiveCamera& cam, PPMImage& image, uint32* pCosts, uint32 nTileX, uint32 nTileY, ScratchMemory& rScratch )
+{
+    int TILE_SIZE = m_opts.nTileSize;
+    int SIZE = m_opts.nImageSize;
+
+    int x = nTileX*TILE_SIZE;
+    int y = nTileY*TILE_SIZE;
+    int xEnd = std::min( x + TILE_SIZE, SIZE );
+    int yEnd = std::min( y + TILE_SIZE, SIZE );
+
+    for( int xi = x; xi < xEnd; xi++ )
+    {
+        for( int yi = y; yi < yEnd; yi++ )
+        {
+            float s = (float) xi / (float) SIZE;
+            float t = (float) yi / (float) SIZE;
+
+            TinyRT::TriangleRayHit triHit;
+            triHit.nTriIdx = 0xffffffff;
+            triHit.vUVCoords = Vec2f(0,0);
+
+            
+            const Vec3f& vOrigin = cam.GetPosition();
+            Vec3f vDir = cam.GetRayDirectionNDC( Vec2f(s,t) );
+            
+            Ray ray( vOrigin, vDir );
+            if( pCosts )
+            {
+                TraversalStats stats;
+                m_pRaycaster->RaycastFirstHit( ray, triHit, rScratch, stats );
+
+                uint64 nCost = ( m_opts.eHeatmap == HEATMAP_NODE_VISITS ) ? stats.nInnerNodes + stats.nLeafs : stats.nPrimitiveTests;
+                pCosts[ yi*SIZE + xi ] = static_cast<uint32>( nCost );
+            }
+            else
+            {
+                m_pRaycaster->RaycastFirstHit( ray, triHit, rScratch );
+            }
+
+            if( triHit.nTriIdx == 0xffffffff )
+            {
+                image.SetPixel( xi, yi, 0,0,0 );
+            }
+            else
+            {
+                // compute face normal and do N.V shading
+                TestMesh* pMesh = m_pRaycaster->GetMesh();
+                Vec3f v0 = pMesh->VertexPosition( pMesh->Index( triHit.nTriIdx, 0 ) );
+                Vec3f v1 = pMesh->VertexPosition( pMesh->Index( triHit.nTriIdx, 1 ) );
+                Vec3f v2 = pMesh->VertexPosition( pMesh->Index( triHit.nTriIdx, 2 ) );
+                Vec3f vNormal = Normalize3( Cross3( v2-v0, v1-v0 ) );
+                
+                Vec3f vHit = vOrigin + vDir*ray.MaxDistance();
+                Vec3f vV = Normalize3( vHit - vOrigin );
+
+                float f = fabs( Dot3( vV, vNormal ) );
+                image.SetPixel( xi, yi, f,f,f );
+            }
+        }
+    }
+}
@@ -20,6 +20,8 @@ using namespace TinyRT;
 #include "ViewpointGenerator.h"
 #include <string>
 
+class PPMImage;
+
 //=====================================================================================================================
 /// \brief Rendering test harness
 //=====================================================================================================================
@@ -27,12 +29,24 @@ class RenderTest
 {
 public:
 
+    /// Per-pixel costs which can be rendered as a heatmap
+    enum HeatmapMode
+    {
+        HEATMAP_NONE,               ///< No heatmap
+        HEATMAP_NODE_VISITS,        ///< Number of nodes (or grid cells) visited by each primary ray
+        HEATMAP_PRIMITIVE_TESTS     ///< Number of ray-triangle tests performed by each primary ray
+    };
+
     struct Options
     {
         uint32 nImageSize;          ///< Size of images to render
         uint32 nTileSize;           ///< Organize pixels in NxN tiles
         std::string dumpFilePrefix; ///< Path and filename prefix for image files.  If non-empty, then images will be dumped
         std::string goldImagePrefix; ///< Path and filename prefix for 'gold' images.  If non-empty, gold image testing is done
+        uint32 nThreads;            ///< Number of rendering threads.  If 0, TinyRT::GetParallelThreadCount() is used
+        HeatmapMode eHeatmap;       ///< \brief If not HEATMAP_NONE, the cost of each pixel is recorded, and percentiles are reported.
+                                    ///   If dumpFilePrefix is also set, a heatmap image is written next to each shaded image
+        uint32 nHeatmapScale;       ///< Cost which maps to the hottest heatmap color.  If 0, each image is scaled to its own 99th percentile
     };
 
     RenderTest( TestRaycaster* pRC, ViewpointGenerator* pViews, const Options& rOpts );
@@ -41,7 +55,20 @@ public:
 
     virtual void Run( );
 
+    /// Renders all viewpoints with increasing numbers of threads, and reports rays/s for each thread count
+    void RunScalingTest( );
+
 private:
+
+    /// \brief Renders one image, using the specified number of threads
+    /// If pCosts is non-NULL, it receives the cost of each pixel, as selected by the heatmap mode
+    void RenderImage( const PerspectiveCamera& rCam, PPMImage& rImage, uint32* pCosts, uint32 nThreads );
+
+    /// Renders one tile of an image
+    void RenderTile( const PerspectiveCamera& rCam, PPMImage& rImage, uint32* pCosts, uint32 nTileX, uint32 nTileY, ScratchMemory& rScratch );
+
+    /// Reports percentiles of the per-pixel costs for a viewpoint, and writes the heatmap image if asked
+    void ReportHeatmap( const std::vector<uint32>& rCosts, uint32 nViewpoint );
     
     Options m_opts;
     TestRaycaster* m_pRaycaster;
@@ -16,6 +16,12 @@
 #include <iostream>
 
 #include "TinyRT.h"
+#include "TRTBuildCache.h"
+#include "TRTSharedMemory.h"
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
 
 using namespace TinyRT;
 
@@ -69,27 +75,337 @@ void RandomRayTest( TestRaycaster* pCast, int nRays )
     TestMesh* pMesh = pCast->GetMesh();
     pMesh->GetAABB( box );
 
+    // generate the rays up front, since rand() is not thread-safe
+    std::vector<TinyRT::Vec3f> endpoints( 2*nRays );
+    for( int i=0; i<2*nRays; i++ )
+    {
+        TinyRT::Vec3f vS = TinyRT::Vec3f( RandomFloat(), RandomFloat(), RandomFloat() );
+        for(int j=0; j<3; j++ )
+            endpoints[i][j] = Lerp( box.Min()[j], box.Max()[j], vS[j] );
+    }
+
+    uint32 nMaxThreads = GetParallelThreadCount();
+    float fBaseRate = 0;
+    for( uint32 nThreads = 1; nThreads <= nMaxThreads; nThreads = ( nThreads*2 <= nMaxThreads || nThreads == nMaxThreads ) ? nThreads*2 : nMaxThreads )
+    {
+        Timer tm;
+
+        #pragma omp parallel num_threads(nThreads)
+        {
+            ScratchMemory scratch;
+
+            #pragma omp for schedule(dynamic,1024)
+            for( int i=0; i<nRays; i++ )
+            {
+                const TinyRT::Vec3f& vS1 = endpoints[2*i];
+                const TinyRT::Vec3f& vS2 = endpoints[2*i+1];
+
+                TinyRT::Ray r( vS1, vS2-vS1 );
+                TriangleRayHit hit;
+                pCast->RaycastFirstHit( r, hit, scratch );
+            }
+        }
+
+        uint32 nTime = std::max( tm.Tick(), 1u );
+        float fRate = nRays / (nTime/1000.0f);
+        if( nThreads == 1 )
+            fBaseRate = fRate;
+
+        printf("Threads: %2u  Time: %u.  Rays/s: %.2f  Speedup: %.2fx\n", nThreads, nTime, fRate, fRate / fBaseRate );
+    }
+
+}
+
+template< class Tree_T >
+void RefitTest( TestMesh* pMesh, Tree_T* pTree, float fTriCost )
+{
+    ConstantCost<uint32> costFunc( fTriCost );
+    SAHQualityMonitor< ConstantCost<uint32> > monitor( costFunc );
+    monitor.Reset( pTree );
+
+    // the mesh hasn't moved, so refitting should leave the tree unchanged
+    Timer tm;
+    pTree->Refit( pMesh );
+    uint32 nSerialTime = tm.Tick();
+    tm.Reset();
+    pTree->RefitParallel( pMesh );
+    uint32 nParallelTime = tm.Tick();
+
+    printf("Refit took: %u ms.  Parallel refit (%u threads) took: %u ms\n", nSerialTime, GetParallelThreadCount(), nParallelTime );
+    printf("SAH degradation after refit: %.3f\n", monitor.Update( pTree ) );
+}
+
+void DynamicUpdateTest( TestMesh* pMesh, AABBTree<TestMesh>* pTree, float fTriCost )
+{
+    ConstantCost<uint32> costFunc( fTriCost );
+    SAHQualityMonitor< ConstantCost<uint32> > monitor( costFunc );
+    monitor.Reset( pTree );
+
+    // pull out every tenth object and put it back, as an editor would when moving props around
+    uint32 nObjects = pMesh->GetObjectCount();
+    Timer tm;
+    for( uint32 i=0; i<nObjects; i += 10 )
+        pTree->Remove( pMesh, i );
+    uint32 nRemoveTime = tm.Tick();
+    tm.Reset();
+    for( uint32 i=0; i<nObjects; i += 10 )
+        pTree->Insert( pMesh, i );
+    uint32 nInsertTime = tm.Tick();
+
+    printf("Dynamic update of %u objects.  Remove took: %u ms.  Insert took: %u ms\n", (nObjects+9)/10, nRemoveTime, nInsertTime );
+    printf("SAH degradation after dynamic update: %.3f\n", monitor.Update( pTree ) );
+}
+
+template< class Tree_T >
+void SerializationTest( const Tree_T* pTree )
+{
+    const char* pFileName = "serialization_test.trt";
+
     Timer tm;
-    for( int i=0; i<nRays; i++ )
+    if( !pTree->Save( pFileName ) )
     {
-        TinyRT::Vec3f vS1 = TinyRT::Vec3f( RandomFloat(), RandomFloat(), RandomFloat() );
-        TinyRT::Vec3f vS2 = TinyRT::Vec3f( RandomFloat(), RandomFloat(), RandomFloat() );
+        printf("ERROR SAVING TREE\n");
+        return;
+    }
+    uint32 nSaveTime = tm.Tick();
+    tm.Reset();
 
-        for(int j=0; j<3; j++ )
+    // the loaded tree uses the mapped file in place, so loading time should not depend on the size of the tree
+    MappedFile file;
+    Tree_T loaded;
+    bool bLoaded = file.Open( pFileName ) && loaded.Attach( file.GetData(), file.GetSize() );
+    uint32 nLoadTime = tm.Tick();
+
+    if( bLoaded )
+    {
+        TreeStatistics before, after;
+        GetTreeStatistics( before, pTree );
+        GetTreeStatistics( after, &loaded );
+        bool bMatch = before.nNodes == after.nNodes && before.nLeafs == after.nLeafs && before.nTotalObjects == after.nTotalObjects &&
+                      before.nMaxLeafDepth == after.nMaxLeafDepth && pTree->GetStackDepth() == loaded.GetStackDepth();
+
+        printf("Save took: %u ms.  Load took: %u ms (%u KB).  Loaded tree %s\n", nSaveTime, nLoadTime,
+               (uint32)( file.GetSize()/1024 ), bMatch ? "matches" : "DOES NOT MATCH" );
+    }
+    else
+    {
+        printf("ERROR LOADING TREE\n");
+    }
+
+    file.Close();
+    remove( pFileName );
+}
+
+/// Layout of a mesh and its tree in a shared memory segment.  Offsets are relative to the start of the segment
+struct SharedSceneHeader
+{
+    uint32 nVertices;
+    uint32 nTriangles;
+    uint64 nVertexOffset;
+    uint64 nIndexOffset;
+    uint64 nTreeOffset;
+    uint64 nTreeSize;
+};
+
+inline uint64 AlignSharedOffset( uint64 nOffset )
+{
+    return ( nOffset + TRT_SERIALIZED_ALIGNMENT-1 ) & ~(uint64)(TRT_SERIALIZED_ALIGNMENT-1);
+}
+
+/// Traces a ray through a QBVH, for CountMismatches
+template< class ObjectSet_T, class HandleTraits_T >
+inline void RaycastTestTree( const QuadAABBTree<ObjectSet_T,HandleTraits_T>* pTree, const ObjectSet_T* pMesh, 
+                             TinyRT::Ray& rRay, TriangleRayHit& rHit )
+{
+    RaycastMultiBVH( pTree, pMesh, rRay, rHit, pTree->GetRoot() );
+}
+
+/// Traces a ray through a KD-tree, for CountMismatches
+template< class ObjectSet_T, class HandleTraits_T >
+inline void RaycastTestTree( const KDTree<ObjectSet_T,HandleTraits_T>* pTree, const ObjectSet_T* pMesh, 
+                             TinyRT::Ray& rRay, TriangleRayHit& rHit )
+{
+    RaycastKDTree< DirectMapMailbox<uint32,16> >( pTree, pMesh, rRay, rHit, pTree->GetRoot() );
+}
+
+/// \brief Traces the same 10000 random rays through two trees, and counts the rays for which they find different hits
+/// The rays are placed within the bounding box of the first mesh
+template< class TreeA_T, class MeshA_T, class TreeB_T, class MeshB_T >
+uint32 CountMismatches( const TreeA_T* pTreeA, const MeshA_T* pMeshA, const TreeB_T* pTreeB, const MeshB_T* pMeshB )
+{
+    AxisAlignedBox box;
+    pMeshA->GetAABB( box );
+    srand(0);
+
+    uint32 nMismatches = 0;
+    for( int i=0; i<10000; i++ )
+    {
+        TinyRT::Vec3f v[2];
+        for( int j=0; j<3; j++ )
         {
-            vS1[j] = Lerp( box.Min()[j], box.Max()[j], vS1[j] );
-            vS2[j] = Lerp( box.Min()[j], box.Max()[j], vS2[j] );
+            v[0][j] = Lerp( box.Min()[j], box.Max()[j], RandomFloat() );
+            v[1][j] = Lerp( box.Min()[j], box.Max()[j], RandomFloat() );
         }
 
-        TinyRT::Ray r( vS1, vS2-vS1 );
-        TriangleRayHit hit;
-        pCast->RaycastFirstHit( r, hit );
+        TinyRT::Ray r0( v[0], v[1]-v[0] );
+        TinyRT::Ray r1( v[0], v[1]-v[0] );
+        TriangleRayHit h0, h1;
+        h0.nTriIdx = h1.nTriIdx = 0xffffffff;
+        RaycastTestTree( pTreeA, pMeshA, r0, h0 );
+        RaycastTestTree( pTreeB, pMeshB, r1, h1 );
+        if( h0.nTriIdx != h1.nTriIdx || r0.MaxDistance() != r1.MaxDistance() )
+            nMismatches++;
+    }
+
+    return nMismatches;
+}
+
+/// \brief Opens the scene which SharedMemoryTest places in shared memory, and counts the rays for which it finds different hits than the private copy.
+/// Returns 0xffffffff if the segment could not be opened or attached.  If 'bRetry' is set, this waits for the segment to be published
+uint32 CheckSharedScene( const char* pName, TestMesh* pMesh, const QuadAABBTree<TestMesh>* pTree, bool bRetry )
+{
+    typedef BasicMesh<TinyRT::Vec3f,uint32> SharedMesh;
+
+    // worker processes may start before the creator has published the segment, so they retry until it is ready
+    SharedMemory view;
+    bool bOpened = view.Open( pName );
+    for( int i=0; i<1000 && !bOpened && bRetry; i++ )
+    {
+#ifdef _WIN32
+        Sleep( 10 );
+#else
+        usleep( 10000 );
+#endif
+        bOpened = view.Open( pName );
+    }
+    if( !bOpened )
+        return 0xffffffff;
+
+    // the mesh is never re-ordered, so its read-only arrays are never written
+    const uint8* pView = reinterpret_cast<const uint8*>( view.GetData() );
+    const SharedSceneHeader* pHeader = reinterpret_cast<const SharedSceneHeader*>( pView );
+    SharedMesh mesh( const_cast<TinyRT::Vec3f*>( reinterpret_cast<const TinyRT::Vec3f*>( pView + pHeader->nVertexOffset ) ),
+                     const_cast<uint32*>( reinterpret_cast<const uint32*>( pView + pHeader->nIndexOffset ) ),
+                     pHeader->nVertices, pHeader->nTriangles );
+
+    QuadAABBTree<SharedMesh> tree;
+    if( !tree.Attach( pView + pHeader->nTreeOffset, static_cast<size_t>( pHeader->nTreeSize ) ) )
+        return 0xffffffff;
+
+    // make sure the shared tree finds the same hits as the private one
+    return CountMismatches( pTree, pMesh, &tree, &mesh );
+}
+
+void SharedMemoryTest( TestMesh* pMesh, const QuadAABBTree<TestMesh>* pTree )
+{
+    const char* pName = "/TRTRenderTest";
+
+    SharedSceneHeader header;
+    header.nVertices = pMesh->GetVertexCount();
+    header.nTriangles = pMesh->GetObjectCount();
+    header.nVertexOffset = AlignSharedOffset( sizeof(SharedSceneHeader) );
+    header.nIndexOffset = AlignSharedOffset( header.nVertexOffset + header.nVertices*sizeof(TinyRT::Vec3f) );
+    header.nTreeOffset = AlignSharedOffset( header.nIndexOffset + 3*header.nTriangles*sizeof(uint32) );
+    header.nTreeSize = pTree->SaveToBuffer( NULL, 0 );
+
+    SharedMemory::Remove( pName ); // in case a previous run did not clean up
+
+#ifndef _WIN32
+    // start a worker process before the segment exists, to make sure that it waits for the segment to be published.
+    //  The worker inherits a private copy of the mesh and tree to compare against
+    fflush( stdout );
+    pid_t nWorker = fork();
+    if( nWorker == 0 )
+        _exit( CheckSharedScene( pName, pMesh, pTree, true ) == 0 ? 0 : 1 );
+#endif
+
+    // the first process places the mesh and tree in the segment
+    Timer tm;
+    SharedMemory segment;
+    if( !segment.Create( pName, static_cast<size_t>( header.nTreeOffset + header.nTreeSize ) ) )
+    {
+        printf("ERROR CREATING SHARED MEMORY\n");
+#ifndef _WIN32
+        if( nWorker > 0 )
+            waitpid( nWorker, NULL, 0 );
+#endif
+        return;
+    }
+
+    uint8* pBytes = reinterpret_cast<uint8*>( segment.GetWritableData() );
+    memcpy( pBytes, &header, sizeof(header) );
+    memcpy( pBytes + header.nVertexOffset, pMesh->VertexArray(), header.nVertices*sizeof(TinyRT::Vec3f) );
+    memcpy( pBytes + header.nIndexOffset, pMesh->IndexArray(), 3*header.nTriangles*sizeof(uint32) );
+    pTree->SaveToBuffer( pBytes + header.nTreeOffset, static_cast<size_t>( header.nTreeSize ) );
+
+    // nobody may open the segment until it is published
+    SharedMemory early;
+    bool bOpenedEarly = early.Open( pName );
+    segment.Publish();
+    uint32 nCreateTime = tm.Tick();
+    tm.Reset();
+
+    // the other processes open read-only views, and use the mesh and tree in place
+    uint32 nMismatches = CheckSharedScene( pName, pMesh, pTree, false );
+    uint32 nOpenTime = tm.Tick();
+
+    const char* pWorkerResult = "no worker";
+#ifndef _WIN32
+    int nStatus = -1;
+    if( nWorker > 0 && waitpid( nWorker, &nStatus, 0 ) == nWorker )
+        pWorkerResult = ( WIFEXITED( nStatus ) && WEXITSTATUS( nStatus ) == 0 ) ? "worker OK" : "WORKER FAILED";
+    else
+        pWorkerResult = "ERROR STARTING WORKER";
+#endif
+
+    if( nMismatches == 0xffffffff )
+        printf("Shared memory: %u KB.  Create took: %u ms.  ERROR OPENING SHARED MEMORY\n", (uint32)( segment.GetSize()/1024 ), nCreateTime );
+    else
+        printf("Shared memory: %u KB.  Create took: %u ms.  Open and test took: %u ms.  %u mismatches, %s%s\n",
+               (uint32)( segment.GetSize()/1024 ), nCreateTime, nOpenTime, nMismatches, pWorkerResult, 
+               bOpenedEarly ? ", ERROR: OPENED BEFORE PUBLISH" : "" );
+
+    segment.Close();
+    SharedMemory::Remove( pName );
+}
+
+/// Builds a tree with CompactTreeHandles and one with LargeTreeHandles, and makes sure that they find the same hits
+template< template< class, class > class Tree_T, class Builder_T >
+void LargeTreeHandlesTest( TestMesh* pMesh, const Builder_T& rBuilder )
+{
+    typedef BasicMesh<TinyRT::Vec3f,uint32> CopyMesh;
+
+    // the builders may re-order the mesh, so each tree is built over its own copy
+    uint32 nVertices = pMesh->GetVertexCount();
+    uint32 nTriangles = pMesh->GetObjectCount();
+    std::vector<TinyRT::Vec3f> vertices[2];
+    std::vector<uint32> indices[2];
+    for( int i=0; i<2; i++ )
+    {
+        vertices[i].assign( pMesh->VertexArray(), pMesh->VertexArray() + nVertices );
+        indices[i].assign( pMesh->IndexArray(), pMesh->IndexArray() + 3*nTriangles );
     }
 
+    CopyMesh compactMesh( &vertices[0][0], &indices[0][0], nVertices, nTriangles );
+    CopyMesh largeMesh( &vertices[1][0], &indices[1][0], nVertices, nTriangles );
+
+    Builder_T compactBuilder( rBuilder );
+    Builder_T largeBuilder( rBuilder );
+    Tree_T<CopyMesh,CompactTreeHandles> compactTree;
+    Tree_T<CopyMesh,LargeTreeHandles> largeTree;
+    if( !compactTree.Build( &compactMesh, compactBuilder ) || !largeTree.Build( &largeMesh, largeBuilder ) )
+    {
+        printf("Large tree handles: ERROR: tree is too large for its handles\n");
+        return;
+    }
 
-    uint32 nTime = tm.Tick();
-    printf("Time: %u.  Rays/s: %.2f\n", nTime, nRays / (nTime/1000.0f) );
+    uint32 nMismatches = CountMismatches( &compactTree, &compactMesh, &largeTree, &largeMesh );
 
+    size_t nCompactUsed, nCompactAllocated, nLargeUsed, nLargeAllocated;
+    compactTree.GetMemoryUsage( nCompactUsed, nCompactAllocated );
+    largeTree.GetMemoryUsage( nLargeUsed, nLargeAllocated );
+    printf("Large tree handles: %u KB (compact handles: %u KB).  %u mismatches\n", 
+           (uint32)( nLargeUsed/1024 ), (uint32)( nCompactUsed/1024 ), nMismatches );
 }
 
 template< class AABBTreeBuilder_T >
@@ -106,11 +422,17 @@ void DoBVHTest( TestMesh* pMesh, AABBTreeBuilder_T& builder, float fTriCost, Vie
     float fCost = GetAABBTreeSAHCost( ConstantCost<uint32>(fTriCost), pBVH, pBVH->GetRoot() );
     printf("SAH cost: %f\n", fCost );
 
+    RefitTest( pMesh, pBVH, fTriCost );
+    SerializationTest( pBVH );
+
     AABBTreeRaycaster rc( pMesh, pBVH );
     RandomRayTest( &rc, 1000000 );
 
     RenderTest rt( &rc, pViews, renderOpts );
     rt.Run();
+
+    // this degrades the tree, so it runs after the timings of the builder's output
+    DynamicUpdateTest( pMesh, pBVH, fTriCost );
 }
 
 
@@ -126,11 +448,19 @@ void DoQBVHTest( TestMesh* pMesh, float fTriCost, ViewpointGenerator* pViews, Re
 
     PrintTreeStats( pTree );
 
+    printf("SAH cost: %f\n", GetQuadAABBTreeSAHCost( fTriCost, pTree, pTree->GetRoot() ) );
+
+    RefitTest( pMesh, pTree, fTriCost );
+    SerializationTest( pTree );
+    SharedMemoryTest( pMesh, pTree );
+    LargeTreeHandlesTest<QuadAABBTree>( pMesh, SahAABBTreeBuilder< BasicMesh<TinyRT::Vec3f,uint32> >( fTriCost ) );
+
     QBVHRaycaster rc( pMesh, pTree );
     RandomRayTest( &rc, 1000000 );
 
     RenderTest rt( &rc, pViews, renderOpts );
     rt.Run();
+    rt.RunScalingTest();
 }
 
 
@@ -175,6 +505,11 @@ void TestGrid( TestMesh* pMesh, ViewpointGenerator* pViews, RenderTest::Options&
     printf("Cell count: %u\n", rc.GetGrid()->GetCellCounts().x * rc.GetGrid()->GetCellCounts().y * rc.GetGrid()->GetCellCounts().z );
     printf("SAH cost: %f\n", GetUniformGridSAHCost( 3.0f, rc.GetGrid() ) );
 
+    size_t nMemUsed, nMemAllocated;
+    rc.GetGrid()->GetMemoryUsage( nMemUsed, nMemAllocated );
+    printf("Cell storage: %s\n", rc.GetGrid()->IsSparse() ? "sparse" : "dense" );
+    printf("Memory used/allocated(KB): %u / %u\n", (uint32) (nMemUsed/1024), (uint32) (nMemAllocated/1024) );
+
     RandomRayTest( &rc, 1000000 );
 
     RenderTest rt( &rc, pViews, renderOpts );
@@ -202,6 +537,9 @@ void TestKDTree( TestMesh* pMesh, ViewpointGenerator* pViews, RenderTest::Option
 
     printf("SAH cost: %f\n", GetKDTreeSAHCost( ISECT_COST, pTree, pTree->GetRoot(), pTree->GetBoundingBox() ) );
 
+    SerializationTest( pTree );
+    LargeTreeHandlesTest<KDTree>( pMesh, SahKDTreeBuilder< BasicMesh<TinyRT::Vec3f,uint32>, BasicMesh<TinyRT::Vec3f,uint32>::Clipper >( ISECT_COST ) );
+
     KDTreeRaycaster rc( pMesh, pTree );
 
     RandomRayTest( &rc, 1000000 );
@@ -213,36 +551,147 @@ void TestKDTree( TestMesh* pMesh, ViewpointGenerator* pViews, RenderTest::Option
 
 
 
-/// Simple little mailboxing performance tester
-template< class Mailbox_T, int TEST_VAL_COUNT >
-long MailboxPerf(  )
+void BuildCacheTest( const char* pModelFile )
 {
-    Mailbox_T mb;
-    int nTestVals[TEST_VAL_COUNT];
-    for( int i=0; i<TEST_VAL_COUNT; i++ )
-        nTestVals[i] = rand();
+    printf("BUILD CACHE\n");
+    printf("================\n");
+
+    // the cache is kept in the working directory, so only the first run of the test should need to build the tree
+    BuildCache cache( "." );
+    SahAABBTreeBuilder< RemapRecorder<TestMesh> > builder( 1.0f );
+
+    for( int i=0; i<2; i++ )
+    {
+        // the cache is keyed by the mesh contents, so each lookup must use the mesh in its original order
+        TestMesh* pMesh = TestMesh::LoadPly( pModelFile, true );
+        if( !pMesh )
+            return;
+
+        Timer tm;
+        AABBTree<TestMesh> tree;
+        bool bHit = cache.GetAABBTree( pMesh, &tree, builder );
+        printf("Cache %s.  Took: %u ms\n", bHit ? "hit" : "miss", tm.Tick() );
+
+        delete pMesh;
+    }
+}
+
 
+/// A set of rays used to compare mailboxes
+struct MailboxWorkload
+{
+    const char* pName;
+    std::vector<TinyRT::Vec3f> origins;
+    std::vector<TinyRT::Vec3f> directions;
+};
+
+/// Traces a workload through a KD-tree and a grid using a particular mailbox, and reports the time and intersection test counts
+template< class Mailbox_T >
+void MailboxPerf( const char* pMailboxName, TestMesh* pMesh, const KDTree<TestMesh>* pTree, const UniformGrid<TestMesh>* pGrid, 
+                  const MailboxWorkload& rWork )
+{
+    ScratchMemory scratch;
+    size_t nRays = rWork.origins.size();
+
+    // the timed pass does not collect statistics, so that the counting overhead does not hide the mailbox overhead
     Timer tm;
+    for( size_t i=0; i<nRays; i++ )
+    {
+        TinyRT::Ray r( rWork.origins[i], rWork.directions[i] );
+        TriangleRayHit hit;
+        RaycastKDTree<Mailbox_T>( pTree, pMesh, r, hit, pTree->GetRoot(), scratch );
+    }
+    uint32 nKDTime = tm.Tick();
+    tm.Reset();
 
-    for(int i=0; i<10000000; i++ )
+    for( size_t i=0; i<nRays; i++ )
     {
-        mb.CheckMailbox(nTestVals[i%TEST_VAL_COUNT]);
+        TinyRT::Ray r( rWork.origins[i], rWork.directions[i] );
+        TriangleRayHit hit;
+        RaycastUniformGrid<Mailbox_T>( pGrid, pMesh, r, hit );
     }
+    uint32 nGridTime = tm.Tick();
 
-    return tm.Tick();
-}
+    TraversalStats kdStats, gridStats;
+    for( size_t i=0; i<nRays; i++ )
+    {
+        TinyRT::Ray r( rWork.origins[i], rWork.directions[i] );
+        TriangleRayHit hit;
+        RaycastKDTree<Mailbox_T>( pTree, pMesh, r, hit, pTree->GetRoot(), scratch, kdStats );
 
+        TinyRT::Ray r2( rWork.origins[i], rWork.directions[i] );
+        TriangleRayHit hit2;
+        RaycastUniformGrid<Mailbox_T>( pGrid, pMesh, r2, hit2, gridStats );
+    }
+
+    printf( "%-8s %-16s KD: %5u ms  tests/ray: %6.2f   Grid: %5u ms  tests/ray: %6.2f\n", rWork.pName, pMailboxName, 
+            nKDTime, kdStats.nPrimitiveTests / (float) nRays, nGridTime, gridStats.nPrimitiveTests / (float) nRays );
+}
 
+template< class Mailbox_T >
+void MailboxPerf( const char* pMailboxName, TestMesh* pMesh, const KDTree<TestMesh>* pTree, const UniformGrid<TestMesh>* pGrid, 
+                  const std::vector<MailboxWorkload>& rWorkloads )
+{
+    for( size_t i=0; i<rWorkloads.size(); i++ )
+        MailboxPerf<Mailbox_T>( pMailboxName, pMesh, pTree, pGrid, rWorkloads[i] );
+}
 
-template<int SIZE>
-void MailboxPerfTest()
+/// Compares the mailboxes on real traversals, using random rays (incoherent), and primary rays from the first viewpoint (coherent)
+void MailboxPerfTest( TestMesh* pMesh, ViewpointGenerator* pViews )
 {
-    printf("--------------\n");
-    printf("SIZE:     %u\n", SIZE );
-    printf("--------------\n");
-    printf("Fifo:     %u\n", MailboxPerf< FifoMailbox<int,SIZE>,128 >() );
-    printf("DM:       %u\n", MailboxPerf< DirectMapMailbox<int,SIZE>,128 >() );
-    printf("SIMDFifo: %u\n", MailboxPerf< SimdFifoMailbox<SIZE>,128 >() );
+    printf("MAILBOX PERFORMANCE\n");
+    printf("================\n");
+
+    KDTree<TestMesh> tree;
+    SahKDTreeBuilder<TestMesh, TestMesh::Clipper > builder( 3.0f );
+    tree.Build( pMesh, builder );
+
+    UniformGrid<TestMesh> grid;
+    grid.Build( pMesh, 100 );
+
+    std::vector<MailboxWorkload> workloads( 2 );
+
+    srand(0);
+    AxisAlignedBox box;
+    pMesh->GetAABB( box );
+    workloads[0].pName = "random";
+    for( int i=0; i<200000; i++ )
+    {
+        TinyRT::Vec3f vS1, vS2;
+        for(int j=0; j<3; j++ )
+        {
+            vS1[j] = Lerp( box.Min()[j], box.Max()[j], RandomFloat() );
+            vS2[j] = Lerp( box.Min()[j], box.Max()[j], RandomFloat() );
+        }
+        workloads[0].origins.push_back( vS1 );
+        workloads[0].directions.push_back( vS2-vS1 );
+    }
+
+    workloads[1].pName = "primary";
+    Vec3f vPosition, vLookAt;
+    float fFOV;
+    pViews->Reset();
+    if( pViews->GetViewpoint( &vPosition, &vLookAt, &fFOV ) )
+    {
+        const uint32 SIZE = 512;
+        TinyRT::PerspectiveCamera cam( vPosition, vLookAt-vPosition, Vec3f(0,1,0), fFOV, 1 );
+        for( uint32 y=0; y<SIZE; y++ )
+        {
+            for( uint32 x=0; x<SIZE; x++ )
+            {
+                workloads[1].origins.push_back( cam.GetPosition() );
+                workloads[1].directions.push_back( cam.GetRayDirectionNDC( Vec2f( x / (float) SIZE, y / (float) SIZE ) ) );
+            }
+        }
+    }
+    pViews->Reset();
+
+    MailboxPerf< NullMailbox >                           ( "Null",          pMesh, &tree, &grid, workloads );
+    MailboxPerf< FifoMailbox<uint32,8> >                 ( "Fifo8",         pMesh, &tree, &grid, workloads );
+    MailboxPerf< DirectMapMailbox<uint32,8> >            ( "DM8",           pMesh, &tree, &grid, workloads );
+    MailboxPerf< DirectMapMailbox<uint32,16> >           ( "DM16",          pMesh, &tree, &grid, workloads );
+    MailboxPerf< RayStampMailbox<uint32> >               ( "RayStamp",      pMesh, &tree, &grid, workloads );
+    MailboxPerf< HashedRayStampMailbox<uint32> >         ( "HashedStamp",   pMesh, &tree, &grid, workloads );
 }
 
 
@@ -250,26 +699,34 @@ int main()
 {
     printf("Loading mesh\n");
 
-    TestMesh* pMesh = TestMesh::LoadPly( "..\\models\\bunny.ply", true );
+    // the mesh cache is kept in the working directory.  After the first run, the mesh is mapped directly from the cache
+    Timer loadTimer;
+    TestMesh* pMesh = TestMesh::LoadCached( "..\\models\\bunny.ply", "bunny.trtmesh", true );
     if( !pMesh )
     {
         printf("ERROR LOADING MODEL\n");
         return 1;
     }
+    printf("Load took: %u ms\n", loadTimer.Tick() );
 
     RenderTest::Options renderOpts;
     renderOpts.dumpFilePrefix = "test";
     renderOpts.goldImagePrefix = "";//"goldimages\\bunny\\test";
     renderOpts.nImageSize = 256;
     renderOpts.nTileSize = 4;
+    renderOpts.nThreads = 0;
+    renderOpts.eHeatmap = RenderTest::HEATMAP_NONE; // or HEATMAP_NODE_VISITS, HEATMAP_PRIMITIVE_TESTS
+    renderOpts.nHeatmapScale = 0;
 
     AxisAlignedBox meshBox;
     pMesh->GetAABB( meshBox );
 
     BoundingBoxViewpointGenerator views( meshBox, 10 );
+    BuildCacheTest( "..\\models\\bunny.ply" );
     TestKDTree( pMesh, &views, renderOpts );
     TestBVH( pMesh, &views, renderOpts );
     TestGrid( pMesh, &views, renderOpts );
+    MailboxPerfTest( pMesh, &views );
 
 
 
@@ -14,6 +14,7 @@
 
 #include "TestMesh.h"
 #include "PlyLoad.h"
+#include "MeshCache.h"
 
 
 /// \brief Reorders vertices in a mesh in order to optimize memory locality for the vertex data
@@ -59,8 +60,14 @@ void OptimizeVertexOrder( Vertex_T* pVB, Index_T* pIB, uint nVertices, uint nInd
 //=====================================================================================================================
 
 TestMesh::TestMesh(  std::vector<Vec3f>* pPositions, std::vector<uint32>* pIndices )
-: m_pVertexArray( pPositions ), m_pIndexArray(pIndices),
-  BasicMesh<Vec3f,uint32>( &pPositions->at(0), &pIndices->at(0), pPositions->size(), pIndices->size()/3 )
+: BasicMesh<Vec3f,uint32>( &pPositions->at(0), &pIndices->at(0), pPositions->size(), pIndices->size()/3 ),
+  m_pVertexArray( pPositions ), m_pIndexArray(pIndices), m_pCacheFile( NULL )
+{
+}
+
+TestMesh::TestMesh( MeshCacheFile* pCacheFile )
+: BasicMesh<Vec3f,uint32>( pCacheFile->GetVertices(), pCacheFile->GetIndices(), pCacheFile->GetVertexCount(), pCacheFile->GetTriangleCount() ),
+  m_pVertexArray( NULL ), m_pIndexArray( NULL ), m_pCacheFile( pCacheFile )
 {
 }
 
@@ -68,6 +75,7 @@ TestMesh::~TestMesh()
 {
     delete m_pVertexArray;
     delete m_pIndexArray;
+    delete m_pCacheFile;
 }
 
 //=====================================================================================================================
@@ -91,11 +99,35 @@ TestMesh* TestMesh::LoadPly( const char* pFile, bool bFixVerts )
     return new TestMesh( pVerts, pIndices );
 }
 
+TestMesh* TestMesh::LoadCached( const char* pFile, const char* pCacheFile, bool bFixVerts )
+{
+    // the cached vertices have already been rescaled (or not), so the cache records which
+    uint32 nLoadFlags = bFixVerts ? 1 : 0;
+
+    MeshCacheFile* pCache = new MeshCacheFile();
+    if( pCache->Open( pCacheFile, pFile, nLoadFlags ) && pCache->GetVertexCount() > 0 && pCache->GetTriangleCount() > 0 )
+        return new TestMesh( pCache );
+
+    delete pCache;
+
+    TestMesh* pMesh = LoadPly( pFile, bFixVerts );
+    if( pMesh )
+    {
+        // failure to write the cache is not fatal, we'll just parse the ply file again next time
+        SaveMeshCache( pCacheFile, pFile, nLoadFlags, &pMesh->m_pVertexArray->at(0), pMesh->GetVertexCount(),
+                       &pMesh->m_pIndexArray->at(0), pMesh->GetObjectCount() );
+    }
+
+    return pMesh;
+}
+
 
 void TestMesh::Optimize()
 {
-    std::vector<uint32> ibCopy = *m_pIndexArray;
-    OptimizeVertexOrder( &m_pVertexArray->at(0), &(m_pIndexArray->at(0)), m_pVertexArray->size(), m_pIndexArray->size() );
+    if( m_pCacheFile )
+        OptimizeVertexOrder( m_pCacheFile->GetVertices(), m_pCacheFile->GetIndices(), GetVertexCount(), 3*GetObjectCount() );
+    else
+        OptimizeVertexOrder( &m_pVertexArray->at(0), &(m_pIndexArray->at(0)), m_pVertexArray->size(), m_pIndexArray->size() );
 }
 
 
@@ -16,6 +16,8 @@
 #include "TinyRT.h"
 using namespace TinyRT;
 
+class MeshCacheFile;
+
 
 //=====================================================================================================================
 /// \brief Mesh loading class for the TRT test suite
@@ -29,16 +31,24 @@ public:
     
     static TestMesh* LoadPly( const char* pFile, bool bFixVerts );
 
+    /// \brief Loads a mesh from a binary cache file, if one exists and is up to date, or from a ply file otherwise.
+    /// If the ply file is loaded, the cache file is written so that subsequent loads can map it directly
+    static TestMesh* LoadCached( const char* pFile, const char* pCacheFile, bool bFixVerts );
+
     void Optimize();
 
 private:
 
     TestMesh( std::vector<Vec3f>* pPositions, std::vector<uint32>* pIndices );
+    TestMesh( MeshCacheFile* pCacheFile );
 
     // you might think there's a perf hit during raytracing, but there isn't. 
     // BasicMesh has pointers directly into these vectors.  There is only a slight size overhead
     std::vector<Vec3f>*  m_pVertexArray;
     std::vector<uint32>* m_pIndexArray;
+
+    // meshes loaded from a cache file point directly into the file's mapping instead
+    MeshCacheFile* m_pCacheFile;
 };
 
 
@@ -39,7 +39,11 @@ public:
 
     inline TestMesh* GetMesh() const { return m_pMesh; };
 
-    virtual void RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo ) = 0;
+    /// Finds the first hit along a ray.  May be called from multiple threads at once, each with its own scratch memory
+    virtual void RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo, TinyRT::ScratchMemory& rScratch ) = 0;
+
+    /// Finds the first hit along a ray, and adds the cost of its traversal to rStats
+    virtual void RaycastFirstHit( TinyRT::Ray& rRay, TinyRT::TriangleRayHit& rHitInfo, TinyRT::ScratchMemory& rScratch, TinyRT::TraversalStats& rStats ) = 0;
 
    
 private:
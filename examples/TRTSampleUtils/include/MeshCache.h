@@ -0,0 +1,71 @@
+//=====================================================================================================================
+//
+//   MeshCache.h
+// 
+//   Binary mesh cache for TRT samples
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+
+#ifndef _MESH_CACHE_H_
+#define _MESH_CACHE_H_
+
+#include "TRTTypes.h"
+
+namespace TinyRT
+{
+    class MappedFile;
+}
+
+/// \brief Writes a mesh to a cache file, which can be mapped into memory by MeshCacheFile
+/// The size and modification time of the source file are recorded, so that stale caches can be detected.  'nLoadFlags' is
+///  a caller-defined value which describes how the source file was processed (for example, the loader options), so that
+///  a cache is never used by a caller which would have loaded the source file differently
+bool SaveMeshCache( const char* pCacheFileName, const char* pSourceFileName, TinyRT::uint32 nLoadFlags, const TinyRT::Vec3f* pVertices, 
+                    TinyRT::uint32 nVertices, const TinyRT::uint32* pIndices, TinyRT::uint32 nTriangles );
+
+
+/// \brief A mesh cache file, mapped into memory
+///
+///  The vertex and index arrays point directly into the mapping, so a mesh can be used without parsing or copying it.
+///   The mapping is copy-on-write, so the arrays may be modified (for example, when a BVH build re-orders the triangles)
+///   without affecting the file.  Only the pages which are written to are copied.
+class MeshCacheFile
+{
+public:
+
+    MeshCacheFile();
+
+    ~MeshCacheFile();
+
+    /// \brief Maps a cache file.  Returns false if the file is missing or invalid, or was not created from the given source file
+    ///  in its current state, with the same load flags
+    bool Open( const char* pCacheFileName, const char* pSourceFileName, TinyRT::uint32 nLoadFlags );
+
+    /// Unmaps the file.  Any meshes which were pointed at it become invalid
+    void Close();
+
+    inline TinyRT::Vec3f* GetVertices() const { return m_pVertices; };
+    inline TinyRT::uint32* GetIndices() const { return m_pIndices; };
+    inline TinyRT::uint32 GetVertexCount() const { return m_nVertices; };
+    inline TinyRT::uint32 GetTriangleCount() const { return m_nTriangles; };
+
+private:
+
+    // held by pointer to avoid including windows.h here
+    TinyRT::MappedFile* m_pFile;
+
+    TinyRT::Vec3f* m_pVertices;
+    TinyRT::uint32* m_pIndices;
+    TinyRT::uint32 m_nVertices;
+    TinyRT::uint32 m_nTriangles;
+};
+
+
+#endif
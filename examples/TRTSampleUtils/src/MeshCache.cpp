@@ -0,0 +1,214 @@
+//=====================================================================================================================
+//
+//   MeshCache.cpp
+// 
+//   Binary mesh cache for TRT samples
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS // make VC++ stop complaining about old 'unsecure' methods
+#endif
+
+#include "TinyRT.h"
+#include "TRTMappedFile.h"
+#include "MeshCache.h"
+
+#include <stdio.h>
+#include <string>
+#include <sys/stat.h>
+
+using namespace TinyRT;
+
+
+#define MESH_CACHE_MAGIC     0x4853454d  // 'MESH'
+#define MESH_CACHE_VERSION   2
+#define MESH_CACHE_ALIGNMENT 64          // arrays are aligned to a cache line, relative to the start of the file
+
+
+/// File header.  The vertex and index arrays follow, at the given offsets
+struct MeshCacheHeader
+{
+    uint32 nMagic;
+    uint32 nVersion;
+    uint32 nVertices;
+    uint32 nTriangles;
+    uint32 nLoadFlags;      ///< Caller-defined description of how the source file was loaded
+    uint32 nReserved;
+    uint64 nVertexOffset;
+    uint64 nIndexOffset;
+    uint64 nSourceSize;     ///< Size of the file that the mesh was loaded from
+    uint64 nSourceTime;     ///< Modification time of the file that the mesh was loaded from
+};
+
+
+static inline uint64 AlignCacheOffset( uint64 nOffset )
+{
+    return ( nOffset + MESH_CACHE_ALIGNMENT - 1 ) & ~static_cast<uint64>( MESH_CACHE_ALIGNMENT - 1 );
+}
+
+static bool GetSourceStamp( const char* pSourceFileName, uint64& rSize, uint64& rTime )
+{
+    struct stat st;
+    if( stat( pSourceFileName, &st ) != 0 )
+        return false;
+
+    rSize = static_cast<uint64>( st.st_size );
+    rTime = static_cast<uint64>( st.st_mtime );
+    return true;
+}
+
+static bool WritePadding( FILE* fp, uint64 nOffset )
+{
+    static const char ZEROS[MESH_CACHE_ALIGNMENT] = { 0 };
+    size_t nPad = static_cast<size_t>( AlignCacheOffset( nOffset ) - nOffset );
+    return fwrite( ZEROS, 1, nPad, fp ) == nPad;
+}
+
+/// Returns a temporary name for a cache file, which includes the process ID and a per-process counter, 
+///  so that processes (or threads) which save the same mesh at once do not write to the same file
+static std::string MakeTempFileName( const char* pFileName )
+{
+    static volatile int32 s_nTempFiles = 0;
+#ifdef _WIN32
+    unsigned long nProcess = static_cast<unsigned long>( GetCurrentProcessId() );
+#else
+    unsigned long nProcess = static_cast<unsigned long>( getpid() );
+#endif
+    char suffix[48];
+    sprintf( suffix, ".%lu.%d.tmp", nProcess, AtomicAdd( &s_nTempFiles, 1 ) );
+    return std::string( pFileName ) + suffix;
+}
+
+/// Atomically replaces a file with another.  Readers see either the old file or the new one, never a missing one
+static bool ReplaceFile( const char* pSource, const char* pTarget )
+{
+#ifdef _WIN32
+    // the C library's rename will not replace an existing file on Windows
+    return MoveFileExA( pSource, pTarget, MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+    return rename( pSource, pTarget ) == 0;
+#endif
+}
+
+
+bool SaveMeshCache( const char* pCacheFileName, const char* pSourceFileName, uint32 nLoadFlags, const Vec3f* pVertices, 
+                    uint32 nVertices, const uint32* pIndices, uint32 nTriangles )
+{
+    MeshCacheHeader header;
+    memset( &header, 0, sizeof(header) );
+    header.nMagic = MESH_CACHE_MAGIC;
+    header.nVersion = MESH_CACHE_VERSION;
+    header.nVertices = nVertices;
+    header.nTriangles = nTriangles;
+    header.nLoadFlags = nLoadFlags;
+    header.nVertexOffset = AlignCacheOffset( sizeof(header) );
+    header.nIndexOffset = AlignCacheOffset( header.nVertexOffset + sizeof(Vec3f)*static_cast<uint64>( nVertices ) );
+    if( !GetSourceStamp( pSourceFileName, header.nSourceSize, header.nSourceTime ) )
+        return false;
+
+    // write under a temporary name, so that a partially written file is never mistaken for a valid cache
+    std::string tempName = MakeTempFileName( pCacheFileName );
+    FILE* fp = fopen( tempName.c_str(), "wb" );
+    if( !fp )
+        return false;
+
+    size_t nIndices = 3*static_cast<size_t>( nTriangles );
+    bool bOk = fwrite( &header, sizeof(header), 1, fp ) == 1 &&
+               WritePadding( fp, sizeof(header) ) &&
+               fwrite( pVertices, sizeof(Vec3f), nVertices, fp ) == nVertices &&
+               WritePadding( fp, header.nVertexOffset + sizeof(Vec3f)*static_cast<uint64>( nVertices ) ) &&
+               fwrite( pIndices, sizeof(uint32), nIndices, fp ) == nIndices;
+    bOk = ( fclose( fp ) == 0 ) && bOk;
+
+    // replace the old cache (if any) in one step, so that other processes never find it missing
+    if( !bOk || !ReplaceFile( tempName.c_str(), pCacheFileName ) )
+    {
+        remove( tempName.c_str() );
+        return false;
+    }
+
+    return true;
+}
+
+
+//=====================================================================================================================
+//
+//         Constructors/Destructors
+//
+//=====================================================================================================================
+
+MeshCacheFile::MeshCacheFile() : m_pFile( NULL ), m_pVertices( NULL ), m_pIndices( NULL ), m_nVertices( 0 ), m_nTriangles( 0 )
+{
+}
+
+MeshCacheFile::~MeshCacheFile()
+{
+    Close();
+}
+
+//=====================================================================================================================
+//
+//            Public Methods
+//
+//=====================================================================================================================
+
+bool MeshCacheFile::Open( const char* pCacheFileName, const char* pSourceFileName, uint32 nLoadFlags )
+{
+    Close();
+
+    uint64 nSourceSize, nSourceTime;
+    if( !GetSourceStamp( pSourceFileName, nSourceSize, nSourceTime ) )
+        return false;
+
+    MappedFile* pFile = new MappedFile();
+    if( !pFile->Open( pCacheFileName, true ) || pFile->GetSize() < sizeof(MeshCacheHeader) )
+    {
+        delete pFile;
+        return false;
+    }
+
+    uint8* pData = reinterpret_cast<uint8*>( pFile->GetWritableData() );
+    uint64 nSize = pFile->GetSize();
+    const MeshCacheHeader* pHeader = reinterpret_cast<const MeshCacheHeader*>( pData );
+
+    bool bValid = pHeader->nMagic == MESH_CACHE_MAGIC &&
+                  pHeader->nVersion == MESH_CACHE_VERSION &&
+                  pHeader->nSourceSize == nSourceSize &&
+                  pHeader->nSourceTime == nSourceTime &&
+                  pHeader->nLoadFlags == nLoadFlags &&
+                  pHeader->nVertexOffset % MESH_CACHE_ALIGNMENT == 0 &&
+                  pHeader->nIndexOffset % MESH_CACHE_ALIGNMENT == 0 &&
+                  pHeader->nVertexOffset <= nSize &&
+                  pHeader->nIndexOffset <= nSize &&
+                  ( nSize - pHeader->nVertexOffset ) / sizeof(Vec3f) >= pHeader->nVertices &&
+                  ( nSize - pHeader->nIndexOffset ) / ( 3*sizeof(uint32) ) >= pHeader->nTriangles;
+    if( !bValid )
+    {
+        delete pFile;
+        return false;
+    }
+
+    m_pFile = pFile;
+    m_pVertices = reinterpret_cast<Vec3f*>( pData + pHeader->nVertexOffset );
+    m_pIndices = reinterpret_cast<uint32*>( pData + pHeader->nIndexOffset );
+    m_nVertices = pHeader->nVertices;
+    m_nTriangles = pHeader->nTriangles;
+    return true;
+}
+
+void MeshCacheFile::Close()
+{
+    delete m_pFile;
+    m_pFile = NULL;
+    m_pVertices = NULL;
+    m_pIndices = NULL;
+    m_nVertices = 0;
+    m_nTriangles = 0;
+}
@@ -3,11 +3,13 @@
 #include "rply.h"  // ply parsing library, courtesy of diego
 
 #include "TinyRT.h"
+#include "TRTMappedFile.h"
 using namespace TinyRT;
 typedef TinyRT::uint32 UINT;
 
 #include <assert.h>
 #include <string>
+#include <sstream>
 #include <float.h>
 
 
@@ -102,24 +104,27 @@ int ColorCallback( p_ply_argument  argument )
 }
 
 
-void FlattenStrips( std::vector<UINT>& triList )
+void FlattenStrips( const UINT* pStripIndices, UINT nStripLength, std::vector<UINT>& triList )
 {
-    triList.push_back( s_nStripIndices[0] );
-    triList.push_back( s_nStripIndices[1] );
-    triList.push_back( s_nStripIndices[2] );
+    if( nStripLength < 3 )
+        return;
+
+    triList.push_back( pStripIndices[0] );
+    triList.push_back( pStripIndices[1] );
+    triList.push_back( pStripIndices[2] );
 
     UINT nFaces=1;
-    for( UINT i=3; i<s_nStripLength; i++ )
+    for( UINT i=3; i<nStripLength; i++ )
     {
-        if( s_nStripIndices[i] == 0xffffffff )
+        if( pStripIndices[i] == 0xffffffff )
         {
             // cut strip
             i++;
-            if( i < s_nStripLength )
+            if( i+2 < nStripLength )
             {
-                triList.push_back( s_nStripIndices[i] );
-                triList.push_back( s_nStripIndices[i+1] );
-                triList.push_back( s_nStripIndices[i+2] );
+                triList.push_back( pStripIndices[i] );
+                triList.push_back( pStripIndices[i+1] );
+                triList.push_back( pStripIndices[i+2] );
                 i+= 2; // the loop adds one more to i
             
                 nFaces=1;
@@ -131,16 +136,16 @@ void FlattenStrips( std::vector<UINT>& triList )
             if( nFaces % 2 )
             {
                 // odd
-                triList.push_back( s_nStripIndices[ i-2 ] );
-                triList.push_back( s_nStripIndices[ i ] );
-                triList.push_back( s_nStripIndices[ i-1 ] );
+                triList.push_back( pStripIndices[ i-2 ] );
+                triList.push_back( pStripIndices[ i ] );
+                triList.push_back( pStripIndices[ i-1 ] );
             }
             else
             {
                 // even
-                triList.push_back( s_nStripIndices[ i-2 ] );
-                triList.push_back( s_nStripIndices[ i-1 ] );
-                triList.push_back( s_nStripIndices[ i ] );
+                triList.push_back( pStripIndices[ i-2 ] );
+                triList.push_back( pStripIndices[ i-1 ] );
+                triList.push_back( pStripIndices[ i ] );
             }
 
             nFaces++;
@@ -193,7 +198,7 @@ void FixVertices( Vec3f* pVertices, UINT nVertices )
 }
 
 
-bool LoadPlyMesh( const char* pMeshFileName, std::vector<Vec3f>& rVertices, std::vector<UINT>& rIndices, bool bFix )
+bool LoadPlyMeshRply( const char* pMeshFileName, std::vector<Vec3f>& rVertices, std::vector<UINT>& rIndices )
 {
     p_ply ply = ply_open(pMeshFileName, NULL);
     
@@ -221,7 +226,7 @@ bool LoadPlyMesh( const char* pMeshFileName, std::vector<Vec3f>& rVertices, std:
 
         if( s_nStripIndices )
         {
-            FlattenStrips( triList );
+            FlattenStrips( s_nStripIndices, s_nStripLength, triList );
         }
         else
         {
@@ -242,8 +247,416 @@ bool LoadPlyMesh( const char* pMeshFileName, std::vector<Vec3f>& rVertices, std:
     s_triList.clear();
     s_nStripLength = 0;
 
+    return ok;
+}
+
+
+//=====================================================================================================================
+//  Binary PLY fast path
+//
+//   Most of the models we care about are little-endian binary files, whose vertex data is a fixed-size record per vertex.
+//   For these, we map the file and read the element blocks directly, instead of going through rply's per-value callbacks.
+//   Vertices and triangle lists are read in parallel.  Anything unusual falls back to rply.
+//=====================================================================================================================
+
+enum BinaryPlyType
+{
+    BINPLY_INVALID,
+    BINPLY_INT8, BINPLY_UINT8, BINPLY_INT16, BINPLY_UINT16, BINPLY_INT32, BINPLY_UINT32, BINPLY_FLOAT32, BINPLY_FLOAT64
+};
+
+struct PlyProperty
+{
+    std::string name;
+    BinaryPlyType eType;          ///< Type of the value, or of the list entries
+    BinaryPlyType eCountType;     ///< Type of the list count, or BINPLY_INVALID if the property is not a list
+};
+
+struct PlyElement
+{
+    std::string name;
+    size_t nCount;
+    std::vector<PlyProperty> properties;
+};
+
+static BinaryPlyType GetBinaryPlyType( const std::string& rName )
+{
+    if( rName == "char"   || rName == "int8"    ) return BINPLY_INT8;
+    if( rName == "uchar"  || rName == "uint8"   ) return BINPLY_UINT8;
+    if( rName == "short"  || rName == "int16"   ) return BINPLY_INT16;
+    if( rName == "ushort" || rName == "uint16"  ) return BINPLY_UINT16;
+    if( rName == "int"    || rName == "int32"   ) return BINPLY_INT32;
+    if( rName == "uint"   || rName == "uint32"  ) return BINPLY_UINT32;
+    if( rName == "float"  || rName == "float32" ) return BINPLY_FLOAT32;
+    if( rName == "double" || rName == "float64" ) return BINPLY_FLOAT64;
+    return BINPLY_INVALID;
+}
+
+static size_t GetPlyTypeSize( BinaryPlyType eType )
+{
+    switch( eType )
+    {
+    case BINPLY_INT8:    case BINPLY_UINT8:  return 1;
+    case BINPLY_INT16:   case BINPLY_UINT16: return 2;
+    case BINPLY_INT32:   case BINPLY_UINT32: case BINPLY_FLOAT32: return 4;
+    case BINPLY_FLOAT64: return 8;
+    default:          return 0;
+    }
+}
+
+/// Reads a list count.  Only integer count types are accepted by the header parser
+static size_t ReadPlyCount( const unsigned char* pData, BinaryPlyType eType )
+{
+    switch( eType )
+    {
+    case BINPLY_INT8:   return static_cast<size_t>( *reinterpret_cast<const signed char*>( pData ) );
+    case BINPLY_UINT8:  return *pData;
+    case BINPLY_INT16:  { short n; memcpy( &n, pData, 2 ); return static_cast<size_t>( n ); }
+    case BINPLY_UINT16: { unsigned short n; memcpy( &n, pData, 2 ); return n; }
+    default:         { UINT n; memcpy( &n, pData, 4 ); return n; }
+    }
+}
+
+/// Parses the header of a binary little-endian PLY file.  Returns the offset of the first element's data, or 0 if the
+///  header is not one that the fast path can handle
+static size_t ParsePlyHeader( const char* pData, size_t nSize, std::vector<PlyElement>& rElements )
+{
+    const char* pEnd = pData + nSize;
+    const char* pLine = pData;
+    bool bBinaryLE = false;
+
+    while( pLine < pEnd )
+    {
+        const char* pEOL = static_cast<const char*>( memchr( pLine, '\n', pEnd - pLine ) );
+        if( !pEOL )
+            return 0;
+
+        std::string line( pLine, pEOL );
+        if( !line.empty() && line[line.size()-1] == '\r' )
+            line.erase( line.size()-1 );
+        pLine = pEOL + 1;
+
+        std::istringstream tokens( line );
+        std::string keyword;
+        tokens >> keyword;
+
+        if( keyword == "format" )
+        {
+            std::string format;
+            tokens >> format;
+            bBinaryLE = ( format == "binary_little_endian" );
+        }
+        else if( keyword == "element" )
+        {
+            PlyElement element;
+            if( !( tokens >> element.name >> element.nCount ) || element.nCount > 0x7fffffff )
+                return 0;
+            rElements.push_back( element );
+        }
+        else if( keyword == "property" )
+        {
+            if( rElements.empty() )
+                return 0;
+
+            PlyProperty prop;
+            std::string type;
+            tokens >> type;
+            if( type == "list" )
+            {
+                std::string countType, itemType;
+                tokens >> countType >> itemType;
+                prop.eCountType = GetBinaryPlyType( countType );
+                prop.eType = GetBinaryPlyType( itemType );
+                if( prop.eCountType == BINPLY_INVALID || prop.eCountType == BINPLY_FLOAT32 || prop.eCountType == BINPLY_FLOAT64 )
+                    return 0;
+            }
+            else
+            {
+                prop.eCountType = BINPLY_INVALID;
+                prop.eType = GetBinaryPlyType( type );
+            }
+
+            if( prop.eType == BINPLY_INVALID || !( tokens >> prop.name ) )
+                return 0;
+            rElements.back().properties.push_back( prop );
+        }
+        else if( keyword == "end_header" )
+        {
+            return bBinaryLE ? static_cast<size_t>( pLine - pData ) : 0;
+        }
+    }
+
+    return 0;
+}
+
+/// Returns the record size of an element with no list properties, or 0 if the element has lists
+static size_t GetPlyRecordSize( const PlyElement& rElement )
+{
+    size_t nSize = 0;
+    for( size_t i=0; i<rElement.properties.size(); i++ )
+    {
+        if( rElement.properties[i].eCountType != BINPLY_INVALID )
+            return 0;
+        nSize += GetPlyTypeSize( rElement.properties[i].eType );
+    }
+    return nSize;
+}
+
+/// Reads the 'x', 'y', and 'z' properties of a vertex element.  Returns false if they are not all floats
+static bool ReadPlyVertices( const PlyElement& rElement, const unsigned char* pData, size_t nStride, std::vector<Vec3f>& rVertices )
+{
+    size_t nOffsets[3] = { nStride, nStride, nStride };
+    size_t nOffset = 0;
+    for( size_t i=0; i<rElement.properties.size(); i++ )
+    {
+        const PlyProperty& prop = rElement.properties[i];
+        int nComponent = prop.name == "x" ? 0 : ( prop.name == "y" ? 1 : ( prop.name == "z" ? 2 : -1 ) );
+        if( nComponent >= 0 )
+        {
+            if( prop.eType != BINPLY_FLOAT32 )
+                return false;
+            nOffsets[nComponent] = nOffset;
+        }
+        nOffset += GetPlyTypeSize( prop.eType );
+    }
+
+    for( int i=0; i<3; i++ )
+    {
+        if( nOffsets[i] == nStride )
+            return false;
+    }
+
+    rVertices.resize( rElement.nCount );
+    int nVertices = static_cast<int>( rElement.nCount );
+
+    #pragma omp parallel for
+    for( int i=0; i<nVertices; i++ )
+    {
+        const unsigned char* pVertex = pData + nStride*static_cast<size_t>( i );
+        for( int j=0; j<3; j++ )
+            memcpy( &rVertices[i][j], pVertex + nOffsets[j], sizeof(float) );
+    }
+
+    return true;
+}
+
+/// \brief Measures one record of an element which contains lists.  The length of each list is stored in pCounts.
+/// If nIndexProperty is a valid property index, the offset of that list's entries is stored in rIndexOffset.
+///  Returns the record size, or 0 if the record runs past the end of the data
+static size_t WalkPlyRecord( const PlyElement& rElement, const unsigned char* pRecord, size_t nSize, size_t* pCounts,
+                             size_t nIndexProperty, size_t& rIndexOffset )
+{
+    size_t nOffset = 0;
+    for( size_t i=0; i<rElement.properties.size(); i++ )
+    {
+        const PlyProperty& prop = rElement.properties[i];
+        size_t nItemSize = GetPlyTypeSize( prop.eType );
+        size_t nCount = 1;
+        if( prop.eCountType != BINPLY_INVALID )
+        {
+            size_t nCountSize = GetPlyTypeSize( prop.eCountType );
+            if( nSize - nOffset < nCountSize )
+                return 0;
+            nCount = ReadPlyCount( pRecord + nOffset, prop.eCountType );
+            nOffset += nCountSize;
+        }
+
+        if( ( nSize - nOffset ) / nItemSize < nCount )
+            return 0;
+
+        pCounts[i] = nCount;
+        if( i == nIndexProperty )
+            rIndexOffset = nOffset;
+        nOffset += nCount*nItemSize;
+    }
+
+    return nOffset;
+}
+
+/// Checks whether a record has the same list lengths as the one that was measured by WalkPlyRecord
+static bool MatchPlyRecord( const PlyElement& rElement, const unsigned char* pRecord, const size_t* pCounts )
+{
+    size_t nOffset = 0;
+    for( size_t i=0; i<rElement.properties.size(); i++ )
+    {
+        const PlyProperty& prop = rElement.properties[i];
+        if( prop.eCountType != BINPLY_INVALID )
+        {
+            if( ReadPlyCount( pRecord + nOffset, prop.eCountType ) != pCounts[i] )
+                return false;
+            nOffset += GetPlyTypeSize( prop.eCountType );
+        }
+        nOffset += pCounts[i]*GetPlyTypeSize( prop.eType );
+    }
+    return true;
+}
+
+/// \brief Reads an element which contains lists.  If nIndexProperty is a valid property index, then that property must
+///  be a list of 32-bit indices, and the lists are concatenated onto rIndices.
+/// Returns the number of bytes read, or 0 if the element could not be read
+static size_t ReadPlyIndexLists( const PlyElement& rElement, const unsigned char* pData, size_t nSize, size_t nIndexProperty,
+                                 std::vector<UINT>& rIndices )
+{
+    if( rElement.nCount == 0 )
+        return 0;
+
+    std::vector<size_t> counts( rElement.properties.size() );
+    size_t nIndexOffset = 0;
+    int nRecords = static_cast<int>( rElement.nCount );
+
+    size_t nStride = WalkPlyRecord( rElement, pData, nSize, &counts[0], nIndexProperty, nIndexOffset );
+    if( nStride == 0 )
+        return 0;
+
+    // meshes are usually all triangles, in which case every record is the same size, and can be read in parallel.
+    //  If the first record that differs is k, then records 0..k-1 were found at the right positions, so the check is exact
+    if( nSize / nStride >= rElement.nCount )
+    {
+        size_t nListLength = ( nIndexProperty < counts.size() ) ? counts[nIndexProperty] : 0;
+        size_t nFirstIndex = rIndices.size();
+        rIndices.resize( nFirstIndex + nListLength*rElement.nCount );
+
+        int nMismatches = 0;
+        #pragma omp parallel for reduction(+:nMismatches)
+        for( int i=0; i<nRecords; i++ )
+        {
+            const unsigned char* pRecord = pData + nStride*static_cast<size_t>( i );
+            if( !MatchPlyRecord( rElement, pRecord, &counts[0] ) )
+                nMismatches++;
+            else if( nListLength )
+                memcpy( &rIndices[ nFirstIndex + nListLength*i ], pRecord + nIndexOffset, nListLength*sizeof(UINT) );
+        }
+
+        if( nMismatches == 0 )
+            return nStride*rElement.nCount;
+
+        rIndices.resize( nFirstIndex );
+    }
+
+    // otherwise, walk the records one at a time
+    size_t nOffset = 0;
+    for( int i=0; i<nRecords; i++ )
+    {
+        size_t nRecordSize = WalkPlyRecord( rElement, pData + nOffset, nSize - nOffset, &counts[0], nIndexProperty, nIndexOffset );
+        if( nRecordSize == 0 )
+            return 0;
+
+        if( nIndexProperty < counts.size() && counts[nIndexProperty] )
+        {
+            size_t nFirstIndex = rIndices.size();
+            rIndices.resize( nFirstIndex + counts[nIndexProperty] );
+            memcpy( &rIndices[nFirstIndex], pData + nOffset + nIndexOffset, counts[nIndexProperty]*sizeof(UINT) );
+        }
+        nOffset += nRecordSize;
+    }
+
+    return nOffset;
+}
+
+/// Loads a binary little-endian PLY file without going through rply.  Returns false if the file is not one that the
+///  fast path can handle, in which case the caller should fall back to rply
+bool LoadPlyMeshBinary( const char* pMeshFileName, std::vector<Vec3f>& rVertices, std::vector<UINT>& rIndices )
+{
+    // the data is read in place, so this only works on little-endian machines
+    const UINT nEndianTest = 1;
+    if( *reinterpret_cast<const unsigned char*>( &nEndianTest ) != 1 )
+        return false;
+
+    MappedFile file;
+    if( !file.Open( pMeshFileName ) )
+        return false;
+
+    const unsigned char* pData = static_cast<const unsigned char*>( file.GetData() );
+    size_t nSize = file.GetSize();
+
+    if( nSize < 4 || memcmp( pData, "ply", 3 ) != 0 )
+        return false;
+
+    std::vector<PlyElement> elements;
+    size_t nOffset = ParsePlyHeader( static_cast<const char*>( file.GetData() ), nSize, elements );
+    if( nOffset == 0 )
+        return false;
+
+    std::vector<Vec3f> vertices;
+    std::vector<UINT> faceIndices;
+    std::vector<UINT> stripIndices;
+    bool bHaveStrips = false;
+
+    for( size_t i=0; i<elements.size(); i++ )
+    {
+        const PlyElement& element = elements[i];
+        size_t nRecordSize = GetPlyRecordSize( element );
+        size_t nRemaining = nSize - nOffset;
+
+        if( nRecordSize != 0 || element.properties.empty() )
+        {
+            // fixed-size records
+            if( nRecordSize != 0 && nRemaining / nRecordSize < element.nCount )
+                return false;
+
+            if( element.name == "vertex" && !ReadPlyVertices( element, pData + nOffset, nRecordSize, vertices ) )
+                return false;
+
+            nOffset += nRecordSize*element.nCount;
+        }
+        else
+        {
+            // variable-size records.  Face and strip indices are only handled if they are 32-bit integers
+            bool bStrips = ( element.name == "tristrips" );
+            bool bFaces = ( element.name == "face" );
+            size_t nIndexProperty = element.properties.size();
+            if( bStrips || bFaces )
+            {
+                for( size_t j=0; j<element.properties.size(); j++ )
+                {
+                    const PlyProperty& prop = element.properties[j];
+                    if( prop.name == "vertex_indices" && prop.eCountType != BINPLY_INVALID )
+                    {
+                        if( prop.eType != BINPLY_INT32 && prop.eType != BINPLY_UINT32 )
+                            return false;
+                        nIndexProperty = j;
+                    }
+                }
+            }
+
+            // the rply path only handles a single strip, so leave anything else to it
+            bool bReadStrips = bStrips && nIndexProperty < element.properties.size();
+            if( bReadStrips && element.nCount != 1 )
+                return false;
+
+            size_t nRead = ReadPlyIndexLists( element, pData + nOffset, nRemaining, nIndexProperty, bStrips ? stripIndices : faceIndices );
+            if( nRead == 0 && element.nCount != 0 )
+                return false;
+
+            bHaveStrips = bHaveStrips || bReadStrips;
+            nOffset += nRead;
+        }
+    }
+
+    rVertices.swap( vertices );
+
+    // convert tri strips to tri lists (the one true mesh representation)
+    rIndices.clear();
+    if( bHaveStrips )
+    {
+        if( !stripIndices.empty() )
+            FlattenStrips( &stripIndices[0], static_cast<UINT>( stripIndices.size() ), rIndices );
+    }
+    else
+    {
+        rIndices.swap( faceIndices );
+    }
+
+    return true;
+}
+
+
+bool LoadPlyMesh( const char* pMeshFileName, std::vector<Vec3f>& rVertices, std::vector<UINT>& rIndices, bool bFix )
+{
+    bool ok = LoadPlyMeshBinary( pMeshFileName, rVertices, rIndices ) ||
+              LoadPlyMeshRply( pMeshFileName, rVertices, rIndices );
 
-    if( bFix )
+    if( ok && bFix )
         FixVertices( &rVertices[0], rVertices.size() );
 
     return ok;
@@ -23,13 +23,8 @@
     #include <windows.h>
 
 #else
-    // on non-windows, time.h should do the job.
-    #include <time.h>
-
-    // check in case we port to some platform without enough precision
-    #if (CLOCKS_PER_SEC < 1000000)
-        #error "CLOCKS_PER_SEC is too low for micro-second precision.  Do something about it."
-    #endif
+    // on non-windows, gettimeofday gives us wall-clock time with micro-second precision
+    #include <sys/time.h>
 
 #endif
 
@@ -90,32 +85,38 @@
 
 #else
 
-    // UNIX version can use clock() for everything since they have better precision
+    // UNIX version uses gettimeofday.  We can't use clock() because it measures the CPU time used by all
+    //  threads in the process, which is useless for timing multi-threaded code
 
     class UnixTimer : public Timer::TimerImpl
     {
-        clock_t m_start;
+        timeval m_start;
+
+        unsigned long long ElapsedMicroSeconds() const
+        {
+            timeval now;
+            gettimeofday( &now, 0 );
+            long long usec = (long long)(now.tv_sec - m_start.tv_sec)*1000000 + (now.tv_usec - m_start.tv_usec);
+            return (unsigned long long) usec;
+        }
+
     public:
 
-        UnixTimer() : m_start(clock()) {};
+        UnixTimer() { gettimeofday( &m_start, 0 ); };
     
         unsigned int Tick() const
         {
-            clock_t elapsed = clock() - m_start;
-            elapsed /= ((CLOCKS_PER_SEC)/1000);
-            return (int)elapsed;
+            return (unsigned int) ( ElapsedMicroSeconds() / 1000 );
         }
 
         unsigned long TickMicroSeconds() const
         {
-            clock_t elapsed = clock() - m_start;
-            elapsed /= ((CLOCKS_PER_SEC)/1000000);
-            return (int)elapsed;
+            return (unsigned long) ElapsedMicroSeconds();
         }
 
         void Reset()
         {
-            m_start = clock();
+            gettimeofday( &m_start, 0 );
         }
     };
 
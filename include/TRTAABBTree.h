@@ -26,6 +26,11 @@ namespace TinyRT
     ///  An AABBTree is a binary BVH with axis aligned bounding boxes as its bounding volumes.
     ///   This class implements the AABBTree_C concept.
     ///
+    ///  In addition to a full rebuild, the tree supports dynamic updates.  Objects may be inserted and removed 
+    ///   individually, and local tree rotations are used to maintain the tree quality as it changes.  The bookkeeping
+    ///   for dynamic updates is created the first time one of these methods is called, and is discarded on rebuild
+    ///
+    ///
     /// \param ObjectSet_T must implement the ObjectSet_C concept
     //=====================================================================================================================
     template< class ObjectSet_T >
@@ -93,7 +98,7 @@ namespace TinyRT
 
         inline AABBTree();
 
-        inline ~AABBTree() { delete[] m_pNodes; }
+        inline ~AABBTree() { if( m_bOwnsNodes ) delete[] m_pNodes; }
        
         inline const Node* GetLeftChild( const Node* n ) const  { return m_pNodes + n->GetLeftChildIndex() ; }
         inline const Node* GetRightChild( const Node* n ) const { return m_pNodes + n->GetRightChildIndex() ; };
@@ -140,8 +145,18 @@ namespace TinyRT
             return RayAABBTest( n->GetAABB().Min(), n->GetAABB().Max(), rRay );
         }
 
+        /// Performs a ray intersection test with a node's bounding volume, for a ray in a known octant
+        template< int OCTANT, class Ray_T >
+        inline bool RayNodeTestOctant( const Node* n, const Ray_T& rRay ) const
+        {
+            return RayAABBTestOctant<OCTANT>( n->GetAABB().Min(), n->GetAABB().Max(), rRay );
+        }
+
+        /// Prefetches the children of an inner node.  Both children share one allocation, so this fetches them both
+        inline void PrefetchChildren( const Node* n ) const { PrefetchMemory( m_pNodes + n->GetLeftChildIndex(), 2*sizeof(Node) ); };
+
         /// Returns the number of nodes in the tree
-        inline uint32 GetNodeCount() const { return m_nNodesInUse; };
+        inline uint32 GetNodeCount() const { return m_nNodesInUse - m_nFreeNodes; };
 
         /// Returns the memory consumption of the data structure, as well as the amount allocated
         inline void GetMemoryUsage( size_t& rnBytesUsed, size_t& rnBytesAllocated ) const;
@@ -150,11 +165,113 @@ namespace TinyRT
         template< class AABBTreeBuilder_T >
         void Build( ObjectSet_T* pObjects, AABBTreeBuilder_T& rBuilder );
 
+        /// \brief Constructs a tree for an object set, recording the re-ordering of the objects so that it can be saved with the tree
+        /// The builder must be instantiated for the RemapRecorder type
+        template< class AABBTreeBuilder_T >
+        void Build( RemapRecorder<ObjectSet_T>* pObjects, AABBTreeBuilder_T& rBuilder ) { m_nStackDepth = rBuilder.BuildTree( pObjects, this ); };
+
+        /// Recomputes the node bounding boxes after the objects have moved, without changing the tree topology
+        void Refit( const ObjectSet_T* pObjects );
+
+        /// Multi-threaded version of 'Refit'
+        void RefitParallel( const ObjectSet_T* pObjects );
+
+        /// Adds an object to the tree, without rebuilding it
+        void Insert( const ObjectSet_T* pObjects, obj_id nObject );
+
+        /// Removes an object from the tree, without rebuilding it
+        void Remove( const ObjectSet_T* pObjects, obj_id nObject );
+
+        /// Applies tree rotations throughout the tree to reduce its SAH cost
+        void OptimizeRotations( const ObjectSet_T* pObjects );
+
+        /// \brief Writes the tree to a file, which may later be used with 'Attach'.  Returns false if the file could not be written
+        /// An object remap table (see RemapRecorder) may be stored along with the tree
+        bool Save( const char* pFileName, const obj_id* pObjectRemap = NULL, obj_id nObjects = 0 ) const;
+
+        /// \brief Writes the tree to a memory buffer, in the same format as 'Save'.  Returns the number of bytes required
+        /// If the buffer is NULL or too small, nothing is written.  The buffer may be passed to 'Attach'
+        size_t SaveToBuffer( void* pBuffer, size_t nBufferSize, const obj_id* pObjectRemap = NULL, obj_id nObjects = 0 ) const;
+
+        /// \brief Uses a tree written by 'Save', in place.  Returns false if the data is not a valid AABB tree
+        /// The data is not copied, and must remain valid until the tree is destroyed or rebuilt.  Nodes are only copied
+        ///  if the tree is modified (by refitting or dynamic updates), so the data may be read-only
+        bool Attach( const void* pData, size_t nSize );
+
     private:
 
+        /// Fills in the header and section list used by 'Save' and 'SaveToBuffer'
+        void GetSerializedSections( SerializedTreeHeader& rHeader, const void* pSections[SERIALIZED_SECTION_COUNT],
+                                    const obj_id* pObjectRemap, obj_id nObjects ) const;
+
+        /// Per-node bookkeeping used for dynamic updates
+        struct DynamicInfo
+        {
+            uint32 nParent;     ///< Index of the parent node.  The root is its own parent
+            uint32 nHeight;     ///< Height of the subtree rooted at this node.  Leaves have a height of 1
+        };
+
+        /// Marker used in the object-to-leaf map for objects which are not in the tree
+        enum { INVALID_LEAF = 0xffffffff };
+
+        /// Copies the nodes into memory owned by the tree, if they belong to an attached file
+        void MakeNodesWritable();
+
+        /// Creates the parent links, subtree heights, and object-to-leaf map, if they do not exist yet
+        void EnableDynamicUpdates( const ObjectSet_T* pObjects );
+
+        /// Fills in dynamic info for a subtree, and returns its height
+        uint32 InitDynamicInfo( uint32 nNode, uint32 nParent );
+
+        /// Allocates two adjacent nodes, re-using freed pairs if possible
+        uint32 AllocateNodePair();
+
+        /// Returns a pair of adjacent nodes to the free list
+        void FreeNodePair( uint32 nFirst );
+
+        /// Copies a node into the given slot, and updates the links which point to it
+        void WriteNode( uint32 nDest, const Node& rNode, uint32 nHeight );
+
+        /// Exchanges the subtrees rooted at two nodes
+        void SwapNodes( uint32 nFirst, uint32 nSecond );
+
+        /// Computes the bounding box of a leaf from its objects
+        void ComputeLeafAABB( const ObjectSet_T* pObjects, Node* pNode );
+
+        /// Selects the node which will become the sibling of a new leaf, using a branch and bound search
+        uint32 FindBestSibling( const AxisAlignedBox& rBox ) const;
+
+        /// Inserts a new leaf containing a range of objects
+        void InsertLeaf( obj_id nFirst, obj_id nCount, const AxisAlignedBox& rBox );
+
+        /// Recomputes the box and height of an inner node from its children
+        void RefitInnerNode( uint32 nNode );
+
+        /// Orders the children of an inner node, and sets its split axis, so that traversal order is preserved
+        void OrderChildren( uint32 nNode );
+
+        /// Swaps a child of the given node with one of its grandchildren, if doing so reduces the tree cost
+        void RotateNode( uint32 nNode );
+
+        /// Refits, rotates, and re-orders each node from the given node up to the root
+        void UpdateAncestors( uint32 nNode );
+
+        /// Recursively applies rotations to a subtree, from the bottom up
+        void OptimizeSubtree( uint32 nNode );
+
+        /// Recomputes the bounding boxes in a subtree, and returns the box of the subtree root
+        const AxisAlignedBox& RefitSubtree( const ObjectSet_T* pObjects, Node* pNode );
+
         Node*  m_pNodes;
         uint32 m_nNodesInUse;
         uint32 m_nStackDepth;
+        uint32 m_nNodeArraySize;     ///< Number of nodes allocated
+        uint32 m_nFreeNodes;         ///< Number of nodes on the free list
+        uint32 m_nFreePairs;         ///< Index of the first free pair of nodes (0 if there are none)
+        bool   m_bOwnsNodes;         ///< False if the nodes belong to an attached file
+
+        std::vector<DynamicInfo> m_dynamicInfo;     ///< Per-node bookkeeping.  Empty until a dynamic update is made
+        std::vector<uint32>      m_objectLeaves;    ///< Leaf containing each object.  Empty until a dynamic update is made
     };
 
 }
@@ -27,7 +27,12 @@ namespace TinyRT
     template< class ObjectSet_T >
     inline AABBTree<ObjectSet_T>::AABBTree( ) :
         m_pNodes( NULL ),
-        m_nNodesInUse( 0 )   // the root node is considered 'in use' 
+        m_nNodesInUse( 0 ),   // the root node is considered 'in use' 
+        m_nStackDepth( 0 ),
+        m_nNodeArraySize( 0 ),
+        m_nFreeNodes( 0 ),
+        m_nFreePairs( 0 ),
+        m_bOwnsNodes( true )
     {
     };
 
@@ -50,14 +55,17 @@ namespace TinyRT
     inline typename AABBTree<ObjectSet_T>::Node* AABBTree<ObjectSet_T>::Initialize( const AxisAlignedBox& rBox, uint32 nMaxNodes )
     {
         // TODO:  Don't reallocate if we already have enough
-        if( m_pNodes ) 
-        {
+        if( m_pNodes && m_bOwnsNodes ) 
             delete[] m_pNodes;
-            m_pNodes = NULL;
-        }
 
         m_pNodes = new Node[ nMaxNodes ];
+        m_bOwnsNodes = true;
         m_nNodesInUse = 1;
+        m_nNodeArraySize = nMaxNodes;
+        m_nFreeNodes = 0;
+        m_nFreePairs = 0;
+        m_dynamicInfo.clear();
+        m_objectLeaves.clear();
         return m_pNodes;
     }
 
@@ -92,10 +100,259 @@ namespace TinyRT
     template< typename ObjectSet_T >
     void AABBTree<ObjectSet_T>::GetMemoryUsage( size_t& rnBytesUsed, size_t& rnBytesAllocated ) const
     {
-        rnBytesUsed = m_nNodesInUse*sizeof(Node);
-        rnBytesAllocated = m_nNodesInUse*sizeof(Node);
+        size_t nDynamicBytes = m_dynamicInfo.size()*sizeof(DynamicInfo) + m_objectLeaves.size()*sizeof(uint32);
+        rnBytesUsed = (m_nNodesInUse-m_nFreeNodes)*sizeof(Node) + nDynamicBytes;
+        rnBytesAllocated = m_nNodeArraySize*sizeof(Node) + nDynamicBytes;
+    }
+
+
+    //=====================================================================================================================
+    /// Refitting is much cheaper than rebuilding the tree, but the quality of the tree will degrade if the objects
+    ///  move too far from their original positions.  
+    /// \param pObjects    The object set used to build the tree.  Object IDs must not have changed since the tree was built
+    /// \sa SAHQualityMonitor
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::Refit( const ObjectSet_T* pObjects )
+    {
+        MakeNodesWritable();
+        RefitSubtree( pObjects, m_pNodes );
+    }
+
+    //=====================================================================================================================
+    /// The upper levels of the tree are split into a set of independent subtrees, which are refit in parallel.  
+    ///  The nodes above these subtrees are then refit on the calling thread.
+    /// \param pObjects    The object set used to build the tree.  Its 'GetObjectAABB' method must be thread-safe
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::RefitParallel( const ObjectSet_T* pObjects )
+    {
+        MakeNodesWritable();
+
+        // expand the tree breadth-first until there are enough subtrees to keep all threads busy
+        size_t nTargetSubtrees = 8*GetParallelThreadCount();
+        
+        std::vector<Node*> subtrees( 1, m_pNodes );
+        std::vector<Node*> innerNodes;
+        std::vector<Node*> nextLevel;
+        while( subtrees.size() < nTargetSubtrees )
+        {
+            nextLevel.clear();
+            for( size_t i=0; i<subtrees.size(); i++ )
+            {
+                Node* pNode = subtrees[i];
+                if( pNode->IsLeaf() )
+                {
+                    nextLevel.push_back( pNode );
+                }
+                else
+                {
+                    innerNodes.push_back( pNode );
+                    nextLevel.push_back( GetLeftChild( pNode ) );
+                    nextLevel.push_back( GetRightChild( pNode ) );
+                }
+            }
+
+            if( nextLevel.size() == subtrees.size() )
+                break; // nothing left to expand
+
+            subtrees.swap( nextLevel );
+        }
+
+        int nSubtrees = static_cast<int>( subtrees.size() );
+
+        #pragma omp parallel for schedule(dynamic)
+        for( int i=0; i<nSubtrees; i++ )
+            RefitSubtree( pObjects, subtrees[i] );
+
+        // inner nodes were collected level by level, so walking the list backwards visits children before parents
+        for( size_t i=innerNodes.size(); i > 0; i-- )
+        {
+            Node* pNode = innerNodes[i-1];
+            AxisAlignedBox box = GetLeftChild( pNode )->GetAABB();
+            box.Merge( GetRightChild( pNode )->GetAABB() );
+            pNode->SetAABB( box );
+        }
+    }
+
+    //=====================================================================================================================
+    /// The new object is placed in its own leaf.  The insertion point is chosen using a branch and bound search for the
+    ///  sibling which minimizes the total increase in surface area.  Rotations are then applied along the path to the
+    ///  root, as described by Kopta et al., "Fast, Effective BVH Updates for Animated Scenes"
+    ///
+    /// Node pointers are invalidated by this method, since the node array may be re-allocated
+    ///
+    /// \param pObjects    The object set used to build the tree.  Object IDs must not have changed since the tree was built
+    /// \param nObject     The object to insert.  It must not already be in the tree
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::Insert( const ObjectSet_T* pObjects, obj_id nObject )
+    {
+        EnableDynamicUpdates( pObjects );
+
+        if( m_objectLeaves.size() <= static_cast<size_t>( nObject ) )
+            m_objectLeaves.resize( static_cast<size_t>( nObject )+1, INVALID_LEAF );
+
+        TRT_ASSERT( m_objectLeaves[nObject] == INVALID_LEAF ); // object is already in the tree
+
+        AxisAlignedBox box;
+        pObjects->GetObjectAABB( nObject, box );
+        InsertLeaf( nObject, 1, box );
+    }
+
+    //=====================================================================================================================
+    /// If the object shares a leaf with other objects, the leaf is shrunk or split in two.  Otherwise, the leaf is removed
+    ///  and replaced by its sibling.  Rotations are applied along the path to the root, as in 'Insert'
+    ///
+    /// Node pointers are invalidated by this method, since the node array may be re-allocated
+    ///
+    /// \param pObjects    The object set used to build the tree.  Object IDs must not have changed since the tree was built
+    /// \param nObject     The object to remove.  It must be in the tree
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::Remove( const ObjectSet_T* pObjects, obj_id nObject )
+    {
+        EnableDynamicUpdates( pObjects );
+
+        TRT_ASSERT( static_cast<size_t>( nObject ) < m_objectLeaves.size() && m_objectLeaves[nObject] != INVALID_LEAF );
+
+        uint32 nLeaf = m_objectLeaves[nObject];
+        m_objectLeaves[nObject] = INVALID_LEAF;
+
+        obj_id nFirst, nLast;
+        m_pNodes[nLeaf].GetObjectRange( nFirst, nLast );
+
+        if( nLast - nFirst > 1 )
+        {
+            // leaf has other objects in it
+            if( nObject == nFirst || nObject == nLast-1 )
+            {
+                // shrink the object range
+                obj_id nNewFirst = ( nObject == nFirst ) ? nFirst+1 : nFirst;
+                m_pNodes[nLeaf].MakeLeaf( nNewFirst, (nLast-nFirst)-1 );
+                ComputeLeafAABB( pObjects, m_pNodes + nLeaf );
+                if( nLeaf != 0 )
+                    UpdateAncestors( m_dynamicInfo[nLeaf].nParent );
+            }
+            else
+            {
+                // object is in the middle of the range, split the leaf in two
+                uint32 nPair = AllocateNodePair();
+
+                Node left, right;
+                left.MakeLeaf( nFirst, nObject - nFirst );
+                right.MakeLeaf( nObject+1, nLast - (nObject+1) );
+                ComputeLeafAABB( pObjects, &left );
+                ComputeLeafAABB( pObjects, &right );
+
+                WriteNode( nPair, left, 1 );
+                WriteNode( nPair+1, right, 1 );
+                m_dynamicInfo[nPair].nParent = nLeaf;
+                m_dynamicInfo[nPair+1].nParent = nLeaf;
+                m_pNodes[nLeaf].MakeInnerNode( nPair, 0 );
+                UpdateAncestors( nLeaf );
+            }
+            return;
+        }
+
+        if( nLeaf == 0 )
+        {
+            // tree is now empty.  Give the root an inverted box so that rays will miss it
+            m_pNodes[0].MakeLeaf( 0, 0 );
+            m_pNodes[0].SetAABB( AxisAlignedBox( Vec3f( FLT_MAX, FLT_MAX, FLT_MAX ), Vec3f( -FLT_MAX, -FLT_MAX, -FLT_MAX ) ) );
+            m_dynamicInfo[0].nHeight = 1;
+            m_nStackDepth = 1;
+            return;
+        }
+
+        // replace the parent with the leaf's sibling
+        uint32 nParent = m_dynamicInfo[nLeaf].nParent;
+        uint32 nPair = m_pNodes[nParent].GetLeftChildIndex();
+        uint32 nSibling = ( nLeaf == nPair ) ? nPair+1 : nPair;
+        WriteNode( nParent, m_pNodes[nSibling], m_dynamicInfo[nSibling].nHeight );
+        FreeNodePair( nPair );
+
+        if( nParent != 0 )
+            UpdateAncestors( m_dynamicInfo[nParent].nParent );
+        else
+            m_nStackDepth = m_dynamicInfo[0].nHeight;
+    }
+
+    //=====================================================================================================================
+    /// This can be used to recover some of the quality lost after a large number of insertions, removals, or refits.
+    ///  It is much cheaper than a rebuild, but will not produce trees of the same quality
+    /// \param pObjects    The object set used to build the tree.  Object IDs must not have changed since the tree was built
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::OptimizeRotations( const ObjectSet_T* pObjects )
+    {
+        EnableDynamicUpdates( pObjects );
+        OptimizeSubtree( 0 );
+        m_nStackDepth = m_dynamicInfo[0].nHeight;
+    }
+
+    //=====================================================================================================================
+    /// The file contains the node array, including any nodes on the free list.  Dynamic update bookkeeping is not saved,
+    ///  and is re-created if the loaded tree is updated.
+    /// \param pFileName     Name of the file to write
+    /// \param pObjectRemap  Optional remap table, as returned by RemapRecorder::GetRemap
+    /// \param nObjects      Number of entries in the remap table
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    bool AABBTree<ObjectSet_T>::Save( const char* pFileName, const obj_id* pObjectRemap, obj_id nObjects ) const
+    {
+        SerializedTreeHeader header;
+        const void* pSections[SERIALIZED_SECTION_COUNT] = { NULL };
+        GetSerializedSections( header, pSections, pObjectRemap, nObjects );
+        return WriteSerializedTree( pFileName, header, pSections );
+    }
+
+    //=====================================================================================================================
+    /// \param pBuffer       Buffer to receive the tree.  Must be aligned to TRT_SIMD_ALIGNMENT if it is to be attached
+    /// \param nBufferSize   Size of the buffer
+    /// \param pObjectRemap  Optional remap table, as returned by RemapRecorder::GetRemap
+    /// \param nObjects      Number of entries in the remap table
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    size_t AABBTree<ObjectSet_T>::SaveToBuffer( void* pBuffer, size_t nBufferSize, const obj_id* pObjectRemap, obj_id nObjects ) const
+    {
+        SerializedTreeHeader header;
+        const void* pSections[SERIALIZED_SECTION_COUNT] = { NULL };
+        GetSerializedSections( header, pSections, pObjectRemap, nObjects );
+        return CopySerializedTree( pBuffer, nBufferSize, header, pSections );
     }
 
+    //=====================================================================================================================
+    /// \param pData    Start of the data written by 'Save' (typically a memory mapped file).  Must be aligned to TRT_SIMD_ALIGNMENT
+    /// \param nSize    Size of the data
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    bool AABBTree<ObjectSet_T>::Attach( const void* pData, size_t nSize )
+    {
+        const SerializedTreeHeader* pHeader = ReadSerializedTreeHeader( pData, nSize, SERIALIZED_AABBTREE, sizeof(Node), sizeof(obj_id) );
+        if( !pHeader )
+            return false;
+
+        size_t nNodeBytes;
+        const void* pNodes = GetSerializedSection( pHeader, SERIALIZED_SECTION_NODES, nNodeBytes );
+        uint32 nNodes = pHeader->nParams[0];
+        if( !pNodes || nNodes == 0 || nNodeBytes != nNodes*sizeof(Node) )
+            return false;
+
+        if( m_pNodes && m_bOwnsNodes )
+            delete[] m_pNodes;
+
+        m_pNodes = const_cast<Node*>( reinterpret_cast<const Node*>( pNodes ) );
+        m_bOwnsNodes = false;
+        m_nNodesInUse = nNodes;
+        m_nNodeArraySize = 0;
+        m_nFreeNodes = pHeader->nParams[1];
+        m_nFreePairs = pHeader->nParams[2];
+        m_nStackDepth = pHeader->nStackDepth;
+        m_dynamicInfo.clear();
+        m_objectLeaves.clear();
+        return true;
+    }
 
     //=====================================================================================================================
     //
@@ -108,4 +365,421 @@ namespace TinyRT
     //            Private Methods
     //
     //=====================================================================================================================
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::GetSerializedSections( SerializedTreeHeader& rHeader, const void* pSections[SERIALIZED_SECTION_COUNT],
+                                                       const obj_id* pObjectRemap, obj_id nObjects ) const
+    {
+        memset( &rHeader, 0, sizeof(rHeader) );
+        rHeader.nStructureType = SERIALIZED_AABBTREE;
+        rHeader.nObjIdSize = sizeof(obj_id);
+        rHeader.nNodeSize = sizeof(Node);
+        rHeader.nStackDepth = m_nStackDepth;
+        rHeader.nParams[0] = m_nNodesInUse;
+        rHeader.nParams[1] = m_nFreeNodes;
+        rHeader.nParams[2] = m_nFreePairs;
+        rHeader.sections[SERIALIZED_SECTION_NODES].nSize = m_nNodesInUse*sizeof(Node);
+        rHeader.sections[SERIALIZED_SECTION_REMAP].nSize = nObjects*sizeof(obj_id);
+
+        pSections[SERIALIZED_SECTION_NODES] = m_pNodes;
+        pSections[SERIALIZED_SECTION_LEAVES] = NULL;
+        pSections[SERIALIZED_SECTION_REMAP] = pObjectRemap;
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::MakeNodesWritable()
+    {
+        if( m_bOwnsNodes )
+            return;
+
+        Node* pNodes = new Node[ m_nNodesInUse ];
+        memcpy( static_cast<void*>( pNodes ), m_pNodes, m_nNodesInUse*sizeof(Node) );
+        m_pNodes = pNodes;
+        m_nNodeArraySize = m_nNodesInUse;
+        m_bOwnsNodes = true;
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    const AxisAlignedBox& AABBTree<ObjectSet_T>::RefitSubtree( const ObjectSet_T* pObjects, Node* pNode )
+    {
+        if( pNode->IsLeaf() )
+        {
+            obj_id nFirst, nLast;
+            pNode->GetObjectRange( nFirst, nLast );
+            if( nFirst != nLast )
+            {
+                AxisAlignedBox box;
+                pObjects->GetObjectAABB( nFirst, box );
+                while( ++nFirst != nLast )
+                {
+                    AxisAlignedBox objBox;
+                    pObjects->GetObjectAABB( nFirst, objBox );
+                    box.Merge( objBox );
+                }
+
+                pNode->SetAABB( box );
+            }
+        }
+        else
+        {
+            AxisAlignedBox box = RefitSubtree( pObjects, GetLeftChild( pNode ) );
+            box.Merge( RefitSubtree( pObjects, GetRightChild( pNode ) ) );
+            pNode->SetAABB( box );
+        }
+
+        return pNode->GetAABB();
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::EnableDynamicUpdates( const ObjectSet_T* pObjects )
+    {
+        if( !m_dynamicInfo.empty() )
+            return;
+
+        if( !m_pNodes )
+        {
+            // no tree has been built yet, start with an empty one
+            Initialize( AxisAlignedBox(), 16 );
+            m_pNodes[0].MakeLeaf( 0, 0 );
+            m_pNodes[0].SetAABB( AxisAlignedBox( Vec3f( FLT_MAX, FLT_MAX, FLT_MAX ), Vec3f( -FLT_MAX, -FLT_MAX, -FLT_MAX ) ) );
+        }
+
+        MakeNodesWritable();
+        m_objectLeaves.assign( pObjects->GetObjectCount(), INVALID_LEAF );
+        m_dynamicInfo.resize( m_nNodeArraySize );
+        m_nStackDepth = InitDynamicInfo( 0, 0 );
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    uint32 AABBTree<ObjectSet_T>::InitDynamicInfo( uint32 nNode, uint32 nParent )
+    {
+        const Node& rNode = m_pNodes[nNode];
+        uint32 nHeight = 1;
+        if( rNode.IsLeaf() )
+        {
+            obj_id nFirst, nLast;
+            rNode.GetObjectRange( nFirst, nLast );
+            for( obj_id i = nFirst; i != nLast; i++ )
+                m_objectLeaves[i] = nNode;
+        }
+        else
+        {
+            uint32 nLeft  = InitDynamicInfo( rNode.GetLeftChildIndex(), nNode );
+            uint32 nRight = InitDynamicInfo( rNode.GetRightChildIndex(), nNode );
+            nHeight = 1 + std::max( nLeft, nRight );
+        }
+
+        m_dynamicInfo[nNode].nParent = nParent;
+        m_dynamicInfo[nNode].nHeight = nHeight;
+        return nHeight;
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    uint32 AABBTree<ObjectSet_T>::AllocateNodePair()
+    {
+        if( m_nFreePairs )
+        {
+            // free pairs are chained together through their first node
+            uint32 nPair = m_nFreePairs;
+            m_nFreePairs = m_pNodes[nPair].GetLeftChildIndex();
+            m_nFreeNodes -= 2;
+            return nPair;
+        }
+
+        if( m_nNodesInUse + 2 > m_nNodeArraySize )
+        {
+            uint32 nNewSize = std::max( 2*m_nNodeArraySize, (uint32) 16 );
+            Node* pNewNodes = new Node[ nNewSize ];
+            for( uint32 i=0; i<m_nNodesInUse; i++ )
+                pNewNodes[i] = m_pNodes[i];
+
+            delete[] m_pNodes;
+            m_pNodes = pNewNodes;
+            m_nNodeArraySize = nNewSize;
+            m_dynamicInfo.resize( nNewSize );
+        }
+
+        uint32 nPair = m_nNodesInUse;
+        m_nNodesInUse += 2;
+        return nPair;
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::FreeNodePair( uint32 nFirst )
+    {
+        m_pNodes[nFirst].MakeInnerNode( m_nFreePairs, 0 );
+        m_nFreePairs = nFirst;
+        m_nFreeNodes += 2;
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::WriteNode( uint32 nDest, const Node& rNode, uint32 nHeight )
+    {
+        m_pNodes[nDest] = rNode;
+        m_dynamicInfo[nDest].nHeight = nHeight;
+
+        const Node& rDest = m_pNodes[nDest];
+        if( rDest.IsLeaf() )
+        {
+            obj_id nFirst, nLast;
+            rDest.GetObjectRange( nFirst, nLast );
+            for( obj_id i = nFirst; i != nLast; i++ )
+                m_objectLeaves[i] = nDest;
+        }
+        else
+        {
+            m_dynamicInfo[ rDest.GetLeftChildIndex() ].nParent = nDest;
+            m_dynamicInfo[ rDest.GetRightChildIndex() ].nParent = nDest;
+        }
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::SwapNodes( uint32 nFirst, uint32 nSecond )
+    {
+        Node tmp = m_pNodes[nFirst];
+        uint32 nTmpHeight = m_dynamicInfo[nFirst].nHeight;
+        WriteNode( nFirst, m_pNodes[nSecond], m_dynamicInfo[nSecond].nHeight );
+        WriteNode( nSecond, tmp, nTmpHeight );
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::ComputeLeafAABB( const ObjectSet_T* pObjects, Node* pNode )
+    {
+        obj_id nFirst, nLast;
+        pNode->GetObjectRange( nFirst, nLast );
+        TRT_ASSERT( nFirst != nLast );
+
+        AxisAlignedBox box;
+        pObjects->GetObjectAABB( nFirst, box );
+        while( ++nFirst != nLast )
+        {
+            AxisAlignedBox objBox;
+            pObjects->GetObjectAABB( nFirst, objBox );
+            box.Merge( objBox );
+        }
+        pNode->SetAABB( box );
+    }
+
+    //=====================================================================================================================
+    /// The cost of choosing a particular sibling is the area of the new parent node, plus the area increase of all of its
+    ///  ancestors.  Since this increase is at least the area of the new box, subtrees whose inherited cost exceeds the 
+    ///  best cost found so far can be skipped.  Nodes are visited in order of increasing inherited cost.
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    uint32 AABBTree<ObjectSet_T>::FindBestSibling( const AxisAlignedBox& rBox ) const
+    {
+        float fNewArea = HalfArea( rBox );
+
+        AxisAlignedBox rootBox = m_pNodes[0].GetAABB();
+        rootBox.Merge( rBox );
+
+        uint32 nBest = 0;
+        float fBestCost = HalfArea( rootBox );
+
+        // min-heap of ( inherited cost, node )
+        typedef std::pair<float,uint32> Candidate;
+        std::vector<Candidate> heap;
+        heap.push_back( Candidate( 0.0f, 0 ) );
+
+        while( !heap.empty() )
+        {
+            std::pop_heap( heap.begin(), heap.end(), std::greater<Candidate>() );
+            Candidate c = heap.back();
+            heap.pop_back();
+
+            if( c.first + fNewArea >= fBestCost )
+                break; // no remaining candidate can do better
+
+            const Node& rNode = m_pNodes[c.second];
+            AxisAlignedBox merged = rNode.GetAABB();
+            merged.Merge( rBox );
+            float fMergedArea = HalfArea( merged );
+
+            float fCost = fMergedArea + c.first;
+            if( fCost < fBestCost )
+            {
+                fBestCost = fCost;
+                nBest = c.second;
+            }
+
+            if( !rNode.IsLeaf() )
+            {
+                float fChildCost = c.first + fMergedArea - HalfArea( rNode.GetAABB() );
+                if( fChildCost + fNewArea < fBestCost )
+                {
+                    heap.push_back( Candidate( fChildCost, rNode.GetLeftChildIndex() ) );
+                    std::push_heap( heap.begin(), heap.end(), std::greater<Candidate>() );
+                    heap.push_back( Candidate( fChildCost, rNode.GetRightChildIndex() ) );
+                    std::push_heap( heap.begin(), heap.end(), std::greater<Candidate>() );
+                }
+            }
+        }
+
+        return nBest;
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::InsertLeaf( obj_id nFirst, obj_id nCount, const AxisAlignedBox& rBox )
+    {
+        Node leaf;
+        leaf.MakeLeaf( nFirst, nCount );
+        leaf.SetAABB( rBox );
+
+        if( m_pNodes[0].IsLeaf() && m_pNodes[0].GetObjectCount() == 0 )
+        {
+            // tree is empty
+            WriteNode( 0, leaf, 1 );
+            m_nStackDepth = 1;
+            return;
+        }
+
+        uint32 nSibling = FindBestSibling( rBox );
+        uint32 nPair = AllocateNodePair();
+
+        // move the sibling down, and turn its slot into the new parent
+        WriteNode( nPair, m_pNodes[nSibling], m_dynamicInfo[nSibling].nHeight );
+        WriteNode( nPair+1, leaf, 1 );
+        m_dynamicInfo[nPair].nParent = nSibling;
+        m_dynamicInfo[nPair+1].nParent = nSibling;
+        m_pNodes[nSibling].MakeInnerNode( nPair, 0 );
+        UpdateAncestors( nSibling );
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::RefitInnerNode( uint32 nNode )
+    {
+        Node& rNode = m_pNodes[nNode];
+        uint32 nLeft = rNode.GetLeftChildIndex();
+        uint32 nRight = rNode.GetRightChildIndex();
+
+        AxisAlignedBox box = m_pNodes[nLeft].GetAABB();
+        box.Merge( m_pNodes[nRight].GetAABB() );
+        rNode.SetAABB( box );
+        m_dynamicInfo[nNode].nHeight = 1 + std::max( m_dynamicInfo[nLeft].nHeight, m_dynamicInfo[nRight].nHeight );
+    }
+
+    //=====================================================================================================================
+    /// The ray traversal visits the left child first if the ray direction is positive along the split axis, so the 
+    ///  split axis is chosen as the axis of greatest separation between the child centroids, and the children are 
+    ///  ordered along it
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::OrderChildren( uint32 nNode )
+    {
+        uint32 nLeft = m_pNodes[nNode].GetLeftChildIndex();
+        Vec3f vDelta = m_pNodes[nLeft+1].GetAABB().Center() - m_pNodes[nLeft].GetAABB().Center();
+        
+        uint32 nAxis = 0;
+        if( fabs( vDelta[1] ) > fabs( vDelta[nAxis] ) ) nAxis = 1;
+        if( fabs( vDelta[2] ) > fabs( vDelta[nAxis] ) ) nAxis = 2;
+
+        if( vDelta[nAxis] < 0 )
+            SwapNodes( nLeft, nLeft+1 );
+
+        m_pNodes[nNode].MakeInnerNode( nLeft, nAxis );
+    }
+
+    //=====================================================================================================================
+    /// Each child may be swapped with either child of its sibling.  The swap which gives the largest reduction in the 
+    ///  area of the sibling is performed.  The area of the node itself is unaffected.
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::RotateNode( uint32 nNode )
+    {
+        uint32 nPair = m_pNodes[nNode].GetLeftChildIndex();
+
+        float fBestGain = 0.0f;
+        uint32 nBestChild = 0;
+        uint32 nBestGrandChild = 0;
+        for( uint32 i=0; i<2; i++ )
+        {
+            uint32 nChild = nPair + i;
+            uint32 nOther = nPair + (1-i);
+            const Node& rOther = m_pNodes[nOther];
+            if( rOther.IsLeaf() )
+                continue;
+
+            float fOtherArea = HalfArea( rOther.GetAABB() );
+            uint32 nGrandChildren = rOther.GetLeftChildIndex();
+            for( uint32 j=0; j<2; j++ )
+            {
+                // swapping the child with grandchild 'j' leaves grandchild '1-j' under the other child
+                AxisAlignedBox box = m_pNodes[nChild].GetAABB();
+                box.Merge( m_pNodes[ nGrandChildren + (1-j) ].GetAABB() );
+                float fGain = fOtherArea - HalfArea( box );
+                if( fGain > fBestGain )
+                {
+                    fBestGain = fGain;
+                    nBestChild = nChild;
+                    nBestGrandChild = nGrandChildren + j;
+                }
+            }
+        }
+
+        if( fBestGain > 0.0f )
+        {
+            uint32 nOther = nPair + ( 1 - ( nBestChild - nPair ) );
+            SwapNodes( nBestChild, nBestGrandChild );
+            RefitInnerNode( nOther );
+            OrderChildren( nOther );
+            RefitInnerNode( nNode );
+        }
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::UpdateAncestors( uint32 nNode )
+    {
+        while( true )
+        {
+            RefitInnerNode( nNode );
+            RotateNode( nNode );
+            OrderChildren( nNode );
+            if( nNode == 0 )
+                break;
+            nNode = m_dynamicInfo[nNode].nParent;
+        }
+
+        m_nStackDepth = m_dynamicInfo[0].nHeight;
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< typename ObjectSet_T >
+    void AABBTree<ObjectSet_T>::OptimizeSubtree( uint32 nNode )
+    {
+        if( m_pNodes[nNode].IsLeaf() )
+            return;
+
+        OptimizeSubtree( m_pNodes[nNode].GetLeftChildIndex() );
+        OptimizeSubtree( m_pNodes[nNode].GetRightChildIndex() );
+        RefitInnerNode( nNode );
+        RotateNode( nNode );
+        OrderChildren( nNode );
+    }
 }
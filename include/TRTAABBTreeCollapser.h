@@ -0,0 +1,80 @@
+//=====================================================================================================================
+//
+//   TRTAABBTreeCollapser.h
+//
+//   Definition of class: TinyRT::AABBTreeCollapser
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_AABBTREECOLLAPSER_H_
+#define _TRT_AABBTREECOLLAPSER_H_
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A QuadAABBTree builder which builds a binary AABB tree with another builder, and collapses it
+    ///
+    ///  Each QBVH node is formed from a binary node by repeatedly replacing the inner child with the largest surface
+    ///   area by its two children, until the QBVH node is full or only leaves remain.  The binary nodes which are pulled
+    ///   up in this way determine the child traversal order for each ray octant, so that the QBVH visits its children 
+    ///   in the same order as the binary traversal would.  The leaves and the object order of the binary tree are kept.
+    ///
+    ///  This allows any AABB tree builder to be used to produce QuadAABBTrees.
+    ///
+    /// \param AABBTreeBuilder_T  An AABB tree builder, such as MedianCutAABBTreeBuilder or SahAABBTreeBuilder
+    //=====================================================================================================================
+    template< class AABBTreeBuilder_T >
+    class AABBTreeCollapser
+    {
+    public:
+
+        typedef typename AABBTreeBuilder_T::ObjectSet ObjectSet;
+        typedef typename ObjectSet::obj_id obj_id;
+
+        inline AABBTreeCollapser( const AABBTreeBuilder_T& rBuilder ) : m_builder( rBuilder ) {};
+
+        /// \brief Builds a binary AABB tree over an object set, and collapses it into a QuadAABBTree
+        /// \param pObjects     Object set for which the tree is constructed.  The objects are re-ordered by the binary builder
+        /// \param pTree        The tree to be constructed.  Must implement the QuadAABBTree_C concept
+        /// \return The maximum depth of the constructed tree
+        template< class QAABBTree_T >
+        uint32 BuildQuadAABBTree( ObjectSet* pObjects, QAABBTree_T* pTree );
+
+        /// \brief Collapses an existing binary tree into a QuadAABBTree.  Returns the maximum depth of the constructed tree
+        /// \param pBinaryTree  Must implement the BVH_C concept, and provide a 'GetNodeBoundingVolume' method (AABBTree does)
+        /// \param pTree        The tree to be constructed.  Must implement the QuadAABBTree_C concept
+        template< class BVH_T, class QAABBTree_T >
+        static uint32 CollapseTree( const BVH_T* pBinaryTree, QAABBTree_T* pTree );
+
+        /// Adds the builder type, and the parameters of the binary builder, to a hash.  Used by BuildCache to identify the build parameters
+        inline void HashParameters( ContentHash& rHash ) const { rHash.AddString( "AABBTreeCollapser" ); m_builder.HashParameters( rHash ); };
+
+    private:
+
+        /// Fills a QBVH node from the subtree beneath a binary node, and recursively collapses the children
+        template< class BVH_T, class QAABBTree_T >
+        static uint32 CollapseNode( const BVH_T* pBinaryTree, typename BVH_T::ConstNodeHandle pBinaryNode, 
+                                    QAABBTree_T* pTree, typename QAABBTree_T::NodeHandle nNode );
+
+        /// Emits the QBVH child indices beneath a binary node, in the order that a binary traversal in a given octant visits them
+        template< class BVH_T >
+        static void GetTraversalOrder( const BVH_T* pBinaryTree, typename BVH_T::ConstNodeHandle pBinaryNode, 
+                                       const typename BVH_T::ConstNodeHandle* pChildren, uint32 nChildren, 
+                                       uint32 nOctant, uint32*& rpOrderOut );
+
+        AABBTreeBuilder_T m_builder;
+    };
+
+}
+
+#include "TRTAABBTreeCollapser.inl"
+
+#endif // _TRT_AABBTREECOLLAPSER_H_
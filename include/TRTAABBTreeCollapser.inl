@@ -0,0 +1,175 @@
+//=====================================================================================================================
+//
+//   TRTAABBTreeCollapser.inl
+//
+//   Implementation of class: TinyRT::AABBTreeCollapser
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#include "TRTAABBTreeCollapser.h"
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    //
+    //            Public Methods
+    //
+    //=====================================================================================================================
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class AABBTreeBuilder_T >
+    template< class QAABBTree_T >
+    uint32 AABBTreeCollapser<AABBTreeBuilder_T>::BuildQuadAABBTree( ObjectSet* pObjects, QAABBTree_T* pTree )
+    {
+        AABBTree<ObjectSet> binaryTree;
+        binaryTree.Build( pObjects, m_builder );
+        return CollapseTree( &binaryTree, pTree );
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class AABBTreeBuilder_T >
+    template< class BVH_T, class QAABBTree_T >
+    uint32 AABBTreeCollapser<AABBTreeBuilder_T>::CollapseTree( const BVH_T* pBinaryTree, QAABBTree_T* pTree )
+    {
+        typedef typename QAABBTree_T::NodeHandle NodeHandle;
+        typedef typename BVH_T::ConstNodeHandle BinaryNodeHandle;
+        typedef typename BVH_T::obj_id binary_obj_id;
+
+        BinaryNodeHandle pBinaryRoot = pBinaryTree->GetRoot();
+        NodeHandle nRoot = pTree->Initialize( pBinaryTree->GetNodeBoundingVolume( pBinaryRoot ) );
+
+        if( !pBinaryTree->IsNodeLeaf( pBinaryRoot ) )
+            return CollapseNode( pBinaryTree, pBinaryRoot, pTree, nRoot );
+
+        // the QBVH root is always an inner node, so a binary tree consisting of one leaf becomes a root with one leaf child
+        binary_obj_id nFirst, nLast;
+        pBinaryTree->GetNodeObjectRange( pBinaryRoot, nFirst, nLast );
+        const AxisAlignedBox& rRootBox = pBinaryTree->GetNodeBoundingVolume( pBinaryRoot );
+        pTree->SetChildAABB( nRoot, 0, rRootBox );
+        pTree->CreateLeafChild( nRoot, 0, nFirst, nLast - nFirst );
+        pTree->CreateEmptyLeafChildren( nRoot, 1, rRootBox );
+        pTree->SetSplitAxes( nRoot, 0, 0, 0 );
+        return 1;
+    }
+
+    //=====================================================================================================================
+    //
+    //            Private Methods
+    //
+    //=====================================================================================================================
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class AABBTreeBuilder_T >
+    template< class BVH_T, class QAABBTree_T >
+    uint32 AABBTreeCollapser<AABBTreeBuilder_T>::CollapseNode( const BVH_T* pBinaryTree, typename BVH_T::ConstNodeHandle pBinaryNode, 
+                                                               QAABBTree_T* pTree, typename QAABBTree_T::NodeHandle nNode )
+    {
+        typedef typename QAABBTree_T::NodeHandle NodeHandle;
+        typedef typename BVH_T::ConstNodeHandle BinaryNodeHandle;
+        typedef typename BVH_T::obj_id binary_obj_id;
+
+        const uint32 BRANCH_FACTOR = QAABBTree_T::BRANCH_FACTOR;
+
+        // pull up the largest inner children until the node is full
+        BinaryNodeHandle children[ QAABBTree_T::BRANCH_FACTOR ];
+        children[0] = pBinaryTree->GetLeftChild( pBinaryNode );
+        children[1] = pBinaryTree->GetRightChild( pBinaryNode );
+        uint32 nChildren = 2;
+
+        while( nChildren < BRANCH_FACTOR )
+        {
+            int nLargest = -1;
+            float fLargestArea = -1.0f;
+            for( uint32 i=0; i<nChildren; i++ )
+            {
+                if( pBinaryTree->IsNodeLeaf( children[i] ) )
+                    continue;
+
+                float fArea = HalfArea( pBinaryTree->GetNodeBoundingVolume( children[i] ) );
+                if( fArea > fLargestArea )
+                {
+                    fLargestArea = fArea;
+                    nLargest = static_cast<int>( i );
+                }
+            }
+
+            if( nLargest == -1 )
+                break; // nothing left to pull up
+
+            BinaryNodeHandle pPulled = children[nLargest];
+            children[nLargest]    = pBinaryTree->GetLeftChild( pPulled );
+            children[nChildren++] = pBinaryTree->GetRightChild( pPulled );
+        }
+
+        // derive the child ordering for each octant from the binary nodes that were pulled up
+        for( uint32 nOctant=0; nOctant<8; nOctant++ )
+        {
+            uint32 order[ QAABBTree_T::BRANCH_FACTOR ];
+            uint32* pOrder = order;
+            GetTraversalOrder( pBinaryTree, pBinaryNode, children, nChildren, nOctant, pOrder );
+            pTree->SetChildTraversalOrder( nNode, nOctant, order, nChildren );
+        }
+
+        // fill in the children.  The node handle remains valid when subdividing, even though the node array may move
+        uint32 nDepth = 1;
+        for( uint32 i=0; i<nChildren; i++ )
+        {
+            pTree->SetChildAABB( nNode, i, pBinaryTree->GetNodeBoundingVolume( children[i] ) );
+            if( pBinaryTree->IsNodeLeaf( children[i] ) )
+            {
+                binary_obj_id nFirst, nLast;
+                pBinaryTree->GetNodeObjectRange( children[i], nFirst, nLast );
+                if( nFirst == nLast )
+                    pTree->CreateEmptyLeafChild( nNode, i );
+                else
+                    pTree->CreateLeafChild( nNode, i, nFirst, nLast - nFirst );
+            }
+            else
+            {
+                NodeHandle nChild = pTree->SubdivideChild( nNode, i );
+                nDepth = std::max( nDepth, CollapseNode( pBinaryTree, children[i], pTree, nChild ) );
+            }
+        }
+
+        pTree->CreateEmptyLeafChildren( nNode, nChildren, pBinaryTree->GetNodeBoundingVolume( children[0] ) );
+
+        return 1 + nDepth;
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class AABBTreeBuilder_T >
+    template< class BVH_T >
+    void AABBTreeCollapser<AABBTreeBuilder_T>::GetTraversalOrder( const BVH_T* pBinaryTree, typename BVH_T::ConstNodeHandle pBinaryNode, 
+                                                                  const typename BVH_T::ConstNodeHandle* pChildren, uint32 nChildren, 
+                                                                  uint32 nOctant, uint32*& rpOrderOut )
+    {
+        for( uint32 i=0; i<nChildren; i++ )
+        {
+            if( pChildren[i] == pBinaryNode )
+            {
+                *(rpOrderOut++) = i;
+                return;
+            }
+        }
+
+        // this node was pulled up.  Visit its children in the same order as RaycastBVH
+        uint32 nAxis = pBinaryTree->GetNodeSplitAxis( pBinaryNode );
+        bool bNegative = ( ( nOctant >> nAxis ) & 1 ) != 0;
+        typename BVH_T::ConstNodeHandle pLeft  = pBinaryTree->GetLeftChild( pBinaryNode );
+        typename BVH_T::ConstNodeHandle pRight = pBinaryTree->GetRightChild( pBinaryNode );
+        GetTraversalOrder( pBinaryTree, bNegative ? pRight : pLeft, pChildren, nChildren, nOctant, rpOrderOut );
+        GetTraversalOrder( pBinaryTree, bNegative ? pLeft : pRight, pChildren, nChildren, nOctant, rpOrderOut );
+    }
+
+}
@@ -0,0 +1,189 @@
+//=====================================================================================================================
+//
+//   TRTAffineTransform.h
+//
+//   Definition of class: TinyRT::AffineTransform
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_AFFINETRANSFORM_H_
+#define _TRT_AFFINETRANSFORM_H_
+
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A 3x4 matrix representing an affine transformation
+    ///
+    ///  The matrix is stored in row-major order, and transforms column vectors.  The fourth column is the translation.
+    //=====================================================================================================================
+    class AffineTransform
+    {
+    public:
+
+        /// Constructs an identity transform
+        inline AffineTransform( )
+        {
+            for( uint i=0; i<3; i++ )
+                for( uint j=0; j<4; j++ )
+                    m_rows[i][j] = ( i == j ) ? 1.0f : 0.0f;
+        };
+
+        /// Constructs a transform from an array of 12 floats, in row-major order
+        inline explicit AffineTransform( const float* pRowMajor )
+        {
+            for( uint i=0; i<3; i++ )
+                for( uint j=0; j<4; j++ )
+                    m_rows[i][j] = pRowMajor[4*i + j];
+        };
+
+        /// Creates a translation
+        static inline AffineTransform Translation( const Vec3f& rOffset )
+        {
+            AffineTransform xform;
+            xform.m_rows[0][3] = rOffset.x;
+            xform.m_rows[1][3] = rOffset.y;
+            xform.m_rows[2][3] = rOffset.z;
+            return xform;
+        };
+
+        /// Creates a non-uniform scale
+        static inline AffineTransform Scale( const Vec3f& rScale )
+        {
+            AffineTransform xform;
+            xform.m_rows[0][0] = rScale.x;
+            xform.m_rows[1][1] = rScale.y;
+            xform.m_rows[2][2] = rScale.z;
+            return xform;
+        };
+
+        /// Creates a rotation about an arbitrary axis
+        /// \param rAxis      The rotation axis.  Need not be normalized
+        /// \param fRadians   The rotation angle, in radians
+        static inline AffineTransform Rotation( const Vec3f& rAxis, float fRadians )
+        {
+            Vec3f a = Normalize3( rAxis );
+            float c = cos( fRadians );
+            float s = sin( fRadians );
+            float t = 1.0f - c;
+
+            AffineTransform xform;
+            xform.m_rows[0][0] = t*a.x*a.x + c;     xform.m_rows[0][1] = t*a.x*a.y - s*a.z; xform.m_rows[0][2] = t*a.x*a.z + s*a.y;
+            xform.m_rows[1][0] = t*a.x*a.y + s*a.z; xform.m_rows[1][1] = t*a.y*a.y + c;     xform.m_rows[1][2] = t*a.y*a.z - s*a.x;
+            xform.m_rows[2][0] = t*a.x*a.z - s*a.y; xform.m_rows[2][1] = t*a.y*a.z + s*a.x; xform.m_rows[2][2] = t*a.z*a.z + c;
+            return xform;
+        };
+
+        /// Accessor for matrix elements
+        inline float& operator()( uint nRow, uint nCol ) { return m_rows[nRow][nCol]; };
+
+        /// Accessor for matrix elements
+        inline float operator()( uint nRow, uint nCol ) const { return m_rows[nRow][nCol]; };
+
+        /// Returns the concatenation of two transforms.  The right-hand transform is applied first
+        inline AffineTransform operator*( const AffineTransform& rhs ) const
+        {
+            AffineTransform xform;
+            for( uint i=0; i<3; i++ )
+            {
+                for( uint j=0; j<4; j++ )
+                {
+                    float f = m_rows[i][0]*rhs.m_rows[0][j] + m_rows[i][1]*rhs.m_rows[1][j] + m_rows[i][2]*rhs.m_rows[2][j];
+                    xform.m_rows[i][j] = ( j == 3 ) ? f + m_rows[i][3] : f;
+                }
+            }
+            return xform;
+        };
+
+        /// Transforms a point
+        inline Vec3f TransformPoint( const Vec3f& p ) const
+        {
+            return Vec3f( m_rows[0][0]*p.x + m_rows[0][1]*p.y + m_rows[0][2]*p.z + m_rows[0][3],
+                          m_rows[1][0]*p.x + m_rows[1][1]*p.y + m_rows[1][2]*p.z + m_rows[1][3],
+                          m_rows[2][0]*p.x + m_rows[2][1]*p.y + m_rows[2][2]*p.z + m_rows[2][3] );
+        };
+
+        /// Transforms a direction vector (ignoring the translation)
+        inline Vec3f TransformVector( const Vec3f& v ) const
+        {
+            return Vec3f( m_rows[0][0]*v.x + m_rows[0][1]*v.y + m_rows[0][2]*v.z,
+                          m_rows[1][0]*v.x + m_rows[1][1]*v.y + m_rows[1][2]*v.z,
+                          m_rows[2][0]*v.x + m_rows[2][1]*v.y + m_rows[2][2]*v.z );
+        };
+
+        /// \brief Multiplies a vector by the transpose of the upper 3x3 part of the matrix
+        /// Calling this method on the inverse of a transform will transform a surface normal
+        inline Vec3f TransformVectorTransposed( const Vec3f& v ) const
+        {
+            return Vec3f( m_rows[0][0]*v.x + m_rows[1][0]*v.y + m_rows[2][0]*v.z,
+                          m_rows[0][1]*v.x + m_rows[1][1]*v.y + m_rows[2][1]*v.z,
+                          m_rows[0][2]*v.x + m_rows[1][2]*v.y + m_rows[2][2]*v.z );
+        };
+
+        /// Computes the bounding box of a transformed box
+        inline void TransformAABB( const AxisAlignedBox& rBox, AxisAlignedBox& rBoxOut ) const
+        {
+            Vec3f vCenter  = TransformPoint( rBox.Center() );
+            Vec3f vExtents = ( rBox.Max() - rBox.Min() ) * 0.5f;
+
+            Vec3f vNewExtents;
+            for( uint i=0; i<3; i++ )
+                vNewExtents[i] = fabs( m_rows[i][0] )*vExtents.x + fabs( m_rows[i][1] )*vExtents.y + fabs( m_rows[i][2] )*vExtents.z;
+
+            rBoxOut = AxisAlignedBox( vCenter - vNewExtents, vCenter + vNewExtents );
+        };
+
+        /// \brief Computes the inverse of this transform
+        /// \return False if the transform is singular, in which case the output is not modified
+        inline bool Invert( AffineTransform& rInverse ) const
+        {
+            const float (&m)[3][4] = m_rows;
+
+            // cofactors of the upper 3x3
+            float c00 = m[1][1]*m[2][2] - m[1][2]*m[2][1];
+            float c01 = m[1][2]*m[2][0] - m[1][0]*m[2][2];
+            float c02 = m[1][0]*m[2][1] - m[1][1]*m[2][0];
+
+            float fDet = m[0][0]*c00 + m[0][1]*c01 + m[0][2]*c02;
+            if( fabs( fDet ) < FLT_MIN )
+                return false;
+
+            float fInvDet = 1.0f / fDet;
+
+            AffineTransform inv;
+            inv.m_rows[0][0] = c00*fInvDet;
+            inv.m_rows[1][0] = c01*fInvDet;
+            inv.m_rows[2][0] = c02*fInvDet;
+            inv.m_rows[0][1] = ( m[0][2]*m[2][1] - m[0][1]*m[2][2] )*fInvDet;
+            inv.m_rows[1][1] = ( m[0][0]*m[2][2] - m[0][2]*m[2][0] )*fInvDet;
+            inv.m_rows[2][1] = ( m[0][1]*m[2][0] - m[0][0]*m[2][1] )*fInvDet;
+            inv.m_rows[0][2] = ( m[0][1]*m[1][2] - m[0][2]*m[1][1] )*fInvDet;
+            inv.m_rows[1][2] = ( m[0][2]*m[1][0] - m[0][0]*m[1][2] )*fInvDet;
+            inv.m_rows[2][2] = ( m[0][0]*m[1][1] - m[0][1]*m[1][0] )*fInvDet;
+
+            // inverse translation is -R^-1 * t
+            Vec3f t = inv.TransformVector( Vec3f( m[0][3], m[1][3], m[2][3] ) );
+            inv.m_rows[0][3] = -t.x;
+            inv.m_rows[1][3] = -t.y;
+            inv.m_rows[2][3] = -t.z;
+
+            rInverse = inv;
+            return true;
+        };
+
+    private:
+
+        float m_rows[3][4];
+    };
+
+}
+
+#endif // _TRT_AFFINETRANSFORM_H_
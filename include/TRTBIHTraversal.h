@@ -0,0 +1,254 @@
+//=====================================================================================================================
+//
+//   TRTBIHTraversal.h
+//
+//   Ray traversal for bounding interval hierarchies
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_BIHTRAVERSAL_H_
+#define _TRT_BIHTRAVERSAL_H_
+
+#include "TRTTraversalStack.h"
+#include "TRTTraversalStats.h"
+
+namespace TinyRT
+{
+    template< class BIHTree_T >
+    struct BIHStackEntry
+    {
+        typename BIHTree_T::ConstNodeHandle pNode;
+        float fTMin;
+        float fTMax;
+    };
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief BIH traversal kernel for rays in a particular octant
+    ///
+    /// This works like RaycastKDTreeOctant, except that each node has two clip planes.  The near child is visited over the
+    ///  part of the ray interval which lies in front of its clip plane, and the far child over the part beyond its own
+    ///  plane.  Either part may be empty, and the two may overlap.  Objects are not duplicated, so no mailbox is needed.
+    ///
+    /// \param pStack           Traversal stack.  Must have room for pTree->GetStackDepth() entries
+    /// \param rStats           Receives traversal statistics
+    /// \param OCTANT           The ray's octant, as returned by GetRayOctant
+    /// \param BIHTree_T        Must be a BIHTree
+    /// \param ObjectSet_T      Must implement the ObjectSet_C concept
+    /// \param HitInfo_T        Must implement the HitInfo_C concept
+    /// \param Ray_T            Must implement the Ray_C concept
+    /// \param Stats_T          Must implement the TraversalStats_C concept
+    //=====================================================================================================================
+    template< int OCTANT, typename BIHTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    void RaycastBIHTreeOctant( const BIHTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo,
+                               typename BIHTree_T::ConstNodeHandle pRoot, BIHStackEntry<BIHTree_T>* pStack, Stats_T& rStats )
+    {
+        typedef BIHStackEntry<BIHTree_T> StackEntry;
+        typedef typename BIHTree_T::ConstNodeHandle NodeHandle;
+        typedef typename BIHTree_T::obj_id obj_id;
+
+        StackEntry* pStackBottom = pStack;
+
+        rStats.CountRay();
+        rStats.CountBoxTests( 1 );
+
+        const AxisAlignedBox& rBox = pTree->GetBoundingBox();
+        float fTMin, fTMax;
+        if( !RayAABBTestOctant<OCTANT>( rBox.Min(), rBox.Max(), rRay, fTMin, fTMax ) )
+            return;
+
+        float fRayMin = rRay.MinDistance();
+        float fRayMax = rRay.MaxDistance();
+        if( fTMin < fRayMin )
+            fTMin = fRayMin;
+        if( fTMax > fRayMax )
+            fTMax = fRayMax;
+
+        const Vec3f& rRayOrigin = rRay.Origin();
+        const Vec3f& rRayDirectionInv = rRay.InvDirection();
+
+        NodeHandle pNode = pRoot;
+        while( 1 )
+        {
+            if( pTree->IsNodeLeaf( pNode ) )
+            {
+                // intersect all objects in this leaf node, then proceed with next node from stack
+                obj_id nFirstObj, nLastObj;
+                pTree->GetNodeObjectRange( pNode, nFirstObj, nLastObj );
+
+                rStats.CountLeaf();
+                rStats.CountPrimitiveTests( static_cast<uint32>( nLastObj - nFirstObj ) );
+
+                while( nFirstObj != nLastObj )
+                {
+                    pObjects->RayIntersect( rRay, rHitInfo, nFirstObj );
+                    nFirstObj++;
+                }
+            }
+            else
+            {
+                rStats.CountInnerNode();
+
+                uint32 nAxis = pTree->GetNodeSplitAxis( pNode );
+                float fLeftClip, fRightClip;
+                pTree->GetNodeClipPlanes( pNode, fLeftClip, fRightClip );
+
+                float fO = rRayOrigin[nAxis];
+                float fD = rRayDirectionInv[nAxis];
+                float fTLeft  = ( fLeftClip - fO ) * fD;
+                float fTRight = ( fRightClip - fO ) * fD;
+
+                // the ray leaves the near child at its clip plane, and enters the far child at the other one
+                bool bNegative = ( ( OCTANT >> nAxis ) & 1 ) != 0;
+                NodeHandle pNear = bNegative ? pTree->GetRightChild( pNode ) : pTree->GetLeftChild( pNode );
+                NodeHandle pFar  = bNegative ? pTree->GetLeftChild( pNode ) : pTree->GetRightChild( pNode );
+                float fTNearExit = bNegative ? fTRight : fTLeft;
+                float fTFarEntry = bNegative ? fTLeft : fTRight;
+
+                // These tests are written so that a NaN distance (a ray origin lying in a clip plane, parallel to it)
+                //  causes the child to be visited
+                bool bSkipNear = ( fTNearExit < fTMin );
+                bool bSkipFar  = ( fTFarEntry > fTMax );
+
+                if( !bSkipNear )
+                {
+                    if( !bSkipFar )
+                    {
+                        // hit both
+                        pStack->pNode = pFar;
+                        pStack->fTMin = ( fTFarEntry > fTMin ) ? fTFarEntry : fTMin;
+                        pStack->fTMax = fTMax;
+                        pStack++;
+                        rStats.CountStackDepth( pStack - pStackBottom );
+                    }
+
+                    pNode = pNear;
+                    if( fTNearExit < fTMax )
+                        fTMax = fTNearExit;
+                    continue;
+                }
+                else if( !bSkipFar )
+                {
+                    // hit far only
+                    pNode = pFar;
+                    if( fTFarEntry > fTMin )
+                        fTMin = fTFarEntry;
+                    continue;
+                }
+
+                // missed both children
+            }
+
+            // continue popping the stack until we locate a node that is nearer than the ray depth limit
+            do
+            {
+                if( pStack == pStackBottom )
+                    return;      // stack is empty, we have fallen out of the tree
+
+                pStack--;
+            } while( !rRay.IsDistanceValid( pStack->fTMin ) );
+
+            // visit the next node from the stack
+            pNode = pStack->pNode;
+            fTMin = pStack->fTMin;
+            fTMax = pStack->fTMax;
+
+        } // end of infinite traversal loop
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a BIH, using a caller-supplied stack.
+    ///  The ray is traversed by the kernel which is specialized for its octant
+    /// \param pStack           Traversal stack.  Must have room for pTree->GetStackDepth() entries
+    /// \param rStats           Receives traversal statistics
+    /// \param BIHTree_T        Must be a BIHTree
+    /// \param ObjectSet_T      Must implement the ObjectSet_C concept
+    /// \param HitInfo_T        Must implement the HitInfo_C concept
+    /// \param Ray_T            Must implement the Ray_C concept
+    /// \param Stats_T          Must implement the TraversalStats_C concept
+    //=====================================================================================================================
+    template< typename BIHTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    void RaycastBIHTreeWithStack( const BIHTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo,
+                                  typename BIHTree_T::ConstNodeHandle pRoot, BIHStackEntry<BIHTree_T>* pStack, Stats_T& rStats )
+    {
+        switch( GetRayOctant( rRay ) )
+        {
+        case 0: RaycastBIHTreeOctant<0>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 1: RaycastBIHTreeOctant<1>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 2: RaycastBIHTreeOctant<2>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 3: RaycastBIHTreeOctant<3>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 4: RaycastBIHTreeOctant<4>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 5: RaycastBIHTreeOctant<5>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 6: RaycastBIHTreeOctant<6>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 7: RaycastBIHTreeOctant<7>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        };
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a BIH, using a caller-supplied stack.
+    /// \param pStack           Traversal stack.  Must have room for pTree->GetStackDepth() entries
+    //=====================================================================================================================
+    template< typename BIHTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastBIHTreeWithStack( const BIHTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo,
+                                         typename BIHTree_T::ConstNodeHandle pRoot, BIHStackEntry<BIHTree_T>* pStack )
+    {
+        NullTraversalStats stats;
+        RaycastBIHTreeWithStack( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, stats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a BIH.
+    ///  The traversal stack is kept on the call stack, and scratch memory is only used if the tree is deeper than TRT_INLINE_STACK_DEPTH
+    /// \param BIHTree_T        Must be a BIHTree
+    /// \param ObjectSet_T      Must implement the ObjectSet_C concept
+    /// \param HitInfo_T        Must implement the HitInfo_C concept
+    /// \param Ray_T            Must implement the Ray_C concept
+    //=====================================================================================================================
+    template< typename BIHTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastBIHTree( const BIHTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, typename BIHTree_T::ConstNodeHandle pRoot, ScratchMemory& rScratch )
+    {
+        TraversalStack< BIHStackEntry<BIHTree_T>, TRT_INLINE_STACK_DEPTH > stack( rScratch, pTree->GetStackDepth() );
+        BIHStackEntry<BIHTree_T>* pStack = stack;
+        RaycastBIHTreeWithStack( pTree, pObjects, rRay, rHitInfo, pRoot, pStack );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a BIH, and records traversal statistics
+    /// \param Stats_T          Must implement the TraversalStats_C concept
+    //=====================================================================================================================
+    template< typename BIHTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    inline void RaycastBIHTree( const BIHTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, typename BIHTree_T::ConstNodeHandle pRoot,
+                                ScratchMemory& rScratch, Stats_T& rStats )
+    {
+        TraversalStack< BIHStackEntry<BIHTree_T>, TRT_INLINE_STACK_DEPTH > stack( rScratch, pTree->GetStackDepth() );
+        BIHStackEntry<BIHTree_T>* pStack = stack;
+        RaycastBIHTreeWithStack( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a BIH, using the calling thread's scratch memory
+    ///  if the tree is too deep for an inline stack
+    /// \sa ThreadScratchMemory
+    //=====================================================================================================================
+    template< typename BIHTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastBIHTree( const BIHTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, typename BIHTree_T::ConstNodeHandle pRoot )
+    {
+        TraversalStack< BIHStackEntry<BIHTree_T>, TRT_INLINE_STACK_DEPTH > stack( pTree->GetStackDepth() );
+        BIHStackEntry<BIHTree_T>* pStack = stack;
+        RaycastBIHTreeWithStack( pTree, pObjects, rRay, rHitInfo, pRoot, pStack );
+    }
+
+}
+
+#endif // _TRT_BIHTRAVERSAL_H_
@@ -0,0 +1,178 @@
+//=====================================================================================================================
+//
+//   TRTBIHTree.h
+//
+//   Definition of class: TinyRT::BIHTree
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_BIHTREE_H_
+#define _TRT_BIHTREE_H_
+
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A bounding interval hierarchy
+    ///
+    ///  A BIH is a binary tree in which each inner node stores two parallel clip planes.  The left child's objects lie
+    ///   entirely below the first plane, and the right child's objects lie entirely above the second.  The planes may
+    ///   overlap, or leave a gap between them.  Like an AABB tree, each object is stored in exactly one leaf, and leaves
+    ///   store a range of objects in the (re-ordered) object set, so traversal needs no mailbox.  Like a KD-tree, it is
+    ///   traversed by clipping a ray interval against planes (see RaycastBIHTree).
+    ///
+    ///  Nodes are 12 bytes, and the tree is much faster to construct than an SAH tree (see BIHTreeBuilder), which makes it
+    ///   suitable for scenes which must be rebuilt every frame.
+    ///
+    /// \param ObjectSet_T Must implement the ObjectSet_C concept
+    //=====================================================================================================================
+    template< class ObjectSet_T >
+    class BIHTree
+    {
+    public:
+
+        typedef ObjectSet_T ObjectSet;
+        typedef typename ObjectSet_T::obj_id obj_id;
+
+        typedef uint32 NodeHandle;
+        typedef uint32 ConstNodeHandle;
+
+        /// A node in a BIH
+        class Node
+        {
+        public:
+
+            inline bool IsLeaf() const { return m_nAxis == 3; };
+            inline uint32 GetSplitAxis() const { return m_nAxis; };
+            inline float GetLeftClip() const { return m_fClip[0]; };
+            inline float GetRightClip() const { return m_fClip[1]; };
+            inline uint32 GetLeftChild() const { return m_nLeftChildOrFirstObj; };
+            inline obj_id GetFirstObject() const { return static_cast<obj_id>( m_nLeftChildOrFirstObj ); };
+            inline obj_id GetObjectCount() const { return m_nObjCount; };
+
+            inline void MakeInnerNode( uint32 nLeftChild, uint32 nAxis, float fLeftClip, float fRightClip )
+            {
+                TRT_ASSERT( nLeftChild < (1<<30) && nAxis < 3 );
+                m_fClip[0] = fLeftClip;
+                m_fClip[1] = fRightClip;
+                m_nLeftChildOrFirstObj = nLeftChild;
+                m_nAxis = nAxis;
+            };
+
+            inline void MakeLeafNode( obj_id nFirstObj, obj_id nObjCount )
+            {
+                TRT_ASSERT( nFirstObj < (1<<30) );
+                m_nObjCount = nObjCount;
+                m_nLeftChildOrFirstObj = static_cast<uint32>( nFirstObj );
+                m_nAxis = 3;
+            };
+
+        private:
+
+            union
+            {
+                float m_fClip[2];       ///< Upper bound of the left child, and lower bound of the right child (if an inner node)
+                obj_id m_nObjCount;     ///< Number of objects (if a leaf)
+            };
+
+            uint32 m_nLeftChildOrFirstObj : 30; ///< Index of the left child (if an inner node), or first object (if a leaf).  The right child follows the left
+            uint32 m_nAxis : 2;                 ///< Clip plane axis (a value of 3 indicates a leaf)
+        };
+
+        inline BIHTree( );
+
+        /// Returns the root node of the tree
+        inline ConstNodeHandle GetRoot() const { return 0; };
+
+        /// Returns the i'th child of an inner node.  0 is the left
+        inline ConstNodeHandle GetChild( ConstNodeHandle n, size_t i ) const { TRT_ASSERT( n < m_nNodesInUse ); return m_pNodes[n].GetLeftChild() + static_cast<uint32>( i ); };
+
+        /// Returns the left (lower) child of an inner node
+        inline ConstNodeHandle GetLeftChild( ConstNodeHandle n ) const { TRT_ASSERT( n < m_nNodesInUse ); return m_pNodes[n].GetLeftChild(); };
+
+        /// Returns the right (upper) child of an inner node
+        inline ConstNodeHandle GetRightChild( ConstNodeHandle n ) const { TRT_ASSERT( n < m_nNodesInUse ); return m_pNodes[n].GetLeftChild() + 1; };
+
+        /// Returns the number of children of a node (always 0 or 2)
+        inline size_t GetChildCount( ConstNodeHandle n ) const { TRT_ASSERT( n < m_nNodesInUse ); return m_pNodes[n].IsLeaf() ? 0 : 2; };
+
+        /// Tests whether or not the given node is a leaf
+        inline bool IsNodeLeaf( ConstNodeHandle n ) const { TRT_ASSERT( n < m_nNodesInUse ); return m_pNodes[n].IsLeaf(); };
+
+        /// Returns the number of objects in a leaf
+        inline obj_id GetNodeObjectCount( ConstNodeHandle n ) const { TRT_ASSERT( n < m_nNodesInUse ); return m_pNodes[n].GetObjectCount(); };
+
+        /// Returns the range of objects in a leaf.  'rLast' is one past the last object
+        inline void GetNodeObjectRange( ConstNodeHandle n, obj_id& rFirst, obj_id& rLast ) const {
+            TRT_ASSERT( n < m_nNodesInUse && m_pNodes[n].IsLeaf() );
+            rFirst = m_pNodes[n].GetFirstObject();
+            rLast = rFirst + m_pNodes[n].GetObjectCount();
+        };
+
+        /// Returns the clip plane axis of an inner node
+        inline uint32 GetNodeSplitAxis( ConstNodeHandle n ) const { TRT_ASSERT( n < m_nNodesInUse && !m_pNodes[n].IsLeaf() ); return m_pNodes[n].GetSplitAxis(); };
+
+        /// Returns the clip planes of an inner node.  The left child lies below 'rfLeftClip', and the right child above 'rfRightClip'
+        inline void GetNodeClipPlanes( ConstNodeHandle n, float& rfLeftClip, float& rfRightClip ) const {
+            TRT_ASSERT( n < m_nNodesInUse && !m_pNodes[n].IsLeaf() );
+            rfLeftClip = m_pNodes[n].GetLeftClip();
+            rfRightClip = m_pNodes[n].GetRightClip();
+        };
+
+        /// Returns the root bounding box of the tree
+        inline const AxisAlignedBox& GetBoundingBox() const { return m_aabb; };
+
+        /// Returns the maximum depth of any node in the tree.  This is used to allocate stack space during traversal
+        inline uint32 GetStackDepth() const { return m_nStackDepth; };
+
+        /// Returns the number of nodes
+        inline size_t GetNodeCount() const { return m_nNodesInUse; };
+
+        /// Provides direct access to the nodes
+        inline const Node* GetNodes() const { return &m_pNodes[0]; };
+
+        /// \brief Clears existing nodes in the tree and creates a single-node tree.  Returns the root node
+        /// \param rRootBox         Bounding box of the object set
+        /// \param nExpectedNodes   Number of nodes to allocate space for.  The node array grows if more are created
+        inline NodeHandle Initialize( const AxisAlignedBox& rRootBox, uint32 nExpectedNodes );
+
+        /// Subdivides a leaf node, creating two empty leaf children for it
+        inline std::pair<NodeHandle,NodeHandle> MakeInnerNode( NodeHandle n, uint32 nAxis, float fLeftClip, float fRightClip );
+
+        /// Turns the specified node into a leaf containing a range of objects
+        inline void MakeLeafNode( NodeHandle n, obj_id nFirstObj, obj_id nObjCount ) { TRT_ASSERT( n < m_nNodesInUse ); m_pNodes[n].MakeLeafNode( nFirstObj, nObjCount ); };
+
+        /// Constructs a tree for an object set.  The objects are re-ordered
+        template< class BIHTreeBuilder_T >
+        inline void Build( ObjectSet_T* pObjects, BIHTreeBuilder_T& rBuilder ) { m_nStackDepth = rBuilder.BuildTree( pObjects, this ); };
+
+        /// Returns the memory usage of the tree
+        inline void GetMemoryUsage( size_t& rnBytesUsed, size_t& rnBytesAllocated ) const
+        {
+            rnBytesUsed = sizeof(BIHTree) + m_nNodesInUse*sizeof(Node);
+            rnBytesAllocated = sizeof(BIHTree) + m_nNodeArraySize*sizeof(Node);
+        };
+
+    private:
+
+        AxisAlignedBox m_aabb;
+        uint32 m_nStackDepth;
+
+        ScopedArray<Node> m_pNodes;
+        size_t m_nNodesInUse;
+        size_t m_nNodeArraySize;
+    };
+
+}
+
+#include "TRTBIHTree.inl"
+
+#endif // _TRT_BIHTREE_H_
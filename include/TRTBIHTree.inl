@@ -0,0 +1,82 @@
+//=====================================================================================================================
+//
+//   TRTBIHTree.inl
+//
+//   Implementation of class: TinyRT::BIHTree
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    //
+    //         Constructors/Destructors
+    //
+    //=====================================================================================================================
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class ObjectSet_T >
+    BIHTree<ObjectSet_T>::BIHTree( ) : m_nStackDepth(0), m_nNodesInUse(0), m_nNodeArraySize(0)
+    {
+    }
+
+    //=====================================================================================================================
+    //
+    //            Public Methods
+    //
+    //=====================================================================================================================
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class ObjectSet_T >
+    typename BIHTree<ObjectSet_T>::NodeHandle BIHTree<ObjectSet_T>::Initialize( const AxisAlignedBox& rRootBox, uint32 nExpectedNodes )
+    {
+        if( m_nNodeArraySize < nExpectedNodes )
+        {
+            m_pNodes.reallocate( nExpectedNodes );
+            m_nNodeArraySize = nExpectedNodes;
+        }
+
+        m_aabb = rRootBox;
+        m_nNodesInUse = 1;
+        m_pNodes[0].MakeLeafNode( 0, 0 );
+        return 0;
+    }
+
+    //=====================================================================================================================
+    /// \param n            The node to subdivide
+    /// \param nAxis        Axis of the clip planes
+    /// \param fLeftClip    Upper bound of the objects in the left child
+    /// \param fRightClip   Lower bound of the objects in the right child
+    //=====================================================================================================================
+    template< class ObjectSet_T >
+    std::pair< typename BIHTree<ObjectSet_T>::NodeHandle, typename BIHTree<ObjectSet_T>::NodeHandle >
+        BIHTree<ObjectSet_T>::MakeInnerNode( NodeHandle n, uint32 nAxis, float fLeftClip, float fRightClip )
+    {
+        TRT_ASSERT( n < m_nNodesInUse );
+
+        NodeHandle nLeft = static_cast<NodeHandle>( m_nNodesInUse );
+        m_nNodesInUse += 2;
+        if( m_nNodeArraySize < m_nNodesInUse )
+        {
+            size_t nNewSize = std::max( m_nNodeArraySize*2, m_nNodesInUse );
+            m_pNodes.resize( nNewSize, m_nNodeArraySize );
+            m_nNodeArraySize = nNewSize;
+        }
+
+        m_pNodes[n].MakeInnerNode( nLeft, nAxis, fLeftClip, fRightClip );
+        m_pNodes[nLeft].MakeLeafNode( 0, 0 );
+        m_pNodes[nLeft+1].MakeLeafNode( 0, 0 );
+        return std::pair<NodeHandle,NodeHandle>( nLeft, nLeft+1 );
+    }
+
+}
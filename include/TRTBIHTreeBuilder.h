@@ -0,0 +1,87 @@
+//=====================================================================================================================
+//
+//   TRTBIHTreeBuilder.h
+//
+//   Definition of class: TinyRT::BIHTreeBuilder
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_BIHTREEBUILDER_H_
+#define _TRT_BIHTREEBUILDER_H_
+
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Constructs bounding interval hierarchies, using spatial median splits
+    ///
+    ///  Each node has a 'candidate' box, which starts as the scene bounding box and is halved at each level, independently
+    ///   of the objects.  A node's objects are partitioned in place by comparing their box centers to the middle of the
+    ///   candidate box's longest axis, and the clip planes are set to the extents of the two halves.  If all objects fall
+    ///   on one side, a node with an empty child is created to cut off the empty space, if the gap is large enough.
+    ///   Otherwise, the candidate box is halved and the split is retried, without creating a node.  Construction
+    ///   runs in O(N log N) time, and does no sorting or cost evaluation.
+    ///
+    ///  This scheme is taken from the 2006 EGSR paper "Instant Ray Tracing: The Bounding Interval Hierarchy", by Waechter and Keller
+    ///
+    /// \param ObjectSet_T Must implement the ObjectSet_C concept
+    //=====================================================================================================================
+    template< class ObjectSet_T >
+    class BIHTreeBuilder
+    {
+    public:
+
+        typedef ObjectSet_T ObjectSet;
+        typedef typename ObjectSet_T::obj_id obj_id;
+
+        /// \param nMaxLeafObjects  Nodes with this many objects or fewer become leaves
+        /// \param nMaxDepth        Maximum depth of the tree.  Nodes at this depth become leaves
+        inline BIHTreeBuilder( uint32 nMaxLeafObjects = 2, uint32 nMaxDepth = 64 )
+            : m_nMaxLeafObjects( nMaxLeafObjects ), m_nMaxDepth( nMaxDepth ) {};
+
+        //=====================================================================================================================
+        /// \param pObjects     Object set for which the tree is constructed.  The objects are re-ordered
+        /// \param pTree        The tree to be constructed.  May NOT be NULL
+        /// \return The maximum depth of the constructed tree (0 is the depth of the root)
+        //=====================================================================================================================
+        template< class BIHTree_T >
+        uint32 BuildTree( ObjectSet_T* pObjects, BIHTree_T* pTree );
+
+        /// Adds the builder type and parameters to a hash.  Used by BuildCache to identify the build parameters
+        inline void HashParameters( ContentHash& rHash ) const { rHash.AddString( "BIHTreeBuilder" ); rHash.AddValue( m_nMaxLeafObjects ); rHash.AddValue( m_nMaxDepth ); };
+
+    private:
+
+        /// Number of times that an empty split may be retried on a smaller candidate box before giving up and making a leaf
+        enum { MAX_EMPTY_SPLITS = 32 };
+
+        /// Fraction of a node's extent which must be empty before it is cut off by a node with an empty child
+        static const float EMPTY_SPACE_RATIO;
+
+        struct Object
+        {
+            AxisAlignedBox box;
+            obj_id nID;
+        };
+
+        template< class BIHTree_T >
+        uint32 BuildTreeRecurse( Object* pObjects, obj_id nObjects, obj_id nFirstObject, const AxisAlignedBox& rCandidateBox,
+                                 const AxisAlignedBox& rNodeBox, BIHTree_T* pTree, typename BIHTree_T::NodeHandle hNode, uint32 nDepth );
+
+        uint32 m_nMaxLeafObjects;
+        uint32 m_nMaxDepth;
+    };
+
+}
+
+#include "TRTBIHTreeBuilder.inl"
+
+#endif // _TRT_BIHTREEBUILDER_H_
@@ -0,0 +1,187 @@
+//=====================================================================================================================
+//
+//   TRTBIHTreeBuilder.inl
+//
+//   Implementation of class: TinyRT::BIHTreeBuilder
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+
+namespace TinyRT
+{
+
+    template< class ObjectSet_T >
+    const float BIHTreeBuilder<ObjectSet_T>::EMPTY_SPACE_RATIO = 0.1f;
+
+    //=====================================================================================================================
+    //
+    //            Public Methods
+    //
+    //=====================================================================================================================
+
+    //=====================================================================================================================
+    /// \param pObjects     Object set for which the tree is constructed.  The objects are re-ordered
+    /// \param pTree        The tree to be constructed.  May NOT be NULL
+    /// \return The maximum depth of the constructed tree (0 is the depth of the root)
+    //=====================================================================================================================
+    template< class ObjectSet_T >
+    template< class BIHTree_T >
+    uint32 BIHTreeBuilder<ObjectSet_T>::BuildTree( ObjectSet_T* pObjects, BIHTree_T* pTree )
+    {
+        obj_id nObjects = pObjects->GetObjectCount();
+        TRT_ASSERT( nObjects > 0 );
+
+        // compute object bounding boxes, and the global bounding box
+        ScopedArray<Object> objects( new Object[nObjects] );
+
+        AxisAlignedBox globalBox;
+        pObjects->GetObjectAABB( 0, globalBox );
+        objects[0].box = globalBox;
+        objects[0].nID = 0;
+        for( obj_id i=1; i<nObjects; i++ )
+        {
+            pObjects->GetObjectAABB( i, objects[i].box );
+            objects[i].nID = i;
+            globalBox.Merge( objects[i].box );
+        }
+
+        // the tree has 2N-1 nodes, plus one for each empty space cutoff
+        typename BIHTree_T::NodeHandle hRoot = pTree->Initialize( globalBox, 2*nObjects - 1 );
+        uint32 nMaxDepth = BuildTreeRecurse( &objects[0], nObjects, 0, globalBox, globalBox, pTree, hRoot, 0 );
+
+        // the partitioning has left the objects in tree order.  Rearrange the object set to match
+        ScopedArray<obj_id> objectRemap( new obj_id[nObjects] );
+        for( obj_id i=0; i<nObjects; i++ )
+            objectRemap[i] = objects[i].nID;
+
+        pObjects->RemapObjects( &objectRemap[0] );
+        return nMaxDepth;
+    }
+
+    //=====================================================================================================================
+    //
+    //            Private Methods
+    //
+    //=====================================================================================================================
+
+    //=====================================================================================================================
+    /// \param pObjects         The objects in the node.  These are partitioned in place
+    /// \param nObjects         Number of objects in the node
+    /// \param nFirstObject     Position of the first object in the final object order
+    /// \param rCandidateBox    The node's candidate box, which is split at its midpoint
+    /// \param rNodeBox         The region of space which the node occupies (the scene box, clipped by the planes above it)
+    /// \param pTree            The tree being constructed
+    /// \param hNode            The node being constructed
+    /// \param nDepth           Depth of the node
+    /// \return The maximum depth of any leaf below this node
+    //=====================================================================================================================
+    template< class ObjectSet_T >
+    template< class BIHTree_T >
+    uint32 BIHTreeBuilder<ObjectSet_T>::BuildTreeRecurse( Object* pObjects, obj_id nObjects, obj_id nFirstObject, const AxisAlignedBox& rCandidateBox,
+                                                          const AxisAlignedBox& rNodeBox, BIHTree_T* pTree, typename BIHTree_T::NodeHandle hNode, 
+                                                          uint32 nDepth )
+    {
+        typedef typename BIHTree_T::NodeHandle NodeHandle;
+
+        if( nObjects > m_nMaxLeafObjects && nDepth < m_nMaxDepth )
+        {
+            AxisAlignedBox candidateBox = rCandidateBox;
+            for( uint32 nAttempt=0; nAttempt < MAX_EMPTY_SPLITS; nAttempt++ )
+            {
+                // split the candidate box in half along its long axis
+                uint32 nAxis = 0;
+                Vec3f vBoxSize = candidateBox.Max() - candidateBox.Min();
+                if( vBoxSize[1] > vBoxSize[0] )
+                    nAxis = 1;
+                if( vBoxSize[2] > vBoxSize[nAxis] )
+                    nAxis = 2;
+
+                float fSplit = 0.5f*( candidateBox.Min()[nAxis] + candidateBox.Max()[nAxis] );
+
+                // partition the objects by their centers, and find the extent of each side
+                float fLeftClip = -FLT_MAX;
+                float fRightClip = FLT_MAX;
+                float fObjectMin = FLT_MAX;
+                float fObjectMax = -FLT_MAX;
+                obj_id nLeft = 0;
+                obj_id nRight = nObjects;
+                while( nLeft < nRight )
+                {
+                    const AxisAlignedBox& rBox = pObjects[nLeft].box;
+                    fObjectMin = std::min( fObjectMin, rBox.Min()[nAxis] );
+                    fObjectMax = std::max( fObjectMax, rBox.Max()[nAxis] );
+                    if( 0.5f*( rBox.Min()[nAxis] + rBox.Max()[nAxis] ) < fSplit )
+                    {
+                        fLeftClip = std::max( fLeftClip, rBox.Max()[nAxis] );
+                        nLeft++;
+                    }
+                    else
+                    {
+                        fRightClip = std::min( fRightClip, rBox.Min()[nAxis] );
+                        nRight--;
+                        std::swap( pObjects[nLeft], pObjects[nRight] );
+                    }
+                }
+
+                if( nLeft == 0 || nLeft == nObjects )
+                {
+                    // Everything is on one side.  If the objects leave a large gap at either end of the node, cut it off
+                    //  by creating a node with an empty child.  Otherwise, try again with the half of the candidate box 
+                    //  that the objects are in
+                    float fEmptyThreshold = EMPTY_SPACE_RATIO * ( rNodeBox.Max()[nAxis] - rNodeBox.Min()[nAxis] );
+                    if( fObjectMin - rNodeBox.Min()[nAxis] > fEmptyThreshold )
+                    {
+                        std::pair<NodeHandle,NodeHandle> kids = pTree->MakeInnerNode( hNode, nAxis, -FLT_MAX, fObjectMin );
+                        pTree->MakeLeafNode( kids.first, nFirstObject, 0 );
+
+                        AxisAlignedBox nodeBox = rNodeBox;
+                        nodeBox.Min()[nAxis] = fObjectMin;
+                        return BuildTreeRecurse( pObjects, nObjects, nFirstObject, candidateBox, nodeBox, pTree, kids.second, nDepth+1 );
+                    }
+                    if( rNodeBox.Max()[nAxis] - fObjectMax > fEmptyThreshold )
+                    {
+                        std::pair<NodeHandle,NodeHandle> kids = pTree->MakeInnerNode( hNode, nAxis, fObjectMax, FLT_MAX );
+                        pTree->MakeLeafNode( kids.second, nFirstObject + nObjects, 0 );
+
+                        AxisAlignedBox nodeBox = rNodeBox;
+                        nodeBox.Max()[nAxis] = fObjectMax;
+                        return BuildTreeRecurse( pObjects, nObjects, nFirstObject, candidateBox, nodeBox, pTree, kids.first, nDepth+1 );
+                    }
+
+                    if( nLeft == 0 )
+                        candidateBox.Min()[nAxis] = fSplit;
+                    else
+                        candidateBox.Max()[nAxis] = fSplit;
+                    continue;
+                }
+
+                std::pair<NodeHandle,NodeHandle> kids = pTree->MakeInnerNode( hNode, nAxis, fLeftClip, fRightClip );
+
+                AxisAlignedBox leftBox = candidateBox;
+                AxisAlignedBox rightBox = candidateBox;
+                leftBox.Max()[nAxis] = fSplit;
+                rightBox.Min()[nAxis] = fSplit;
+
+                AxisAlignedBox leftNodeBox = rNodeBox;
+                AxisAlignedBox rightNodeBox = rNodeBox;
+                leftNodeBox.Max()[nAxis] = std::min( leftNodeBox.Max()[nAxis], fLeftClip );
+                rightNodeBox.Min()[nAxis] = std::max( rightNodeBox.Min()[nAxis], fRightClip );
+
+                uint32 nLeftDepth = BuildTreeRecurse( pObjects, nLeft, nFirstObject, leftBox, leftNodeBox, pTree, kids.first, nDepth+1 );
+                uint32 nRightDepth = BuildTreeRecurse( pObjects + nLeft, nObjects - nLeft, nFirstObject + nLeft, rightBox, rightNodeBox, 
+                                                       pTree, kids.second, nDepth+1 );
+                return std::max( nLeftDepth, nRightDepth );
+            }
+        }
+
+        pTree->MakeLeafNode( hNode, nFirstObject, nObjects );
+        return nDepth;
+    }
+
+}
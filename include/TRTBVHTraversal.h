@@ -16,35 +16,49 @@
 #define _TRT_BVHTRAVERSAL_H_
 
 #include "TRTScratchMemory.h"
+#include "TRTTraversalStack.h"
+#include "TRTTraversalStats.h"
+#include "TRTPrefetch.h"
 
 namespace TinyRT
 {
 
     //=====================================================================================================================
     /// \ingroup TinyRT
-    /// Searches for the first intersection between a ray and an object in a BVH.  
+    /// \brief BVH traversal kernel for rays in a particular octant.  
+    ///
+    /// The octant determines the box slabs and child ordering at compile time, so the kernel does not branch on the ray direction.
+    ///  The ray must actually lie in the given octant.  RaycastBVHWithStack selects the kernel for each ray.
+    ///
+    /// \param pStack       Traversal stack.  Must have room for pBVH->GetStackDepth() entries
+    /// \param rStats       Receives traversal statistics
+    /// \param OCTANT       The ray's octant, as returned by GetRayOctant
+    /// \param Prefetch_T   Must implement the Prefetch_C concept.  Applied to each node which is pushed onto the stack
     /// \param BVH_T        Must implement the BVH_C concept
     /// \param ObjectSet_T  Must implement the ObjectSet_C concept
     /// \param HitInfo_T    Must implement the HitInfo_C concept
     /// \param Ray_T        Must implement the Ray_C concept
+    /// \param Stats_T      Must implement the TraversalStats_C concept
     //=====================================================================================================================
-    template< typename BVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
-    void RaycastBVH( const BVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, typename BVH_T::ConstNodeHandle pRoot, ScratchMemory& rScratch )
+    template< int OCTANT, typename Prefetch_T, typename BVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    void RaycastBVHOctant( const BVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                           typename BVH_T::ConstNodeHandle pRoot, typename BVH_T::ConstNodeHandle* pStack, Stats_T& rStats )
     {
         typedef typename BVH_T::obj_id obj_id;
         typedef typename BVH_T::ConstNodeHandle NodeHandle;
-        ScratchArray< NodeHandle > stack( rScratch, pBVH->GetStackDepth() );
-        NodeHandle* pStack = stack;
         
         NodeHandle* pStackBottom = pStack++;
         *pStackBottom = pRoot;
+
+        rStats.CountRay();
         
         while( pStack != pStackBottom )
         {
             pStack--;
             NodeHandle pNode = *pStack;
 
-            while( pBVH->RayNodeTest( pNode, rRay ) )
+            rStats.CountBoxTests( 1 );
+            while( pBVH->template RayNodeTestOctant<OCTANT>( pNode, rRay ) )
             {
                 if( pBVH->IsNodeLeaf( pNode ) )
                 {
@@ -53,6 +67,9 @@ namespace TinyRT
                     obj_id rLastObj;
                     pBVH->GetNodeObjectRange( pNode, rFirstObj, rLastObj );
 
+                    rStats.CountLeaf();
+                    rStats.CountPrimitiveTests( static_cast<uint32>( rLastObj - rFirstObj ) );
+
                     while( rFirstObj != rLastObj )
                     {
                         pObjects->RayIntersect( rRay, rHitInfo, rFirstObj );
@@ -64,22 +81,22 @@ namespace TinyRT
                 else
                 {
                     // inner node: Visit node's children
+                    rStats.CountInnerNode();
                     NodeHandle pLeft  = pBVH->GetLeftChild( pNode );
                     NodeHandle pRight = pBVH->GetRightChild( pNode );
 
+                    // visit the child on the near side of the split first
                     uint32 nAxis = pBVH->GetNodeSplitAxis( pNode );
-                    if( rRay.Direction()[nAxis] < 0 )
-                    {
-                        *pStack = pLeft;
-                        pNode = pRight;
-                    }
-                    else
-                    {
-                        *pStack = pRight;
-                        pNode = pLeft;
-                    }
+                    bool bNegative = ( ( OCTANT >> nAxis ) & 1 ) != 0;
+                    *pStack = bNegative ? pLeft : pRight;
+                    pNode   = bNegative ? pRight : pLeft;
+
+                    // start fetching whatever the far child will need, so that it is in cache by the time it is popped
+                    Prefetch_T::PrefetchBVHNode( pBVH, pObjects, *pStack );
                     pStack++;
-                    
+
+                    rStats.CountStackDepth( pStack - pStackBottom );
+                    rStats.CountBoxTests( 1 );
                 }
             }
         }
@@ -176,6 +193,149 @@ namespace TinyRT
         } // end of infinite traversal loop
         */
     }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a BVH, using a caller-supplied stack and a prefetch policy.
+    ///  The ray is traversed by the kernel which is specialized for its octant
+    /// \param pStack       Traversal stack.  Must have room for pBVH->GetStackDepth() entries
+    /// \param rStats       Receives traversal statistics
+    /// \param Prefetch_T   Must implement the Prefetch_C concept
+    /// \param BVH_T        Must implement the BVH_C concept
+    /// \param ObjectSet_T  Must implement the ObjectSet_C concept
+    /// \param HitInfo_T    Must implement the HitInfo_C concept
+    /// \param Ray_T        Must implement the Ray_C concept
+    /// \param Stats_T      Must implement the TraversalStats_C concept
+    //=====================================================================================================================
+    template< typename Prefetch_T, typename BVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    void RaycastBVHPrefetchedWithStack( const BVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                                        typename BVH_T::ConstNodeHandle pRoot, typename BVH_T::ConstNodeHandle* pStack, Stats_T& rStats )
+    {
+        switch( GetRayOctant( rRay ) )
+        {
+        case 0: RaycastBVHOctant<0,Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 1: RaycastBVHOctant<1,Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 2: RaycastBVHOctant<2,Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 3: RaycastBVHOctant<3,Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 4: RaycastBVHOctant<4,Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 5: RaycastBVHOctant<5,Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 6: RaycastBVHOctant<6,Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 7: RaycastBVHOctant<7,Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        };
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a BVH, using a caller-supplied stack.
+    ///  The ray is traversed by the kernel which is specialized for its octant
+    /// \param pStack       Traversal stack.  Must have room for pBVH->GetStackDepth() entries
+    /// \param rStats       Receives traversal statistics
+    /// \param BVH_T        Must implement the BVH_C concept
+    /// \param ObjectSet_T  Must implement the ObjectSet_C concept
+    /// \param HitInfo_T    Must implement the HitInfo_C concept
+    /// \param Ray_T        Must implement the Ray_C concept
+    /// \param Stats_T      Must implement the TraversalStats_C concept
+    //=====================================================================================================================
+    template< typename BVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    inline void RaycastBVHWithStack( const BVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                                     typename BVH_T::ConstNodeHandle pRoot, typename BVH_T::ConstNodeHandle* pStack, Stats_T& rStats )
+    {
+        RaycastBVHPrefetchedWithStack<NullPrefetch>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a BVH, using a caller-supplied stack.
+    /// \param pStack       Traversal stack.  Must have room for pBVH->GetStackDepth() entries
+    /// \param BVH_T        Must implement the BVH_C concept
+    /// \param ObjectSet_T  Must implement the ObjectSet_C concept
+    /// \param HitInfo_T    Must implement the HitInfo_C concept
+    /// \param Ray_T        Must implement the Ray_C concept
+    //=====================================================================================================================
+    template< typename BVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastBVHWithStack( const BVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                                     typename BVH_T::ConstNodeHandle pRoot, typename BVH_T::ConstNodeHandle* pStack )
+    {
+        NullTraversalStats stats;
+        RaycastBVHWithStack( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, stats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a BVH.  
+    ///  The traversal stack is kept on the call stack, and scratch memory is only used if the tree is deeper than TRT_INLINE_STACK_DEPTH
+    /// \param BVH_T        Must implement the BVH_C concept
+    /// \param ObjectSet_T  Must implement the ObjectSet_C concept
+    /// \param HitInfo_T    Must implement the HitInfo_C concept
+    /// \param Ray_T        Must implement the Ray_C concept
+    //=====================================================================================================================
+    template< typename BVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastBVH( const BVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, typename BVH_T::ConstNodeHandle pRoot, ScratchMemory& rScratch )
+    {
+        TraversalStack< typename BVH_T::ConstNodeHandle, TRT_INLINE_STACK_DEPTH > stack( rScratch, pBVH->GetStackDepth() );
+        RaycastBVHWithStack( pBVH, pObjects, rRay, rHitInfo, pRoot, stack );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a BVH, and records traversal statistics
+    /// \param Stats_T      Must implement the TraversalStats_C concept
+    //=====================================================================================================================
+    template< typename BVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    inline void RaycastBVH( const BVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, typename BVH_T::ConstNodeHandle pRoot, 
+                            ScratchMemory& rScratch, Stats_T& rStats )
+    {
+        TraversalStack< typename BVH_T::ConstNodeHandle, TRT_INLINE_STACK_DEPTH > stack( rScratch, pBVH->GetStackDepth() );
+        RaycastBVHWithStack( pBVH, pObjects, rRay, rHitInfo, pRoot, stack, rStats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a BVH, using the calling thread's scratch memory
+    ///  if the tree is too deep for an inline stack
+    /// \sa ThreadScratchMemory
+    //=====================================================================================================================
+    template< typename BVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastBVH( const BVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, typename BVH_T::ConstNodeHandle pRoot )
+    {
+        TraversalStack< typename BVH_T::ConstNodeHandle, TRT_INLINE_STACK_DEPTH > stack( pBVH->GetStackDepth() );
+        RaycastBVHWithStack( pBVH, pObjects, rRay, rHitInfo, pRoot, stack );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Searches for the first intersection between a ray and an object in a BVH, prefetching nodes as they are pushed
+    ///
+    ///  This is intended for trees which are much larger than the cache.  For smaller trees, the prefetches only add overhead,
+    ///   and RaycastBVH should be used instead.  ShouldPrefetch may be used to choose between them.
+    ///
+    /// \param Prefetch_T   Must implement the Prefetch_C concept (for example: NodePrefetch or NodeAndObjectPrefetch)
+    /// \param BVH_T        Must implement the BVH_C concept
+    /// \param ObjectSet_T  Must implement the ObjectSet_C concept
+    /// \param HitInfo_T    Must implement the HitInfo_C concept
+    /// \param Ray_T        Must implement the Ray_C concept
+    //=====================================================================================================================
+    template< typename Prefetch_T, typename BVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastBVHPrefetched( const BVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, typename BVH_T::ConstNodeHandle pRoot, ScratchMemory& rScratch )
+    {
+        NullTraversalStats stats;
+        TraversalStack< typename BVH_T::ConstNodeHandle, TRT_INLINE_STACK_DEPTH > stack( rScratch, pBVH->GetStackDepth() );
+        RaycastBVHPrefetchedWithStack<Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, stack, stats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a BVH, prefetching nodes as they are pushed, and records traversal statistics
+    /// \param Prefetch_T   Must implement the Prefetch_C concept
+    /// \param Stats_T      Must implement the TraversalStats_C concept
+    //=====================================================================================================================
+    template< typename Prefetch_T, typename BVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    inline void RaycastBVHPrefetched( const BVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, typename BVH_T::ConstNodeHandle pRoot, 
+                                      ScratchMemory& rScratch, Stats_T& rStats )
+    {
+        TraversalStack< typename BVH_T::ConstNodeHandle, TRT_INLINE_STACK_DEPTH > stack( rScratch, pBVH->GetStackDepth() );
+        RaycastBVHPrefetchedWithStack<Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, stack, rStats );
+    }
 }
 
 #endif // _TRT_BVHTRAVERSAL_H_
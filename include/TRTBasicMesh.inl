@@ -78,6 +78,17 @@ namespace TinyRT
         TinyRT::RemapArray( reinterpret_cast<Indices*>( m_pIndices ), m_nTriangles, pObjectRemap );
     }
 
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class Vec3_T, class uint_t >
+    inline void BasicMesh< Vec3_T,uint_t >::HashContents( ContentHash& rHash ) const
+    {
+        rHash.AddValue( m_nVertices );
+        rHash.AddValue( m_nTriangles );
+        rHash.Add( m_pVertices, m_nVertices*sizeof(Position_T) );
+        rHash.Add( m_pIndices, 3*m_nTriangles*sizeof(Index_T) );
+    }
+
     //=====================================================================================================================
     //=====================================================================================================================
     template< class Vec3_T, class uint_t >
@@ -170,6 +181,15 @@ namespace TinyRT
         return bHit;        
     }
 
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class Vec3_T, class uint_t >
+    template< typename Ray_T >
+    bool BasicMesh< Vec3_T,uint_t >::RayIntersectList( Ray_T& rRay, TriangleRayHit& rRayHit, const uint32* pObjects, uint32 nObjects ) const
+    {
+        return RayTriangleListTest( *this, rRay, rRayHit, pObjects, nObjects );
+    }
+
     //=====================================================================================================================
     //
     //           Protected Methods
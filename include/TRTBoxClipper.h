@@ -61,6 +61,9 @@ namespace TinyRT
             TRT_ASSERT( rOldBB.Min()[nAxis] < fPosition && rOldBB.Max()[nAxis] > fPosition );
             rOldBB.Cut( nAxis, fPosition, rLeftSideOut, rRightSideOut );
         }
+
+        /// Adds the clipper type to a hash.  Used by BuildCache to identify the build parameters
+        static inline void HashParameters( ContentHash& rHash ) { rHash.AddString( "BoxClipper" ); };
     };
     
 }
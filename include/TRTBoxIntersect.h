@@ -192,6 +192,79 @@ namespace TinyRT
         return true;
     }
 
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Returns the octant of a ray's direction, for use with the octant-specialized box tests and traversal kernels
+    ///
+    /// Bit 0, 1, or 2 of the result is set if the X, Y, or Z component of the ray's reciprocal direction is negative.
+    ///  This is the same test used by RayAABBTest to select the entry and exit slabs
+    //=====================================================================================================================
+    template< class Ray_T >
+    TRT_FORCEINLINE int GetRayOctant( const Ray_T& rRay )
+    {
+        const Vec3f& rInvDir = rRay.InvDirection();
+        return ( rInvDir.x < 0 ? 1 : 0 ) | ( rInvDir.y < 0 ? 2 : 0 ) | ( rInvDir.z < 0 ? 4 : 0 );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Computes the entry and exit distances of a ray through an AABB's slabs, for a ray in a known octant
+    ///
+    /// The octant selects the entry and exit slabs on each axis at compile time, so unlike RayAABBTest, this contains
+    ///  no branches on the ray direction.  The results are identical to those of RayAABBTest for rays in the given octant
+    /// \param OCTANT   The ray's octant, as returned by GetRayOctant
+    //=====================================================================================================================
+    template< int OCTANT, class Ray_T >
+    TRT_FORCEINLINE void RayAABBSlabsOctant( const Vec3f& rBBMin, const Vec3f& rBBMax, const Ray_T& rRay, float& rTMin, float& rTMax )
+    {
+        const Vec3f& rOrigin = rRay.Origin();
+        const Vec3f& rInvDir = rRay.InvDirection();
+
+        float fTMin = ( ( ( OCTANT & 1 ) ? rBBMax.x : rBBMin.x ) - rOrigin.x ) * rInvDir.x;
+        float fTMax = ( ( ( OCTANT & 1 ) ? rBBMin.x : rBBMax.x ) - rOrigin.x ) * rInvDir.x;
+        fTMin = std::max( fTMin, ( ( ( OCTANT & 2 ) ? rBBMax.y : rBBMin.y ) - rOrigin.y ) * rInvDir.y );
+        fTMax = std::min( fTMax, ( ( ( OCTANT & 2 ) ? rBBMin.y : rBBMax.y ) - rOrigin.y ) * rInvDir.y );
+        fTMin = std::max( fTMin, ( ( ( OCTANT & 4 ) ? rBBMax.z : rBBMin.z ) - rOrigin.z ) * rInvDir.z );
+        fTMax = std::min( fTMax, ( ( ( OCTANT & 4 ) ? rBBMin.z : rBBMax.z ) - rOrigin.z ) * rInvDir.z );
+
+        rTMin = fTMin;
+        rTMax = fTMax;
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Ray-box intersection test for a ray in a known octant, which returns entry and exit distances
+    /// \sa RayAABBTest
+    /// \param OCTANT   The ray's octant, as returned by GetRayOctant
+    //=====================================================================================================================
+    template< int OCTANT, class Ray_T >
+    TRT_FORCEINLINE bool RayAABBTestOctant( const Vec3f& rBBMin, const Vec3f& rBBMax, const Ray_T& rRay, float& rTMinOut, float& rTMaxOut )
+    {
+        float fTMin, fTMax;
+        RayAABBSlabsOctant<OCTANT>( rBBMin, rBBMax, rRay, fTMin, fTMax );
+
+        if( fTMax < fTMin || !rRay.IsIntervalValid( fTMin, fTMax ) )
+            return false;
+
+        rTMinOut = fTMin;
+        rTMaxOut = fTMax;
+        return true;
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Ray-box intersection test for a ray in a known octant, which returns NO hit distance
+    /// \sa RayAABBTest
+    /// \param OCTANT   The ray's octant, as returned by GetRayOctant
+    //=====================================================================================================================
+    template< int OCTANT, class Ray_T >
+    TRT_FORCEINLINE bool RayAABBTestOctant( const Vec3f& rBBMin, const Vec3f& rBBMax, const Ray_T& rRay )
+    {
+        float fTMin, fTMax;
+        RayAABBSlabsOctant<OCTANT>( rBBMin, rBBMax, rRay, fTMin, fTMax );
+        return !( fTMax < fTMin ) && rRay.IsIntervalValid( fTMin, fTMax );
+    }
+
 
     //=====================================================================================================================
     /// \ingroup TinyRT
@@ -284,6 +357,46 @@ namespace TinyRT
         return ( SimdVecf::Mask( (vTMin <= vTMax) & rRay.AreIntervalsValid( vTMin, vTMax ) ) );
     }
 
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    ///
+    /// \brief Performs an intersection test between a ray in a known octant and a vectorized set of AABBs.  
+    ///
+    /// This is equivalent to the version of RayQuadAABBTest which takes direction signs, but the slabs are selected
+    ///  at compile time, so no address arithmetic is needed to load them
+    ///  
+    /// \param vAABB        Array containing sets of four AABB slabs.  The order is:  XMin,XMax, YMin,YMax, ZMin,ZMax
+    /// \param vSIMDRay     Array containing pre-swizzled ray information.  See RayQuadAABBTest
+    /// \param rRay         The ray to be tested
+    /// \param OCTANT       The ray's octant, as returned by GetRayOctant
+    /// \return A four-bit mask indicating which AABBs were hit by the ray
+    //=====================================================================================================================
+    template< int OCTANT, class Ray_T >
+    TRT_FORCEINLINE int RayQuadAABBTestOctant( const SimdVec4f vAABB[6], const SimdVec4f vSIMDRay[6], const Ray_T& rRay )
+    {
+        const int X = ( OCTANT & 1 ) ? 1 : 0;
+        const int Y = ( OCTANT & 2 ) ? 1 : 0;
+        const int Z = ( OCTANT & 4 ) ? 1 : 0;
+
+        // intersect with X aligned slabs 
+        SimdVec4f vTMin  = (vAABB[X]   - vSIMDRay[1] ) * vSIMDRay[0];
+        SimdVec4f vTMax  = (vAABB[1-X] - vSIMDRay[1] ) * vSIMDRay[0];
+
+        // Y aligned slabs
+        SimdVec4f vTYIn  = (vAABB[2+Y] - vSIMDRay[3] ) * vSIMDRay[2];
+        SimdVec4f vTYOut = (vAABB[3-Y] - vSIMDRay[3] ) * vSIMDRay[2];
+        vTMin = SimdVec4f::Max( vTYIn, vTMin ); // we want to grab the largest min and smallest max
+        vTMax = SimdVec4f::Min( vTYOut, vTMax );
+
+        // Z aligned slabs
+        SimdVec4f vTZIn  = (vAABB[4+Z] - vSIMDRay[5] ) * vSIMDRay[4];
+        SimdVec4f vTZOut = (vAABB[5-Z] - vSIMDRay[5] ) * vSIMDRay[4];
+        vTMin = SimdVec4f::Max( vTZIn, vTMin );
+        vTMax = SimdVec4f::Min( vTZOut, vTMax );
+
+        return ( SimdVecf::Mask( (vTMin <= vTMax) & rRay.AreIntervalsValid( vTMin, vTMax ) ) );
+    }
+
 }
 
 #endif // _TRT_BOXINTERSECT_H_
@@ -0,0 +1,220 @@
+//=====================================================================================================================
+//
+//   TRTBuildCache.h
+//
+//   Definition of class: TinyRT::BuildCache
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_BUILDCACHE_H_
+#define _TRT_BUILDCACHE_H_
+
+// This header is not included by TinyRT.h, because it pulls in platform headers.  Include it after TinyRT.h
+
+#include <string>
+#include <stdio.h>
+
+#include "TRTMappedFile.h"
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A directory of pre-built acceleration structures, keyed by the contents of the object set
+    ///
+    ///  Each request hashes the object set, the builder parameters, and the structure type.  If a file for that hash
+    ///   exists in the cache directory, the tree is attached to a memory mapped view of the file, and the object set is
+    ///   re-ordered to match the order that it was built with.  Otherwise, the tree is built and written to the cache.
+    ///
+    ///  The object set must provide a method 'void HashContents( ContentHash& ) const' (BasicMesh and StridedMesh do),
+    ///   and the builder a method 'void HashParameters( ContentHash& ) const'.  The object set must be in its original
+    ///   order (as it was before any tree was built over it), since this is the order which is hashed.
+    ///
+    ///  Trees loaded from the cache use the cache's mapped files, so the cache must not be destroyed until the trees are.
+    ///   Concurrent processes may share a cache directory.  Files are written under a temporary name which is unique to
+    ///   the writing process and call, and then renamed.  If two processes build the same tree, one rename wins, and the
+    ///   other is discarded.
+    ///
+    ///  A tree which is too large for its handle type is left empty by its 'Build' method (see CompactTreeHandles), and 
+    ///   is not written to the cache.
+    //=====================================================================================================================
+    class BuildCache
+    {
+    public:
+
+        /// \param pDirectory  Directory in which to store the trees.  The directory must already exist
+        inline BuildCache( const char* pDirectory ) : m_directory( pDirectory ), m_nHits( 0 ), m_nMisses( 0 ) {};
+
+        inline ~BuildCache( )
+        {
+            for( size_t i=0; i<m_files.size(); i++ )
+                delete m_files[i];
+        };
+
+        /// \brief Loads or builds an AABB tree.  Returns true if the tree was loaded from the cache
+        /// The builder must be instantiated for RemapRecorder<ObjectSet_T>, so that the object ordering can be recorded
+        template< class ObjectSet_T, class AABBTreeBuilder_T >
+        inline bool GetAABBTree( ObjectSet_T* pObjects, AABBTree<ObjectSet_T>* pTree, AABBTreeBuilder_T& rBuilder )
+        {
+            return GetObjectOrderTree( SERIALIZED_AABBTREE, pObjects, pTree, rBuilder );
+        };
+
+        /// \brief Loads or builds a QuadAABBTree.  Returns true if the tree was loaded from the cache
+        /// The builder must be instantiated for RemapRecorder<ObjectSet_T>, so that the object ordering can be recorded
+        template< class ObjectSet_T, class HandleTraits_T, class QAABBBuilder_T >
+        inline bool GetQuadAABBTree( ObjectSet_T* pObjects, QuadAABBTree<ObjectSet_T,HandleTraits_T>* pTree, QAABBBuilder_T& rBuilder )
+        {
+            return GetObjectOrderTree( SERIALIZED_QUADAABBTREE, pObjects, pTree, rBuilder );
+        };
+
+        /// Loads or builds a KD tree.  Returns true if the tree was loaded from the cache
+        template< class ObjectSet_T, class HandleTraits_T, class KDTreeBuilder_T >
+        inline bool GetKDTree( ObjectSet_T* pObjects, KDTree<ObjectSet_T,HandleTraits_T>* pTree, KDTreeBuilder_T& rBuilder )
+        {
+            typedef typename ObjectSet_T::obj_id obj_id;
+
+            std::string fileName = GetFileName( SERIALIZED_KDTREE, pObjects, pTree, rBuilder );
+            if( AttachTree( fileName, pTree ) )
+            {
+                m_nHits++;
+                return true;
+            }
+
+            // KD tree construction does not re-order the objects, so no remap is needed
+            m_nMisses++;
+            if( pTree->Build( pObjects, rBuilder ) )
+                StoreTree( fileName, pTree, static_cast<const obj_id*>( NULL ), obj_id( 0 ) );
+            return false;
+        };
+
+        /// Returns the number of trees which were loaded from the cache
+        inline uint32 GetHitCount() const { return m_nHits; };
+
+        /// Returns the number of trees which had to be built
+        inline uint32 GetMissCount() const { return m_nMisses; };
+
+    private:
+
+        /// \brief Computes the name of the cache file for a particular structure, object set, and builder
+        /// The tree's handle size is included, so that trees with different handle traits do not overwrite each other's files
+        template< class ObjectSet_T, class Tree_T, class Builder_T >
+        inline std::string GetFileName( uint32 nStructureType, const ObjectSet_T* pObjects, const Tree_T*, const Builder_T& rBuilder ) const
+        {
+            ContentHash hash;
+            hash.AddValue( nStructureType );
+            hash.AddValue( static_cast<uint32>( TRT_SERIALIZED_VERSION ) );
+            hash.AddValue( static_cast<uint32>( sizeof(typename ObjectSet_T::obj_id) ) );
+            hash.AddValue( static_cast<uint32>( sizeof(typename Tree_T::NodeHandle) ) );
+            pObjects->HashContents( hash );
+            rBuilder.HashParameters( hash );
+
+            uint64 nHash = hash.GetValue();
+            char name[32];
+            sprintf( name, "%08x%08x.trt", static_cast<uint32>( nHash >> 32 ), static_cast<uint32>( nHash ) );
+            return m_directory + "/" + name;
+        };
+
+        /// Loads or builds a tree whose construction re-orders the object set
+        template< class ObjectSet_T, class Tree_T, class Builder_T >
+        inline bool GetObjectOrderTree( uint32 nStructureType, ObjectSet_T* pObjects, Tree_T* pTree, Builder_T& rBuilder )
+        {
+            typedef typename ObjectSet_T::obj_id obj_id;
+
+            std::string fileName = GetFileName( nStructureType, pObjects, pTree, rBuilder );
+
+            MappedFile* pFile = new MappedFile();
+            if( pFile->Open( fileName.c_str() ) )
+            {
+                size_t nObjects;
+                const obj_id* pRemap = GetSerializedObjectRemap<obj_id>( pFile->GetData(), pFile->GetSize(), nObjects );
+
+                // make sure the tree is usable before re-ordering the objects
+                if( pRemap && nObjects == pObjects->GetObjectCount() && pTree->Attach( pFile->GetData(), pFile->GetSize() ) )
+                {
+                    std::vector<obj_id> remap( pRemap, pRemap + nObjects );
+                    pObjects->RemapObjects( &remap[0] );
+                    m_files.push_back( pFile );
+                    m_nHits++;
+                    return true;
+                }
+            }
+            delete pFile;
+
+            m_nMisses++;
+            RemapRecorder<ObjectSet_T> recorder( pObjects );
+            if( BuildTree( pTree, &recorder, rBuilder ) )
+                StoreTree( fileName, pTree, recorder.GetRemap(), recorder.GetObjectCount() );
+            return false;
+        };
+
+        /// Builds an AABB tree.  Always returns true, since AABBTree's builds do not fail
+        template< class ObjectSet_T, class Builder_T >
+        static inline bool BuildTree( AABBTree<ObjectSet_T>* pTree, RemapRecorder<ObjectSet_T>* pObjects, Builder_T& rBuilder )
+        {
+            pTree->Build( pObjects, rBuilder );
+            return true;
+        };
+
+        /// Builds a QuadAABBTree.  Returns false if the tree is too large for its handle type
+        template< class ObjectSet_T, class HandleTraits_T, class Builder_T >
+        static inline bool BuildTree( QuadAABBTree<ObjectSet_T,HandleTraits_T>* pTree, RemapRecorder<ObjectSet_T>* pObjects, Builder_T& rBuilder )
+        {
+            return pTree->Build( pObjects, rBuilder );
+        };
+
+        /// Maps a cache file and attaches a tree to it.  Returns false if the file is missing or invalid
+        template< class Tree_T >
+        inline bool AttachTree( const std::string& rFileName, Tree_T* pTree )
+        {
+            MappedFile* pFile = new MappedFile();
+            if( !pFile->Open( rFileName.c_str() ) || !pTree->Attach( pFile->GetData(), pFile->GetSize() ) )
+            {
+                delete pFile;
+                return false;
+            }
+
+            m_files.push_back( pFile );
+            return true;
+        };
+
+        /// Writes a newly built tree to the cache.  Failures are ignored, since the tree is still usable
+        template< class Tree_T, class obj_id >
+        inline void StoreTree( const std::string& rFileName, const Tree_T* pTree, const obj_id* pRemap, obj_id nObjects )
+        {
+            // write under a temporary name, so that other processes never map a partially written file.
+            //  If the rename fails because another process has already stored the same tree, that tree is used instead
+            std::string tempName = MakeTempFileName( rFileName );
+            if( !pTree->Save( tempName.c_str(), pRemap, nObjects ) || rename( tempName.c_str(), rFileName.c_str() ) != 0 )
+                remove( tempName.c_str() );
+        };
+
+        /// Returns a temporary name for a cache file, which includes the process ID and a per-process counter
+        static inline std::string MakeTempFileName( const std::string& rFileName )
+        {
+            static volatile int32 s_nTempFiles = 0;
+        #ifdef _WIN32
+            unsigned long nProcess = static_cast<unsigned long>( GetCurrentProcessId() );
+        #else
+            unsigned long nProcess = static_cast<unsigned long>( getpid() );
+        #endif
+            char suffix[48];
+            sprintf( suffix, ".%lu.%d.tmp", nProcess, AtomicAdd( &s_nTempFiles, 1 ) );
+            return rFileName + suffix;
+        };
+
+        std::string m_directory;
+        std::vector<MappedFile*> m_files;    ///< Files which loaded trees are attached to
+        uint32 m_nHits;
+        uint32 m_nMisses;
+    };
+
+}
+
+#endif // _TRT_BUILDCACHE_H_
@@ -90,6 +90,12 @@ namespace TinyRT
 
         /// Vectorized version of 'AreDistancesValid'
         virtual SimdVec4f AreDistancesValid( const SimdVec4f& rT ) const  = 0;
+
+        /// Moves the ray origin.  Used to transform rays into an object's local space
+        virtual void SetOrigin( const Vec3f& rOrigin ) = 0;
+
+        /// Changes the ray direction, and recomputes the reciprocal direction
+        virtual void SetDirection( const Vec3f& rDirection ) = 0;
         
     };
 
@@ -154,6 +160,12 @@ namespace TinyRT
         /// Returns the number of objects in the set
         virtual obj_id GetObjectCount() const;
 
+        /// \brief Prefetches the data for a range of objects.  Only required by the NodeAndObjectPrefetch policy
+        virtual void PrefetchObjects( obj_id nFirst, obj_id nLast ) const;
+
+        /// \brief Performs an intersection test between a list of objects and a ray, returning true if a hit was found.  
+        /// Only required by SimdLeafIntersector
+        virtual bool RayIntersectList( Ray_C& rRay, HitInfo_C& rHitInfo, const obj_id* pObjects, obj_id nCount ) const;
 
     };
 
@@ -183,6 +195,9 @@ namespace TinyRT
                                                  uint nAxis,
                                                  AxisAlignedBox& rLeftSideOut, 
                                                  AxisAlignedBox& rRightSideOut ) {};
+
+        /// Adds the clipper type to a hash.  Used by BuildCache to tell apart trees built with different clippers
+        static void HashParameters( ContentHash& rHash ) {};
     };
 
 
@@ -284,6 +299,17 @@ namespace TinyRT
         /// \return True if the ray strikes the node's bounding volume
         virtual bool RayNodeTest( ConstNodeHandle p, const Ray_C& rRay ) const = 0;
 
+        /// \brief Tests whether a ray strikes a bounding volume, for a ray in a known octant
+        /// The result must be the same as that of RayNodeTest.  The octant is known at compile time, so that sign-dependent
+        ///  branches in the test can be eliminated.
+        /// \param OCTANT   The ray's octant, as returned by GetRayOctant
+        template< int OCTANT >
+        bool RayNodeTestOctant( ConstNodeHandle p, const Ray_C& rRay ) const { return false; };
+
+        /// \brief Prefetches the children of an inner node.  Only required by the NodePrefetch and NodeAndObjectPrefetch policies
+        /// \param p    Handle to an inner node
+        virtual void PrefetchChildren( ConstNodeHandle p ) const = 0;
+
         /// Retrieves the range of objects in a leaf node
         /// \param p        Node whose objects are desired
         /// \param rFirst   Receives the first object ID in the object range
@@ -365,6 +391,10 @@ namespace TinyRT
 
         /// Retrieves a list of objects stored in a particular cell
         virtual void GetCellObjectList( const Vec3<UnsignedCellIndex>& rCell, CellIterator& hCellStart, CellIterator& hCellEnd ) const =0; 
+
+        /// Returns the edge length (in cells) of the largest empty, aligned block of cells containing a particular cell, or 0 if the cell is occupied.
+        ///  The block size must be a power of two.  Implementations which do not track empty space may simply return 1 for empty cells
+        virtual uint32 GetEmptyBlockSize( const Vec3<UnsignedCellIndex>& rCell ) const = 0;
         
     };
 
@@ -388,6 +418,57 @@ namespace TinyRT
     };
 
 
+    /// \ingroup TRTConcepts
+    /// \brief Interface for a traversal statistics policy
+    ///
+    /// The raycasting functions call these methods as they traverse a data structure.  
+    /// An implementation which does nothing (TinyRT::NullTraversalStats) adds no cost to the traversal
+    /// \sa TRTConcepts
+    /// \sa TraversalStats
+    struct TraversalStats_C
+    {
+        /// Called once for each ray that is traced
+        void CountRay();
+
+        /// Called for each inner node that the ray visits
+        void CountInnerNode();
+
+        /// Called for each leaf node (or non-empty grid cell) that the ray visits
+        void CountLeaf();
+
+        /// Called when ray-box tests are performed against tree nodes
+        void CountBoxTests( uint32 nTests );
+
+        /// Called when ray-object intersection tests are performed
+        void CountPrimitiveTests( uint32 nTests );
+
+        /// Called when an object is skipped because the mailbox has already seen it
+        void CountMailboxRejection();
+
+        /// Called with the number of entries on the traversal stack, after something is pushed onto it
+        void CountStackDepth( size_t nDepth );
+    };
+
+
+    /// \ingroup TRTConcepts
+    /// \brief Interface for a traversal prefetch policy
+    ///
+    /// The raycasting functions call these methods for nodes which are pushed onto the traversal stack, so that their
+    ///  memory can be fetched while other nodes are being visited.  
+    /// \sa TRTConcepts
+    /// \sa NullPrefetch, NodePrefetch, NodeAndObjectPrefetch
+    struct Prefetch_C
+    {
+        /// Called for a node of a binary BVH which has been pushed onto the stack
+        template< class BVH_T, class ObjectSet_T >
+        static void PrefetchBVHNode( const BVH_T* pBVH, const ObjectSet_T* pObjects, typename BVH_T::ConstNodeHandle pNode );
+
+        /// Called for a node of an N-ary BVH which has been pushed onto the stack
+        template< class MBVH_T, class ObjectSet_T >
+        static void PrefetchMultiBVHNode( const MBVH_T* pBVH, const ObjectSet_T* pObjects, typename MBVH_T::ConstNodeHandle nNode );
+    };
+
+
     /// \ingroup TRTConcepts
     /// \brief Interface for a per-object cost function
     /// \sa TRTConcepts
@@ -433,6 +514,15 @@ namespace TinyRT
         template< class Ray_T >
         ConstNodeHandle* RayIntersectChildren( ConstNodeHandle nNode, const Ray_T& rRay, ConstNodeHandle* pStack, const int nDirSigns[4] ) const { return 0; };
 
+        /// \brief Performs a ray intersection test against the children of a node, for a ray in a known octant
+        /// This must be equivalent to RayIntersectChildren, but the octant index is known at compile time
+        /// \param OCTANT   The ray's octant, as returned by GetRayOctant
+        template< int OCTANT, class Ray_T >
+        ConstNodeHandle* RayIntersectChildrenOctant( ConstNodeHandle nNode, const SimdVec4f vSIMDRay[6], const Ray_T& rRay, ConstNodeHandle* pStack ) const { return 0; };
+
+        /// \brief Prefetches the memory which is read when a node is visited.  Only required by the NodePrefetch and NodeAndObjectPrefetch policies
+        virtual void PrefetchNode( ConstNodeHandle n ) const = 0;
+
     };
 
 
@@ -460,6 +550,9 @@ namespace TinyRT
 
         /// Sets the split axes that are used for ordered traversal of a particular node
         virtual void SetSplitAxes( NodeHandle nNode, uint32 nA0, uint32 nA1, uint32 nA2 )= 0;
+
+        /// Sets the order in which rays in a particular octant visit a node's children, for nodes which are not divided by three split planes
+        virtual void SetChildTraversalOrder( NodeHandle nNode, uint nRayOctant, uint8 nOrder ) = 0;
     
         /// Turns a child of a QBVH node into a leaf
         virtual void CreateLeafChild( NodeHandle nNode, uint32 nChildIdx, obj_id nFirstObject, obj_id nObjects )= 0; 
@@ -469,6 +562,15 @@ namespace TinyRT
    
         /// Sets the stored AABB for one of a node's children
         virtual void SetChildAABB( NodeHandle nNode, uint32 nChildIdx, const AxisAlignedBox& rBox )= 0;
+
+        /// Retrieves the stored AABB for one of a node's children
+        virtual void GetChildAABB( NodeHandle nNode, uint nChildIdx, AxisAlignedBox& rBoxOut ) const = 0;
+
+        /// Returns the 'N'th child of a node
+        virtual NodeHandle GetChild( NodeHandle nNode, size_t nChildIdx ) const = 0;
+
+        /// Returns a mask where each bit is 0 if the corresponding child is an empty leaf node, and 1 otherwise (LSB to MSB)
+        virtual uint GetEmptyLeafMask( NodeHandle nNode ) const = 0;
    
     };
 
@@ -0,0 +1,65 @@
+//=====================================================================================================================
+//
+//   TRTContentHash.h
+//
+//   Definition of class: TinyRT::ContentHash
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_CONTENTHASH_H_
+#define _TRT_CONTENTHASH_H_
+
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Computes a 64-bit FNV-1a hash over a sequence of values
+    ///
+    ///  This is used to identify object sets and build parameters, so that pre-built acceleration structures can be
+    ///   re-used (see BuildCache).  It is not a cryptographic hash.  Values are hashed by their binary representation,
+    ///   so the hash of a given set of values is only stable on machines with the same endianness and type sizes.
+    //=====================================================================================================================
+    class ContentHash
+    {
+    public:
+
+        inline ContentHash( ) : m_nHash( ( static_cast<uint64>( 0xcbf29ce4 ) << 32 ) | 0x84222325 ) {};
+
+        /// Adds a block of bytes to the hash
+        inline void Add( const void* pData, size_t nBytes )
+        {
+            const uint64 FNV_PRIME = ( static_cast<uint64>( 1 ) << 40 ) | 0x1b3;
+
+            const uint8* pBytes = reinterpret_cast<const uint8*>( pData );
+            uint64 nHash = m_nHash;
+            for( size_t i=0; i<nBytes; i++ )
+                nHash = ( nHash ^ pBytes[i] ) * FNV_PRIME;
+            m_nHash = nHash;
+        };
+
+        /// Adds a POD value to the hash
+        template< class T >
+        inline void AddValue( const T& rValue ) { Add( &rValue, sizeof(T) ); };
+
+        /// Adds a null-terminated string to the hash, including the terminator
+        inline void AddString( const char* pString ) { Add( pString, strlen( pString ) + 1 ); };
+
+        /// Returns the hash value
+        inline uint64 GetValue() const { return m_nHash; };
+
+    private:
+
+        uint64 m_nHash;
+    };
+
+}
+
+#endif // _TRT_CONTENTHASH_H_
@@ -32,10 +32,44 @@ namespace TinyRT
 
         inline float operator()( obj_id i ) const { return m_fConstantCost; };
 
+        /// Adds the cost to a hash.  Used by BuildCache to identify the build parameters
+        inline void HashParameters( ContentHash& rHash ) const { rHash.AddString( "ConstantCost" ); rHash.AddValue( m_fConstantCost ); };
+
     private:
         float m_fConstantCost;
     };
 
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Cost function which obtains per-object costs from the object set
+    ///
+    ///  The object set must provide a method 'float GetObjectCost( obj_id ) const'.  Since the costs are looked up in
+    ///   the object set, they remain correct after the objects are re-ordered during tree construction.
+    ///   This is useful for object sets whose objects vary widely in cost, such as InstanceSet.
+    ///
+    /// This class implements the CostFunction_C concept.
+    //=====================================================================================================================
+    template< class ObjectSet_T >
+    class ObjectCost
+    {
+    public:
+
+        inline ObjectCost( const ObjectSet_T* pObjects ) : m_pObjects(pObjects) {};
+
+        inline float operator()( typename ObjectSet_T::obj_id i ) const { return m_pObjects->GetObjectCost( i ); };
+
+        /// Adds the cost of each object to a hash.  Used by BuildCache to identify the build parameters
+        inline void HashParameters( ContentHash& rHash ) const
+        {
+            rHash.AddString( "ObjectCost" );
+            for( typename ObjectSet_T::obj_id i=0; i<m_pObjects->GetObjectCount(); i++ )
+                rHash.AddValue( m_pObjects->GetObjectCost( i ) );
+        };
+
+    private:
+        const ObjectSet_T* m_pObjects;
+    };
+
 
     //=====================================================================================================================
     /// \ingroup TinyRT
@@ -100,6 +134,83 @@ namespace TinyRT
     }
 
 
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Calculates the SAH cost of a quad AABB tree, using a cost functor
+    ///
+    /// Each visit to an inner node (which tests the ray against all four child boxes at once) is assigned a cost of 1.
+    ///  The area of a node is the area of the union of its non-empty children.
+    ///
+    /// \param rCostFunc        Function giving the cost of an intersection test, relative to the cost of a QBVH node visit
+    /// \param pTree            The tree whose cost is desired
+    /// \param nNode            The node whose subtree cost is being calculated
+    /// \param QuadAABBTree_T   Must implement the QuadAABBTree_C concept
+    /// \param CostFunction_T   Must implement the CostFunction_C concept
+    //=====================================================================================================================
+    template< typename QuadAABBTree_T, typename CostFunction_T >
+    float GetQuadAABBTreeSAHCost( const CostFunction_T& rCostFunc, const QuadAABBTree_T* pTree, typename QuadAABBTree_T::ConstNodeHandle nNode )
+    {
+        if( pTree->IsNodeLeaf( nNode ) )
+        {
+            typename QuadAABBTree_T::obj_id nFirst, nLast;
+            pTree->GetNodeObjectRange( nNode, nFirst, nLast );
+            
+            float fCost = 0;
+            while( nFirst != nLast )
+            {
+                fCost += rCostFunc(nFirst);
+                nFirst++;
+            }
+
+            return fCost;
+        }
+        else
+        {
+            uint nMask = pTree->GetEmptyLeafMask( nNode );
+            if( !nMask )
+                return 1.0f;
+
+            AxisAlignedBox nodeBox;
+            float fChildCosts = 0;
+            bool bFirst = true;
+            for( uint i=0; i<QuadAABBTree_T::BRANCH_FACTOR; i++ )
+            {
+                if( !( nMask & (1<<i) ) )
+                    continue;
+
+                AxisAlignedBox childBox;
+                pTree->GetChildAABB( nNode, i, childBox );
+                if( bFirst )
+                    nodeBox = childBox;
+                else
+                    nodeBox.Merge( childBox );
+                bFirst = false;
+
+                Vec3f vSize = childBox.Max() - childBox.Min();
+                float fArea = vSize.x*( vSize.y + vSize.z ) + vSize.y*vSize.z;
+                fChildCosts += fArea * GetQuadAABBTreeSAHCost( rCostFunc, pTree, pTree->GetChild( nNode, i ) );
+            }
+
+            Vec3f vSize = nodeBox.Max() - nodeBox.Min();
+            float fArea = vSize.x*( vSize.y + vSize.z ) + vSize.y*vSize.z;
+            return 1.0f + fChildCosts / (fArea+0.000001f);
+        }
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Calculates the SAH cost of a quad AABB tree, assuming a fixed cost per object
+    /// \param fFixedCost   The cost of an intersection test, relative to the cost of a QBVH node visit
+    /// \param pTree        The tree whose cost is desired
+    /// \param nNode        The node whose subtree cost is being calculated
+    /// \param QuadAABBTree_T Must implement the QuadAABBTree_C concept
+    //=====================================================================================================================
+    template< typename QuadAABBTree_T >
+    float GetQuadAABBTreeSAHCost( float fFixedCost, const QuadAABBTree_T* pTree, typename QuadAABBTree_T::ConstNodeHandle nNode )
+    {
+        return GetQuadAABBTreeSAHCost( ConstantCost<typename QuadAABBTree_T::obj_id>(fFixedCost), pTree, nNode );
+    }
+
     //=====================================================================================================================
     /// \ingroup TinyRT
     /// \brief Calculates the SAH cost of a KD tree, using a cost functor
@@ -56,6 +56,11 @@ namespace TinyRT
         /// Vectorized version of 'AreDistancesValid'
         inline SimdVecf AreDistancesValid( const SimdVecf& rT ) const { return rT >= SimdVecf( MinDistance() ) & rT < SimdVecf( MaxDistance() ); };
 
+        /// Modifies the ray origin
+        inline void SetOrigin( const Vec3f& rOrigin ) { Ray::SetOrigin( rOrigin ); };
+
+        /// Modifies the ray direction, and recomputes the reciprocal direction
+        inline void SetDirection( const Vec3f& rDirection ) { Ray::SetDirection( rDirection ); };
 
     };
 
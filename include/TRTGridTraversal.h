@@ -167,31 +167,99 @@ namespace TinyRT
     }
 
 
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Advances a DDA out of an empty block of grid cells
+    ///
+    /// This is equivalent to calling DDAStep repeatedly until the ray leaves the block, but its cost does not depend
+    ///  on the number of cells that are skipped.
+    ///
+    /// \param rState    A DDA state structure built by 'TinyRT::DDAInit'
+    /// \param rRay      The ray used in the call to 'TinyRT::DDAInit'
+    /// \param nBlockSize Edge length of the block, in cells.  Must be a power of two.  
+    ///                      The block containing the current cell is the one whose cell indices are aligned to multiples of this value
+    /// \return True if the ray continued to the next cell.  False if the ray has left the grid, or if the 
+    ///             next cell is beyond the ray's valid disatance
+    ///
+    /// \param DDA_T            An instance of the TinyRT::DDAState template
+    /// \param Ray_T            Must implement the Ray_C concept
+    //=====================================================================================================================
+    template< typename DDA_T, typename Ray_T >
+    TRT_FORCEINLINE bool DDASkipBlock( DDA_T& rState, const Ray_T& rRay, uint32 nBlockSize )
+    {
+        // compute the number of steps needed to leave the block on each axis, and the distance at which the ray leaves it
+        uint32 nSteps[3];
+        int nExitAxis = 0;
+        float fTExit = FLT_MAX;
+        for( int i=0; i<3; i++ )
+        {
+            uint32 nPos = rState.vCellIndices[i] & (nBlockSize-1);
+            nSteps[i] = ( rState.vStepSigns[i] > 0 ) ? nBlockSize - nPos : nPos + 1;
+
+            float fT = rState.vTNext[i] + (nSteps[i]-1)*rState.vDeltaT[i];
+            if( fT < fTExit )
+            {
+                fTExit = fT;
+                nExitAxis = i;
+            }
+        }
+
+        if( rRay.MaxDistance() < fTExit )
+            return false;
+
+        // step each axis over all of the cell boundaries that the ray crosses inside the block
+        bool bInside = true;
+        for( int i=0; i<3; i++ )
+        {
+            uint32 nStep;
+            if( i == nExitAxis )
+                nStep = nSteps[i];
+            else if( rState.vTNext[i] <= fTExit )
+                nStep = std::min( static_cast<uint32>( (fTExit - rState.vTNext[i]) / rState.vDeltaT[i] ) + 1, nSteps[i]-1 );
+            else
+                nStep = 0;
+
+            rState.vTNext[i] += nStep*rState.vDeltaT[i];
+            rState.vCellIndices[i] += nStep*rState.vStepSigns[i];
+
+            // if stepping negatively, overflow will make us stop...
+            bInside = bInside && ( rState.vCellIndices[i] < rState.vCellCounts[i] );
+        }
+
+        return bInside;
+    }
+
     //=====================================================================================================================
     /// \ingroup TinyRT
     /// \brief Searches for the first intersection between a ray and an object in a uniform grid
     /// \param pGrid    The grid to be traversed
     /// \param pObjects The object set used to create the grid (or an equivalent one)
     /// \param rHitInfo Receives intersection information
+    /// \param rStats   Receives traversal statistics
     ///
     /// \param Mailbox_T        Must implement the Mailbox_C concept
     /// \param UniformGrid_T    Must implement the UniformGrid_C concept
     /// \param ObjectSet_T      Must implement the ObjectSet_C concept
     /// \param HitInfo_T        Must implement the HitInfo_C concept
     /// \param Ray_T            Must implement the Ray_C concept
+    /// \param Stats_T          Must implement the TraversalStats_C concept
     //=====================================================================================================================
     template< 
         typename Mailbox_T,
         typename UniformGrid_T,
         typename ObjectSet_T,
         typename HitInfo_T,
-        typename Ray_T
+        typename Ray_T,
+        typename Stats_T
     >
-    void RaycastUniformGrid( const UniformGrid_T* pGrid, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo )
+    void RaycastUniformGrid( const UniformGrid_T* pGrid, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, Stats_T& rStats )
     {
         Mailbox_T mailbox(pObjects);
         const ObjectSet_T& rObjects = *pObjects;
            
+        rStats.CountRay();
+        rStats.CountBoxTests( 1 );
+
         // DDA setup
         DDAState<typename UniformGrid_T::UnsignedCellIndex,
                  typename UniformGrid_T::SignedCellIndex > ddaState;
@@ -201,16 +269,36 @@ namespace TinyRT
         while(1)
         {
             // Does this cell have objects?  If it does, intersect them
-            typename UniformGrid_T::CellIterator itBegin, itEnd;
-            pGrid->GetCellObjectList( ddaState.vCellIndices, itBegin, itEnd );
+            uint32 nEmptyBlock = pGrid->GetEmptyBlockSize( ddaState.vCellIndices );
+            if( nEmptyBlock == 0 )
+            {
+                typename UniformGrid_T::CellIterator itBegin, itEnd;
+                pGrid->GetCellObjectList( ddaState.vCellIndices, itBegin, itEnd );
 
-            while( itBegin != itEnd )
+                rStats.CountLeaf();
+                while( itBegin != itEnd )
+                {
+                    typename UniformGrid_T::obj_id nObject = *itBegin;
+                    if( !mailbox.CheckMailbox( nObject ) )
+                    {
+                        rStats.CountPrimitiveTests( 1 );
+                        rObjects.RayIntersect( rRay, rHitInfo, nObject ); 
+                    }
+                    else
+                    {
+                        rStats.CountMailboxRejection();
+                    }
+                    
+                    ++itBegin;
+                }
+            }
+            else if( nEmptyBlock > 2 )
             {
-                typename UniformGrid_T::obj_id nObject = *itBegin;
-                if( !mailbox.CheckMailbox( nObject ) )
-                    rObjects.RayIntersect( rRay, rHitInfo, nObject ); 
-                
-                ++itBegin;
+                // skip the entire run of empty cells.  For very small blocks, it is cheaper to just step through them
+                if( !DDASkipBlock( ddaState, rRay, nEmptyBlock ) )
+                    return;
+
+                continue;
             }
            
             // advance to next cell
@@ -219,4 +307,30 @@ namespace TinyRT
          }
     }
 
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Searches for the first intersection between a ray and an object in a uniform grid
+    /// \param pGrid    The grid to be traversed
+    /// \param pObjects The object set used to create the grid (or an equivalent one)
+    /// \param rHitInfo Receives intersection information
+    ///
+    /// \param Mailbox_T        Must implement the Mailbox_C concept
+    /// \param UniformGrid_T    Must implement the UniformGrid_C concept
+    /// \param ObjectSet_T      Must implement the ObjectSet_C concept
+    /// \param HitInfo_T        Must implement the HitInfo_C concept
+    /// \param Ray_T            Must implement the Ray_C concept
+    //=====================================================================================================================
+    template< 
+        typename Mailbox_T,
+        typename UniformGrid_T,
+        typename ObjectSet_T,
+        typename HitInfo_T,
+        typename Ray_T
+    >
+    inline void RaycastUniformGrid( const UniformGrid_T* pGrid, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo )
+    {
+        NullTraversalStats stats;
+        RaycastUniformGrid<Mailbox_T>( pGrid, pObjects, rRay, rHitInfo, stats );
+    }
+
 }
@@ -0,0 +1,117 @@
+//=====================================================================================================================
+//
+//   TRTHashedRayStampMailbox.h
+//
+//   Definition of class: TinyRT::HashedRayStampMailbox
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_HASHEDRAYSTAMPMAILBOX_H_
+#define _TRT_HASHEDRAYSTAMPMAILBOX_H_
+
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A fixed-size hash table of object IDs and ray stamps, used by HashedRayStampMailbox
+    //=====================================================================================================================
+    template< class ObjectRef_T, uint32 SIZE_LOG2 >
+    class HashedRayStampTable
+    {
+    public:
+
+        struct Entry
+        {
+            ObjectRef_T nID;
+            uint32 nStamp;
+        };
+
+        inline HashedRayStampTable( ) : m_nLastStamp( 0 ) { Clear(); };
+
+        /// Returns a stamp for a new ray
+        inline uint32 BeginRay( )
+        {
+            if( ++m_nLastStamp == 0 )
+            {
+                // the counter wrapped.  Stamps from old rays could match new ones, so they must be cleared
+                Clear();
+                m_nLastStamp = 1;
+            }
+            return m_nLastStamp;
+        };
+
+        /// Returns the entry that a particular object maps to
+        inline Entry& GetEntry( const ObjectRef_T& nID )
+        {
+            // Fibonacci hashing.  The high bits of the product depend on all of the ID's bits
+            uint32 nHash = static_cast<uint32>( nID ) * 2654435761u;
+            return m_entries[ nHash >> ( 32 - SIZE_LOG2 ) ];
+        };
+
+    private:
+
+        inline void Clear()
+        {
+            for( uint32 i=0; i < ( 1u << SIZE_LOG2 ); i++ )
+                m_entries[i].nStamp = 0;
+        };
+
+        Entry m_entries[ 1 << SIZE_LOG2 ];
+        uint32 m_nLastStamp;
+    };
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A ray-stamp mailbox which uses a fixed-size hash table, for object sets which are too large for RayStampMailbox
+    ///
+    ///  Each thread uses a table of 2^SIZE_LOG2 (ID,stamp) pairs, regardless of the size of the object set.  Like 
+    ///   DirectMapMailbox, this is an 'inverse mailbox', and two objects which map to the same entry may evict one another.
+    ///   However, the table is much larger, and is not cleared for each ray, so misses are rare unless the ray tests a 
+    ///   large fraction of the table's size.
+    ///
+    ///  Nested traversals on the same thread share the table.  This is safe, but may cause repeated intersection tests.
+    ///
+    ///  This class implements the Mailbox_C concept
+    //=====================================================================================================================
+    template< class ObjectRef_T, uint32 SIZE_LOG2=12 >
+    class HashedRayStampMailbox
+    {
+    public:
+
+        typedef HashedRayStampTable<ObjectRef_T,SIZE_LOG2> Table;
+
+        inline HashedRayStampMailbox( const void* ) : m_rTable( ThreadLocalInstance<Table>::Get() )
+        {
+            m_nStamp = m_rTable.BeginRay();
+        };
+
+        //=====================================================================================================================
+        //=====================================================================================================================
+        inline bool CheckMailbox( const ObjectRef_T& nID )
+        {
+            typename Table::Entry& rEntry = m_rTable.GetEntry( nID );
+            if( rEntry.nStamp == m_nStamp && rEntry.nID == nID )
+                return true;
+
+            rEntry.nID = nID;
+            rEntry.nStamp = m_nStamp;
+            return false;
+        };
+
+    private:
+
+        Table& m_rTable;
+        uint32 m_nStamp;
+    };
+
+}
+
+#endif // _TRT_HASHEDRAYSTAMPMAILBOX_H_
@@ -0,0 +1,229 @@
+//=====================================================================================================================
+//
+//   TRTInstanceSet.h
+//
+//   Definition of class: TinyRT::InstanceSet
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_INSTANCESET_H_
+#define _TRT_INSTANCESET_H_
+
+#include "TRTAffineTransform.h"
+#include "TRTScratchMemory.h"
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Information about a ray hit in an InstanceSet
+    ///
+    ///  In addition to the hit information, this structure carries the scratch memory used for the nested traversals.
+    ///   Each thread must use its own scratch memory.  By default, the calling thread's 'ThreadScratchMemory' is used.
+    ///
+    /// \param HitInfo_T  Hit information for the instanced objects.  Must implement the HitInfo_C concept
+    //=====================================================================================================================
+    template< class HitInfo_T >
+    struct InstanceRayHit
+    {
+        enum { INVALID_INSTANCE = 0xffffffff };
+
+        /// Uses the calling thread's scratch memory for nested traversals
+        inline InstanceRayHit( ) : nInstance( INVALID_INSTANCE ), pScratch( &ThreadScratchMemory::Get() ) {};
+
+        inline InstanceRayHit( ScratchMemory& rScratch ) : nInstance( INVALID_INSTANCE ), pScratch( &rScratch ) {};
+
+        HitInfo_T      objectHit;    ///< Hit information for the object that was hit, in the instance's object space
+        uint32         nInstance;    ///< ID of the instance which was hit (as returned by InstanceSet::AddInstance)
+        ScratchMemory* pScratch;     ///< Scratch memory for nested traversals.  Must not be shared between threads
+    };
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Casts a ray through a nested AABBTree.  This is used by InstanceSet to select a traversal for its prototypes
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HitInfo_T, class Ray_T >
+    inline void RaycastNestedTree( const AABBTree<ObjectSet_T>* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, ScratchMemory& rScratch )
+    {
+        RaycastBVH( pTree, pObjects, rRay, rHitInfo, pTree->GetRoot(), rScratch );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Casts a ray through a nested QuadAABBTree.  This is used by InstanceSet to select a traversal for its prototypes
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T, class HitInfo_T, class Ray_T >
+    inline void RaycastNestedTree( const QuadAABBTree<ObjectSet_T,HandleTraits_T>* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, ScratchMemory& rScratch )
+    {
+        RaycastMultiBVH( pTree, pObjects, rRay, rHitInfo, pTree->GetRoot(), rScratch );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Casts a ray through a nested KDTree.  This is used by InstanceSet to select a traversal for its prototypes
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T, class HitInfo_T, class Ray_T >
+    inline void RaycastNestedTree( const KDTree<ObjectSet_T,HandleTraits_T>* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, ScratchMemory& rScratch )
+    {
+        RaycastKDTree< DirectMapMailbox<typename ObjectSet_T::obj_id,16> >( pTree, pObjects, rRay, rHitInfo, pTree->GetRoot(), rScratch );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Computes the SAH cost of a nested AABBTree.  This is used by InstanceSet to estimate the cost of its prototypes
+    //=====================================================================================================================
+    template< class ObjectSet_T, class CostFunction_T >
+    inline float GetNestedTreeSAHCost( const CostFunction_T& rCostFunc, const AABBTree<ObjectSet_T>* pTree )
+    {
+        return GetAABBTreeSAHCost( rCostFunc, pTree, pTree->GetRoot() );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Computes the SAH cost of a nested QuadAABBTree.  This is used by InstanceSet to estimate the cost of its prototypes
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T, class CostFunction_T >
+    inline float GetNestedTreeSAHCost( const CostFunction_T& rCostFunc, const QuadAABBTree<ObjectSet_T,HandleTraits_T>* pTree )
+    {
+        return GetQuadAABBTreeSAHCost( rCostFunc, pTree, pTree->GetRoot() );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Computes the SAH cost of a nested KDTree.  This is used by InstanceSet to estimate the cost of its prototypes
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T, class CostFunction_T >
+    inline float GetNestedTreeSAHCost( const CostFunction_T& rCostFunc, const KDTree<ObjectSet_T,HandleTraits_T>* pTree )
+    {
+        return GetKDTreeSAHCost( rCostFunc, pTree, pTree->GetRoot(), pTree->GetBoundingBox() );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A set of transformed instances of a smaller number of prototype objects
+    ///
+    ///  Each prototype is an object set with its own acceleration structure, which is shared by all instances of the
+    ///   prototype.  Each instance has an affine transform, which maps it from its object space into world space.  Rays
+    ///   are transformed into object space and cast through the prototype's tree.  The instances are organized into
+    ///   a top-level AABBTree, which is built using the surface area heuristic.
+    ///
+    ///  The instance set does not own its prototypes, and does not modify them.  Raycasting is reentrant, provided that
+    ///   each thread uses its own scratch memory.
+    ///
+    ///  Each prototype is assigned an intersection cost, which by default is the SAH cost of its tree.  The top-level
+    ///   tree is built using these costs, so that expensive instances are separated from cheap ones.
+    ///
+    ///  This class implements the ObjectSet_C concept.
+    ///
+    /// \param ObjectSet_T  Prototype object type.  Must implement the ObjectSet_C concept
+    /// \param Tree_T       Acceleration structure for the prototypes.  Must be an AABBTree or QuadAABBTree over ObjectSet_T,
+    ///                      or some other type for which 'RaycastNestedTree' and 'GetNestedTreeSAHCost' have been overloaded
+    //=====================================================================================================================
+    template< class ObjectSet_T, class Tree_T = AABBTree<ObjectSet_T> >
+    class InstanceSet
+    {
+    public:
+
+        typedef uint32 obj_id;
+        typedef AABBTree< InstanceSet<ObjectSet_T,Tree_T> > TopLevelTree;
+
+        enum { INVALID_INSTANCE = 0xffffffff };
+
+        /// Adds a prototype to the set, and returns its ID.  The object set and tree must remain valid until the instance set is destroyed
+        inline uint32 AddPrototype( const ObjectSet_T* pObjects, const Tree_T* pTree, float fObjectCost = 1.0f );
+
+        /// Overrides the intersection cost of a prototype.  This takes effect on the next call to 'Build'
+        inline void SetPrototypeCost( uint32 nPrototype, float fCost ) { m_prototypes[nPrototype].fCost = fCost; };
+
+        /// \brief Adds an instance of a prototype, and returns its ID.
+        /// Instance IDs are assigned sequentially, and are not affected by 'Build'.  INVALID_INSTANCE is returned if the transform is singular
+        inline uint32 AddInstance( uint32 nPrototype, const AffineTransform& rObjectToWorld );
+
+        /// Changes the transform of an instance.  'Refit' or 'Build' must be called before the next raycast
+        inline bool SetInstanceTransform( uint32 nInstance, const AffineTransform& rObjectToWorld );
+
+        /// Builds the top-level tree over the instances, using the prototype costs
+        inline void Build();
+
+        /// Updates the top-level tree after instance transforms have changed
+        inline void Refit() { m_tree.RefitParallel( this ); };
+
+        /// Finds the nearest intersection between a ray and the instances.  'Build' must have been called first
+        template< class Ray_T, class HitInfo_T >
+        inline void Raycast( Ray_T& rRay, InstanceRayHit<HitInfo_T>& rHitInfo ) const
+        {
+            RaycastBVH( &m_tree, this, rRay, rHitInfo, m_tree.GetRoot(), *rHitInfo.pScratch );
+        };
+
+        inline uint32 GetPrototypeCount() const { return static_cast<uint32>( m_prototypes.size() ); };
+        inline const ObjectSet_T* GetPrototypeObjects( uint32 nPrototype ) const { return m_prototypes[nPrototype].pObjects; };
+        inline const Tree_T* GetPrototypeTree( uint32 nPrototype ) const { return m_prototypes[nPrototype].pTree; };
+        inline float GetPrototypeCost( uint32 nPrototype ) const { return m_prototypes[nPrototype].fCost; };
+
+        inline uint32 GetInstancePrototype( uint32 nInstance ) const { return m_instances[ m_instanceSlots[nInstance] ].nPrototype; };
+        inline const AffineTransform& GetInstanceObjectToWorld( uint32 nInstance ) const { return m_objectToWorld[nInstance]; };
+        inline const AffineTransform& GetInstanceWorldToObject( uint32 nInstance ) const { return m_instances[ m_instanceSlots[nInstance] ].worldToObject; };
+
+        inline const TopLevelTree& GetTree() const { return m_tree; };
+
+        /// Performs an intersection test between a ray and an instance, returning true if a hit was found
+        template< class Ray_T, class HitInfo_T >
+        inline bool RayIntersect( Ray_T& rRay, InstanceRayHit<HitInfo_T>& rHitInfo, obj_id nObject ) const;
+
+        /// Performs an intersection test between a ray and a range of instances, returning true if a hit was found
+        template< class Ray_T, class HitInfo_T >
+        inline bool RayIntersect( Ray_T& rRay, InstanceRayHit<HitInfo_T>& rHitInfo, obj_id nObject, obj_id nCount ) const;
+
+        /// Returns the number of instances
+        inline obj_id GetObjectCount() const { return static_cast<obj_id>( m_instances.size() ); };
+
+        /// Computes the world-space bounding box of an instance
+        inline void GetObjectAABB( obj_id nObject, AxisAlignedBox& rBox ) const { rBox = m_instances[nObject].box; };
+
+        /// Returns the cost of intersecting an instance, relative to the cost of a node traversal.  Used by ObjectCost
+        inline float GetObjectCost( obj_id nObject ) const { return m_prototypes[ m_instances[nObject].nPrototype ].fCost; };
+
+        /// Computes the world-space bounding box of all instances
+        inline void GetAABB( AxisAlignedBox& rBox ) const;
+
+        /// Rearranges the order of the instances.  Instance IDs are preserved
+        inline void RemapObjects( obj_id* pObjectRemap );
+
+    private:
+
+        struct Prototype
+        {
+            const ObjectSet_T* pObjects;
+            const Tree_T* pTree;
+            AxisAlignedBox box;         ///< Object space bounding box
+            float fCost;                ///< Cost of intersecting an instance of this prototype
+        };
+
+        struct Instance
+        {
+            AffineTransform worldToObject;
+            AxisAlignedBox box;         ///< World space bounding box
+            uint32 nPrototype;
+            uint32 nInstance;           ///< ID returned by 'AddInstance'
+        };
+
+        std::vector<Prototype>       m_prototypes;
+        std::vector<Instance>        m_instances;       ///< Instances, in the order used by the top-level tree
+        std::vector<AffineTransform> m_objectToWorld;   ///< Object-to-world transform for each instance ID
+        std::vector<uint32>          m_instanceSlots;   ///< Position of each instance ID in 'm_instances'
+
+        TopLevelTree m_tree;
+    };
+
+}
+
+#include "TRTInstanceSet.inl"
+
+#endif // _TRT_INSTANCESET_H_
@@ -0,0 +1,158 @@
+//=====================================================================================================================
+//
+//   TRTInstanceSet.inl
+//
+//   Implementation of class: TinyRT::InstanceSet
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    //
+    //            Public Methods
+    //
+    //=====================================================================================================================
+
+    //=====================================================================================================================
+    /// \param pObjects      The prototype's objects
+    /// \param pTree         Tree built over the prototype's objects
+    /// \param fObjectCost   Cost of intersecting one of the prototype's objects, relative to the cost of a node traversal.
+    ///                        The prototype cost is the SAH cost of its tree, plus one for the ray transformation
+    //=====================================================================================================================
+    template< class ObjectSet_T, class Tree_T >
+    uint32 InstanceSet<ObjectSet_T,Tree_T>::AddPrototype( const ObjectSet_T* pObjects, const Tree_T* pTree, float fObjectCost )
+    {
+        Prototype proto;
+        proto.pObjects = pObjects;
+        proto.pTree = pTree;
+        proto.fCost = 1.0f + GetNestedTreeSAHCost( ConstantCost<typename ObjectSet_T::obj_id>( fObjectCost ), pTree );
+        pObjects->GetAABB( proto.box );
+        m_prototypes.push_back( proto );
+        return static_cast<uint32>( m_prototypes.size() - 1 );
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class ObjectSet_T, class Tree_T >
+    uint32 InstanceSet<ObjectSet_T,Tree_T>::AddInstance( uint32 nPrototype, const AffineTransform& rObjectToWorld )
+    {
+        TRT_ASSERT( nPrototype < m_prototypes.size() );
+
+        Instance inst;
+        if( !rObjectToWorld.Invert( inst.worldToObject ) )
+            return INVALID_INSTANCE;
+
+        uint32 nInstance = static_cast<uint32>( m_instances.size() );
+        rObjectToWorld.TransformAABB( m_prototypes[nPrototype].box, inst.box );
+        inst.nPrototype = nPrototype;
+        inst.nInstance = nInstance;
+
+        m_instances.push_back( inst );
+        m_objectToWorld.push_back( rObjectToWorld );
+        m_instanceSlots.push_back( nInstance );
+        return nInstance;
+    }
+
+    //=====================================================================================================================
+    /// \return False if the transform is singular, in which case the instance is not modified
+    //=====================================================================================================================
+    template< class ObjectSet_T, class Tree_T >
+    bool InstanceSet<ObjectSet_T,Tree_T>::SetInstanceTransform( uint32 nInstance, const AffineTransform& rObjectToWorld )
+    {
+        Instance& rInst = m_instances[ m_instanceSlots[nInstance] ];
+        if( !rObjectToWorld.Invert( rInst.worldToObject ) )
+            return false;
+
+        rObjectToWorld.TransformAABB( m_prototypes[rInst.nPrototype].box, rInst.box );
+        m_objectToWorld[nInstance] = rObjectToWorld;
+        return true;
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class ObjectSet_T, class Tree_T >
+    void InstanceSet<ObjectSet_T,Tree_T>::Build( )
+    {
+        typedef InstanceSet<ObjectSet_T,Tree_T> ThisType;
+        SahAABBTreeBuilder< ThisType, ObjectCost<ThisType> > builder( ObjectCost<ThisType>( this ) );
+        m_tree.Build( this, builder );
+    }
+
+    //=====================================================================================================================
+    /// The ray is transformed into the instance's object space.  Since the transform is affine, the ray direction is
+    ///  not re-normalized, and distances along the transformed ray are the same as distances along the original one.
+    //=====================================================================================================================
+    template< class ObjectSet_T, class Tree_T >
+    template< class Ray_T, class HitInfo_T >
+    bool InstanceSet<ObjectSet_T,Tree_T>::RayIntersect( Ray_T& rRay, InstanceRayHit<HitInfo_T>& rHitInfo, obj_id nObject ) const
+    {
+        const Instance& rInst = m_instances[nObject];
+        const Prototype& rProto = m_prototypes[rInst.nPrototype];
+
+        Ray_T objectRay( rRay );
+        objectRay.SetOrigin( rInst.worldToObject.TransformPoint( rRay.Origin() ) );
+        objectRay.SetDirection( rInst.worldToObject.TransformVector( rRay.Direction() ) );
+
+        HitInfo_T hit;
+        RaycastNestedTree( rProto.pTree, rProto.pObjects, objectRay, hit, *rHitInfo.pScratch );
+
+        if( objectRay.MaxDistance() < rRay.MaxDistance() )
+        {
+            rRay.SetMaxDistance( objectRay.MaxDistance() );
+            rHitInfo.objectHit = hit;
+            rHitInfo.nInstance = rInst.nInstance;
+            return true;
+        }
+        return false;
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class ObjectSet_T, class Tree_T >
+    template< class Ray_T, class HitInfo_T >
+    bool InstanceSet<ObjectSet_T,Tree_T>::RayIntersect( Ray_T& rRay, InstanceRayHit<HitInfo_T>& rHitInfo, obj_id nObject, obj_id nCount ) const
+    {
+        bool bHit = false;
+        for( obj_id i=0; i<nCount; i++ )
+            bHit = RayIntersect( rRay, rHitInfo, nObject+i ) || bHit;
+        return bHit;
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class ObjectSet_T, class Tree_T >
+    void InstanceSet<ObjectSet_T,Tree_T>::GetAABB( AxisAlignedBox& rBox ) const
+    {
+        if( m_instances.empty() )
+        {
+            // an empty set has an inverted box, which every ray misses
+            rBox = AxisAlignedBox( Vec3f( std::numeric_limits<float>::max() ), 
+                                   Vec3f( -std::numeric_limits<float>::max() ) );
+            return;
+        }
+
+        rBox = m_instances[0].box;
+        for( size_t i=1; i<m_instances.size(); i++ )
+            rBox.Merge( m_instances[i].box );
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class ObjectSet_T, class Tree_T >
+    void InstanceSet<ObjectSet_T,Tree_T>::RemapObjects( obj_id* pObjectRemap )
+    {
+        RemapArray( &m_instances[0], m_instances.size(), pObjectRemap );
+        for( size_t i=0; i<m_instances.size(); i++ )
+            m_instanceSlots[ m_instances[i].nInstance ] = static_cast<uint32>( i );
+    }
+
+}
@@ -15,6 +15,12 @@
 #ifndef _TRTKDTRAVERSAL_H_
 #define _TRTKDTRAVERSAL_H_
 
+#include "TRTTraversalStack.h"
+#include "TRTTraversalStats.h"
+
+/// Maximum tree depth for the restart trail of RaycastKDTreeShortStackOctant.  The trail holds one bit per level in a uint64
+#define TRT_KD_RESTART_TRAIL_DEPTH 64
+
 namespace TinyRT
 {
     template< class KDTree_T >
@@ -27,27 +33,120 @@ namespace TinyRT
 
     //=====================================================================================================================
     /// \ingroup TinyRT
-    /// Searches for the first intersection between a ray and an object in a KD-Tree.  
+    /// \brief KD-Tree leaf intersection policy which tests the objects in a leaf one at a time
+    ///
+    ///  This is the policy used by the raycasting functions which do not take a leaf intersection policy
+    //=====================================================================================================================
+    class ScalarLeafIntersector
+    {
+    public:
+
+        template< class Mailbox_T, class ObjectSet_T, class LeafIterator_T, class Ray_T, class HitInfo_T, class Stats_T >
+        static TRT_FORCEINLINE void IntersectLeaf( const ObjectSet_T* pObjects, LeafIterator_T itBegin, LeafIterator_T itEnd, 
+                                                   Mailbox_T& rMailbox, Ray_T& rRay, HitInfo_T& rHitInfo, Stats_T& rStats )
+        {
+            while( itBegin != itEnd )
+            {
+                typename ObjectSet_T::obj_id nObject = *itBegin;
+                if( !rMailbox.CheckMailbox( nObject ) )
+                {
+                    rStats.CountPrimitiveTests( 1 );
+                    pObjects->RayIntersect( rRay, rHitInfo, nObject ); 
+                }
+                else
+                {
+                    rStats.CountMailboxRejection();
+                }
+                
+                ++itBegin;
+            }
+        };
+    };
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief KD-Tree leaf intersection policy which tests the objects in a leaf several at a time
+    ///
+    ///  The objects which pass the mailbox check are collected into a small batch, and passed to the object set's
+    ///   'RayIntersectList' method, which gathers them into SIMD groups (BasicMesh and StridedMesh provide this).  
+    ///   Rejected objects are removed before the gather, so mailboxing does not leave SIMD lanes idle.  Leaves of SAH 
+    ///   KD-trees are small, so this only pays off when leaves regularly hold more objects than the SIMD width
+    //=====================================================================================================================
+    class SimdLeafIntersector
+    {
+    public:
+
+        /// Number of objects which are collected before they are tested
+        enum { BATCH_SIZE = 4*SimdVecf::WIDTH };
+
+        template< class Mailbox_T, class ObjectSet_T, class LeafIterator_T, class Ray_T, class HitInfo_T, class Stats_T >
+        static TRT_FORCEINLINE void IntersectLeaf( const ObjectSet_T* pObjects, LeafIterator_T itBegin, LeafIterator_T itEnd, 
+                                                   Mailbox_T& rMailbox, Ray_T& rRay, HitInfo_T& rHitInfo, Stats_T& rStats )
+        {
+            typename ObjectSet_T::obj_id pBatch[ BATCH_SIZE ];
+            uint32 nBatch = 0;
+            while( itBegin != itEnd )
+            {
+                typename ObjectSet_T::obj_id nObject = *itBegin;
+                ++itBegin;
+
+                if( rMailbox.CheckMailbox( nObject ) )
+                {
+                    rStats.CountMailboxRejection();
+                    continue;
+                }
+
+                pBatch[nBatch++] = nObject;
+                if( nBatch == BATCH_SIZE )
+                {
+                    rStats.CountPrimitiveTests( nBatch );
+                    pObjects->RayIntersectList( rRay, rHitInfo, pBatch, nBatch );
+                    nBatch = 0;
+                }
+            }
+
+            if( nBatch )
+            {
+                rStats.CountPrimitiveTests( nBatch );
+                pObjects->RayIntersectList( rRay, rHitInfo, pBatch, nBatch );
+            }
+        };
+    };
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief KD-Tree traversal kernel for rays in a particular octant
+    ///
+    /// The octant determines the near and far children of each node at compile time, so the kernel does not branch on the
+    ///  ray direction.  The ray must actually lie in the given octant.  RaycastKDTreeWithStack selects the kernel for each ray.
+    ///
+    /// \param pStack           Traversal stack.  Must have room for pTree->GetStackDepth() entries
+    /// \param rStats           Receives traversal statistics
+    /// \param OCTANT           The ray's octant, as returned by GetRayOctant
+    /// \param LeafIntersector_T  Leaf intersection policy (ScalarLeafIntersector or SimdLeafIntersector)
     /// \param Mailbox_T        Must implement the Mailbox_C concept
-    /// \param UniformGrid_T    Must implement the KDTree_C concept
+    /// \param KDTree_T         Must implement the KDTree_C concept
     /// \param ObjectSet_T      Must implement the ObjectSet_C concept
     /// \param HitInfo_T        Must implement the HitInfo_C concept
     /// \param Ray_T            Must implement the Ray_C concept
+    /// \param Stats_T          Must implement the TraversalStats_C concept
     //=====================================================================================================================
-    template< class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
-    void RaycastKDTree( const KDTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, typename KDTree_T::ConstNodeHandle pRoot, ScratchMemory& rScratch )
+    template< int OCTANT, class LeafIntersector_T, class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    void RaycastKDTreeOctant( const KDTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                              typename KDTree_T::ConstNodeHandle pRoot, KDStackEntry<KDTree_T>* pStack, Stats_T& rStats )
     {
         Mailbox_T mailbox( pObjects );
 
         typedef KDStackEntry<KDTree_T> StackEntry;
 
-        ScratchArray<StackEntry> pStackArray( rScratch, pTree->GetStackDepth() );
-        StackEntry* pStack = pStackArray;
         StackEntry* pStackBottom = pStack;
 
+        rStats.CountRay();
+        rStats.CountBoxTests( 1 );
+
         const AxisAlignedBox& rBox = pTree->GetBoundingBox();
         float fTMin, fTMax;
-        if( !RayAABBTest( rBox.Min(), rBox.Max(), rRay, fTMin, fTMax ) )
+        if( !RayAABBTestOctant<OCTANT>( rBox.Min(), rBox.Max(), rRay, fTMin, fTMax ) )
             return;
 
         float fRayMin = rRay.MinDistance();
@@ -68,38 +167,25 @@ namespace TinyRT
                 // intersect all objects in this leaf node, then proceed with next node from stack
                 typename KDTree_T::LeafIterator itBegin, itEnd;
                 pTree->GetNodeObjectList( pNode, itBegin, itEnd );
-                const typename KDTree_T::ObjectSet& rObjects = *pObjects;
-
-                while( itBegin != itEnd )
-                {
-                    typename KDTree_T::obj_id nObject = *itBegin;
-                    if( !mailbox.CheckMailbox( nObject ) )
-                        rObjects.RayIntersect( rRay, rHitInfo, nObject ); 
-                    
-                    ++itBegin;
-                }
 
+                rStats.CountLeaf();
+                LeafIntersector_T::IntersectLeaf( pObjects, itBegin, itEnd, mailbox, rRay, rHitInfo, rStats );
             }
             else
             {
+                rStats.CountInnerNode();
+
                 int axis     = pTree->GetNodeSplitAxis( pNode );
                 float fSplit = pTree->GetNodeSplitPosition( pNode );
                 float fO     = rRayOrigin[axis] ;
                 float fD     = rRayDirectionInv[axis];
                 float fTHit  = ( fSplit - fO ) * fD;
 
-                typename KDTree_T::ConstNodeHandle pNear;
-                typename KDTree_T::ConstNodeHandle pFar;
-                if( fD < 0 )
-                {
-                    pNear = pTree->GetRightChild(pNode);
-                    pFar  = pTree->GetLeftChild(pNode);
-                }
-                else
-                {
-                    pNear = pTree->GetLeftChild(pNode);
-                    pFar  = pTree->GetRightChild(pNode);
-                }
+                typename KDTree_T::ConstNodeHandle pLeft  = pTree->GetLeftChild(pNode);
+                typename KDTree_T::ConstNodeHandle pRight = pTree->GetRightChild(pNode);
+                bool bNegative = ( ( OCTANT >> axis ) & 1 ) != 0;
+                typename KDTree_T::ConstNodeHandle pNear = bNegative ? pRight : pLeft;
+                typename KDTree_T::ConstNodeHandle pFar  = bNegative ? pLeft : pRight;
                     
                 if( fTHit > fTMax )
                 {
@@ -120,6 +206,7 @@ namespace TinyRT
                     pStack->fTMin = fTHit;
                     pStack->fTMax = fTMax;
                     pStack++;
+                    rStats.CountStackDepth( pStack - pStackBottom );
 
                     pNode = pNear;
                     fTMax = fTHit;
@@ -144,5 +231,671 @@ namespace TinyRT
         } // end of infinite traversal loop
 
     }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a KD-Tree, using a caller-supplied stack and 
+    ///  a particular leaf intersection policy.  The ray is traversed by the kernel which is specialized for its octant
+    /// \param pStack           Traversal stack.  Must have room for pTree->GetStackDepth() entries
+    /// \param rStats           Receives traversal statistics
+    /// \param LeafIntersector_T  Leaf intersection policy (ScalarLeafIntersector or SimdLeafIntersector)
+    /// \param Mailbox_T        Must implement the Mailbox_C concept
+    /// \param KDTree_T         Must implement the KDTree_C concept
+    /// \param ObjectSet_T      Must implement the ObjectSet_C concept
+    /// \param HitInfo_T        Must implement the HitInfo_C concept
+    /// \param Ray_T            Must implement the Ray_C concept
+    /// \param Stats_T          Must implement the TraversalStats_C concept
+    //=====================================================================================================================
+    template< class LeafIntersector_T, class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    void RaycastKDTreeWithLeafIntersector( const KDTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                                           typename KDTree_T::ConstNodeHandle pRoot, KDStackEntry<KDTree_T>* pStack, Stats_T& rStats )
+    {
+        switch( GetRayOctant( rRay ) )
+        {
+        case 0: RaycastKDTreeOctant<0,LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 1: RaycastKDTreeOctant<1,LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 2: RaycastKDTreeOctant<2,LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 3: RaycastKDTreeOctant<3,LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 4: RaycastKDTreeOctant<4,LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 5: RaycastKDTreeOctant<5,LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 6: RaycastKDTreeOctant<6,LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 7: RaycastKDTreeOctant<7,LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        };
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a KD-Tree, using a caller-supplied stack.
+    ///  The ray is traversed by the kernel which is specialized for its octant
+    /// \param pStack           Traversal stack.  Must have room for pTree->GetStackDepth() entries
+    /// \param rStats           Receives traversal statistics
+    /// \param Mailbox_T        Must implement the Mailbox_C concept
+    /// \param KDTree_T         Must implement the KDTree_C concept
+    /// \param ObjectSet_T      Must implement the ObjectSet_C concept
+    /// \param HitInfo_T        Must implement the HitInfo_C concept
+    /// \param Ray_T            Must implement the Ray_C concept
+    /// \param Stats_T          Must implement the TraversalStats_C concept
+    //=====================================================================================================================
+    template< class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    inline void RaycastKDTreeWithStack( const KDTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                                        typename KDTree_T::ConstNodeHandle pRoot, KDStackEntry<KDTree_T>* pStack, Stats_T& rStats )
+    {
+        RaycastKDTreeWithLeafIntersector<ScalarLeafIntersector,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a KD-Tree, using a caller-supplied stack.
+    /// \param pStack           Traversal stack.  Must have room for pTree->GetStackDepth() entries
+    /// \param Mailbox_T        Must implement the Mailbox_C concept
+    /// \param KDTree_T         Must implement the KDTree_C concept
+    /// \param ObjectSet_T      Must implement the ObjectSet_C concept
+    /// \param HitInfo_T        Must implement the HitInfo_C concept
+    /// \param Ray_T            Must implement the Ray_C concept
+    //=====================================================================================================================
+    template< class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastKDTreeWithStack( const KDTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                                        typename KDTree_T::ConstNodeHandle pRoot, KDStackEntry<KDTree_T>* pStack )
+    {
+        NullTraversalStats stats;
+        RaycastKDTreeWithStack<Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, stats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a KD-Tree.  
+    ///  The traversal stack is kept on the call stack, and scratch memory is only used if the tree is deeper than TRT_INLINE_STACK_DEPTH
+    /// \param Mailbox_T        Must implement the Mailbox_C concept
+    /// \param KDTree_T         Must implement the KDTree_C concept
+    /// \param ObjectSet_T      Must implement the ObjectSet_C concept
+    /// \param HitInfo_T        Must implement the HitInfo_C concept
+    /// \param Ray_T            Must implement the Ray_C concept
+    //=====================================================================================================================
+    template< class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastKDTree( const KDTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, typename KDTree_T::ConstNodeHandle pRoot, ScratchMemory& rScratch )
+    {
+        TraversalStack< KDStackEntry<KDTree_T>, TRT_INLINE_STACK_DEPTH > stack( rScratch, pTree->GetStackDepth() );
+        KDStackEntry<KDTree_T>* pStack = stack;
+        RaycastKDTreeWithStack<Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a KD-Tree, and records traversal statistics
+    /// \param Stats_T          Must implement the TraversalStats_C concept
+    //=====================================================================================================================
+    template< class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    inline void RaycastKDTree( const KDTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, typename KDTree_T::ConstNodeHandle pRoot, 
+                               ScratchMemory& rScratch, Stats_T& rStats )
+    {
+        TraversalStack< KDStackEntry<KDTree_T>, TRT_INLINE_STACK_DEPTH > stack( rScratch, pTree->GetStackDepth() );
+        KDStackEntry<KDTree_T>* pStack = stack;
+        RaycastKDTreeWithStack<Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a KD-Tree, using the calling thread's scratch memory
+    ///  if the tree is too deep for an inline stack
+    /// \sa ThreadScratchMemory
+    //=====================================================================================================================
+    template< class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastKDTree( const KDTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, typename KDTree_T::ConstNodeHandle pRoot )
+    {
+        TraversalStack< KDStackEntry<KDTree_T>, TRT_INLINE_STACK_DEPTH > stack( pTree->GetStackDepth() );
+        KDStackEntry<KDTree_T>* pStack = stack;
+        RaycastKDTreeWithStack<Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a KD-Tree, testing the objects in each leaf 
+    ///  several at a time (see SimdLeafIntersector).  The object set must provide a 'RayIntersectList' method
+    /// \param rStats           Receives traversal statistics
+    /// \param Mailbox_T        Must implement the Mailbox_C concept
+    /// \param KDTree_T         Must implement the KDTree_C concept
+    /// \param ObjectSet_T      Must implement the ObjectSet_C concept
+    /// \param HitInfo_T        Must implement the HitInfo_C concept
+    /// \param Ray_T            Must implement the Ray_C concept
+    /// \param Stats_T          Must implement the TraversalStats_C concept
+    //=====================================================================================================================
+    template< class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    inline void RaycastKDTreeSimd( const KDTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, typename KDTree_T::ConstNodeHandle pRoot, 
+                                   ScratchMemory& rScratch, Stats_T& rStats )
+    {
+        TraversalStack< KDStackEntry<KDTree_T>, TRT_INLINE_STACK_DEPTH > stack( rScratch, pTree->GetStackDepth() );
+        KDStackEntry<KDTree_T>* pStack = stack;
+        RaycastKDTreeWithLeafIntersector<SimdLeafIntersector,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a KD-Tree, testing the objects in each leaf 
+    ///  several at a time (see SimdLeafIntersector).  The object set must provide a 'RayIntersectList' method
+    //=====================================================================================================================
+    template< class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastKDTreeSimd( const KDTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, typename KDTree_T::ConstNodeHandle pRoot, 
+                                   ScratchMemory& rScratch )
+    {
+        NullTraversalStats stats;
+        RaycastKDTreeSimd<Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, rScratch, stats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A fixed-size traversal stack which discards its oldest entries when it overflows
+    ///
+    ///  Used by RaycastKDTreeShortStack.  If an entry has been discarded, the traversal restarts from the root once
+    ///   the stack runs dry.  A stack with a size of zero holds nothing, and results in a pure restart traversal
+    //=====================================================================================================================
+    template< class Entry_T, int SIZE >
+    class KDShortStack
+    {
+    public:
+
+        inline KDShortStack() : m_nTop(0), m_nCount(0) {};
+
+        inline bool IsEmpty() const { return m_nCount == 0; };
+
+        inline uint GetSize() const { return m_nCount; };
+
+        inline void Push( const Entry_T& rEntry )
+        {
+            m_entries[m_nTop] = rEntry;
+            m_nTop = ( m_nTop + 1 ) % SIZE;
+            if( m_nCount < SIZE )
+                m_nCount++;
+        };
+
+        inline const Entry_T& Pop()
+        {
+            TRT_ASSERT( m_nCount > 0 );
+            m_nTop = ( m_nTop + SIZE - 1 ) % SIZE;
+            m_nCount--;
+            return m_entries[m_nTop];
+        };
+
+    private:
+
+        Entry_T m_entries[SIZE];
+        uint m_nTop;
+        uint m_nCount;
+    };
+
+    template< class Entry_T >
+    class KDShortStack<Entry_T,0>
+    {
+    public:
+
+        inline bool IsEmpty() const { return true; };
+        inline uint GetSize() const { return 0; };
+        inline void Push( const Entry_T& ) {};
+    };
+
+    /// Pops the top entry of a short stack into 'rEntry'.  Returns false if the stack is empty
+    template< class Entry_T, int SIZE >
+    inline bool PopKDShortStack( KDShortStack<Entry_T,SIZE>& rStack, Entry_T& rEntry )
+    {
+        if( rStack.IsEmpty() )
+            return false;
+
+        rEntry = rStack.Pop();
+        return true;
+    }
+
+    /// A stack with a size of zero never holds anything, and has no Pop method
+    template< class Entry_T >
+    inline bool PopKDShortStack( KDShortStack<Entry_T,0>&, Entry_T& )
+    {
+        return false;
+    }
+
+    /// Stack entry used by RaycastKDTreeShortStack
+    template< class KDTree_T >
+    struct KDShortStackEntry
+    {
+        typename KDTree_T::ConstNodeHandle pNode;
+        float fTMin;
+        float fTMax;
+        uint nLevel;    ///< Number of nodes with two visited children on the path to this entry's parent
+    };
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Short-stack KD-Tree traversal kernel for rays in a particular octant
+    ///
+    ///  The far children which the ray must return to are kept in a small stack.  When the stack overflows, the oldest
+    ///   entry is discarded.  When the stack runs dry before the ray has left the tree, the traversal restarts from the 
+    ///   root.  A 'restart trail' (one bit per node on the current path whose children are both visited) records which 
+    ///   near children are finished, so that a restart resumes exactly where the discarded entry would have, and
+    ///   visits the leaves in the same order as RaycastKDTree.  This matters for flat cells, which a restart based only 
+    ///   on the ray distance would skip or revisit.  With a stack size of zero, this is a pure restart traversal, and the 
+    ///   traversal state between leaves is just the current node, the ray interval, and two 64-bit masks.
+    ///
+    ///  The restart trail holds one bit for each node on the path which has both children visited, so this kernel
+    ///   requires that the tree's stack depth is at most TRT_KD_RESTART_TRAIL_DEPTH.  RaycastKDTreeShortStack and RaycastKDTreeRestart check 
+    ///   this, and use RaycastKDTreeWithStack for deeper trees.
+    ///
+    /// \param rStats           Receives traversal statistics
+    /// \param OCTANT           The ray's octant, as returned by GetRayOctant
+    /// \param STACK_SIZE       Number of stack entries (0 for a pure restart traversal)
+    /// \param LeafIntersector_T  Leaf intersection policy (ScalarLeafIntersector or SimdLeafIntersector)
+    /// \param Mailbox_T        Must implement the Mailbox_C concept
+    /// \param KDTree_T         Must implement the KDTree_C concept
+    /// \param ObjectSet_T      Must implement the ObjectSet_C concept
+    /// \param HitInfo_T        Must implement the HitInfo_C concept
+    /// \param Ray_T            Must implement the Ray_C concept
+    /// \param Stats_T          Must implement the TraversalStats_C concept
+    //=====================================================================================================================
+    template< int OCTANT, int STACK_SIZE, class LeafIntersector_T, class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    void RaycastKDTreeShortStackOctant( const KDTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                                        typename KDTree_T::ConstNodeHandle pRoot, Stats_T& rStats )
+    {
+        Mailbox_T mailbox( pObjects );
+
+        typedef KDShortStackEntry<KDTree_T> StackEntry;
+        KDShortStack< StackEntry, STACK_SIZE > stack;
+
+        rStats.CountRay();
+        rStats.CountBoxTests( 1 );
+
+        const AxisAlignedBox& rBox = pTree->GetBoundingBox();
+        float fSceneTMin, fSceneTMax;
+        if( !RayAABBTestOctant<OCTANT>( rBox.Min(), rBox.Max(), rRay, fSceneTMin, fSceneTMax ) )
+            return;
+
+        float fRayMin = rRay.MinDistance();
+        float fRayMax = rRay.MaxDistance();
+        if( fSceneTMin < fRayMin )
+            fSceneTMin = fRayMin;
+        if( fSceneTMax > fRayMax )
+            fSceneTMax = fRayMax;
+
+        const Vec3f& rRayOrigin = rRay.Origin();
+        const Vec3f& rRayDirectionInv = rRay.InvDirection();
+
+        // The node intervals are always computed from the initial ray interval, even after hits shorten the ray, so that 
+        //  every restart makes the same decisions at the same nodes.  
+        uint64 nTrail = 0;      ///< Levels at which the near child is finished, and the far child is being visited
+        uint64 nPending = 0;    ///< Levels at which the far child has not been visited yet
+
+        typename KDTree_T::ConstNodeHandle pNode = pRoot;
+        float fTMin = fSceneTMin;
+        float fTMax = fSceneTMax;
+        uint nLevel = 0;
+        while( 1 )
+        {
+            if( pTree->IsNodeLeaf( pNode ) )
+            {
+                // intersect all objects in this leaf node, then proceed with next node from stack
+                typename KDTree_T::LeafIterator itBegin, itEnd;
+                pTree->GetNodeObjectList( pNode, itBegin, itEnd );
+
+                rStats.CountLeaf();
+                LeafIntersector_T::IntersectLeaf( pObjects, itBegin, itEnd, mailbox, rRay, rHitInfo, rStats );
+            }
+            else
+            {
+                rStats.CountInnerNode();
+
+                int axis     = pTree->GetNodeSplitAxis( pNode );
+                float fSplit = pTree->GetNodeSplitPosition( pNode );
+                float fO     = rRayOrigin[axis] ;
+                float fD     = rRayDirectionInv[axis];
+                float fTHit  = ( fSplit - fO ) * fD;
+
+                typename KDTree_T::ConstNodeHandle pLeft  = pTree->GetLeftChild(pNode);
+                typename KDTree_T::ConstNodeHandle pRight = pTree->GetRightChild(pNode);
+                bool bNegative = ( ( OCTANT >> axis ) & 1 ) != 0;
+                typename KDTree_T::ConstNodeHandle pNear = bNegative ? pRight : pLeft;
+                typename KDTree_T::ConstNodeHandle pFar  = bNegative ? pLeft : pRight;
+                    
+                if( fTHit > fTMax )
+                {
+                    // hit near only
+                    pNode = pNear;
+                    continue;
+                }
+                else if( fTHit < fTMin )
+                {
+                    // hit far only
+                    pNode = pFar;
+                    continue;
+                }
+                else
+                {
+                    // hit both
+                    TRT_ASSERT( nLevel < TRT_KD_RESTART_TRAIL_DEPTH );
+                    uint64 nLevelBit = static_cast<uint64>( 1 ) << nLevel;
+                    if( nTrail & nLevelBit )
+                    {
+                        // restarting, and the near child is already finished
+                        if( !rRay.IsDistanceValid( fTHit ) )
+                            return;
+
+                        pNode = pFar;
+                        fTMin = fTHit;
+                    }
+                    else
+                    {
+                        StackEntry entry;
+                        entry.pNode = pFar;
+                        entry.fTMin = fTHit;
+                        entry.fTMax = fTMax;
+                        entry.nLevel = nLevel;
+                        stack.Push( entry );
+                        rStats.CountStackDepth( stack.GetSize() );
+                        nPending |= nLevelBit;
+
+                        pNode = pNear;
+                        fTMax = fTHit;
+                    }
+
+                    nLevel++;
+                    continue;
+                }         
+            }
+
+            StackEntry entry;
+            if( PopKDShortStack( stack, entry ) )
+            {
+                // the entries are ordered along the ray, so if the nearest is beyond the ray depth limit, all of them are
+                if( !rRay.IsDistanceValid( entry.fTMin ) )
+                    return;
+
+                pNode = entry.pNode;
+                fTMin = entry.fTMin;
+                fTMax = entry.fTMax;
+                nLevel = entry.nLevel;
+            }
+            else
+            {
+                // the stack is empty.  The deepest pending level is the next one along the ray.  Restart from the root, 
+                //  and follow the trail to it
+                if( !nPending )
+                    return;
+
+                nLevel = TRT_KD_RESTART_TRAIL_DEPTH-1;
+                while( !( ( nPending >> nLevel ) & 1 ) )
+                    nLevel--;
+
+                pNode = pRoot;
+                fTMin = fSceneTMin;
+                fTMax = fSceneTMax;
+            }
+
+            // the near child at this level is now finished.  Deeper levels belong to the far child's subtree
+            uint64 nLevelBit = static_cast<uint64>( 1 ) << nLevel;
+            uint64 nDeeperBits = ~( nLevelBit | ( nLevelBit - 1 ) );
+            nTrail = ( nTrail & ~nDeeperBits ) | nLevelBit;
+            nPending &= ~( nLevelBit | nDeeperBits );
+            if( pNode != pRoot )
+                nLevel++;
+            else
+                nLevel = 0;
+
+        } // end of infinite traversal loop
+
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a KD-Tree, using a fixed-size traversal stack
+    ///  and a particular leaf intersection policy.  No scratch memory is needed.  The ray is traversed by the kernel 
+    ///  which is specialized for its octant.  Trees which are too deep for the restart trail are traversed by 
+    ///  RaycastKDTreeWithLeafIntersector instead, using a heap-allocated stack
+    /// \param rStats           Receives traversal statistics
+    /// \param STACK_SIZE       Number of stack entries (0 for a pure restart traversal)
+    /// \param LeafIntersector_T  Leaf intersection policy (ScalarLeafIntersector or SimdLeafIntersector)
+    /// \param Mailbox_T        Must implement the Mailbox_C concept
+    /// \param KDTree_T         Must implement the KDTree_C concept
+    /// \param ObjectSet_T      Must implement the ObjectSet_C concept
+    /// \param HitInfo_T        Must implement the HitInfo_C concept
+    /// \param Ray_T            Must implement the Ray_C concept
+    /// \param Stats_T          Must implement the TraversalStats_C concept
+    /// \sa RaycastKDTreeShortStackOctant
+    //=====================================================================================================================
+    template< int STACK_SIZE, class LeafIntersector_T, class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    void RaycastKDTreeShortStackWithLeafIntersector( const KDTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                                                     typename KDTree_T::ConstNodeHandle pRoot, Stats_T& rStats )
+    {
+        if( pTree->GetStackDepth() > TRT_KD_RESTART_TRAIL_DEPTH )
+        {
+            TraversalStack< KDStackEntry<KDTree_T>, TRT_INLINE_STACK_DEPTH > stack( pTree->GetStackDepth() );
+            KDStackEntry<KDTree_T>* pStack = stack;
+            RaycastKDTreeWithLeafIntersector<LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, pStack, rStats );
+            return;
+        }
+
+        switch( GetRayOctant( rRay ) )
+        {
+        case 0: RaycastKDTreeShortStackOctant<0,STACK_SIZE,LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, rStats ); break;
+        case 1: RaycastKDTreeShortStackOctant<1,STACK_SIZE,LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, rStats ); break;
+        case 2: RaycastKDTreeShortStackOctant<2,STACK_SIZE,LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, rStats ); break;
+        case 3: RaycastKDTreeShortStackOctant<3,STACK_SIZE,LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, rStats ); break;
+        case 4: RaycastKDTreeShortStackOctant<4,STACK_SIZE,LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, rStats ); break;
+        case 5: RaycastKDTreeShortStackOctant<5,STACK_SIZE,LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, rStats ); break;
+        case 6: RaycastKDTreeShortStackOctant<6,STACK_SIZE,LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, rStats ); break;
+        case 7: RaycastKDTreeShortStackOctant<7,STACK_SIZE,LeafIntersector_T,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, rStats ); break;
+        };
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a KD-Tree, using a fixed-size traversal stack,
+    ///  and records traversal statistics.  The objects in each leaf are tested one at a time
+    /// \param rStats           Receives traversal statistics
+    /// \param STACK_SIZE       Number of stack entries (0 for a pure restart traversal)
+    /// \param Stats_T          Must implement the TraversalStats_C concept
+    /// \sa RaycastKDTreeShortStackWithLeafIntersector
+    //=====================================================================================================================
+    template< int STACK_SIZE, class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    inline void RaycastKDTreeShortStack( const KDTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                                         typename KDTree_T::ConstNodeHandle pRoot, Stats_T& rStats )
+    {
+        RaycastKDTreeShortStackWithLeafIntersector<STACK_SIZE,ScalarLeafIntersector,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, rStats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a KD-Tree, using a fixed-size traversal stack
+    /// \sa RaycastKDTreeShortStackOctant
+    //=====================================================================================================================
+    template< int STACK_SIZE, class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastKDTreeShortStack( const KDTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                                         typename KDTree_T::ConstNodeHandle pRoot )
+    {
+        NullTraversalStats stats;
+        RaycastKDTreeShortStack<STACK_SIZE,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, stats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a KD-Tree, without a traversal stack ('kd-restart').
+    ///  Each time a leaf is left, the traversal restarts from the root.  Trees which are too deep for the restart trail 
+    ///  are traversed with a stack, as in RaycastKDTreeShortStack.  For other leaf intersection policies, use
+    ///  RaycastKDTreeShortStackWithLeafIntersector with a STACK_SIZE of 0
+    /// \sa RaycastKDTreeShortStackOctant
+    //=====================================================================================================================
+    template< class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastKDTreeRestart( const KDTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                                      typename KDTree_T::ConstNodeHandle pRoot )
+    {
+        NullTraversalStats stats;
+        RaycastKDTreeShortStack<0,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, stats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a KD-Tree, without a traversal stack, and records
+    ///  traversal statistics
+    /// \param Stats_T          Must implement the TraversalStats_C concept
+    //=====================================================================================================================
+    template< class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    inline void RaycastKDTreeRestart( const KDTree_T* pTree, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                                      typename KDTree_T::ConstNodeHandle pRoot, Stats_T& rStats )
+    {
+        RaycastKDTreeShortStack<0,Mailbox_T>( pTree, pObjects, rRay, rHitInfo, pRoot, rStats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Rope-based KD-Tree traversal kernel for rays in a particular octant
+    ///
+    ///  The ray descends from the root to the leaf containing its entry point.  After each leaf is intersected, the ray
+    ///   follows the rope for the face through which it leaves, and descends from the rope's node to the next leaf.  
+    ///   The traversal state between leaves is just the current leaf and the distance to its exit face.
+    ///
+    /// \param pRopes           Ropes for the tree.  These must have been built for the tree's current contents
+    /// \param rStats           Receives traversal statistics
+    /// \param OCTANT           The ray's octant, as returned by GetRayOctant
+    /// \param LeafIntersector_T  Leaf intersection policy (ScalarLeafIntersector or SimdLeafIntersector)
+    /// \param Mailbox_T        Must implement the Mailbox_C concept
+    /// \param KDTree_T         Must implement the KDTree_C concept
+    /// \param ObjectSet_T      Must implement the ObjectSet_C concept
+    /// \param HitInfo_T        Must implement the HitInfo_C concept
+    /// \param Ray_T            Must implement the Ray_C concept
+    /// \param Stats_T          Must implement the TraversalStats_C concept
+    //=====================================================================================================================
+    template< int OCTANT, class LeafIntersector_T, class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    void RaycastKDTreeRopesOctant( const KDTree_T* pTree, const KDTreeRopes<KDTree_T>* pRopes, const ObjectSet_T* pObjects, 
+                                   Ray_T& rRay, HitInfo_T& rHitInfo, Stats_T& rStats )
+    {
+        Mailbox_T mailbox( pObjects );
+
+        rStats.CountRay();
+        rStats.CountBoxTests( 1 );
+
+        const AxisAlignedBox& rBox = pTree->GetBoundingBox();
+        float fTMin, fTMax;
+        if( !RayAABBTestOctant<OCTANT>( rBox.Min(), rBox.Max(), rRay, fTMin, fTMax ) )
+            return;
+
+        float fRayMin = rRay.MinDistance();
+        float fRayMax = rRay.MaxDistance();
+        if( fTMin < fRayMin )
+            fTMin = fRayMin;
+        if( fTMax > fRayMax )
+            fTMax = fRayMax;
+
+        const Vec3f& rRayOrigin = rRay.Origin();
+        const Vec3f& rRayDirectionInv = rRay.InvDirection();
+
+        typename KDTree_T::ConstNodeHandle pNode = pTree->GetRoot();
+        while( 1 )
+        {
+            // descend to the leaf which contains the ray at fTMin.  Ties go to the near child, as in RaycastKDTree
+            while( !pTree->IsNodeLeaf( pNode ) )
+            {
+                rStats.CountInnerNode();
+
+                int axis     = pTree->GetNodeSplitAxis( pNode );
+                float fSplit = pTree->GetNodeSplitPosition( pNode );
+                float fTHit  = ( fSplit - rRayOrigin[axis] ) * rRayDirectionInv[axis];
+
+                bool bNegative = ( ( OCTANT >> axis ) & 1 ) != 0;
+                if( ( fTHit < fTMin ) != bNegative )
+                    pNode = pTree->GetRightChild( pNode );
+                else
+                    pNode = pTree->GetLeftChild( pNode );
+            }
+
+            // intersect all objects in this leaf node
+            typename KDTree_T::LeafIterator itBegin, itEnd;
+            pTree->GetNodeObjectList( pNode, itBegin, itEnd );
+
+            rStats.CountLeaf();
+            LeafIntersector_T::IntersectLeaf( pObjects, itBegin, itEnd, mailbox, rRay, rHitInfo, rStats );
+
+            // find the face through which the ray leaves the leaf.  Faces which the ray never reaches yield NaN or infinity.
+            //  A face at exactly the end of the ray interval is still followed, so that flat cells there are not skipped
+            const AxisAlignedBox& rLeafBox = pRopes->GetLeafAABB( pNode );
+            float fTExit = fTMax;
+            int nExitFace = -1;
+            for( int axis=0; axis<3; axis++ )
+            {
+                bool bNegative = ( ( OCTANT >> axis ) & 1 ) != 0;
+                float fPlane = bNegative ? rLeafBox.Min()[axis] : rLeafBox.Max()[axis];
+                float fT = ( fPlane - rRayOrigin[axis] ) * rRayDirectionInv[axis];
+                if( fT <= fTExit )
+                {
+                    fTExit = fT;
+                    nExitFace = 2*axis + ( bNegative ? 0 : 1 );
+                }
+            }
+
+            // stop if the ray leaves the tree, or has hit something before leaving the leaf
+            if( nExitFace == -1 || !rRay.IsDistanceValid( fTExit ) )
+                return;
+
+            pNode = pRopes->GetRope( pNode, nExitFace );
+            if( pNode == KDTreeRopes<KDTree_T>::NO_ROPE )
+                return;
+
+            fTMin = fTExit;
+        }
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a KD-Tree, by following the ropes between leaves,
+    ///  using a particular leaf intersection policy.  No traversal stack is needed.  The ray is traversed by the kernel 
+    ///  which is specialized for its octant
+    /// \param pRopes           Ropes for the tree.  These must have been built for the tree's current contents
+    /// \param rStats           Receives traversal statistics
+    /// \param LeafIntersector_T  Leaf intersection policy (ScalarLeafIntersector or SimdLeafIntersector)
+    /// \param Mailbox_T        Must implement the Mailbox_C concept
+    /// \param KDTree_T         Must implement the KDTree_C concept
+    /// \param ObjectSet_T      Must implement the ObjectSet_C concept
+    /// \param HitInfo_T        Must implement the HitInfo_C concept
+    /// \param Ray_T            Must implement the Ray_C concept
+    /// \param Stats_T          Must implement the TraversalStats_C concept
+    /// \sa RaycastKDTreeRopesOctant
+    //=====================================================================================================================
+    template< class LeafIntersector_T, class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    void RaycastKDTreeRopesWithLeafIntersector( const KDTree_T* pTree, const KDTreeRopes<KDTree_T>* pRopes, const ObjectSet_T* pObjects, 
+                                                Ray_T& rRay, HitInfo_T& rHitInfo, Stats_T& rStats )
+    {
+        switch( GetRayOctant( rRay ) )
+        {
+        case 0: RaycastKDTreeRopesOctant<0,LeafIntersector_T,Mailbox_T>( pTree, pRopes, pObjects, rRay, rHitInfo, rStats ); break;
+        case 1: RaycastKDTreeRopesOctant<1,LeafIntersector_T,Mailbox_T>( pTree, pRopes, pObjects, rRay, rHitInfo, rStats ); break;
+        case 2: RaycastKDTreeRopesOctant<2,LeafIntersector_T,Mailbox_T>( pTree, pRopes, pObjects, rRay, rHitInfo, rStats ); break;
+        case 3: RaycastKDTreeRopesOctant<3,LeafIntersector_T,Mailbox_T>( pTree, pRopes, pObjects, rRay, rHitInfo, rStats ); break;
+        case 4: RaycastKDTreeRopesOctant<4,LeafIntersector_T,Mailbox_T>( pTree, pRopes, pObjects, rRay, rHitInfo, rStats ); break;
+        case 5: RaycastKDTreeRopesOctant<5,LeafIntersector_T,Mailbox_T>( pTree, pRopes, pObjects, rRay, rHitInfo, rStats ); break;
+        case 6: RaycastKDTreeRopesOctant<6,LeafIntersector_T,Mailbox_T>( pTree, pRopes, pObjects, rRay, rHitInfo, rStats ); break;
+        case 7: RaycastKDTreeRopesOctant<7,LeafIntersector_T,Mailbox_T>( pTree, pRopes, pObjects, rRay, rHitInfo, rStats ); break;
+        };
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a KD-Tree, by following the ropes between leaves,
+    ///  and records traversal statistics.  The objects in each leaf are tested one at a time
+    /// \param pRopes           Ropes for the tree.  These must have been built for the tree's current contents
+    /// \param rStats           Receives traversal statistics
+    /// \param Stats_T          Must implement the TraversalStats_C concept
+    /// \sa RaycastKDTreeRopesWithLeafIntersector
+    //=====================================================================================================================
+    template< class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    inline void RaycastKDTreeRopes( const KDTree_T* pTree, const KDTreeRopes<KDTree_T>* pRopes, const ObjectSet_T* pObjects, 
+                                    Ray_T& rRay, HitInfo_T& rHitInfo, Stats_T& rStats )
+    {
+        RaycastKDTreeRopesWithLeafIntersector<ScalarLeafIntersector,Mailbox_T>( pTree, pRopes, pObjects, rRay, rHitInfo, rStats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in a KD-Tree, by following the ropes between leaves
+    /// \sa RaycastKDTreeRopesOctant
+    //=====================================================================================================================
+    template< class Mailbox_T, typename KDTree_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastKDTreeRopes( const KDTree_T* pTree, const KDTreeRopes<KDTree_T>* pRopes, const ObjectSet_T* pObjects, 
+                                    Ray_T& rRay, HitInfo_T& rHitInfo )
+    {
+        NullTraversalStats stats;
+        RaycastKDTreeRopes<Mailbox_T>( pTree, pRopes, pObjects, rRay, rHitInfo, stats );
+    }
 }
 #endif // _TRTKDTRAVERSAL_H_
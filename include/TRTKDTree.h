@@ -24,9 +24,10 @@ namespace TinyRT
     /// \brief A basic KDTree implementation
     ///
     /// This class implements the KDTree_C concept
-    /// \param ObjectSet_T Must implement the ObjectSet_C concept
+    /// \param ObjectSet_T     Must implement the ObjectSet_C concept
+    /// \param HandleTraits_T  Selects the width of node handles and links.  Either CompactTreeHandles or LargeTreeHandles
     //=====================================================================================================================
-    template< class ObjectSet_T >
+    template< class ObjectSet_T, class HandleTraits_T = CompactTreeHandles >
     class KDTree
     {
 
@@ -36,28 +37,36 @@ namespace TinyRT
         typedef typename ObjectSet_T::obj_id obj_id;
         typedef const obj_id* LeafIterator; ///< Type that acts as an iterator over objects in a leaf
 
+        typedef typename HandleTraits_T::Handle NodeHandle;
+        typedef typename HandleTraits_T::Handle ConstNodeHandle;
+
         /// A node in a KD-tree
         class Node
         {
         public:
+
+            /// Number of bits available for child links and object indices
+            enum { LINK_BITS = sizeof(NodeHandle)*8 - 2 };
             
             inline float GetSplitPosition() const { return m_fSplitPlane; };
-            inline uint GetSplitAxis() const { return m_nSplitAxis; };
+            inline uint GetSplitAxis() const { return static_cast<uint>( m_nSplitAxis ); };
             inline bool IsLeaf() const { return m_nSplitAxis == 3; };
             inline uint GetObjectCount() const { return m_nObjCount; };
-            inline uint GetFirstObject() const { return m_nLeftChildOrFirstObj; };
-            inline uint GetChildren() const { return m_nLeftChildOrFirstObj; };
+            inline NodeHandle GetFirstObject() const { return m_nLeftChildOrFirstObj; };
+            inline NodeHandle GetChildren() const { return m_nLeftChildOrFirstObj; };
             inline Node* GetChildren() { return this + m_nLeftChildOrFirstObj; };
 
-            inline void MakeInnerNode( uint nLeftChild, float fSplit, uint nSplitAxis )
+            inline void MakeInnerNode( NodeHandle nLeftChild, float fSplit, uint nSplitAxis )
             {
+                TRT_ASSERT( ( nLeftChild >> LINK_BITS ) == 0 ); // tree is too large for its handle type
                 m_fSplitPlane = fSplit;
                 m_nSplitAxis = nSplitAxis;
                 m_nLeftChildOrFirstObj = nLeftChild;
             }
 
-            inline void MakeLeafNode( uint nFirstObj, uint nObjCount )
+            inline void MakeLeafNode( NodeHandle nFirstObj, uint nObjCount )
             {
+                TRT_ASSERT( ( nFirstObj >> LINK_BITS ) == 0 ); // tree is too large for its handle type
                 m_nObjCount = nObjCount;
                 m_nLeftChildOrFirstObj = nFirstObj;
                 m_nSplitAxis = 3;
@@ -72,13 +81,10 @@ namespace TinyRT
             };
 
              
-            unsigned m_nLeftChildOrFirstObj : 30;     ///< Offset of first child (if an inner node), or index of first object (if leaf)
-            unsigned m_nSplitAxis : 2;                ///< Split axis (a value of 3 indicates a leaf)
+            NodeHandle m_nLeftChildOrFirstObj : LINK_BITS;  ///< Offset of first child (if an inner node), or index of first object (if leaf)
+            NodeHandle m_nSplitAxis : 2;                    ///< Split axis (a value of 3 indicates a leaf)
         };
 
-        typedef uint NodeHandle;
-        typedef uint ConstNodeHandle;
-
         inline KDTree( );
 
         /// Returns the root node of the tree
@@ -139,9 +145,10 @@ namespace TinyRT
         /// Turns the specified node into a leaf containing the given set of object references.  Returns an object ref array which the caller must fill
         inline obj_id* MakeLeafNode( NodeHandle n, obj_id nObjCount ) ;
 
-        /// Constructs a new KD tree
+        /// \brief Constructs a new KD tree.  Returns false if the tree is too large for its handle type
+        /// In that case, the tree is left empty, and must be built again using LargeTreeHandles
         template< class KDTreeBuilder_T >
-        inline void Build( ObjectSet_T* pObjects, KDTreeBuilder_T& rBuilder );
+        inline bool Build( ObjectSet_T* pObjects, KDTreeBuilder_T& rBuilder );
 
         /// Returns the memory usage of the tree
         inline void GetMemoryUsage( size_t& rnBytesUsed, size_t& rnBytesAllocated ) const
@@ -154,6 +161,18 @@ namespace TinyRT
         /// Sanity-checks the tree
         inline bool Validate( );
 
+        /// \brief Writes the tree to a file, which may later be used with 'Attach'.  Returns false if the file could not be written
+        /// An object remap table (see RemapRecorder) may be stored along with the tree, though KD tree construction does not re-order objects
+        bool Save( const char* pFileName, const obj_id* pObjectRemap = NULL, obj_id nObjects = 0 ) const;
+
+        /// \brief Writes the tree to a memory buffer, in the same format as 'Save'.  Returns the number of bytes required
+        /// If the buffer is NULL or too small, nothing is written.  The buffer may be passed to 'Attach'
+        size_t SaveToBuffer( void* pBuffer, size_t nBufferSize, const obj_id* pObjectRemap = NULL, obj_id nObjects = 0 ) const;
+
+        /// \brief Uses a tree written by 'Save', in place.  Returns false if the data is not a valid KD tree
+        /// The data is not copied, and must remain valid until the tree is destroyed or rebuilt.  The data may be read-only
+        bool Attach( const void* pData, size_t nSize );
+
         /// Provides direct access to the nodes
         inline const Node* GetNodes() const { return &m_pNodes[0]; };
 
@@ -169,16 +188,24 @@ namespace TinyRT
 
     private:
 
+        /// Fills in the header and section list used by 'Save' and 'SaveToBuffer'
+        void GetSerializedSections( SerializedTreeHeader& rHeader, const void* pSections[SERIALIZED_SECTION_COUNT],
+                                    const obj_id* pObjectRemap, obj_id nObjects ) const;
+
         AxisAlignedBox m_aabb;
         size_t m_nStackDepth;
 
-        ScopedArray<Node> m_pNodes;
+        const Node* m_pNodes;                   ///< Points at either 'm_nodeStorage', or an attached file
         size_t m_nNodesInUse;
-        size_t m_nNodeArraySize;
+        size_t m_nNodeArraySize;                ///< Size of 'm_nodeStorage'.  Zero if the nodes belong to an attached file
 
-        ScopedArray<obj_id> m_pObjectRefs;
+        const obj_id* m_pObjectRefs;            ///< Points at either 'm_objectRefStorage', or an attached file
         size_t m_nObjectRefsInUse;
-        size_t m_nObjectRefArraySize;
+        size_t m_nObjectRefArraySize;           ///< Size of 'm_objectRefStorage'.  Zero if the refs belong to an attached file
+        bool m_bHandleOverflow;                 ///< Set during construction if a link does not fit in Node::LINK_BITS
+
+        ScopedArray<Node> m_nodeStorage;
+        ScopedArray<obj_id> m_objectRefStorage;
 
     };
     
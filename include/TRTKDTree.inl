@@ -23,12 +23,15 @@ namespace TinyRT
     //
     //=====================================================================================================================
     
-    template< class ObjectSet_T >
-    KDTree<ObjectSet_T>::KDTree() :
+    template< class ObjectSet_T, class HandleTraits_T >
+    KDTree<ObjectSet_T,HandleTraits_T>::KDTree() :
+        m_pNodes(0),
         m_nNodesInUse(0), 
         m_nNodeArraySize(0), 
+        m_pObjectRefs(0),
         m_nObjectRefsInUse(0), 
-        m_nObjectRefArraySize(0)
+        m_nObjectRefArraySize(0),
+        m_bHandleOverflow(false)
     {
     }
 
@@ -40,16 +43,19 @@ namespace TinyRT
     
     //=====================================================================================================================
     //=====================================================================================================================
-    template< class ObjectSet_T >
-    typename KDTree<ObjectSet_T>::NodeHandle KDTree<ObjectSet_T>::Initialize( const AxisAlignedBox& rRootAABB )
+    template< class ObjectSet_T, class HandleTraits_T >
+    typename KDTree<ObjectSet_T,HandleTraits_T>::NodeHandle KDTree<ObjectSet_T,HandleTraits_T>::Initialize( const AxisAlignedBox& rRootAABB )
     {
         if( m_nNodeArraySize < 1 )
         {
-            m_pNodes.resize( 100, m_nNodeArraySize );
+            m_nodeStorage.resize( 100, m_nNodeArraySize );
             m_nNodeArraySize = 100;
         }
 
-        m_pNodes[0].MakeLeafNode(0,0);
+        m_pNodes = m_nodeStorage;
+        m_pObjectRefs = m_objectRefStorage;
+
+        m_nodeStorage[0].MakeLeafNode(0,0);
         m_nNodesInUse = 1;
         m_nObjectRefsInUse = 0;
         m_aabb = rRootAABB;
@@ -58,59 +64,87 @@ namespace TinyRT
 
     //=====================================================================================================================
     //=====================================================================================================================
-    template< class ObjectSet_T >
-    std::pair< typename KDTree<ObjectSet_T>::NodeHandle, typename KDTree<ObjectSet_T>::NodeHandle > 
-        KDTree<ObjectSet_T>::MakeInnerNode( NodeHandle hNode, float fSplitPlane, uint nSplitAxis )
+    template< class ObjectSet_T, class HandleTraits_T >
+    std::pair< typename KDTree<ObjectSet_T,HandleTraits_T>::NodeHandle, typename KDTree<ObjectSet_T,HandleTraits_T>::NodeHandle > 
+        KDTree<ObjectSet_T,HandleTraits_T>::MakeInnerNode( NodeHandle hNode, float fSplitPlane, uint nSplitAxis )
     {
         m_nNodesInUse += 2;
         if( m_nNodeArraySize < m_nNodesInUse )
         {
-            uint nNewSize = std::max( m_nNodeArraySize*2, m_nNodesInUse );
-            m_pNodes.resize( nNewSize, m_nNodeArraySize );
+            size_t nNewSize = std::max( m_nNodeArraySize*2, m_nNodesInUse );
+            m_nodeStorage.resize( nNewSize, m_nNodeArraySize );
             m_nNodeArraySize = nNewSize;
+            m_pNodes = m_nodeStorage;
         }
 
-        NodeHandle hLeft = m_nNodesInUse - 2;
-        m_pNodes[hNode].MakeInnerNode( hLeft, fSplitPlane, nSplitAxis );
+        // if the link does not fit, the build carries on, so that the builder's handles stay valid, but fails at the end
+        NodeHandle hLeft = static_cast<NodeHandle>( m_nNodesInUse - 2 );
+        if( ( static_cast<uint64>( m_nNodesInUse - 2 ) >> Node::LINK_BITS ) != 0 )
+        {
+            m_bHandleOverflow = true;
+            m_nodeStorage[hNode].MakeInnerNode( 0, fSplitPlane, nSplitAxis );
+        }
+        else
+        {
+            m_nodeStorage[hNode].MakeInnerNode( hLeft, fSplitPlane, nSplitAxis );
+        }
 
         return std::pair< NodeHandle, NodeHandle > ( hLeft, hLeft+1 );
     }
 
     //=====================================================================================================================
     //=====================================================================================================================
-    template< class ObjectSet_T >
-    typename KDTree<ObjectSet_T>::obj_id* KDTree<ObjectSet_T>::MakeLeafNode( typename KDTree<ObjectSet_T>::NodeHandle n, 
-                                                                             typename KDTree<ObjectSet_T>::obj_id nObjCount )
+    template< class ObjectSet_T, class HandleTraits_T >
+    typename KDTree<ObjectSet_T,HandleTraits_T>::obj_id* KDTree<ObjectSet_T,HandleTraits_T>::MakeLeafNode( typename KDTree<ObjectSet_T,HandleTraits_T>::NodeHandle n, 
+                                                                                                           typename KDTree<ObjectSet_T,HandleTraits_T>::obj_id nObjCount )
     {
-        uint nStart = m_nObjectRefsInUse;
+        size_t nStart = m_nObjectRefsInUse;
         m_nObjectRefsInUse += nObjCount;
 
         if( m_nObjectRefArraySize < m_nObjectRefsInUse )
         {
-            uint nNewSize = std::max( m_nObjectRefArraySize*2, m_nObjectRefsInUse );
-            m_pObjectRefs.resize( nNewSize, m_nObjectRefArraySize );
+            size_t nNewSize = std::max( m_nObjectRefArraySize*2, m_nObjectRefsInUse );
+            m_objectRefStorage.resize( nNewSize, m_nObjectRefArraySize );
             m_nObjectRefArraySize = nNewSize;
+            m_pObjectRefs = m_objectRefStorage;
         }
 
-        m_pNodes[n].MakeLeafNode( nStart, nObjCount );
-        return &m_pObjectRefs[nStart];
+        if( ( static_cast<uint64>( nStart ) >> Node::LINK_BITS ) != 0 )
+        {
+            m_bHandleOverflow = true;
+            m_nodeStorage[n].MakeLeafNode( 0, 0 );
+        }
+        else
+        {
+            m_nodeStorage[n].MakeLeafNode( static_cast<NodeHandle>( nStart ), nObjCount );
+        }
+        return &m_objectRefStorage[nStart];
     }
 
     //=====================================================================================================================
     //=====================================================================================================================
-    template< class ObjectSet_T >
+    template< class ObjectSet_T, class HandleTraits_T >
     template< class KDTreeBuilder_T >
-    void KDTree<ObjectSet_T>::Build( ObjectSet_T* pObjects, KDTreeBuilder_T& rBuilder )
+    bool KDTree<ObjectSet_T,HandleTraits_T>::Build( ObjectSet_T* pObjects, KDTreeBuilder_T& rBuilder )
     {
+        m_bHandleOverflow = false;
         m_nStackDepth = rBuilder.BuildTree( pObjects, this );
+        if( !m_bHandleOverflow )
+            return true;
+
+        // the tree is too large for its handle type.  Leave an empty tree behind, which no ray will hit anything in
+        Initialize( m_aabb );
+        m_nStackDepth = 1;
+        m_bHandleOverflow = false;
+        return false;
     }
 
     //=====================================================================================================================
     //=====================================================================================================================
-    template< class ObjectSet_T >
-    bool KDTree<ObjectSet_T>::Validate()
+    template< class ObjectSet_T, class HandleTraits_T >
+    bool KDTree<ObjectSet_T,HandleTraits_T>::Validate()
     {
-        for( uint i=0; i<m_nNodesInUse; i++ )
+        for( size_t i=0; i<m_nNodesInUse; i++ )
         {
             const Node* pN = &m_pNodes[i];
             if( pN->IsLeaf() )
@@ -128,6 +162,71 @@ namespace TinyRT
         return true;
     }
 
+    //=====================================================================================================================
+    /// \param pFileName     Name of the file to write
+    /// \param pObjectRemap  Optional remap table, as returned by RemapRecorder::GetRemap
+    /// \param nObjects      Number of entries in the remap table
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T >
+    bool KDTree<ObjectSet_T,HandleTraits_T>::Save( const char* pFileName, const obj_id* pObjectRemap, obj_id nObjects ) const
+    {
+        SerializedTreeHeader header;
+        const void* pSections[SERIALIZED_SECTION_COUNT] = { NULL };
+        GetSerializedSections( header, pSections, pObjectRemap, nObjects );
+        return WriteSerializedTree( pFileName, header, pSections );
+    }
+
+    //=====================================================================================================================
+    /// \param pBuffer       Buffer to receive the tree.  Must be aligned to TRT_SIMD_ALIGNMENT if it is to be attached
+    /// \param nBufferSize   Size of the buffer
+    /// \param pObjectRemap  Optional remap table, as returned by RemapRecorder::GetRemap
+    /// \param nObjects      Number of entries in the remap table
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T >
+    size_t KDTree<ObjectSet_T,HandleTraits_T>::SaveToBuffer( void* pBuffer, size_t nBufferSize, const obj_id* pObjectRemap, obj_id nObjects ) const
+    {
+        SerializedTreeHeader header;
+        const void* pSections[SERIALIZED_SECTION_COUNT] = { NULL };
+        GetSerializedSections( header, pSections, pObjectRemap, nObjects );
+        return CopySerializedTree( pBuffer, nBufferSize, header, pSections );
+    }
+
+    //=====================================================================================================================
+    /// \param pData    Start of the data written by 'Save' (typically a memory mapped file).  Must be aligned to TRT_SIMD_ALIGNMENT
+    /// \param nSize    Size of the data
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T >
+    bool KDTree<ObjectSet_T,HandleTraits_T>::Attach( const void* pData, size_t nSize )
+    {
+        const SerializedTreeHeader* pHeader = ReadSerializedTreeHeader( pData, nSize, SERIALIZED_KDTREE, sizeof(Node), sizeof(obj_id) );
+        if( !pHeader )
+            return false;
+
+        size_t nNodeBytes, nRefBytes;
+        const void* pNodes = GetSerializedSection( pHeader, SERIALIZED_SECTION_NODES, nNodeBytes );
+        const void* pRefs = GetSerializedSection( pHeader, SERIALIZED_SECTION_LEAVES, nRefBytes );
+        // the high halves of the counts are only non-zero for trees which use LargeTreeHandles
+        size_t nNodes = static_cast<size_t>( pHeader->nParams[0] | ( static_cast<uint64>( pHeader->nParams[2] ) << 32 ) );
+        size_t nRefs = static_cast<size_t>( pHeader->nParams[1] | ( static_cast<uint64>( pHeader->nParams[3] ) << 32 ) );
+        if( !pNodes || nNodes == 0 || nNodeBytes != nNodes*sizeof(Node) || nRefBytes != nRefs*sizeof(obj_id) )
+            return false;
+
+        // release any nodes from a previous build
+        m_nodeStorage.reallocate( 0 );
+        m_objectRefStorage.reallocate( 0 );
+        m_nNodeArraySize = 0;
+        m_nObjectRefArraySize = 0;
+
+        m_pNodes = reinterpret_cast<const Node*>( pNodes );
+        m_pObjectRefs = reinterpret_cast<const obj_id*>( pRefs );
+        m_nNodesInUse = nNodes;
+        m_nObjectRefsInUse = nRefs;
+        m_nStackDepth = pHeader->nStackDepth;
+        m_aabb = AxisAlignedBox( Vec3f( pHeader->fBox[0], pHeader->fBox[1], pHeader->fBox[2] ),
+                                 Vec3f( pHeader->fBox[3], pHeader->fBox[4], pHeader->fBox[5] ) );
+        return true;
+    }
+
 
     //=====================================================================================================================
     //
@@ -140,5 +239,34 @@ namespace TinyRT
     //            Private Methods
     //
     //=====================================================================================================================
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T >
+    void KDTree<ObjectSet_T,HandleTraits_T>::GetSerializedSections( SerializedTreeHeader& rHeader, const void* pSections[SERIALIZED_SECTION_COUNT],
+                                                                    const obj_id* pObjectRemap, obj_id nObjects ) const
+    {
+        memset( &rHeader, 0, sizeof(rHeader) );
+        rHeader.nStructureType = SERIALIZED_KDTREE;
+        rHeader.nObjIdSize = sizeof(obj_id);
+        rHeader.nNodeSize = sizeof(Node);
+        rHeader.nStackDepth = static_cast<uint32>( m_nStackDepth );
+        rHeader.nParams[0] = static_cast<uint32>( m_nNodesInUse );
+        rHeader.nParams[1] = static_cast<uint32>( m_nObjectRefsInUse );
+        rHeader.nParams[2] = static_cast<uint32>( static_cast<uint64>( m_nNodesInUse ) >> 32 );
+        rHeader.nParams[3] = static_cast<uint32>( static_cast<uint64>( m_nObjectRefsInUse ) >> 32 );
+        for( uint i=0; i<3; i++ )
+        {
+            rHeader.fBox[i]   = m_aabb.Min()[i];
+            rHeader.fBox[i+3] = m_aabb.Max()[i];
+        }
+        rHeader.sections[SERIALIZED_SECTION_NODES].nSize = m_nNodesInUse*sizeof(Node);
+        rHeader.sections[SERIALIZED_SECTION_LEAVES].nSize = m_nObjectRefsInUse*sizeof(obj_id);
+        rHeader.sections[SERIALIZED_SECTION_REMAP].nSize = nObjects*sizeof(obj_id);
+
+        pSections[SERIALIZED_SECTION_NODES] = m_pNodes;
+        pSections[SERIALIZED_SECTION_LEAVES] = m_pObjectRefs;
+        pSections[SERIALIZED_SECTION_REMAP] = pObjectRemap;
+    }
 }
 
@@ -0,0 +1,98 @@
+//=====================================================================================================================
+//
+//   TRTKDTreeRopes.h
+//
+//   Definition of class: TinyRT::KDTreeRopes
+//
+//   Part of the TinyRT raytracing library.
+//   Author: Joshua Barczak
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRTKDTREEROPES_H_
+#define _TRTKDTREEROPES_H_
+
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Neighbor links ('ropes') for the leaves of a KD tree
+    ///
+    ///  Each leaf stores its bounding box, and a rope for each of its six faces.  A rope points to the deepest node whose
+    ///   cell contains the entire face, on the other side of it.  Faces which lie on the boundary of the tree have no rope.
+    ///   RaycastKDTreeRopes uses these to step from leaf to leaf without a traversal stack.
+    ///
+    ///  The ropes are kept separately from the tree, so that the tree's node layout and file format are unchanged.  The
+    ///   ropes must be rebuilt whenever the tree is.
+    ///
+    /// \param KDTree_T  Must implement the KDTree_C concept.  Node handles must be indices less than 'GetNodeCount()'
+    //=====================================================================================================================
+    template< class KDTree_T >
+    class KDTreeRopes
+    {
+    public:
+
+        typedef typename KDTree_T::ConstNodeHandle ConstNodeHandle;
+
+        /// Face indices are 2*axis for the min face, and 2*axis+1 for the max face
+        enum { FACE_COUNT = 6 };
+
+        /// Value of a rope for a face on the boundary of the tree
+        static const ConstNodeHandle NO_ROPE = static_cast<ConstNodeHandle>( ~0 );
+
+        inline KDTreeRopes( ) {};
+
+        /// Constructs ropes for all leaves of a tree
+        void Build( const KDTree_T* pTree );
+
+        /// Returns the rope for a particular face of a leaf
+        inline ConstNodeHandle GetRope( ConstNodeHandle hLeaf, uint nFace ) const 
+        { 
+            TRT_ASSERT( hLeaf < m_leafIndices.size() && m_leafIndices[hLeaf] != NO_LEAF && nFace < FACE_COUNT );
+            return m_leaves[ m_leafIndices[hLeaf] ].ropes[nFace]; 
+        };
+
+        /// Returns the cell of a particular leaf
+        inline const AxisAlignedBox& GetLeafAABB( ConstNodeHandle hLeaf ) const 
+        { 
+            TRT_ASSERT( hLeaf < m_leafIndices.size() && m_leafIndices[hLeaf] != NO_LEAF );
+            return m_leaves[ m_leafIndices[hLeaf] ].box; 
+        };
+
+        /// Returns the memory usage of the ropes
+        inline void GetMemoryUsage( size_t& rnBytesUsed, size_t& rnBytesAllocated ) const
+        {
+            rnBytesUsed = sizeof(KDTreeRopes) + m_leafIndices.size()*sizeof(uint32) + m_leaves.size()*sizeof(Leaf);
+            rnBytesAllocated = sizeof(KDTreeRopes) + m_leafIndices.capacity()*sizeof(uint32) + m_leaves.capacity()*sizeof(Leaf);
+        };
+
+    private:
+
+        static const uint32 NO_LEAF = 0xffffffff;
+
+        struct Leaf
+        {
+            AxisAlignedBox box;
+            ConstNodeHandle ropes[FACE_COUNT];
+        };
+
+        /// Records the ropes for the leaves beneath a node
+        void BuildRecurse( const KDTree_T* pTree, ConstNodeHandle hNode, const AxisAlignedBox& rBox, const ConstNodeHandle ropes[FACE_COUNT] );
+
+        /// Moves each rope down to the deepest node whose cell still contains the corresponding face of a box
+        static void PushRopesDown( const KDTree_T* pTree, const AxisAlignedBox& rBox, ConstNodeHandle ropes[FACE_COUNT] );
+
+        std::vector<uint32> m_leafIndices;  ///< Index of each node in 'm_leaves', or NO_LEAF for inner nodes
+        std::vector<Leaf> m_leaves;
+    };
+
+}
+
+#include "TRTKDTreeRopes.inl"
+
+#endif // _TRTKDTREEROPES_H_
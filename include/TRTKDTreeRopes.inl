@@ -0,0 +1,133 @@
+//=====================================================================================================================
+//
+//   TRTKDTreeRopes.inl
+//
+//   Implementation of class: TinyRT::KDTreeRopes
+//
+//   Part of the TinyRT raytracing library.
+//   Author: Joshua Barczak
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    //
+    //            Public Methods
+    //
+    //=====================================================================================================================
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class KDTree_T >
+    void KDTreeRopes<KDTree_T>::Build( const KDTree_T* pTree )
+    {
+        m_leafIndices.clear();
+        m_leafIndices.resize( pTree->GetNodeCount(), static_cast<uint32>( NO_LEAF ) );
+        m_leaves.clear();
+
+        ConstNodeHandle ropes[FACE_COUNT];
+        for( uint i=0; i<FACE_COUNT; i++ )
+            ropes[i] = NO_ROPE;
+
+        BuildRecurse( pTree, pTree->GetRoot(), pTree->GetBoundingBox(), ropes );
+    }
+
+    //=====================================================================================================================
+    //
+    //            Private Methods
+    //
+    //=====================================================================================================================
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class KDTree_T >
+    void KDTreeRopes<KDTree_T>::BuildRecurse( const KDTree_T* pTree, ConstNodeHandle hNode, const AxisAlignedBox& rBox, 
+                                              const ConstNodeHandle ropes[FACE_COUNT] )
+    {
+        ConstNodeHandle nodeRopes[FACE_COUNT];
+        for( uint i=0; i<FACE_COUNT; i++ )
+            nodeRopes[i] = ropes[i];
+        PushRopesDown( pTree, rBox, nodeRopes );
+
+        if( pTree->IsNodeLeaf( hNode ) )
+        {
+            Leaf leaf;
+            leaf.box = rBox;
+            for( uint i=0; i<FACE_COUNT; i++ )
+                leaf.ropes[i] = nodeRopes[i];
+
+            m_leafIndices[hNode] = static_cast<uint32>( m_leaves.size() );
+            m_leaves.push_back( leaf );
+            return;
+        }
+
+        uint nAxis = pTree->GetNodeSplitAxis( hNode );
+        float fSplit = pTree->GetNodeSplitPosition( hNode );
+        ConstNodeHandle hLeft = pTree->GetLeftChild( hNode );
+        ConstNodeHandle hRight = pTree->GetRightChild( hNode );
+
+        // the children are each other's neighbors across the split plane
+        AxisAlignedBox leftBox = rBox;
+        leftBox.Max()[nAxis] = fSplit;
+
+        ConstNodeHandle childRopes[FACE_COUNT];
+        for( uint i=0; i<FACE_COUNT; i++ )
+            childRopes[i] = nodeRopes[i];
+        childRopes[2*nAxis+1] = hRight;
+        BuildRecurse( pTree, hLeft, leftBox, childRopes );
+
+        AxisAlignedBox rightBox = rBox;
+        rightBox.Min()[nAxis] = fSplit;
+
+        childRopes[2*nAxis+1] = nodeRopes[2*nAxis+1];
+        childRopes[2*nAxis] = hLeft;
+        BuildRecurse( pTree, hRight, rightBox, childRopes );
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class KDTree_T >
+    void KDTreeRopes<KDTree_T>::PushRopesDown( const KDTree_T* pTree, const AxisAlignedBox& rBox, ConstNodeHandle ropes[FACE_COUNT] )
+    {
+        for( uint nFace=0; nFace<FACE_COUNT; nFace++ )
+        {
+            ConstNodeHandle hRope = ropes[nFace];
+            if( hRope == NO_ROPE )
+                continue;
+
+            uint nFaceAxis = nFace / 2;
+            bool bMaxFace = ( nFace & 1 ) != 0;
+            while( !pTree->IsNodeLeaf( hRope ) )
+            {
+                uint nAxis = pTree->GetNodeSplitAxis( hRope );
+                float fSplit = pTree->GetNodeSplitPosition( hRope );
+                if( nAxis == nFaceAxis )
+                {
+                    // the face is parallel to the split.  Only the child which is adjacent to the face is a neighbor
+                    hRope = bMaxFace ? pTree->GetLeftChild( hRope ) : pTree->GetRightChild( hRope );
+                }
+                else if( fSplit <= rBox.Min()[nAxis] )
+                {
+                    hRope = pTree->GetRightChild( hRope );
+                }
+                else if( fSplit >= rBox.Max()[nAxis] )
+                {
+                    hRope = pTree->GetLeftChild( hRope );
+                }
+                else
+                {
+                    break;  // the split divides the face, so we can go no further
+                }
+            }
+
+            ropes[nFace] = hRope;
+        }
+    }
+
+}
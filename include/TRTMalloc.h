@@ -15,6 +15,12 @@
 #ifndef _TRTMALLOC_H_
 #define _TRTMALLOC_H_
 
+#include <stdlib.h>
+#ifdef _MSC_VER
+    #include <stddef.h> // for uintptr_t.  Older versions of VC++ do not provide stdint.h
+#else
+    #include <stdint.h> // for uintptr_t
+#endif
 
 namespace TinyRT
 {
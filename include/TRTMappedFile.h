@@ -0,0 +1,139 @@
+//=====================================================================================================================
+//
+//   TRTMappedFile.h
+//
+//   Definition of class: TinyRT::MappedFile
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_MAPPEDFILE_H_
+#define _TRT_MAPPEDFILE_H_
+
+// This header is not included by TinyRT.h, because it pulls in platform headers.  Include it after TinyRT.h
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A read-only, memory mapped file
+    ///
+    ///  This is intended for loading acceleration structures which were written using their 'Save' methods.  The file
+    ///   contents are paged in on demand, and are shared between processes which map the same file.  The mapping always
+    ///   begins on a page boundary, so it meets the alignment requirements of the 'Attach' methods.
+    ///
+    ///  A file may also be mapped copy-on-write.  The contents may then be modified in memory, and only the pages which
+    ///   are written to are copied.  The modifications are never written back to the file.
+    //=====================================================================================================================
+    class MappedFile
+    {
+    public:
+
+        inline MappedFile( ) : m_pData( NULL ), m_nSize( 0 ), m_bWritable( false ) {};
+
+        inline ~MappedFile( ) { Close(); };
+
+        /// \brief Maps a file into memory, closing any previously mapped file.  Returns false if the file could not be mapped
+        /// \param bCopyOnWrite  If true, the view may be modified via 'GetWritableData', without affecting the file
+        inline bool Open( const char* pFileName, bool bCopyOnWrite = false )
+        {
+            Close();
+
+#ifdef _WIN32
+            HANDLE hFile = CreateFileA( pFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+            if( hFile == INVALID_HANDLE_VALUE )
+                return false;
+
+            LARGE_INTEGER size;
+            HANDLE hMapping = NULL;
+            if( GetFileSizeEx( hFile, &size ) && size.QuadPart > 0 )
+                hMapping = CreateFileMappingA( hFile, NULL, bCopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL );
+
+            if( hMapping )
+            {
+                m_pData = MapViewOfFile( hMapping, bCopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0 );
+                m_nSize = m_pData ? static_cast<size_t>( size.QuadPart ) : 0;
+                CloseHandle( hMapping ); // the view keeps the mapping alive
+            }
+
+            CloseHandle( hFile );
+#else
+            int fd = open( pFileName, O_RDONLY );
+            if( fd < 0 )
+                return false;
+
+            struct stat st;
+            if( fstat( fd, &st ) == 0 && st.st_size > 0 )
+            {
+                void* pData = bCopyOnWrite ? mmap( NULL, static_cast<size_t>( st.st_size ), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 )
+                                           : mmap( NULL, static_cast<size_t>( st.st_size ), PROT_READ, MAP_SHARED, fd, 0 );
+                if( pData != MAP_FAILED )
+                {
+                    m_pData = pData;
+                    m_nSize = static_cast<size_t>( st.st_size );
+                }
+            }
+
+            close( fd ); // the mapping remains valid after the descriptor is closed
+#endif
+            m_bWritable = bCopyOnWrite && m_pData;
+            return m_pData != NULL;
+        };
+
+        /// Unmaps the file.  Any structures which were attached to the file's contents become invalid
+        inline void Close( )
+        {
+            if( !m_pData )
+                return;
+
+#ifdef _WIN32
+            UnmapViewOfFile( m_pData );
+#else
+            munmap( m_pData, m_nSize );
+#endif
+            m_pData = NULL;
+            m_nSize = 0;
+            m_bWritable = false;
+        };
+
+        /// Returns the start of the file contents, or NULL if no file is mapped
+        inline const void* GetData() const { return m_pData; };
+
+        /// Returns the start of the file contents, or NULL if the file is not mapped copy-on-write
+        inline void* GetWritableData() { return m_bWritable ? m_pData : NULL; };
+
+        /// Returns the size of the file
+        inline size_t GetSize() const { return m_nSize; };
+
+    private:
+
+        /// Disallow copies
+        inline MappedFile( const MappedFile& ) {};
+        inline MappedFile& operator=( const MappedFile& ) { return *this; };
+
+        void* m_pData;
+        size_t m_nSize;
+        bool m_bWritable;
+    };
+
+}
+
+#endif // _TRT_MAPPEDFILE_H_
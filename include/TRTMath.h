@@ -297,6 +297,19 @@ namespace TinyRT
         }
     }
 
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Returns half the surface area of an axis-aligned box.  This is the area term used in SAH cost estimates
+    //=====================================================================================================================
+    template< class Box_T >
+    inline float HalfArea( const Box_T& rBox )
+    {
+        float dx = rBox.Max()[0] - rBox.Min()[0];
+        float dy = rBox.Max()[1] - rBox.Min()[1];
+        float dz = rBox.Max()[2] - rBox.Min()[2];
+        return dx*( dy + dz ) + dy*dz;
+    }
+
 
 }
 
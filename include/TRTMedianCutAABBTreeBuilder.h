@@ -44,6 +44,9 @@ namespace TinyRT
         template< class AABBTree_T >
         uint32 BuildTree( ObjectSet* pObjects, AABBTree_T* pTree );
 
+        /// Adds the builder type and leaf size to a hash.  Used by BuildCache to identify the build parameters
+        inline void HashParameters( ContentHash& rHash ) const { rHash.AddString( "MedianCutAABBTreeBuilder" ); rHash.AddValue( m_nMaxLeafObjects ); };
+
     
     private:
 
@@ -55,17 +58,8 @@ namespace TinyRT
         };
 
 
-        /// Functor for sorting object structures along an axis
-        template< int axis >
-        class ObjectSorter
-        {
-        public:
-
-            inline bool operator()( const Object* a, const Object* b ) const
-            {
-                return ( a->box.Min()[axis] < b->box.Min()[axis] );
-            };
-        };
+        /// Sorts object structures along an axis, keyed on their box minima
+        typedef RadixSorter<uint32,Object*> ObjectSorter;
 
 
         template< typename AABBTree_T >
@@ -76,7 +70,9 @@ namespace TinyRT
                           const AxisAlignedBox* pRootBox,
                           obj_id* pObjectsOut,
                           obj_id nFirstObject,
-                          uint32 nDepth  );
+                          uint32 nDepth,
+                          ObjectSorter& rSorter,
+                          uint32* pSortKeys );
 
         uint32 m_nMaxLeafObjects;   ///< Maximum number of objects allowed in a leaf node
     };
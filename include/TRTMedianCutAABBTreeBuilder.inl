@@ -75,7 +75,9 @@ namespace TinyRT
         typename AABBTree_T::NodeHandle pRoot = pTree->Initialize( globalBox, 2*nObjects - 1 );
 
         // build the tree
-        uint32 nMaxDepth = MedianCut( &objectPtrs[0], nObjects, pTree, pRoot, &globalBox, &objectRemap[0], 0, 0 );
+        ObjectSorter sorter;
+        ScopedArray<uint32> sortKeys( new uint32[nObjects] );
+        uint32 nMaxDepth = MedianCut( &objectPtrs[0], nObjects, pTree, pRoot, &globalBox, &objectRemap[0], 0, 0, sorter, &sortKeys[0] );
 
         // rearrange the objects so they are in tree order
         pObjects->RemapObjects( &objectRemap[0] );
@@ -100,7 +102,9 @@ namespace TinyRT
                                                               const AxisAlignedBox* pRootBox,
                                                               obj_id* pObjectRemap,
                                                               obj_id nFirstObject,
-                                                              uint32 nDepth  )
+                                                              uint32 nDepth,
+                                                              ObjectSorter& rSorter,
+                                                              uint32* pSortKeys )
     {
         typedef typename AABBTree_T::NodeHandle NodeHandle;
 
@@ -132,13 +136,10 @@ namespace TinyRT
                 nAxis = 2;
 
             // sort the objects along this axis
-            ObjectSorter<0> sortx; ObjectSorter<1> sorty; ObjectSorter<2> sortz;
-            switch( nAxis )
-            {
-            case 0: std::sort( pObjects, pObjects + nObjects, sortx ); break;
-            case 1: std::sort( pObjects, pObjects + nObjects, sorty ); break;
-            case 2: std::sort( pObjects, pObjects + nObjects, sortz ); break;
-            };
+            //  The key array is only needed during the sort, so every node re-uses the same one
+            for( obj_id i=0; i<nObjects; i++ )
+                pSortKeys[i] = FloatToRadixKey( pObjects[i]->box.Min()[nAxis] );
+            rSorter.Sort( pSortKeys, pObjects, nObjects );
 
             // split the object list in half
             Object** pLeftObjects = pObjects;
@@ -159,10 +160,10 @@ namespace TinyRT
             pTree->SetNodeAABB( pNode, *pRootBox );
 
             uint32 nLeftDepth = MedianCut( pLeftObjects, nLeftObjects, pTree, children.first, &leftBox, 
-                                           pObjectRemap, nFirstObject, nDepth+1 );
+                                           pObjectRemap, nFirstObject, nDepth+1, rSorter, pSortKeys );
 
             uint32 nRightDepth = MedianCut( pRightObjects, nRightObjects, pTree, children.second, &rightBox, 
-                                            pObjectRemap + nLeftObjects, nFirstObject + nLeftObjects, nDepth+1 );
+                                            pObjectRemap + nLeftObjects, nFirstObject + nLeftObjects, nDepth+1, rSorter, pSortKeys );
                     
             return std::max( nLeftDepth, nRightDepth );
         }
@@ -15,19 +15,32 @@
 #ifndef _TRT_MULTIBVHTRAVERSAL_H_
 #define _TRT_MULTIBVHTRAVERSAL_H_
 
+#include "TRTTraversalStack.h"
+#include "TRTTraversalStats.h"
+#include "TRTPrefetch.h"
 
 namespace TinyRT
 {
     //=====================================================================================================================
     /// \ingroup TinyRT
-    /// \brief Searches for the first intersection between a ray and an object in an N-ary BVH
+    /// \brief N-ary BVH traversal kernel for rays in a particular octant
+    ///
+    /// The octant determines the box slabs and child ordering at compile time.  The ray must actually lie in the given octant.  
+    ///  RaycastMultiBVHWithStack selects the kernel for each ray.
+    ///
+    /// \param pStack       Traversal stack.  Must have room for pBVH->GetStackDepth()*MBVH_T::BRANCH_FACTOR entries
+    /// \param rStats       Receives traversal statistics
+    /// \param OCTANT       The ray's octant, as returned by GetRayOctant
+    /// \param Prefetch_T   Must implement Prefetch_C.  Applied to each node which is pushed beneath the next one to be visited
     /// \param MBVH_T       Must implement MBVH_C
     /// \param ObjectSet_T  Must implement ObjectSet_C
     /// \param HitInfo_T    Must implement HitInfo_C
     /// \param Ray_T        Must implement Ray_C
+    /// \param Stats_T      Must implement TraversalStats_C
     //=====================================================================================================================
-    template< typename MBVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
-    void RaycastMultiBVH( const MBVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, const typename MBVH_T::ConstNodeHandle pRoot, ScratchMemory& rScratch )
+    template< int OCTANT, typename Prefetch_T, typename MBVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    void RaycastMultiBVHOctant( const MBVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                                const typename MBVH_T::ConstNodeHandle pRoot, typename MBVH_T::ConstNodeHandle* pStack, Stats_T& rStats )
     {
         typedef typename MBVH_T::ConstNodeHandle ConstNodeHandle;
         typedef typename MBVH_T::obj_id obj_id;
@@ -35,28 +48,16 @@ namespace TinyRT
         const Vec3f& rOrigin = rRay.Origin();
         const Vec3f& rInvDir = rRay.InvDirection();
 
-        int nDirSigns[4] = {
-            rInvDir.x > 0 ? 0 : 1,
-            rInvDir.y > 0 ? 0 : 1,
-            rInvDir.z > 0 ? 0 : 1
-        };
-        nDirSigns[3] =  (nDirSigns[2] << 2) | (nDirSigns[1] << 1) | (nDirSigns[0]);
-        nDirSigns[0] <<= 4;
-        nDirSigns[1] <<= 4;
-        nDirSigns[2] <<= 4;
-
         SimdVec4f vSIMDRay[6] = {
             SimdVec4f( rInvDir.x ), SimdVec4f( rOrigin.x ),
             SimdVec4f( rInvDir.y ), SimdVec4f( rOrigin.y ),
             SimdVec4f( rInvDir.z ), SimdVec4f( rOrigin.z )
         };
 
-        size_t nStackSize = pBVH->GetStackDepth()*(MBVH_T::BRANCH_FACTOR);
-        ScratchArray<ConstNodeHandle> pStackMem( rScratch, nStackSize );
-        ConstNodeHandle* pStack = pStackMem;
         const ConstNodeHandle* pStackBottom = pStack;
         (*pStack++) = pRoot;
 
+        rStats.CountRay();
 
         while( pStack != pStackBottom )
         {
@@ -69,15 +70,171 @@ namespace TinyRT
                 obj_id nLastObject;
                 pBVH->GetNodeObjectRange( pNode, nFirstObject, nLastObject );
                 
+                rStats.CountLeaf();
+                rStats.CountPrimitiveTests( static_cast<uint32>( nLastObject - nFirstObject ) );
                 pObjects->RayIntersect( rRay, rHitInfo, nFirstObject, nLastObject );
             }
             else
             {
-                pStack = pBVH->RayIntersectChildren( pNode, vSIMDRay, rRay, pStack, nDirSigns );
+                ConstNodeHandle* pPushed = pStack;
+                pStack = pBVH->template RayIntersectChildrenOctant<OCTANT>( pNode, vSIMDRay, rRay, pStack );
+
+                // the top entry is visited next, so there is no time to hide its latency.  Start fetching the ones beneath it
+                for( ConstNodeHandle* pEntry = pPushed; pEntry+1 < pStack; pEntry++ )
+                    Prefetch_T::PrefetchMultiBVHNode( pBVH, pObjects, *pEntry );
+
+                rStats.CountInnerNode();
+                rStats.CountBoxTests( MBVH_T::BRANCH_FACTOR );
+                rStats.CountStackDepth( pStack - pStackBottom );
             }
         }
     }
 
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Searches for the first intersection between a ray and an object in an N-ary BVH, using a caller-supplied stack 
+    ///   and a prefetch policy.  The ray is traversed by the kernel which is specialized for its octant
+    /// \param pStack       Traversal stack.  Must have room for pBVH->GetStackDepth()*MBVH_T::BRANCH_FACTOR entries
+    /// \param rStats       Receives traversal statistics
+    /// \param Prefetch_T   Must implement Prefetch_C
+    /// \param MBVH_T       Must implement MBVH_C
+    /// \param ObjectSet_T  Must implement ObjectSet_C
+    /// \param HitInfo_T    Must implement HitInfo_C
+    /// \param Ray_T        Must implement Ray_C
+    /// \param Stats_T      Must implement TraversalStats_C
+    //=====================================================================================================================
+    template< typename Prefetch_T, typename MBVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    void RaycastMultiBVHPrefetchedWithStack( const MBVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                                             const typename MBVH_T::ConstNodeHandle pRoot, typename MBVH_T::ConstNodeHandle* pStack, Stats_T& rStats )
+    {
+        switch( GetRayOctant( rRay ) )
+        {
+        case 0: RaycastMultiBVHOctant<0,Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 1: RaycastMultiBVHOctant<1,Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 2: RaycastMultiBVHOctant<2,Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 3: RaycastMultiBVHOctant<3,Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 4: RaycastMultiBVHOctant<4,Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 5: RaycastMultiBVHOctant<5,Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 6: RaycastMultiBVHOctant<6,Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        case 7: RaycastMultiBVHOctant<7,Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats ); break;
+        };
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Searches for the first intersection between a ray and an object in an N-ary BVH, using a caller-supplied stack
+    ///  The ray is traversed by the kernel which is specialized for its octant
+    /// \param pStack       Traversal stack.  Must have room for pBVH->GetStackDepth()*MBVH_T::BRANCH_FACTOR entries
+    /// \param rStats       Receives traversal statistics
+    /// \param MBVH_T       Must implement MBVH_C
+    /// \param ObjectSet_T  Must implement ObjectSet_C
+    /// \param HitInfo_T    Must implement HitInfo_C
+    /// \param Ray_T        Must implement Ray_C
+    /// \param Stats_T      Must implement TraversalStats_C
+    //=====================================================================================================================
+    template< typename MBVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    inline void RaycastMultiBVHWithStack( const MBVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                                          const typename MBVH_T::ConstNodeHandle pRoot, typename MBVH_T::ConstNodeHandle* pStack, Stats_T& rStats )
+    {
+        RaycastMultiBVHPrefetchedWithStack<NullPrefetch>( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, rStats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Searches for the first intersection between a ray and an object in an N-ary BVH, using a caller-supplied stack
+    /// \param pStack       Traversal stack.  Must have room for pBVH->GetStackDepth()*MBVH_T::BRANCH_FACTOR entries
+    /// \param MBVH_T       Must implement MBVH_C
+    /// \param ObjectSet_T  Must implement ObjectSet_C
+    /// \param HitInfo_T    Must implement HitInfo_C
+    /// \param Ray_T        Must implement Ray_C
+    //=====================================================================================================================
+    template< typename MBVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastMultiBVHWithStack( const MBVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, 
+                                          const typename MBVH_T::ConstNodeHandle pRoot, typename MBVH_T::ConstNodeHandle* pStack )
+    {
+        NullTraversalStats stats;
+        RaycastMultiBVHWithStack( pBVH, pObjects, rRay, rHitInfo, pRoot, pStack, stats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Searches for the first intersection between a ray and an object in an N-ary BVH
+    ///  The traversal stack is kept on the call stack, and scratch memory is only used if the tree is deeper than TRT_INLINE_STACK_DEPTH
+    /// \param MBVH_T       Must implement MBVH_C
+    /// \param ObjectSet_T  Must implement ObjectSet_C
+    /// \param HitInfo_T    Must implement HitInfo_C
+    /// \param Ray_T        Must implement Ray_C
+    //=====================================================================================================================
+    template< typename MBVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastMultiBVH( const MBVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, const typename MBVH_T::ConstNodeHandle pRoot, ScratchMemory& rScratch )
+    {
+        TraversalStack< typename MBVH_T::ConstNodeHandle, TRT_INLINE_STACK_DEPTH*MBVH_T::BRANCH_FACTOR > stack( rScratch, pBVH->GetStackDepth()*MBVH_T::BRANCH_FACTOR );
+        RaycastMultiBVHWithStack( pBVH, pObjects, rRay, rHitInfo, pRoot, stack );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Searches for the first intersection between a ray and an object in an N-ary BVH, and records traversal statistics
+    /// \param Stats_T      Must implement TraversalStats_C
+    //=====================================================================================================================
+    template< typename MBVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    inline void RaycastMultiBVH( const MBVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, const typename MBVH_T::ConstNodeHandle pRoot, 
+                                 ScratchMemory& rScratch, Stats_T& rStats )
+    {
+        TraversalStack< typename MBVH_T::ConstNodeHandle, TRT_INLINE_STACK_DEPTH*MBVH_T::BRANCH_FACTOR > stack( rScratch, pBVH->GetStackDepth()*MBVH_T::BRANCH_FACTOR );
+        RaycastMultiBVHWithStack( pBVH, pObjects, rRay, rHitInfo, pRoot, stack, rStats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// Searches for the first intersection between a ray and an object in an N-ary BVH, using the calling thread's scratch memory
+    ///  if the tree is too deep for an inline stack
+    /// \sa ThreadScratchMemory
+    //=====================================================================================================================
+    template< typename MBVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastMultiBVH( const MBVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, const typename MBVH_T::ConstNodeHandle pRoot )
+    {
+        TraversalStack< typename MBVH_T::ConstNodeHandle, TRT_INLINE_STACK_DEPTH*MBVH_T::BRANCH_FACTOR > stack( pBVH->GetStackDepth()*MBVH_T::BRANCH_FACTOR );
+        RaycastMultiBVHWithStack( pBVH, pObjects, rRay, rHitInfo, pRoot, stack );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Searches for the first intersection between a ray and an object in an N-ary BVH, prefetching nodes as they are pushed
+    ///
+    ///  This is intended for trees which are much larger than the cache.  For smaller trees, the prefetches only add overhead,
+    ///   and RaycastMultiBVH should be used instead.  ShouldPrefetch may be used to choose between them.
+    ///
+    /// \param Prefetch_T   Must implement Prefetch_C (for example: NodePrefetch or NodeAndObjectPrefetch)
+    /// \param MBVH_T       Must implement MBVH_C
+    /// \param ObjectSet_T  Must implement ObjectSet_C
+    /// \param HitInfo_T    Must implement HitInfo_C
+    /// \param Ray_T        Must implement Ray_C
+    //=====================================================================================================================
+    template< typename Prefetch_T, typename MBVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T >
+    inline void RaycastMultiBVHPrefetched( const MBVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, const typename MBVH_T::ConstNodeHandle pRoot, 
+                                           ScratchMemory& rScratch )
+    {
+        NullTraversalStats stats;
+        TraversalStack< typename MBVH_T::ConstNodeHandle, TRT_INLINE_STACK_DEPTH*MBVH_T::BRANCH_FACTOR > stack( rScratch, pBVH->GetStackDepth()*MBVH_T::BRANCH_FACTOR );
+        RaycastMultiBVHPrefetchedWithStack<Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, stack, stats );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Searches for the first intersection between a ray and an object in an N-ary BVH, prefetching nodes as they are pushed,
+    ///   and records traversal statistics
+    /// \param Prefetch_T   Must implement Prefetch_C
+    /// \param Stats_T      Must implement TraversalStats_C
+    //=====================================================================================================================
+    template< typename Prefetch_T, typename MBVH_T, typename ObjectSet_T, typename HitInfo_T, typename Ray_T, typename Stats_T >
+    inline void RaycastMultiBVHPrefetched( const MBVH_T* pBVH, const ObjectSet_T* pObjects, Ray_T& rRay, HitInfo_T& rHitInfo, const typename MBVH_T::ConstNodeHandle pRoot, 
+                                           ScratchMemory& rScratch, Stats_T& rStats )
+    {
+        TraversalStack< typename MBVH_T::ConstNodeHandle, TRT_INLINE_STACK_DEPTH*MBVH_T::BRANCH_FACTOR > stack( rScratch, pBVH->GetStackDepth()*MBVH_T::BRANCH_FACTOR );
+        RaycastMultiBVHPrefetchedWithStack<Prefetch_T>( pBVH, pObjects, rRay, rHitInfo, pRoot, stack, rStats );
+    }
+
 }
 
 #endif // _TRT_MULTIBVHTRAVERSAL_H_
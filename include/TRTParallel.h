@@ -0,0 +1,184 @@
+//=====================================================================================================================
+//
+//   TRTParallel.h
+//
+//   Helpers for multi-threaded operations
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_PARALLEL_H_
+#define _TRT_PARALLEL_H_
+
+// TinyRT's parallel algorithms are written using OpenMP.  If OpenMP is not enabled by the compiler, 
+//  they will simply run on the calling thread
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <pthread.h>
+#endif
+
+/// Storage class for thread-local variables.  These may only be used for POD types
+#ifdef _MSC_VER
+    #define TRT_THREAD_LOCAL __declspec(thread)
+#else
+    #define TRT_THREAD_LOCAL __thread
+#endif
+
+/// Size of a cache line, used to pad shared data to prevent false sharing
+#define TRT_CACHE_LINE_SIZE 64
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Returns the number of threads that TinyRT's parallel algorithms will use
+    //=====================================================================================================================
+    inline uint32 GetParallelThreadCount()
+    {
+    #ifdef _OPENMP
+        return static_cast<uint32>( omp_get_max_threads() );
+    #else
+        return 1;
+    #endif
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Returns the index of the calling thread in the current parallel region (0 if there is none)
+    //=====================================================================================================================
+    inline uint32 GetParallelThreadIndex()
+    {
+    #ifdef _OPENMP
+        return static_cast<uint32>( omp_get_thread_num() );
+    #else
+        return 0;
+    #endif
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Atomically adds a value to an integer, and returns the integer's previous value
+    //=====================================================================================================================
+    inline int32 AtomicAdd( volatile int32* pValue, int32 nAdd )
+    {
+    #if defined(_MSC_VER)
+        return _InterlockedExchangeAdd( reinterpret_cast<volatile long*>( pValue ), nAdd );
+    #elif defined(__GNUC__)
+        return __sync_fetch_and_add( pValue, nAdd );
+    #else
+        int32 nOld;
+        #pragma omp critical(TRTAtomicAdd)
+        {
+            nOld = *pValue;
+            *pValue = nOld + nAdd;
+        }
+        return nOld;
+    #endif
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Prevents the compiler and the CPU from moving memory accesses across this point
+    ///
+    ///  Used when publishing data to other threads or processes:  The writer fences between writing the data and setting
+    ///   the flag which marks it ready, and the reader fences between seeing the flag and reading the data.
+    //=====================================================================================================================
+    inline void MemoryFence()
+    {
+    #if defined(_MSC_VER)
+        _ReadWriteBarrier();
+        _mm_mfence();
+    #elif defined(__GNUC__)
+        __sync_synchronize();
+    #else
+        #pragma omp flush
+    #endif
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Manages one heap-allocated instance of a class for each thread
+    ///
+    ///  The first call to 'Get' on a particular thread default-constructs an instance for that thread.  Subsequent calls
+    ///   on the same thread return the same instance.  No locks are taken, since each thread only ever touches its own.
+    ///
+    ///  On POSIX systems, the thread's instance is destroyed automatically when the thread exits.  On Windows,
+    ///   threads which exit before the process does should call 'Release' to avoid leaking it.
+    //=====================================================================================================================
+    template< class T >
+    class ThreadLocalInstance
+    {
+    public:
+
+        /// Returns the calling thread's instance, creating it if necessary
+        static inline T& Get()
+        {
+            T*& rpInstance = GetSlot();
+            if( !rpInstance )
+            {
+                rpInstance = new T();
+            #ifndef _MSC_VER
+                pthread_setspecific( GetKey(), rpInstance );
+            #endif
+            }
+            return *rpInstance;
+        }
+
+        /// Destroys the calling thread's instance.  It will be re-created by the next call to 'Get'
+        static inline void Release()
+        {
+            T*& rpInstance = GetSlot();
+            delete rpInstance;
+            rpInstance = NULL;
+        #ifndef _MSC_VER
+            pthread_setspecific( GetKey(), NULL );
+        #endif
+        }
+
+    private:
+
+        static inline T*& GetSlot()
+        {
+            static TRT_THREAD_LOCAL T* s_pInstance = NULL;
+            return s_pInstance;
+        }
+
+    #ifndef _MSC_VER
+
+        // The thread-local pointer is used for lookups, since it is much faster than pthread_getspecific.
+        //   The pthread key exists only to destroy the instance on thread exit
+
+        static void DestroyInstance( void* pInstance ) { delete reinterpret_cast<T*>( pInstance ); };
+
+        static pthread_key_t& GetKeyStorage()
+        {
+            static pthread_key_t s_key;
+            return s_key;
+        }
+
+        static void CreateKey() { pthread_key_create( &GetKeyStorage(), &DestroyInstance ); };
+
+        static inline pthread_key_t GetKey()
+        {
+            static pthread_once_t s_once = PTHREAD_ONCE_INIT;
+            pthread_once( &s_once, &CreateKey );
+            return GetKeyStorage();
+        }
+
+    #endif
+    };
+
+}
+
+#endif // _TRT_PARALLEL_H_
@@ -0,0 +1,158 @@
+//=====================================================================================================================
+//
+//   TRTPrefetch.h
+//
+//   Software prefetching helpers and traversal prefetch policies
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_PREFETCH_H_
+#define _TRT_PREFETCH_H_
+
+/// Size of a cache line, in bytes
+#define TRT_CACHE_LINE_SIZE 64
+
+/// \brief Default size threshold for 'ShouldPrefetch'.  
+/// Structures smaller than this are expected to stay cache resident, so prefetching them only adds instructions
+#ifndef TRT_PREFETCH_MIN_BYTES
+    #define TRT_PREFETCH_MIN_BYTES (16*1024*1024)
+#endif
+
+namespace TinyRT
+{
+
+    /// \ingroup TinyRT
+    /// Requests that the cache line containing a particular address be loaded into the cache.  This never faults
+    TRT_FORCEINLINE void PrefetchCacheLine( const void* p )
+    {
+        _mm_prefetch( reinterpret_cast<const char*>( p ), _MM_HINT_T0 );
+    }
+
+    /// \ingroup TinyRT
+    /// Requests that all cache lines overlapping a block of memory be loaded into the cache
+    TRT_FORCEINLINE void PrefetchMemory( const void* p, size_t nBytes )
+    {
+        const char* pLine = reinterpret_cast<const char*>( reinterpret_cast<size_t>( p ) & ~static_cast<size_t>( TRT_CACHE_LINE_SIZE-1 ) );
+        const char* pEnd  = reinterpret_cast<const char*>( p ) + nBytes;
+        while( pLine < pEnd )
+        {
+            PrefetchCacheLine( pLine );
+            pLine += TRT_CACHE_LINE_SIZE;
+        }
+    }
+
+    /// \ingroup TinyRT
+    /// \brief Decides whether a tree is large enough for a prefetching traversal to be worthwhile
+    ///
+    ///  Prefetching hides the latency of cache misses during traversal, but trees which fit in the cache do not miss often
+    ///   enough to repay the extra instructions.  The threshold should be set to roughly the size of the largest cache level.
+    ///  
+    /// \param Tree_T  Must provide a 'GetMemoryUsage' method (AABBTree, QuadAABBTree, and KDTree all do)
+    template< class Tree_T >
+    inline bool ShouldPrefetch( const Tree_T* pTree, size_t nMinBytes = TRT_PREFETCH_MIN_BYTES )
+    {
+        size_t nBytesUsed, nBytesAllocated;
+        pTree->GetMemoryUsage( nBytesUsed, nBytesAllocated );
+        return nBytesUsed >= nMinBytes;
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A traversal prefetch policy which does not prefetch anything
+    ///
+    ///  This is the policy used by the raycasting functions which do not take a prefetch policy.  
+    ///
+    ///  This class implements the Prefetch_C concept
+    //=====================================================================================================================
+    class NullPrefetch
+    {
+    public:
+
+        template< class BVH_T, class ObjectSet_T >
+        static TRT_FORCEINLINE void PrefetchBVHNode( const BVH_T* , const ObjectSet_T* , typename BVH_T::ConstNodeHandle ) {};
+
+        template< class MBVH_T, class ObjectSet_T >
+        static TRT_FORCEINLINE void PrefetchMultiBVHNode( const MBVH_T* , const ObjectSet_T* , typename MBVH_T::ConstNodeHandle ) {};
+    };
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A traversal prefetch policy which prefetches tree nodes as they are pushed onto the traversal stack
+    ///
+    ///  For binary BVHs, the children of each pushed node are prefetched, since the node itself was already loaded along 
+    ///   with its sibling.  For N-ary BVHs, the pushed node itself is prefetched.  By the time the node is popped, its
+    ///   memory is usually in the cache.
+    ///
+    ///  This class implements the Prefetch_C concept
+    //=====================================================================================================================
+    class NodePrefetch
+    {
+    public:
+
+        template< class BVH_T, class ObjectSet_T >
+        static TRT_FORCEINLINE void PrefetchBVHNode( const BVH_T* pBVH, const ObjectSet_T* , typename BVH_T::ConstNodeHandle pNode ) 
+        {
+            if( !pBVH->IsNodeLeaf( pNode ) )
+                pBVH->PrefetchChildren( pNode );
+        };
+
+        template< class MBVH_T, class ObjectSet_T >
+        static TRT_FORCEINLINE void PrefetchMultiBVHNode( const MBVH_T* pBVH, const ObjectSet_T* , typename MBVH_T::ConstNodeHandle nNode ) 
+        {
+            pBVH->PrefetchNode( nNode );
+        };
+    };
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A traversal prefetch policy which prefetches tree nodes, and the object data for leaves, as they are pushed 
+    ///         onto the traversal stack
+    ///
+    ///  The object set must implement the optional 'PrefetchObjects' method of the ObjectSet_C concept
+    ///
+    ///  This class implements the Prefetch_C concept
+    //=====================================================================================================================
+    class NodeAndObjectPrefetch
+    {
+    public:
+
+        template< class BVH_T, class ObjectSet_T >
+        static TRT_FORCEINLINE void PrefetchBVHNode( const BVH_T* pBVH, const ObjectSet_T* pObjects, typename BVH_T::ConstNodeHandle pNode ) 
+        {
+            if( !pBVH->IsNodeLeaf( pNode ) )
+            {
+                pBVH->PrefetchChildren( pNode );
+            }
+            else
+            {
+                typename BVH_T::obj_id nFirst, nLast;
+                pBVH->GetNodeObjectRange( pNode, nFirst, nLast );
+                pObjects->PrefetchObjects( nFirst, nLast );
+            }
+        };
+
+        template< class MBVH_T, class ObjectSet_T >
+        static TRT_FORCEINLINE void PrefetchMultiBVHNode( const MBVH_T* pBVH, const ObjectSet_T* pObjects, typename MBVH_T::ConstNodeHandle nNode ) 
+        {
+            if( !pBVH->IsNodeLeaf( nNode ) )
+            {
+                pBVH->PrefetchNode( nNode );
+            }
+            else
+            {
+                typename MBVH_T::obj_id nFirst, nLast;
+                pBVH->GetNodeObjectRange( nNode, nFirst, nLast );
+                pObjects->PrefetchObjects( nFirst, nLast );
+            }
+        };
+    };
+
+}
+
+#endif // _TRT_PREFETCH_H_
@@ -25,9 +25,10 @@ namespace TinyRT
     ///
     /// This class implements the QuadAABBTree_C concept.
     ///
-    /// \param ObjectSet_T Must implement the ObjectSet_C concept
+    /// \param ObjectSet_T     Must implement the ObjectSet_C concept
+    /// \param HandleTraits_T  Selects the width of node handles.  Either CompactTreeHandles or LargeTreeHandles
     //=====================================================================================================================
-    template< class ObjectSet_T >
+    template< class ObjectSet_T, class HandleTraits_T = CompactTreeHandles >
     class QuadAABBTree
     {
     public:
@@ -35,8 +36,8 @@ namespace TinyRT
         typedef ObjectSet_T ObjectSet;
         typedef typename ObjectSet_T::obj_id     obj_id;
         
-        typedef uint32 NodeHandle;
-        typedef uint32 ConstNodeHandle;
+        typedef typename HandleTraits_T::Handle NodeHandle;
+        typedef typename HandleTraits_T::Handle ConstNodeHandle;
 
     public:
 
@@ -49,7 +50,7 @@ namespace TinyRT
 
         /// Called at the start of tree construction.  Returns a reference to the QBVH root
         /// QBVH trees always have a single QBVH node as their root
-        inline NodeHandle Initialize( const AxisAlignedBox& rBox ) { m_nNodesInUse=1; return 0; };
+        inline NodeHandle Initialize( const AxisAlignedBox& rBox ) { MakeMemoryWritable(); m_nNodesInUse=1; m_nLeafsInUse=1; return 0; };
 
         /// Returns the maximum depth of the tree
         inline uint32 GetStackDepth() const { return m_nStackDepth; };
@@ -58,7 +59,7 @@ namespace TinyRT
         inline NodeHandle GetRoot() const { return 0; };
 
         /// Tests whether or not a node is a leaf
-        inline bool IsNodeLeaf( NodeHandle n ) const { return n >= 0x80000000; };
+        inline bool IsNodeLeaf( NodeHandle n ) const { return n >= LEAF_FLAG; };
 
         /// Returns the range of objects stored in a leaf node
         inline void GetNodeObjectRange( NodeHandle n, obj_id& rFirst, obj_id& rLast ) const;
@@ -79,17 +80,42 @@ namespace TinyRT
             return pN->m_children[i];
         };
 
+        /// Prefetches the memory which is read when a node is visited (the child boxes for an inner node, or the object range for a leaf)
+        inline void PrefetchNode( NodeHandle n ) const {
+            if( IsNodeLeaf( n ) )
+                PrefetchCacheLine( LookupLeaf( n ) );
+            else
+                PrefetchMemory( LookupNode( n ), sizeof(Node) );
+        };
+
         /// Subdivides a child node into four children, and returns a reference to the subdivided child
         inline NodeHandle SubdivideChild( NodeHandle nNode, uint32 nChild );
 
         /// Sets the split axes that are used for ordered traversal of a particular node
         inline void SetSplitAxes( NodeHandle nNode, uint32 nA0, uint32 nA1, uint32 nA2 );
+
+        /// \brief Sets the order in which rays in a particular octant visit a node's children
+        /// This is an alternative to 'SetSplitAxes', for nodes whose children are not divided by three split planes.
+        /// \param nOrder   Two-bit child indices, in the format returned by 'GetChildTraversalOrder'
+        inline void SetChildTraversalOrder( NodeHandle nNode, uint nRayOctant, uint8 nOrder ) {
+            TRT_ASSERT( !IsNodeLeaf(nNode) );
+            LookupNode(nNode)->m_traversalOrder[nRayOctant] = nOrder;
+        };
+
+        /// \brief Sets the order in which rays in a particular octant visit a node's children, given a list of child indices
+        /// \param pOrder       Indices of the node's first 'nChildren' children, in the order that they are visited
+        /// \param nChildren    Number of non-empty children.  The remaining slots are placed last, since they are never visited
+        inline void SetChildTraversalOrder( NodeHandle nNode, uint nRayOctant, const uint32* pOrder, uint32 nChildren );
     
         /// Turns a child of a QBVH node into a leaf
         inline void CreateLeafChild( NodeHandle nNode, uint32 nChildIdx, obj_id nFirstObject, obj_id nObjects ); 
 
         /// Turns a child of a QBVH node into an empty leaf
         inline void CreateEmptyLeafChild( NodeHandle pNode, uint32 nChildIdx );
+
+        /// \brief Turns the children of a QBVH node from 'nFirstEmpty' onwards into empty leaves
+        /// Empty children are never visited, but are given a valid box so that saved trees contain no uninitialized data
+        inline void CreateEmptyLeafChildren( NodeHandle nNode, uint32 nFirstEmpty, const AxisAlignedBox& rBox );
    
         /// Sets the stored AABB for one of a node's children
         inline void SetChildAABB( NodeHandle nNode, uint32 nChildIdx, const AxisAlignedBox& rBox );
@@ -98,13 +124,47 @@ namespace TinyRT
         template< class Ray_T >
         TRT_FORCEINLINE NodeHandle* RayIntersectChildren( NodeHandle nNode, const SimdVec4f vSIMDRay[6], const Ray_T& rRay, NodeHandle* pStack, const int nDirSigns[4] ) const;
 
+        /// Performs a ray intersection test against the children of a node, for a ray in a known octant
+        template< int OCTANT, class Ray_T >
+        TRT_FORCEINLINE NodeHandle* RayIntersectChildrenOctant( NodeHandle nNode, const SimdVec4f vSIMDRay[6], const Ray_T& rRay, NodeHandle* pStack ) const;
+
 
         /// Returns the memory consumption of the data structure, as well as the amount allocated
         inline void GetMemoryUsage( size_t& rnBytesUsed, size_t& rnBytesAllocated ) const;
 
-        /// Constructs a tree for an object set
+        /// \brief Constructs a tree for an object set.  Returns false if the tree is too large for its handle type
+        /// In that case, the tree is left empty, and must be built again using LargeTreeHandles
+        template< class QAABBBuilder_T >
+        inline bool Build( ObjectSet_T* pObjects, QAABBBuilder_T& rBuilder );
+
+        /// \brief Constructs a tree for an object set, recording the re-ordering of the objects so that it can be saved with the tree
+        /// The builder must be instantiated for the RemapRecorder type.  Returns false if the tree is too large for its handle type
         template< class QAABBBuilder_T >
-        inline void Build( ObjectSet_T* pObjects, QAABBBuilder_T& rBuilder );
+        inline bool Build( RemapRecorder<ObjectSet_T>* pObjects, QAABBBuilder_T& rBuilder ) 
+        { 
+            m_bHandleOverflow = false;
+            m_nStackDepth = rBuilder.BuildQuadAABBTree( pObjects, this ); 
+            return FinishBuild();
+        };
+
+        /// Recomputes the child bounding boxes after the objects have moved, without changing the tree topology
+        void Refit( const ObjectSet_T* pObjects );
+
+        /// Multi-threaded version of 'Refit'
+        void RefitParallel( const ObjectSet_T* pObjects );
+
+        /// \brief Writes the tree to a file, which may later be used with 'Attach'.  Returns false if the file could not be written
+        /// An object remap table (see RemapRecorder) may be stored along with the tree
+        bool Save( const char* pFileName, const obj_id* pObjectRemap = NULL, obj_id nObjects = 0 ) const;
+
+        /// \brief Writes the tree to a memory buffer, in the same format as 'Save'.  Returns the number of bytes required
+        /// If the buffer is NULL or too small, nothing is written.  The buffer may be passed to 'Attach'
+        size_t SaveToBuffer( void* pBuffer, size_t nBufferSize, const obj_id* pObjectRemap = NULL, obj_id nObjects = 0 ) const;
+
+        /// \brief Uses a tree written by 'Save', in place.  Returns false if the data is not a valid QuadAABBTree
+        /// The data is not copied, and must remain valid until the tree is destroyed or rebuilt.  The data is only copied
+        ///  if the tree is modified (by refitting), so the data may be read-only
+        bool Attach( const void* pData, size_t nSize );
 
 
 
@@ -145,7 +205,12 @@ namespace TinyRT
 
     private:
 
-        static const uint32 EMPTY_LEAF = 0x80000000;
+        /// Fills in the header and section list used by 'Save' and 'SaveToBuffer'
+        void GetSerializedSections( SerializedTreeHeader& rHeader, const void* pSections[SERIALIZED_SECTION_COUNT],
+                                    const obj_id* pObjectRemap, obj_id nObjects ) const;
+
+        static const NodeHandle LEAF_FLAG = static_cast<NodeHandle>( 1 ) << ( sizeof(NodeHandle)*8 - 1 ); ///< Set in leaf handles
+        static const NodeHandle EMPTY_LEAF = LEAF_FLAG;
 
         /// Inner node data structure
         struct Node
@@ -164,6 +229,15 @@ namespace TinyRT
         };
 
 
+        /// Recomputes the child AABBs of a node, and returns the union of the non-empty children
+        bool RefitNode( const ObjectSet_T* pObjects, NodeHandle nNode, bool bRecurse, AxisAlignedBox& rBoxOut );
+
+        /// Copies the nodes and leaves into memory owned by the tree, if they belong to an attached file
+        void MakeMemoryWritable();
+
+        /// Empties the tree if it overflowed its handle type during construction.  Returns false if it did
+        bool FinishBuild();
+
         /// Allocates a QBVH node
         inline NodeHandle BuyNode()
         {
@@ -177,7 +251,14 @@ namespace TinyRT
                 m_nNodeArraySize *= 2;
             }
 
-            return m_nNodesInUse++;
+            // if the tree is too large for its handle type, the builder is given the root to write to instead.  
+            //  Its handles stay valid, and 'Build' fails at the end
+            if( static_cast<uint64>( m_nNodesInUse ) >= static_cast<uint64>( LEAF_FLAG ) )
+            {
+                m_bHandleOverflow = true;
+                return 0;
+            }
+            return static_cast<NodeHandle>( m_nNodesInUse++ );
         }
 
         /// Allocates leaf information
@@ -192,9 +273,16 @@ namespace TinyRT
                 m_nLeafArraySize*=2;
             }
 
+            // as in BuyNode, the builder is given the sentinel leaf to write to if the handle type overflows
+            if( static_cast<uint64>( m_nLeafsInUse ) >= static_cast<uint64>( LEAF_FLAG ) )
+            {
+                m_bHandleOverflow = true;
+                return EMPTY_LEAF;
+            }
+
             m_nLeafsInUse++;
-            uint32 n = m_nLeafsInUse-1;
-            return ( n | 0x80000000 );
+            NodeHandle n = static_cast<NodeHandle>( m_nLeafsInUse-1 );
+            return ( n | LEAF_FLAG );
         };
 
         /// Obtains a QBVH node pointer
@@ -208,23 +296,25 @@ namespace TinyRT
         inline LeafObjects* LookupLeaf( NodeHandle nNode ) 
         {
             TRT_ASSERT( IsNodeLeaf( nNode ) );
-            return &m_pLeafObjects[nNode & 0x7fffffff ];
+            return &m_pLeafObjects[nNode & ~LEAF_FLAG ];
         }
         inline const LeafObjects* LookupLeaf( NodeHandle nNode ) const 
         {
             TRT_ASSERT( IsNodeLeaf( nNode ) );
-            return &m_pLeafObjects[nNode & 0x7fffffff ];
+            return &m_pLeafObjects[nNode & ~LEAF_FLAG ];
         }
 
         LeafObjects* m_pLeafObjects;
-        uint32 m_nLeafArraySize;
-        uint32 m_nLeafsInUse;
+        size_t m_nLeafArraySize;
+        size_t m_nLeafsInUse;
 
         Node* m_pNodes;
-        uint32 m_nNodeArraySize;
-        uint32 m_nNodesInUse;
+        size_t m_nNodeArraySize;
+        size_t m_nNodesInUse;
 
         uint32 m_nStackDepth;
+        bool m_bOwnsMemory;         ///< False if the nodes and leaves belong to an attached file
+        bool m_bHandleOverflow;     ///< Set during construction if the tree has more nodes or leaves than its handles can address
     };
 }
 
@@ -25,10 +25,10 @@ namespace TinyRT
 
     //=====================================================================================================================
     //=====================================================================================================================
-    template< class ObjectSet_T >
-    QuadAABBTree<ObjectSet_T>::QuadAABBTree( )
+    template< class ObjectSet_T, class HandleTraits_T >
+    QuadAABBTree<ObjectSet_T,HandleTraits_T>::QuadAABBTree( )
     : m_pNodes(0), m_nNodeArraySize(1), m_nNodesInUse(1),
-      m_pLeafObjects(0), m_nLeafArraySize(1), m_nLeafsInUse(1)
+      m_pLeafObjects(0), m_nLeafArraySize(1), m_nLeafsInUse(1), m_bOwnsMemory(true), m_bHandleOverflow(false)
     {
         // allocate a sentinal leaf to point empty leaf pointers at
         m_pLeafObjects = new LeafObjects[1];
@@ -43,9 +43,12 @@ namespace TinyRT
 
     //=====================================================================================================================
     //=====================================================================================================================
-    template< class ObjectSet_T >
-    QuadAABBTree<ObjectSet_T>::~QuadAABBTree( )
+    template< class ObjectSet_T, class HandleTraits_T >
+    QuadAABBTree<ObjectSet_T,HandleTraits_T>::~QuadAABBTree( )
     {
+        if( !m_bOwnsMemory )
+            return;
+
         if( m_pNodes )
             AlignedFree( m_pNodes );
         if( m_pLeafObjects )
@@ -59,17 +62,19 @@ namespace TinyRT
     //
     //=====================================================================================================================
 
-    template< class ObjectSet_T >
+    template< class ObjectSet_T, class HandleTraits_T >
     template< class QAABBBuilder_T >
-    void QuadAABBTree<ObjectSet_T>::Build( ObjectSet_T* pObjects, QAABBBuilder_T& rBuilder )
+    bool QuadAABBTree<ObjectSet_T,HandleTraits_T>::Build( ObjectSet_T* pObjects, QAABBBuilder_T& rBuilder )
     {
+        m_bHandleOverflow = false;
         m_nStackDepth = rBuilder.BuildQuadAABBTree( pObjects, this );
+        return FinishBuild();
     }
 
     //=====================================================================================================================
     //=====================================================================================================================
-    template< class ObjectSet_T >
-    void QuadAABBTree<ObjectSet_T>::GetNodeObjectRange( NodeHandle n, obj_id& rFirst, obj_id& rLast ) const
+    template< class ObjectSet_T, class HandleTraits_T >
+    void QuadAABBTree<ObjectSet_T,HandleTraits_T>::GetNodeObjectRange( NodeHandle n, obj_id& rFirst, obj_id& rLast ) const
     {
         const LeafObjects* pLeaf = LookupLeaf( n );
         rFirst = pLeaf->nFirstObj;
@@ -78,8 +83,8 @@ namespace TinyRT
 
     //=====================================================================================================================
     //=====================================================================================================================
-    template< class ObjectSet_T >
-    typename QuadAABBTree<ObjectSet_T>::NodeHandle QuadAABBTree<ObjectSet_T>::SubdivideChild( NodeHandle nNode, uint32 nChild )
+    template< class ObjectSet_T, class HandleTraits_T >
+    typename QuadAABBTree<ObjectSet_T,HandleTraits_T>::NodeHandle QuadAABBTree<ObjectSet_T,HandleTraits_T>::SubdivideChild( NodeHandle nNode, uint32 nChild )
     {
         NodeHandle nChildNode = BuyNode();
         Node* pNode = LookupNode( nNode );
@@ -95,8 +100,8 @@ namespace TinyRT
     /// \param nA1      Axis dividing the first two children
     /// \param nA2      Axis dividing the last two children
     //=====================================================================================================================
-    template< class ObjectSet_T >
-    void QuadAABBTree<ObjectSet_T>::SetSplitAxes( NodeHandle nNode, uint32 nA0, uint32 nA1, uint32 nA2 )
+    template< class ObjectSet_T, class HandleTraits_T >
+    void QuadAABBTree<ObjectSet_T,HandleTraits_T>::SetSplitAxes( NodeHandle nNode, uint32 nA0, uint32 nA1, uint32 nA2 )
     {
         Node* pNode = LookupNode( nNode );
       
@@ -137,8 +142,8 @@ namespace TinyRT
 
     //=====================================================================================================================
     //=====================================================================================================================
-    template< class ObjectSet_T >
-    void QuadAABBTree<ObjectSet_T>::CreateLeafChild( NodeHandle nNode, uint32 nChildIdx, obj_id nFirstObject, obj_id nObjects )
+    template< class ObjectSet_T, class HandleTraits_T >
+    void QuadAABBTree<ObjectSet_T,HandleTraits_T>::CreateLeafChild( NodeHandle nNode, uint32 nChildIdx, obj_id nFirstObject, obj_id nObjects )
     {
         Node* pNode = LookupNode( nNode );
         pNode->m_children[nChildIdx] = BuyLeaf();
@@ -151,8 +156,8 @@ namespace TinyRT
 
     //=====================================================================================================================
     //=====================================================================================================================
-    template< class ObjectSet_T >
-    void QuadAABBTree<ObjectSet_T>::CreateEmptyLeafChild( NodeHandle nNode, uint32 nChildIdx )
+    template< class ObjectSet_T, class HandleTraits_T >
+    void QuadAABBTree<ObjectSet_T,HandleTraits_T>::CreateEmptyLeafChild( NodeHandle nNode, uint32 nChildIdx )
     {
         Node* pNode = LookupNode( nNode );
         pNode->m_children[nChildIdx] = EMPTY_LEAF;
@@ -161,8 +166,37 @@ namespace TinyRT
 
     //=====================================================================================================================
     //=====================================================================================================================
-    template< class ObjectSet_T >
-    void QuadAABBTree<ObjectSet_T>::SetChildAABB( NodeHandle nNode, uint32 nChildIdx, const AxisAlignedBox& rBox )
+    template< class ObjectSet_T, class HandleTraits_T >
+    void QuadAABBTree<ObjectSet_T,HandleTraits_T>::CreateEmptyLeafChildren( NodeHandle nNode, uint32 nFirstEmpty, const AxisAlignedBox& rBox )
+    {
+        for( uint32 i=nFirstEmpty; i<BRANCH_FACTOR; i++ )
+        {
+            SetChildAABB( nNode, i, rBox );
+            CreateEmptyLeafChild( nNode, i );
+        }
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T >
+    void QuadAABBTree<ObjectSet_T,HandleTraits_T>::SetChildTraversalOrder( NodeHandle nNode, uint nRayOctant, const uint32* pOrder, uint32 nChildren )
+    {
+        TRT_ASSERT( nChildren <= BRANCH_FACTOR );
+
+        // the first child visited ends up in the highest order bits
+        uint8 nOrder = 0;
+        for( uint32 i=0; i<nChildren; i++ )
+            nOrder = static_cast<uint8>( ( nOrder << 2 ) | pOrder[i] );
+        for( uint32 i=nChildren; i<BRANCH_FACTOR; i++ )
+            nOrder = static_cast<uint8>( ( nOrder << 2 ) | i );
+
+        SetChildTraversalOrder( nNode, nRayOctant, nOrder );
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T >
+    void QuadAABBTree<ObjectSet_T,HandleTraits_T>::SetChildAABB( NodeHandle nNode, uint32 nChildIdx, const AxisAlignedBox& rBox )
     {
         Node* pNode = LookupNode( nNode );
         for(int i=0; i<3; i++ )
@@ -182,14 +216,14 @@ namespace TinyRT
     ///                        This encodes the octant index of the ray
     /// \return The node stack
     //=====================================================================================================================
-    template< class ObjectSet_T >
+    template< class ObjectSet_T, class HandleTraits_T >
     template< class Ray_T >
     TRT_FORCEINLINE
-    typename QuadAABBTree<ObjectSet_T>::ConstNodeHandle* QuadAABBTree<ObjectSet_T>::RayIntersectChildren( ConstNodeHandle nNode, 
-                                                                                                        const SimdVec4f vSIMDRay[6],                                                                                                   
-                                                                                                        const Ray_T& rRay, 
-                                                                                                       ConstNodeHandle* pStack, 
-                                                                                                       const int nDirSigns[4] ) const
+    typename QuadAABBTree<ObjectSet_T,HandleTraits_T>::ConstNodeHandle* QuadAABBTree<ObjectSet_T,HandleTraits_T>::RayIntersectChildren( ConstNodeHandle nNode, 
+                                                                                                                                      const SimdVec4f vSIMDRay[6],                                                                                                   
+                                                                                                                                      const Ray_T& rRay, 
+                                                                                                                                     ConstNodeHandle* pStack, 
+                                                                                                                                     const int nDirSigns[4] ) const
     {
         Node* pNode = LookupNode( nNode );
         
@@ -219,20 +253,320 @@ namespace TinyRT
         return pStack;
     }
 
+    //=====================================================================================================================
+    /// This is equivalent to RayIntersectChildren, but the slab selection and traversal order lookup are resolved at compile time
+    /// \param nNode    The node to be tested
+    /// \param vSIMDRay Pre-swizzled ray information.  See RayQuadAABBTest
+    /// \param rRay     The ray
+    /// \param pStack   The traversal stack.  Each time a hit is found, it is placed on the stack, and the stack is incremented
+    /// \param OCTANT   The ray's octant, as returned by GetRayOctant
+    /// \return The node stack
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T >
+    template< int OCTANT, class Ray_T >
+    TRT_FORCEINLINE
+    typename QuadAABBTree<ObjectSet_T,HandleTraits_T>::ConstNodeHandle* QuadAABBTree<ObjectSet_T,HandleTraits_T>::RayIntersectChildrenOctant( ConstNodeHandle nNode, 
+                                                                                                                                            const SimdVec4f vSIMDRay[6],
+                                                                                                                                            const Ray_T& rRay, 
+                                                                                                                                            ConstNodeHandle* pStack ) const
+    {
+        Node* pNode = LookupNode( nNode );
+        
+        int nHit = RayQuadAABBTestOctant<OCTANT>( pNode->m_bbox, vSIMDRay, rRay ) & pNode->m_intersectMask;
+        if( !nHit )
+            return pStack;
+
+        int nOrder = pNode->m_traversalOrder[OCTANT];
+        for(int i=0; i<4; i++ )
+        {
+            uint nChild = nOrder & 3;
+            *pStack = pNode->m_children[nChild];
+            pStack += (( nHit >> nChild ) & 1);
+            nOrder >>= 2;
+        }
+
+        return pStack;
+    }
+
     //=====================================================================================================================
     //=====================================================================================================================
-    template< class ObjectSet_T >
-    inline void QuadAABBTree<ObjectSet_T>::GetMemoryUsage( size_t& rnBytesUsed, size_t& rnBytesAllocated ) const
+    template< class ObjectSet_T, class HandleTraits_T >
+    inline void QuadAABBTree<ObjectSet_T,HandleTraits_T>::GetMemoryUsage( size_t& rnBytesUsed, size_t& rnBytesAllocated ) const
     {
         rnBytesUsed = m_nNodesInUse*sizeof(Node) + m_nLeafsInUse*sizeof(LeafObjects);
         rnBytesAllocated = m_nNodeArraySize*sizeof(Node) + m_nLeafArraySize*sizeof(LeafObjects);
     }
 
+    //=====================================================================================================================
+    /// \param pObjects    The object set used to build the tree.  Object IDs must not have changed since the tree was built
+    /// \sa SAHQualityMonitor
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T >
+    void QuadAABBTree<ObjectSet_T,HandleTraits_T>::Refit( const ObjectSet_T* pObjects )
+    {
+        MakeMemoryWritable();
+
+        AxisAlignedBox box;
+        RefitNode( pObjects, GetRoot(), true, box );
+    }
+
+    //=====================================================================================================================
+    /// The upper levels of the tree are split into a set of independent subtrees, which are refit in parallel.  
+    ///  The nodes above these subtrees are then refit on the calling thread.
+    /// \param pObjects    The object set used to build the tree.  Its 'GetObjectAABB' method must be thread-safe
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T >
+    void QuadAABBTree<ObjectSet_T,HandleTraits_T>::RefitParallel( const ObjectSet_T* pObjects )
+    {
+        MakeMemoryWritable();
+
+        // expand the tree breadth-first until there are enough subtrees to keep all threads busy
+        size_t nTargetSubtrees = 8*GetParallelThreadCount();
+        
+        std::vector<NodeHandle> subtrees( 1, GetRoot() );
+        std::vector<NodeHandle> innerNodes;
+        std::vector<NodeHandle> nextLevel;
+        while( !subtrees.empty() && subtrees.size() < nTargetSubtrees )
+        {
+            nextLevel.clear();
+            for( size_t i=0; i<subtrees.size(); i++ )
+            {
+                const Node* pNode = LookupNode( subtrees[i] );
+                innerNodes.push_back( subtrees[i] );
+                for( uint32 j=0; j<BRANCH_FACTOR; j++ )
+                {
+                    if( !IsNodeLeaf( pNode->m_children[j] ) )
+                        nextLevel.push_back( pNode->m_children[j] );
+                }
+            }
+
+            subtrees.swap( nextLevel );
+        }
+
+        // refit the subtrees in parallel
+        int nSubtrees = static_cast<int>( subtrees.size() );
+
+        #pragma omp parallel for schedule(dynamic)
+        for( int i=0; i<nSubtrees; i++ )
+        {
+            AxisAlignedBox box;
+            RefitNode( pObjects, subtrees[i], true, box );
+        }
+
+        // refit everything above the subtrees, using the child boxes that the subtrees computed.
+        // inner nodes were collected level by level, so walking the list backwards visits children before parents
+        for( size_t i=innerNodes.size(); i > 0; i-- )
+        {
+            AxisAlignedBox box;
+            RefitNode( pObjects, innerNodes[i-1], false, box );
+        }
+    }
+
+    //=====================================================================================================================
+    /// \param pFileName     Name of the file to write
+    /// \param pObjectRemap  Optional remap table, as returned by RemapRecorder::GetRemap
+    /// \param nObjects      Number of entries in the remap table
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T >
+    bool QuadAABBTree<ObjectSet_T,HandleTraits_T>::Save( const char* pFileName, const obj_id* pObjectRemap, obj_id nObjects ) const
+    {
+        SerializedTreeHeader header;
+        const void* pSections[SERIALIZED_SECTION_COUNT] = { NULL };
+        GetSerializedSections( header, pSections, pObjectRemap, nObjects );
+        return WriteSerializedTree( pFileName, header, pSections );
+    }
+
+    //=====================================================================================================================
+    /// \param pBuffer       Buffer to receive the tree.  Must be aligned to TRT_SIMD_ALIGNMENT if it is to be attached
+    /// \param nBufferSize   Size of the buffer
+    /// \param pObjectRemap  Optional remap table, as returned by RemapRecorder::GetRemap
+    /// \param nObjects      Number of entries in the remap table
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T >
+    size_t QuadAABBTree<ObjectSet_T,HandleTraits_T>::SaveToBuffer( void* pBuffer, size_t nBufferSize, const obj_id* pObjectRemap, obj_id nObjects ) const
+    {
+        SerializedTreeHeader header;
+        const void* pSections[SERIALIZED_SECTION_COUNT] = { NULL };
+        GetSerializedSections( header, pSections, pObjectRemap, nObjects );
+        return CopySerializedTree( pBuffer, nBufferSize, header, pSections );
+    }
+
+    //=====================================================================================================================
+    /// \param pData    Start of the data written by 'Save' (typically a memory mapped file).  Must be aligned to TRT_SIMD_ALIGNMENT
+    /// \param nSize    Size of the data
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T >
+    bool QuadAABBTree<ObjectSet_T,HandleTraits_T>::Attach( const void* pData, size_t nSize )
+    {
+        const SerializedTreeHeader* pHeader = ReadSerializedTreeHeader( pData, nSize, SERIALIZED_QUADAABBTREE, sizeof(Node), sizeof(obj_id) );
+        if( !pHeader )
+            return false;
+
+        size_t nNodeBytes, nLeafBytes;
+        const void* pNodes = GetSerializedSection( pHeader, SERIALIZED_SECTION_NODES, nNodeBytes );
+        const void* pLeaves = GetSerializedSection( pHeader, SERIALIZED_SECTION_LEAVES, nLeafBytes );
+        // the high halves of the counts are only non-zero for trees which use LargeTreeHandles
+        size_t nNodes = static_cast<size_t>( pHeader->nParams[0] | ( static_cast<uint64>( pHeader->nParams[2] ) << 32 ) );
+        size_t nLeaves = static_cast<size_t>( pHeader->nParams[1] | ( static_cast<uint64>( pHeader->nParams[3] ) << 32 ) );
+        if( !pNodes || !pLeaves || nNodes == 0 || nLeaves == 0 ||
+            nNodeBytes != nNodes*sizeof(Node) || nLeafBytes != nLeaves*sizeof(LeafObjects) )
+            return false;
+
+        if( m_bOwnsMemory )
+        {
+            AlignedFree( m_pNodes );
+            delete[] m_pLeafObjects;
+        }
+
+        m_pNodes = const_cast<Node*>( reinterpret_cast<const Node*>( pNodes ) );
+        m_pLeafObjects = const_cast<LeafObjects*>( reinterpret_cast<const LeafObjects*>( pLeaves ) );
+        m_nNodesInUse = nNodes;
+        m_nNodeArraySize = nNodes;
+        m_nLeafsInUse = nLeaves;
+        m_nLeafArraySize = nLeaves;
+        m_nStackDepth = pHeader->nStackDepth;
+        m_bOwnsMemory = false;
+        return true;
+    }
+
     //=====================================================================================================================
     //
     //            Private Methods
     //
     //=====================================================================================================================
 
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T >
+    void QuadAABBTree<ObjectSet_T,HandleTraits_T>::GetSerializedSections( SerializedTreeHeader& rHeader, const void* pSections[SERIALIZED_SECTION_COUNT],
+                                                                          const obj_id* pObjectRemap, obj_id nObjects ) const
+    {
+        memset( &rHeader, 0, sizeof(rHeader) );
+        rHeader.nStructureType = SERIALIZED_QUADAABBTREE;
+        rHeader.nObjIdSize = sizeof(obj_id);
+        rHeader.nNodeSize = sizeof(Node);
+        rHeader.nStackDepth = m_nStackDepth;
+        rHeader.nParams[0] = static_cast<uint32>( m_nNodesInUse );
+        rHeader.nParams[1] = static_cast<uint32>( m_nLeafsInUse );
+        rHeader.nParams[2] = static_cast<uint32>( static_cast<uint64>( m_nNodesInUse ) >> 32 );
+        rHeader.nParams[3] = static_cast<uint32>( static_cast<uint64>( m_nLeafsInUse ) >> 32 );
+        rHeader.sections[SERIALIZED_SECTION_NODES].nSize = m_nNodesInUse*sizeof(Node);
+        rHeader.sections[SERIALIZED_SECTION_LEAVES].nSize = m_nLeafsInUse*sizeof(LeafObjects);
+        rHeader.sections[SERIALIZED_SECTION_REMAP].nSize = nObjects*sizeof(obj_id);
+
+        pSections[SERIALIZED_SECTION_NODES] = m_pNodes;
+        pSections[SERIALIZED_SECTION_LEAVES] = m_pLeafObjects;
+        pSections[SERIALIZED_SECTION_REMAP] = pObjectRemap;
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T >
+    bool QuadAABBTree<ObjectSet_T,HandleTraits_T>::FinishBuild()
+    {
+        if( !m_bHandleOverflow )
+            return true;
+
+        // leave an empty tree behind, whose root has only empty children.  The sentinel leaf may have been written to
+        m_bHandleOverflow = false;
+        m_nNodesInUse = 1;
+        m_nLeafsInUse = 1;
+        m_pLeafObjects[0].nFirstObj = 0;
+        m_pLeafObjects[0].nLastObj = 0;
+        CreateEmptyLeafChildren( GetRoot(), 0, AxisAlignedBox( Vec3f( std::numeric_limits<float>::max() ), 
+                                                               Vec3f( -std::numeric_limits<float>::max() ) ) );
+        m_nStackDepth = 1;
+        return false;
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T >
+    void QuadAABBTree<ObjectSet_T,HandleTraits_T>::MakeMemoryWritable()
+    {
+        if( m_bOwnsMemory )
+            return;
+
+        Node* pNodes = reinterpret_cast<Node*>( AlignedMalloc( sizeof(Node)*m_nNodeArraySize, SimdVec4f::ALIGN ) );
+        memcpy( static_cast<void*>( pNodes ), m_pNodes, sizeof(Node)*m_nNodesInUse );
+        m_pNodes = pNodes;
+
+        LeafObjects* pLeafs = new LeafObjects[m_nLeafArraySize];
+        memcpy( pLeafs, m_pLeafObjects, sizeof(LeafObjects)*m_nLeafsInUse );
+        m_pLeafObjects = pLeafs;
+
+        m_bOwnsMemory = true;
+    }
+
+    //=====================================================================================================================
+    /// \param pObjects    The object set
+    /// \param nNode       The node whose child boxes are to be recomputed
+    /// \param bRecurse    If true, inner children are refit recursively.  If false, the boxes of inner children are
+    ///                      computed from their own (already refit) child boxes
+    /// \param rBoxOut     Receives the union of the non-empty child boxes
+    /// \return False if all of the node's children are empty
+    //=====================================================================================================================
+    template< class ObjectSet_T, class HandleTraits_T >
+    bool QuadAABBTree<ObjectSet_T,HandleTraits_T>::RefitNode( const ObjectSet_T* pObjects, NodeHandle nNode, bool bRecurse, AxisAlignedBox& rBoxOut )
+    {
+        bool bNonEmpty = false;
+        for( uint32 i=0; i<BRANCH_FACTOR; i++ )
+        {
+            NodeHandle nChild = LookupNode( nNode )->m_children[i];
+            
+            AxisAlignedBox box;
+            if( IsNodeLeaf( nChild ) )
+            {
+                obj_id nFirst, nLast;
+                GetNodeObjectRange( nChild, nFirst, nLast );
+                if( nFirst == nLast )
+                    continue;   // empty leaf
+                
+                pObjects->GetObjectAABB( nFirst, box );
+                while( ++nFirst != nLast )
+                {
+                    AxisAlignedBox objBox;
+                    pObjects->GetObjectAABB( nFirst, objBox );
+                    box.Merge( objBox );
+                }
+            }
+            else if( bRecurse )
+            {
+                if( !RefitNode( pObjects, nChild, true, box ) )
+                    continue;
+            }
+            else
+            {
+                // merge the grandchild boxes
+                uint nMask = GetEmptyLeafMask( nChild );
+                if( !nMask )
+                    continue;
+
+                bool bFirst = true;
+                for( uint32 j=0; j<BRANCH_FACTOR; j++ )
+                {
+                    if( nMask & (1<<j) )
+                    {
+                        AxisAlignedBox childBox;
+                        GetChildAABB( nChild, j, childBox );
+                        if( bFirst )
+                            box = childBox;
+                        else
+                            box.Merge( childBox );
+                        bFirst = false;
+                    }
+                }
+            }
+
+            SetChildAABB( nNode, i, box );
+            if( bNonEmpty )
+                rBoxOut.Merge( box );
+            else
+                rBoxOut = box;
+            bNonEmpty = true;
+        }
+
+        return bNonEmpty;
+    }
 
 }
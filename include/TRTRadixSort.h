@@ -0,0 +1,219 @@
+//=====================================================================================================================
+//
+//   TRTRadixSort.h
+//
+//   Definition of class: TinyRT::RadixSorter
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_RADIXSORT_H_
+#define _TRT_RADIXSORT_H_
+
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Converts a float to an unsigned integer key which sorts in the same order as the float
+    ///
+    ///  Positive floats have their sign bit set, and negative floats have all of their bits flipped, so that larger
+    ///   magnitudes sort lower.  NaNs sort above (or below) all other values.  -0 and +0 produce the same key, since
+    ///   they compare equal.
+    //=====================================================================================================================
+    inline uint32 FloatToRadixKey( float f )
+    {
+        union { float f; uint32 n; } bits;
+        bits.f = f + 0.0f; // -0 + 0 = +0
+        uint32 nMask = static_cast<uint32>( -static_cast<int32>( bits.n >> 31 ) ) | 0x80000000;
+        return bits.n ^ nMask;
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Inverse of FloatToRadixKey (except that -0 becomes +0)
+    //=====================================================================================================================
+    inline float RadixKeyToFloat( uint32 nKey )
+    {
+        union { float f; uint32 n; } bits;
+        uint32 nMask = ( static_cast<uint32>( -static_cast<int32>( nKey >> 31 ) ) ^ 0xffffffff ) | 0x80000000;
+        bits.n = nKey ^ nMask;
+        return bits.f;
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Sorts arrays of key/value pairs using an LSD radix sort
+    ///
+    ///  The sort is stable, and makes one pass over the data for each byte of the key.  Passes in which every key has
+    ///   the same digit are skipped, so keys which do not use all of their bits are cheaper to sort.  Large arrays are
+    ///   divided into blocks which are histogrammed and scattered in parallel (see TRTParallel.h).  Small arrays are
+    ///   insertion sorted instead, since the histogram passes would dominate.
+    ///
+    ///  The sorter keeps its scratch memory between sorts, so that a builder which sorts many small arrays can re-use it.
+    ///
+    ///  Float keys must be converted with FloatToRadixKey.  Keys containing more than one field can be sorted by
+    ///   packing them into a single integer with the most significant field in the highest bits.
+    ///
+    /// \param Key_T    Unsigned integer key type
+    /// \param Value_T  Value type.  Must be default constructible and copyable
+    //=====================================================================================================================
+    template< class Key_T, class Value_T >
+    class RadixSorter
+    {
+    public:
+
+        inline RadixSorter() : m_nScratchSize(0) {};
+
+        //=====================================================================================================================
+        /// \brief Sorts key/value pairs by ascending key
+        /// \param pKeys    Array of keys.  These are sorted in place
+        /// \param pValues  Array of values.  These are re-ordered along with the keys
+        /// \param nCount   Number of pairs to sort
+        //=====================================================================================================================
+        inline void Sort( Key_T* pKeys, Value_T* pValues, size_t nCount )
+        {
+            if( nCount <= INSERTION_SORT_CUTOFF )
+            {
+                InsertionSort( pKeys, pValues, nCount );
+                return;
+            }
+
+            if( m_nScratchSize < nCount )
+            {
+                m_pKeyScratch.reallocate( nCount );
+                m_pValueScratch.reallocate( nCount );
+                m_nScratchSize = nCount;
+            }
+
+            // divide large arrays into one block per thread
+            int nBlocks = 1;
+            if( nCount >= PARALLEL_CUTOFF )
+                nBlocks = static_cast<int>( std::min( GetParallelThreadCount(), static_cast<uint32>( MAX_BLOCKS ) ) );
+
+            Key_T* pKeysIn = pKeys;
+            Value_T* pValuesIn = pValues;
+            Key_T* pKeysOut = m_pKeyScratch;
+            Value_T* pValuesOut = m_pValueScratch;
+
+            for( uint32 nShift=0; nShift < 8*sizeof(Key_T); nShift += RADIX_BITS )
+            {
+                // count the digits in each block
+                #pragma omp parallel for schedule(static) if( nBlocks > 1 )
+                for( int b=0; b<nBlocks; b++ )
+                {
+                    size_t* pCounts = m_nOffsets[b];
+                    for( uint32 i=0; i<BUCKET_COUNT; i++ )
+                        pCounts[i] = 0;
+
+                    size_t nEnd = BlockStart( b+1, nBlocks, nCount );
+                    for( size_t i = BlockStart( b, nBlocks, nCount ); i < nEnd; i++ )
+                        pCounts[ ( pKeysIn[i] >> nShift ) & ( BUCKET_COUNT-1 ) ]++;
+                }
+
+                // skip this digit if every key has the same value for it
+                if( GetBucketTotal( ( pKeysIn[0] >> nShift ) & ( BUCKET_COUNT-1 ), nBlocks ) == nCount )
+                    continue;
+
+                // convert the counts to output positions.  Each block writes after the previous blocks' keys in the same bucket
+                size_t nOffset = 0;
+                for( uint32 i=0; i<BUCKET_COUNT; i++ )
+                {
+                    for( int b=0; b<nBlocks; b++ )
+                    {
+                        size_t nBucketCount = m_nOffsets[b][i];
+                        m_nOffsets[b][i] = nOffset;
+                        nOffset += nBucketCount;
+                    }
+                }
+
+                // scatter
+                #pragma omp parallel for schedule(static) if( nBlocks > 1 )
+                for( int b=0; b<nBlocks; b++ )
+                {
+                    size_t* pOffsets = m_nOffsets[b];
+                    size_t nEnd = BlockStart( b+1, nBlocks, nCount );
+                    for( size_t i = BlockStart( b, nBlocks, nCount ); i < nEnd; i++ )
+                    {
+                        size_t nDst = pOffsets[ ( pKeysIn[i] >> nShift ) & ( BUCKET_COUNT-1 ) ]++;
+                        pKeysOut[nDst] = pKeysIn[i];
+                        pValuesOut[nDst] = pValuesIn[i];
+                    }
+                }
+
+                std::swap( pKeysIn, pKeysOut );
+                std::swap( pValuesIn, pValuesOut );
+            }
+
+            // an odd number of passes leaves the results in the scratch arrays
+            if( pKeysIn != pKeys )
+            {
+                std::copy( pKeysIn, pKeysIn + nCount, pKeys );
+                std::copy( pValuesIn, pValuesIn + nCount, pValues );
+            }
+        };
+
+        /// Returns the amount of scratch memory held by the sorter
+        inline size_t GetMemoryUsage() const { return sizeof(RadixSorter) + m_nScratchSize*( sizeof(Key_T) + sizeof(Value_T) ); };
+
+    private:
+
+        enum
+        {
+            RADIX_BITS = 8,
+            BUCKET_COUNT = 1<<RADIX_BITS,
+            INSERTION_SORT_CUTOFF = 32,     ///< Arrays this size or smaller are insertion sorted
+            PARALLEL_CUTOFF = 1<<16,        ///< Arrays smaller than this are sorted on the calling thread
+            MAX_BLOCKS = 16                 ///< Maximum number of blocks sorted in parallel
+        };
+
+        /// Returns the index of the first element in a block
+        static inline size_t BlockStart( int nBlock, int nBlocks, size_t nCount ) { return ( nCount / nBlocks ) * nBlock + std::min( nCount % nBlocks, static_cast<size_t>( nBlock ) ); };
+
+        /// Returns the number of keys in a particular bucket, summed over all blocks
+        inline size_t GetBucketTotal( size_t nBucket, int nBlocks ) const
+        {
+            size_t nTotal = 0;
+            for( int b=0; b<nBlocks; b++ )
+                nTotal += m_nOffsets[b][nBucket];
+            return nTotal;
+        };
+
+        static inline void InsertionSort( Key_T* pKeys, Value_T* pValues, size_t nCount )
+        {
+            for( size_t i=1; i<nCount; i++ )
+            {
+                Key_T nKey = pKeys[i];
+                Value_T value = pValues[i];
+                size_t j = i;
+                while( j > 0 && nKey < pKeys[j-1] )
+                {
+                    pKeys[j] = pKeys[j-1];
+                    pValues[j] = pValues[j-1];
+                    j--;
+                }
+                pKeys[j] = nKey;
+                pValues[j] = value;
+            }
+        };
+
+        /// Disallow copies
+        inline RadixSorter( const RadixSorter& ) {};
+        inline RadixSorter& operator=( const RadixSorter& ) { return *this; };
+
+        ScopedArray<Key_T> m_pKeyScratch;
+        ScopedArray<Value_T> m_pValueScratch;
+        size_t m_nScratchSize;
+
+        size_t m_nOffsets[MAX_BLOCKS][BUCKET_COUNT];   ///< Per-block digit counts, then output positions
+    };
+
+}
+
+#endif // _TRT_RADIXSORT_H_
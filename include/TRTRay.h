@@ -73,6 +73,13 @@ namespace TinyRT
         
         /// Modifies the ray origin
         inline void SetOrigin( const Vec3f& rOrigin ) { m_origin = rOrigin; };
+
+        /// Modifies the ray direction, and recomputes its reciprocal
+        inline void SetDirection( const Vec3f& rDirection ) 
+        { 
+            m_direction = rDirection;
+            m_invDirection = Vec3f( 1.0f / rDirection.x, 1.0f / rDirection.y, 1.0f / rDirection.z );
+        };
         
     private:
 
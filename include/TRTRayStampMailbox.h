@@ -0,0 +1,110 @@
+//=====================================================================================================================
+//
+//   TRTRayStampMailbox.h
+//
+//   Definition of class: TinyRT::RayStampMailbox
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_RAYSTAMPMAILBOX_H_
+#define _TRT_RAYSTAMPMAILBOX_H_
+
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A per-object array of ray stamps, used by RayStampMailbox
+    ///
+    ///  Each ray receives a new stamp.  An object has been tested by a ray if its entry holds that ray's stamp.  Since the
+    ///   stamps are never reused (until the 32-bit counter wraps, when the array is cleared), the array never needs 
+    ///   to be cleared between rays.
+    //=====================================================================================================================
+    class RayStampTable
+    {
+    public:
+
+        inline RayStampTable( ) : m_nLastStamp( 0 ) {};
+
+        /// Returns a stamp for a new ray, and makes room for objects whose IDs are less than 'nObjects'
+        inline uint32 BeginRay( size_t nObjects )
+        {
+            if( m_stamps.size() < nObjects )
+                m_stamps.resize( nObjects, 0 );
+
+            if( ++m_nLastStamp == 0 )
+            {
+                // the counter wrapped.  Stamps from old rays could match new ones, so they must be cleared
+                std::fill( m_stamps.begin(), m_stamps.end(), 0 );
+                m_nLastStamp = 1;
+            }
+            return m_nLastStamp;
+        };
+
+        /// Returns the stamp of the last ray which tested a particular object
+        inline uint32& operator[]( size_t nObject ) { return m_stamps[nObject]; };
+
+        /// Returns the amount of memory used by the table, in bytes
+        inline size_t GetMemoryUsage() const { return m_stamps.capacity()*sizeof(uint32); };
+
+    private:
+
+        std::vector<uint32> m_stamps;
+        uint32 m_nLastStamp;
+    };
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A mailbox which stores the ID of the last ray that tested each object
+    ///
+    ///  Unlike the cache-based mailboxes, this one never reports an object as untested when it has been tested by the
+    ///   same ray.  This matters for KD-trees and grids, which reference objects that straddle cell boundaries from many 
+    ///   leaves.  The cost is one 32-bit stamp per object, per thread.  Each thread uses its own table
+    ///   (see ThreadLocalInstance), so the object set must be small enough for a table per thread to be acceptable.  
+    ///   HashedRayStampMailbox is an alternative for very large object sets.
+    ///
+    ///  Nested traversals on the same thread (for example, through an InstanceSet) share the table.  This is safe, but
+    ///   the outer ray may repeat a few intersection tests after the inner ray overwrites its stamps.
+    ///
+    ///  This class implements the Mailbox_C concept
+    //=====================================================================================================================
+    template< class ObjectRef_T >
+    class RayStampMailbox
+    {
+    public:
+
+        /// \param ObjectSet_T  Must implement the ObjectSet_C concept
+        template< class ObjectSet_T >
+        inline RayStampMailbox( const ObjectSet_T* pObjects ) : m_rTable( ThreadLocalInstance<RayStampTable>::Get() )
+        {
+            m_nStamp = m_rTable.BeginRay( pObjects->GetObjectCount() );
+        };
+
+        //=====================================================================================================================
+        //=====================================================================================================================
+        inline bool CheckMailbox( const ObjectRef_T& nID )
+        {
+            uint32& rStamp = m_rTable[ static_cast<size_t>( nID ) ];
+            if( rStamp == m_nStamp )
+                return true;
+
+            rStamp = m_nStamp;
+            return false;
+        };
+
+    private:
+
+        RayStampTable& m_rTable;
+        uint32 m_nStamp;
+    };
+
+}
+
+#endif // _TRT_RAYSTAMPMAILBOX_H_
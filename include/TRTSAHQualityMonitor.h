@@ -0,0 +1,88 @@
+//=====================================================================================================================
+//
+//   TRTSAHQualityMonitor.h
+//
+//   Definition of class: TinyRT::SAHQualityMonitor
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_SAHQUALITYMONITOR_H_
+#define _TRT_SAHQUALITYMONITOR_H_
+
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Tracks the degradation of a refitted tree, in order to decide when it should be rebuilt
+    ///
+    ///  Refitting a tree after its objects move is much cheaper than rebuilding it, but the tree's quality will gradually
+    ///   degrade as the objects drift away from their original positions.  This class compares the SAH cost of a refitted
+    ///   tree with the cost of the tree when it was last built, and reports when the ratio exceeds a threshold.
+    ///
+    ///  Evaluating the SAH cost requires a full tree traversal, which is roughly as expensive as the refit itself.
+    ///
+    /// \param CostFunction_T Must implement the CostFunction_C concept
+    //=====================================================================================================================
+    template< class CostFunction_T >
+    class SAHQualityMonitor
+    {
+    public:
+
+        /// \param rCostFunc            Per-object cost function used to evaluate the tree
+        /// \param fRebuildThreshold    Ratio of current cost to original cost at which a rebuild is recommended
+        inline SAHQualityMonitor( const CostFunction_T& rCostFunc, float fRebuildThreshold = 1.3f ) 
+            : m_costFunc( rCostFunc ), m_fThreshold( fRebuildThreshold ), m_fReferenceCost(0), m_fCurrentCost(0) {};
+
+        /// Records the cost of a freshly built tree.  Returns the cost
+        inline float Reset( float fCost ) { m_fReferenceCost = fCost; m_fCurrentCost = fCost; return fCost; };
+
+        /// Records the cost of a freshly built AABB tree.  Returns the cost
+        template< class ObjectSet_T >
+        inline float Reset( const AABBTree<ObjectSet_T>* pTree ) { return Reset( GetAABBTreeSAHCost( m_costFunc, pTree, pTree->GetRoot() ) ); };
+        
+        /// Records the cost of a freshly built QBVH.  Returns the cost
+        template< class ObjectSet_T, class HandleTraits_T >
+        inline float Reset( const QuadAABBTree<ObjectSet_T,HandleTraits_T>* pTree ) { return Reset( GetQuadAABBTreeSAHCost( m_costFunc, pTree, pTree->GetRoot() ) ); };
+
+        /// Records the cost of a refitted tree.  Returns the degradation ratio
+        inline float Update( float fCost ) { m_fCurrentCost = fCost; return GetDegradation(); };
+
+        /// Records the cost of a refitted AABB tree.  Returns the degradation ratio
+        template< class ObjectSet_T >
+        inline float Update( const AABBTree<ObjectSet_T>* pTree ) { return Update( GetAABBTreeSAHCost( m_costFunc, pTree, pTree->GetRoot() ) ); };
+
+        /// Records the cost of a refitted QBVH.  Returns the degradation ratio
+        template< class ObjectSet_T, class HandleTraits_T >
+        inline float Update( const QuadAABBTree<ObjectSet_T,HandleTraits_T>* pTree ) { return Update( GetQuadAABBTreeSAHCost( m_costFunc, pTree, pTree->GetRoot() ) ); };
+
+        /// Returns the SAH cost of the tree when it was last built
+        inline float GetReferenceCost() const { return m_fReferenceCost; };
+
+        /// Returns the SAH cost of the tree when it was last refit
+        inline float GetCurrentCost() const { return m_fCurrentCost; };
+
+        /// Returns the ratio of the current SAH cost to the original cost.  1.0 means no degradation
+        inline float GetDegradation() const { return ( m_fReferenceCost > 0 ) ? m_fCurrentCost / m_fReferenceCost : 1.0f; };
+
+        /// Tests whether the tree has degraded enough that it ought to be rebuilt
+        inline bool NeedsRebuild() const { return GetDegradation() > m_fThreshold; };
+
+    private:
+
+        CostFunction_T m_costFunc;
+        float m_fThreshold;
+        float m_fReferenceCost;
+        float m_fCurrentCost;
+    };
+
+}
+
+#endif // _TRT_SAHQUALITYMONITOR_H_
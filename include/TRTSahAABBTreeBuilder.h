@@ -30,6 +30,17 @@ namespace TinyRT
     /// \param CostFunction_T Must implement the CostFunction_C concept. 
     ///                         The cost function should return the cost of a ray-object intersection test, 
     ///                         relative to the cost of a node traversal
+    ///
+    ///  By default, each QuadAABBTree node is built from two levels of binary SAH splits.  If 'bDirectQuadSplits' is set,
+    ///   the builder instead partitions the objects greedily into up to four children, and uses the SAH cost of the
+    ///   4-ary node to decide whether to subdivide.  Children which are not worth subdividing become leaves in place,
+    ///   and a child slot is left empty only if there are too few objects to fill it.  This generally yields fewer nodes.
+    ///
+    ///  'fQuadNodeCost' is the cost of traversing one 4-ary node in the direct build, in the same units as the cost function.
+    ///   The binary build charges 2 per node.  A 4-ary node tests its four boxes with one set of SIMD instructions, but must
+    ///   also order and push up to four children, and it stands in for a binary node and its two children, of which a
+    ///   ray usually visits two.  The default of 3 lies between the cost of one and two binary nodes.  Larger values
+    ///   give shallower trees with larger leaves.  It has no effect unless 'bDirectQuadSplits' is set.
     //=====================================================================================================================
     template< class ObjectSet_T, class CostFunction_T = ConstantCost<typename ObjectSet_T::obj_id> >
     class SahAABBTreeBuilder 
@@ -39,7 +50,7 @@ namespace TinyRT
         typedef ObjectSet_T ObjectSet;
         typedef typename ObjectSet::obj_id   obj_id;
 
-        inline SahAABBTreeBuilder( const CostFunction_T& rCost );
+        inline SahAABBTreeBuilder( const CostFunction_T& rCost, bool bDirectQuadSplits=false, float fQuadNodeCost=3.0f );
 
         /// Builds an AABB tree
         template< class AABBTree_T >
@@ -49,6 +60,15 @@ namespace TinyRT
         template< class QAABBTree_T >
         uint32 BuildQuadAABBTree( ObjectSet* pObjects, QAABBTree_T* pTree );
 
+        /// Adds the builder type, its parameters, and the cost function to a hash.  Used by BuildCache to identify the build parameters
+        inline void HashParameters( ContentHash& rHash ) const 
+        { 
+            rHash.AddString( "SahAABBTreeBuilder" ); 
+            rHash.AddValue( m_bDirectQuadSplits ); 
+            rHash.AddValue( m_fQuadNodeCost ); 
+            m_costFunc.HashParameters( rHash ); 
+        };
+
 
     private:
 
@@ -56,23 +76,43 @@ namespace TinyRT
         {
             AxisAlignedBox box;
             obj_id nID;
+            float fCost;            ///< Intersection cost of this object, from the cost function
             obj_id nSortIndices[3]; ///< Position of this object in a sorted ordering along each axis
         };
 
+        /// Describes the best binary split of a set of objects
+        struct Split
+        {
+            int nAxis;                  ///< Split axis, or -1 if the objects cannot be split
+            obj_id nSplitId;            ///< Sort index of the last object on the left side
+            float fCost;                ///< SAH cost of the split
+            AxisAlignedBox rightBox;    ///< Bounding box of the objects on the right side
+        };
+
+        /// Maximum number of children in a QuadAABBTree node
+        static const uint32 QUAD_BRANCH_FACTOR = 4;
 
-        /// Functor for sorting object structures along an axis
-        template< int axis >
-        class SortObjects
+        /// A child of a QuadAABBTree node, during direct 4-way partitioning
+        struct QuadChild
         {
-        public:
+            Object** objectsByAxis[3];
+            obj_id nObjects;
+            obj_id nFirstObject;
+            AxisAlignedBox box;
+            float fLeafCost;            ///< Sum of the intersection costs of the objects in this child
+            Split split;                ///< Best binary split of the objects in this child
+        };
 
-            inline bool operator()( const Object* a, const Object* b ) const
-            {
-                return ( (a->box.Min()[axis]+a->box.Max()[axis]) < 
-                         (b->box.Min()[axis]+b->box.Max()[axis]) );
-            };
+        /// The children of a QuadAABBTree node, and the sequence of binary splits that produced them
+        struct QuadPartition
+        {
+            QuadChild children[QUAD_BRANCH_FACTOR];
+            uint32 nChildren;
+            uint32 nSplitChildren[QUAD_BRANCH_FACTOR-1];   ///< Child that was split.  The right side becomes child i+1
+            uint32 nSplitAxes[QUAD_BRANCH_FACTOR-1];       ///< Axis of each split
         };
 
+
         /// Functor for partitioning sorted object lists along an axis
         class PartitionObjects
         {
@@ -121,6 +161,14 @@ namespace TinyRT
         /// Performs preprocessing on the object set to build the data structures needed for tree construction
         void SetupObjectInfo( ObjectSet* pObjects, std::vector<Object>& rObjects, std::vector<Object*> objectPtrs[3], AxisAlignedBox& rGlobalBB );
 
+        /// \brief Finds the lowest-cost binary split of a set of objects.  Returns the sum of the object intersection costs
+        /// The cost of a split is: fTraversalCost + (left area*left cost + right area*right cost)*fInvArea
+        float FindBestSplit( Object** objectsByAxis[3], obj_id nObjects, float fTraversalCost, float fInvArea, Split& rSplit );
+
+        /// Partitions the sorted object lists according to a split, and computes the bounding box of the left side
+        void PartitionSplit( Object** objectsByAxis[3], obj_id nObjects, const Split& rSplit,
+                             Object** objectsRight[3], obj_id& rnObjectsLeft, AxisAlignedBox& rLeftBox );
+
         int SplitObjects( Object** objectsByAxis[3],
                           const AxisAlignedBox& rBox,
                           obj_id nObjects,
@@ -158,8 +206,19 @@ namespace TinyRT
                                   obj_id  nFirstObject,
                                   uint32& nSplitAxisOut );
 
+        /// Initializes a child for direct 4-way partitioning
+        void SetupQuadChild( Object** objectsByAxis[3], obj_id nObjects, obj_id nFirstObject, const AxisAlignedBox& rBox, QuadChild& rChild );
+
+        /// \brief Partitions the objects in a child (set up by 'SetupQuadChild') into the children of a QuadAABBTree node.  
+        /// Returns false if it is cheaper to place the objects in a leaf
+        bool PartitionQuad( const QuadChild& rNode, QuadPartition& rPartition );
+
+        template< typename QAABBTree_T >
+        uint32 BuildQAABBRecurse_Direct( QAABBTree_T* pTree, typename QAABBTree_T::NodeHandle pNode, QuadPartition& rPartition );
 
         CostFunction_T m_costFunc;
+        bool m_bDirectQuadSplits;   ///< Partition QuadAABBTree nodes using the 4-ary SAH cost
+        float m_fQuadNodeCost;      ///< Cost of traversing a QuadAABBTree node, for direct 4-ary partitioning
     };
 }
 
@@ -24,8 +24,8 @@ namespace TinyRT
 
 
     template< typename ObjectSet_T, typename CostFunction_T >
-    SahAABBTreeBuilder<ObjectSet_T, CostFunction_T>::SahAABBTreeBuilder( const CostFunction_T& rCost  ) 
-        : m_costFunc(rCost)
+    SahAABBTreeBuilder<ObjectSet_T, CostFunction_T>::SahAABBTreeBuilder( const CostFunction_T& rCost, bool bDirectQuadSplits, float fQuadNodeCost ) 
+        : m_costFunc(rCost), m_bDirectQuadSplits(bDirectQuadSplits), m_fQuadNodeCost(fQuadNodeCost)
     {
     }
 
@@ -106,15 +106,36 @@ namespace TinyRT
         
         Object** objectsByAxis[3] = { &(objectPtrs[0][0]), &(objectPtrs[1][0]), &(objectPtrs[2][0]) };
 
-        obj_id nObjectsLeft;
-        obj_id nObjectsRight;
-        AxisAlignedBox leftBox;
-        AxisAlignedBox rightBox;
-        Object** objectsRight[3];
-        int nAxis0 = SplitObjects( objectsByAxis, globalBox, nObjects, objectsRight, nObjectsLeft, nObjectsRight, leftBox, rightBox );
-        
-        uint32 nDepth = 1;
-        if( nAxis0 == -1 )
+        uint32 nDepth = 0;
+        if( m_bDirectQuadSplits )
+        {
+            QuadChild root;
+            SetupQuadChild( objectsByAxis, nObjects, 0, globalBox, root );
+
+            QuadPartition partition;
+            if( PartitionQuad( root, partition ) )
+                nDepth = BuildQAABBRecurse_Direct( pTree, pRoot, partition );
+        }
+        else
+        {
+            obj_id nObjectsLeft;
+            obj_id nObjectsRight;
+            AxisAlignedBox leftBox;
+            AxisAlignedBox rightBox;
+            Object** objectsRight[3];
+            int nAxis0 = SplitObjects( objectsByAxis, globalBox, nObjects, objectsRight, nObjectsLeft, nObjectsRight, leftBox, rightBox );
+            if( nAxis0 != -1 )
+            {
+                uint32 nAxis1, nAxis2;
+                uint32 nDepthLeft = BuildQAABBRecurse_Odd( objectsByAxis, nObjectsLeft, pTree, pRoot, 0, leftBox, 0, nAxis1 );
+                uint32 nDepthRight = BuildQAABBRecurse_Odd( objectsRight, nObjectsRight, pTree,pRoot, 2, rightBox, nObjectsLeft, nAxis2 );
+                pTree->SetSplitAxes( pRoot, nAxis0, nAxis1, nAxis2 );
+
+                nDepth = 1 + std::max( nDepthLeft, nDepthRight );
+            }
+        }
+
+        if( nDepth == 0 )
         {
             // this means its better not to split at all, but to just create a flat list
             pTree->SetChildAABB( pRoot, 0, globalBox );
@@ -124,35 +145,26 @@ namespace TinyRT
             pTree->CreateEmptyLeafChild( pRoot, 3 );
             return 1;
         }
-        else
-        {
-            uint32 nAxis1, nAxis2;
-            uint32 nDepthLeft = BuildQAABBRecurse_Odd( objectsByAxis, nObjectsLeft, pTree, pRoot, 0, leftBox, 0, nAxis1 );
-            uint32 nDepthRight = BuildQAABBRecurse_Odd( objectsRight, nObjectsRight, pTree,pRoot, 2, rightBox, nObjectsLeft, nAxis2 );
-            pTree->SetSplitAxes( pRoot, nAxis0, nAxis1, nAxis2 );
-
-            uint32 nDepth = 1 + std::max( nDepthLeft, nDepthRight );
             
-            // free up some memory.  We only need one set of pointers now 
-            objectPtrs[0].clear();
-            objectPtrs[1].clear();
-
-            // construct an object remapping table
-            std::vector<obj_id> objectRemap;
-            objectRemap.resize( nObjects );
-            for( size_t i=0; i<nObjects; i++ )
-            {
-                objectRemap[i] = objectPtrs[2][i]->nID;
-            }
+        // free up some memory.  We only need one set of pointers now 
+        objectPtrs[0].clear();
+        objectPtrs[1].clear();
+
+        // construct an object remapping table
+        std::vector<obj_id> objectRemap;
+        objectRemap.resize( nObjects );
+        for( size_t i=0; i<nObjects; i++ )
+        {
+            objectRemap[i] = objectPtrs[2][i]->nID;
+        }
 
-            // don't need these anymore, so free up some memory
-            objects.clear();
-            objectPtrs[2].clear();
+        // don't need these anymore, so free up some memory
+        objects.clear();
+        objectPtrs[2].clear();
 
-            // put the objects in the right order
-            pObjects->RemapObjects( &objectRemap[0] );
-            return nDepth;
-        }        
+        // put the objects in the right order
+        pObjects->RemapObjects( &objectRemap[0] );
+        return nDepth;
     }
 
     //=====================================================================================================================
@@ -183,6 +195,7 @@ namespace TinyRT
         // initialize the first object's information
         pObjects->GetObjectAABB( 0, objects[0].box );
         objects[0].nID = 0;
+        objects[0].fCost = m_costFunc( 0 );
         objectPtrs[0][0] = &objects[0];
         objectPtrs[1][0] = &objects[0];
         objectPtrs[2][0] = &objects[0];
@@ -194,6 +207,7 @@ namespace TinyRT
         {
             pObjects->GetObjectAABB( i, objects[i].box );
             objects[i].nID = i;
+            objects[i].fCost = m_costFunc( i );
             objectPtrs[0][i] = &objects[i];
             objectPtrs[1][i] = &objects[i];
             objectPtrs[2][i] = &objects[i];
@@ -202,11 +216,15 @@ namespace TinyRT
             rGlobalBB.Merge( objects[i].box );
         }
 
-        // sort the pointer lists
-        SortObjects<0> x; SortObjects<1> y; SortObjects<2> z;
-        std::sort( objectPtrs[0].begin(), objectPtrs[0].end(), x );
-        std::sort( objectPtrs[1].begin(), objectPtrs[1].end(), y );
-        std::sort( objectPtrs[2].begin(), objectPtrs[2].end(), z );
+        // sort the pointer lists by box centroid
+        RadixSorter<uint32,Object*> sorter;
+        ScopedArray<uint32> sortKeys( new uint32[nObjects] );
+        for( uint32 nAxis=0; nAxis<3; nAxis++ )
+        {
+            for( obj_id i=0; i<nObjects; i++ )
+                sortKeys[i] = FloatToRadixKey( objects[i].box.Min()[nAxis] + objects[i].box.Max()[nAxis] );
+            sorter.Sort( &sortKeys[0], &objectPtrs[nAxis][0], nObjects );
+        }
         
         // fill in the sort indices in the object structures
         typename std::vector<Object*>::iterator itX = objectPtrs[0].begin();
@@ -227,39 +245,23 @@ namespace TinyRT
  
     //=====================================================================================================================
     /// \param objectsByAxis    Lists of objects, sorted along each axis
-    /// \param rBox             Root AABB of subtree being constructed
     /// \param nObjects         Number of objects
-    /// \param objectsRight     Array which receives pointers to the objects on the right side, sorted along each axis
-    /// \param rnObjectsLeft     Receives the number of objects on the left side
-    /// \param rnObjectsRight    Receives the number of objects on the right side
-    /// \param rLeftBox         Receives the left side AABB
-    /// \param rRightBox        Receives the right side AABB
-    /// \return The axis on which the objects are split.  -1 if it is decided not to split
+    /// \param fTraversalCost   Cost which is added to the cost of each split
+    /// \param fInvArea         Factor by which the area-weighted costs of the two sides are scaled
+    /// \param rSplit           Receives the lowest cost split.  rSplit.nAxis is -1 if no split was found
+    /// \return The sum of the intersection costs of the objects (the cost of making a leaf)
     //=====================================================================================================================
     template< class ObjectSet_T, class CostFunction_T >
-    int SahAABBTreeBuilder<ObjectSet_T, CostFunction_T>::SplitObjects( Object** objectsByAxis[3],
-                                                       const AxisAlignedBox& rBox,
-                                                       obj_id nObjects,
-                                                       Object** objectsRight[3],
-                                                       obj_id&  rnObjectsLeft,
-                                                       obj_id&  rnObjectsRight,
-                                                       AxisAlignedBox& rLeftBox,
-                                                       AxisAlignedBox& rRightBox )
+    float SahAABBTreeBuilder<ObjectSet_T, CostFunction_T>::FindBestSplit( Object** objectsByAxis[3], obj_id nObjects, 
+                                                                          float fTraversalCost, float fInvArea, Split& rSplit )
     {
-        if( nObjects == 1 )
-            return -1; // do not split a single object
-
         TRT_ASSERT( nObjects > 1 );
-        
-        Vec3f vBoxSizes = rBox.Max() - rBox.Min();
-        float fRootArea = ( vBoxSizes.x * ( vBoxSizes.y + vBoxSizes.z ) + vBoxSizes.y*vBoxSizes.z );
-        float fInvRootArea = 1.0f / fRootArea;
 
-        // split information, initialized to the cost of creating a leaf
-        float fBestCost =0;
-        int nSplitAxis = -1;
-        obj_id nSplitId = 0;
-        AxisAlignedBox splitRightBox;
+        float fLeafCost = 0;
+        float fBestCost = std::numeric_limits<float>::max();
+        rSplit.nAxis = -1;
+        rSplit.nSplitId = 0;
+        rSplit.rightBox = AxisAlignedBox( Vec3f(0,0,0), Vec3f(0,0,0) );
 
         // left subtree costs resulting from putting all objects > i on the right side 
         //   - first entry is the cost of having only the leftmost object on the left side
@@ -281,7 +283,7 @@ namespace TinyRT
                 
                 Vec3f vLeftSize = leftBox.Max() - leftBox.Min();
                 float fLeftArea = ( vLeftSize.x * ( vLeftSize.y + vLeftSize.z ) + vLeftSize.y*vLeftSize.z );
-                fTotalCost +=  m_costFunc( objectsByAxis[axis][i]->nID );
+                fTotalCost += objectsByAxis[axis][i]->fCost;
                 leftCosts[i] = fLeftArea*fTotalCost;
             }
 
@@ -289,7 +291,7 @@ namespace TinyRT
             AxisAlignedBox rightBox = objectsByAxis[axis][nObjects-1]->box;
             
             if( axis == 0 )
-                fBestCost = fTotalCost; // we now have the sum of the object ISect costs.  Use that as the 'no-split' cost
+                fLeafCost = fTotalCost; // we now have the sum of the object ISect costs.  Use that as the 'no-split' cost
             
             fTotalCost = 0;
 
@@ -301,35 +303,43 @@ namespace TinyRT
                 Vec3f vRightSize = rightBox.Max() - rightBox.Min();
                 float fRightArea = ( vRightSize.x * ( vRightSize.y + vRightSize.z ) + vRightSize.y*vRightSize.z );
 
-                fTotalCost += m_costFunc( (*it)->nID );
-                float fCost = 2.0f + ( leftCosts[i] + (fRightArea*fTotalCost)) * fInvRootArea ;
+                fTotalCost += (*it)->fCost;
+                float fCost = fTraversalCost + ( leftCosts[i] + (fRightArea*fTotalCost)) * fInvArea ;
                 
                 // if this split is better than the previous one, save it
                 if( fCost < fBestCost )
                 {
                     fBestCost = fCost;
-                    nSplitAxis = axis;
-                    nSplitId = (*it)->nSortIndices[axis];
-                    splitRightBox = rightBox;        
+                    rSplit.nAxis = axis;
+                    rSplit.nSplitId = (*it)->nSortIndices[axis];
+                    rSplit.rightBox = rightBox;        
                 }
         
                 rightBox.Merge( (*it)->box ); 
             }
         }
 
-        // we have now figured out what to do (split or not split)
-        if( nSplitAxis == -1 )
-        {
-            // do not split
-            return -1;
-        }
+        rSplit.fCost = fBestCost;
+        return fLeafCost;
+    }
 
-        // split
+    //=====================================================================================================================
+    /// \param objectsByAxis    Lists of objects, sorted along each axis
+    /// \param nObjects         Number of objects
+    /// \param rSplit           The split to perform
+    /// \param objectsRight     Array which receives pointers to the objects on the right side, sorted along each axis
+    /// \param rnObjectsLeft    Receives the number of objects on the left side
+    /// \param rLeftBox         Receives the left side AABB
+    //=====================================================================================================================
+    template< class ObjectSet_T, class CostFunction_T >
+    void SahAABBTreeBuilder<ObjectSet_T, CostFunction_T>::PartitionSplit( Object** objectsByAxis[3], obj_id nObjects, const Split& rSplit,
+                                                                          Object** objectsRight[3], obj_id& rnObjectsLeft, AxisAlignedBox& rLeftBox )
+    {
         rLeftBox = AxisAlignedBox( Vec3f( std::numeric_limits<float>::max() ), 
                                    Vec3f( -std::numeric_limits<float>::max() ) );
             
-        PartitionObjects partF( nSplitAxis, nSplitId );
-        PartitionAndComputeBox partBoxF( nSplitAxis, nSplitId, &rLeftBox );
+        PartitionObjects partF( rSplit.nAxis, rSplit.nSplitId );
+        PartitionAndComputeBox partBoxF( rSplit.nAxis, rSplit.nSplitId, &rLeftBox );
         
         // partition the three sorted object lists, and get pointers to the first object on the right side 
         //  The first partitioning pass also computes the AABB of the left side. 
@@ -340,10 +350,54 @@ namespace TinyRT
         objectsRight[2] = std::stable_partition( objectsByAxis[2], objectsByAxis[2] + nObjects, partF );
 
         rnObjectsLeft = static_cast<obj_id>( objectsRight[0] - objectsByAxis[0] );
+    }
+
+    //=====================================================================================================================
+    /// \param objectsByAxis    Lists of objects, sorted along each axis
+    /// \param rBox             Root AABB of subtree being constructed
+    /// \param nObjects         Number of objects
+    /// \param objectsRight     Array which receives pointers to the objects on the right side, sorted along each axis
+    /// \param rnObjectsLeft     Receives the number of objects on the left side
+    /// \param rnObjectsRight    Receives the number of objects on the right side
+    /// \param rLeftBox         Receives the left side AABB
+    /// \param rRightBox        Receives the right side AABB
+    /// \return The axis on which the objects are split.  -1 if it is decided not to split
+    //=====================================================================================================================
+    template< class ObjectSet_T, class CostFunction_T >
+    int SahAABBTreeBuilder<ObjectSet_T, CostFunction_T>::SplitObjects( Object** objectsByAxis[3],
+                                                       const AxisAlignedBox& rBox,
+                                                       obj_id nObjects,
+                                                       Object** objectsRight[3],
+                                                       obj_id&  rnObjectsLeft,
+                                                       obj_id&  rnObjectsRight,
+                                                       AxisAlignedBox& rLeftBox,
+                                                       AxisAlignedBox& rRightBox )
+    {
+        if( nObjects == 1 )
+            return -1; // do not split a single object
+
+        TRT_ASSERT( nObjects > 1 );
+        
+        Vec3f vBoxSizes = rBox.Max() - rBox.Min();
+        float fRootArea = ( vBoxSizes.x * ( vBoxSizes.y + vBoxSizes.z ) + vBoxSizes.y*vBoxSizes.z );
+        float fInvRootArea = 1.0f / fRootArea;
+
+        Split split;
+        float fLeafCost = FindBestSplit( objectsByAxis, nObjects, 2.0f, fInvRootArea, split );
+
+        // we have now figured out what to do (split or not split)
+        if( split.nAxis == -1 || !( split.fCost < fLeafCost ) )
+        {
+            // do not split
+            return -1;
+        }
+
+        // split
+        PartitionSplit( objectsByAxis, nObjects, split, objectsRight, rnObjectsLeft, rLeftBox );
         rnObjectsRight = nObjects - rnObjectsLeft;
 
-        rRightBox = splitRightBox;
-        return nSplitAxis;
+        rRightBox = split.rightBox;
+        return split.nAxis;
     }
 
 
@@ -430,6 +484,7 @@ namespace TinyRT
         if( nAxis0 != -1 )
         {
             // it makes sense to subdivide the objects, split this child node and build subtrees recursively
+            pTree->SetChildAABB( pNode, nChild, rBox );
             NodeHandle pLeaf = pTree->SubdivideChild( pNode, nChild );
 
             uint32 nAxis1, nAxis2;
@@ -479,9 +534,6 @@ namespace TinyRT
         if( nAxis != -1 )
         {
             // recursively build on either side of the node
-            pTree->SetChildAABB( pNode, nChild, rBox );
-            pTree->SetChildAABB( pNode, nChild+1, rBox );
-            
             uint32 nDepth1 = BuildQAABBRecurse_Even( objectsByAxis, nObjectsLeft, pTree, pNode, nChild, leftBox, nFirstObject );
             uint32 nDepth2 = BuildQAABBRecurse_Even( objectsRight, nObjectsRight, pTree, pNode, nChild+1, rightBox, nFirstObject+nObjectsLeft );
             rSplitAxis = nAxis;
@@ -498,5 +550,176 @@ namespace TinyRT
         }       
     }
 
+    //=====================================================================================================================
+    /// \param objectsByAxis    Lists of objects, sorted along each axis
+    /// \param nObjects         Number of objects
+    /// \param nFirstObject     Index of the first object (in the reordered object set)
+    /// \param rBox             Bounding box of the objects
+    /// \param rChild           The child to initialize
+    //=====================================================================================================================
+    template< class ObjectSet_T, typename CostFunction_T >
+    void SahAABBTreeBuilder<ObjectSet_T,CostFunction_T>::SetupQuadChild( Object** objectsByAxis[3], obj_id nObjects, obj_id nFirstObject,
+                                                                          const AxisAlignedBox& rBox, QuadChild& rChild )
+    {
+        rChild.objectsByAxis[0] = objectsByAxis[0];
+        rChild.objectsByAxis[1] = objectsByAxis[1];
+        rChild.objectsByAxis[2] = objectsByAxis[2];
+        rChild.nObjects = nObjects;
+        rChild.nFirstObject = nFirstObject;
+        rChild.box = rBox;
+
+        if( nObjects == 1 )
+        {
+            // a single object cannot be split
+            rChild.fLeafCost = objectsByAxis[0][0]->fCost;
+            rChild.split.nAxis = -1;
+        }
+        else
+        {
+            // split costs are not normalized, so that they can be compared across children
+            rChild.fLeafCost = FindBestSplit( objectsByAxis, nObjects, 0.0f, 1.0f, rChild.split );
+        }
+    }
+
+    //=====================================================================================================================
+    /// The objects are split greedily.  At each step, the child whose best binary split gives the largest reduction in
+    ///  the SAH cost of the node is split, until the node is full, or no split reduces the cost.  Each child is costed
+    ///  as though it were a leaf.  Since all of the children of a node are tested at once, the cost of the node does not
+    ///  depend on how many children it has.
+    ///
+    ///  The node's own best split was found when it was set up as a child of its parent, so it is not searched for again.
+    ///
+    /// \param rNode            The objects to partition.  Their sorted object lists are partitioned among the children
+    /// \param rPartition       Receives the children
+    /// \return True if the SAH cost of the node is lower than the cost of placing the objects in a leaf
+    //=====================================================================================================================
+    template< class ObjectSet_T, typename CostFunction_T >
+    bool SahAABBTreeBuilder<ObjectSet_T,CostFunction_T>::PartitionQuad( const QuadChild& rNode, QuadPartition& rPartition )
+    {
+        rPartition.children[0] = rNode;
+        rPartition.nChildren = 1;
+
+        float fLeafCost = rNode.fLeafCost;
+        if( rNode.nObjects == 1 )
+            return false;
+
+        while( rPartition.nChildren < QUAD_BRANCH_FACTOR )
+        {
+            // pick the child whose split reduces the cost the most
+            int nBest = -1;
+            float fBestGain = 0.0f;
+            for( uint32 i=0; i<rPartition.nChildren; i++ )
+            {
+                const QuadChild& rChild = rPartition.children[i];
+                if( rChild.split.nAxis == -1 )
+                    continue;
+
+                float fGain = HalfArea( rChild.box )*rChild.fLeafCost - rChild.split.fCost;
+                if( fGain > fBestGain )
+                {
+                    fBestGain = fGain;
+                    nBest = static_cast<int>( i );
+                }
+            }
+
+            if( nBest == -1 )
+                break; // no split is worth making
+
+            // split it.  The left side stays where it is, and the right side becomes a new child
+            QuadChild& rChild = rPartition.children[nBest];
+            Object** objectsRight[3];
+            obj_id nObjectsLeft;
+            AxisAlignedBox leftBox;
+            PartitionSplit( rChild.objectsByAxis, rChild.nObjects, rChild.split, objectsRight, nObjectsLeft, leftBox );
+
+            AxisAlignedBox rightBox = rChild.split.rightBox;
+            uint32 nSplit = rPartition.nChildren - 1;
+            rPartition.nSplitChildren[nSplit] = static_cast<uint32>( nBest );
+            rPartition.nSplitAxes[nSplit] = static_cast<uint32>( rChild.split.nAxis );
+
+            SetupQuadChild( objectsRight, rChild.nObjects - nObjectsLeft, rChild.nFirstObject + nObjectsLeft, rightBox, 
+                            rPartition.children[rPartition.nChildren] );
+            SetupQuadChild( rChild.objectsByAxis, nObjectsLeft, rChild.nFirstObject, leftBox, rChild );
+            rPartition.nChildren++;
+        }
+
+        if( rPartition.nChildren == 1 )
+            return false;
+
+        // compare the SAH cost of the node to the cost of a leaf
+        float fChildCost = 0;
+        for( uint32 i=0; i<rPartition.nChildren; i++ )
+            fChildCost += HalfArea( rPartition.children[i].box ) * rPartition.children[i].fLeafCost;
+
+        float fNodeCost = m_fQuadNodeCost + fChildCost / HalfArea( rNode.box );
+        return fNodeCost < fLeafCost;
+    }
+
+    //=====================================================================================================================
+    /// \param pTree        The tree being constructed
+    /// \param pNode        The node whose children are being constructed
+    /// \param rPartition   Partitioning of the node's objects among its children
+    /// \return The depth of the subtree rooted at this node
+    //=====================================================================================================================
+    template< class ObjectSet_T, typename CostFunction_T >
+    template< class QAABBTree_T >
+    uint32 SahAABBTreeBuilder<ObjectSet_T,CostFunction_T>::BuildQAABBRecurse_Direct( QAABBTree_T* pTree, typename QAABBTree_T::NodeHandle pNode,
+                                                                                      QuadPartition& rPartition )
+    {
+        typedef typename QAABBTree_T::NodeHandle NodeHandle;
+
+        // derive the child ordering for each octant by replaying the splits
+        for( uint32 nOctant=0; nOctant<8; nOctant++ )
+        {
+            uint32 order[ QUAD_BRANCH_FACTOR ] = { 0 };
+            for( uint32 nSplit=0; nSplit+1<rPartition.nChildren; nSplit++ )
+            {
+                uint32 nLeft = rPartition.nSplitChildren[nSplit];
+                uint32 nRight = nSplit+1;
+                uint32 nPos = 0;
+                while( order[nPos] != nLeft )
+                    nPos++;
+
+                for( uint32 i=nSplit+1; i>nPos+1; i-- )
+                    order[i] = order[i-1];
+
+                if( ( nOctant >> rPartition.nSplitAxes[nSplit] ) & 1 )
+                {
+                    order[nPos] = nRight;
+                    order[nPos+1] = nLeft;
+                }
+                else
+                {
+                    order[nPos+1] = nRight;
+                }
+            }
+
+            pTree->SetChildTraversalOrder( pNode, nOctant, order, rPartition.nChildren );
+        }
+
+        // build the children.  Those which are not worth subdividing become leaves
+        uint32 nDepth = 1;
+        for( uint32 i=0; i<rPartition.nChildren; i++ )
+        {
+            QuadChild& rChild = rPartition.children[i];
+            pTree->SetChildAABB( pNode, i, rChild.box );
+
+            QuadPartition childPartition;
+            if( PartitionQuad( rChild, childPartition ) )
+            {
+                NodeHandle pChildNode = pTree->SubdivideChild( pNode, i );
+                nDepth = std::max( nDepth, BuildQAABBRecurse_Direct( pTree, pChildNode, childPartition ) );
+            }
+            else
+            {
+                pTree->CreateLeafChild( pNode, i, rChild.nFirstObject, rChild.nObjects );
+            }
+        }
+
+        pTree->CreateEmptyLeafChildren( pNode, rPartition.nChildren, rPartition.children[0].box );
+
+        return 1 + nDepth;
+    }
+
 
 }
@@ -52,6 +52,14 @@ namespace TinyRT
         /// Constructs a KD tree for the specified object set, returning its maximum depth
         template< class KDTree_T >
         inline uint BuildTree( ObjectSet_T* pObjects, KDTree_T* pTree );
+
+        /// Adds the builder type, clipper type, and cost function to a hash.  Used by BuildCache to identify the build parameters
+        inline void HashParameters( ContentHash& rHash ) const 
+        { 
+            rHash.AddString( "SahKDTreeBuilder" ); 
+            Clipper_T::HashParameters( rHash ); 
+            m_costFunc.HashParameters( rHash ); 
+        };
     
     private:
 
@@ -74,6 +82,7 @@ namespace TinyRT
         {
             AxisAlignedBox bbox;    ///< Bounding box of that portion of the object which intersects the split region
             obj_id nObject;         ///< ID of object in object set
+            float  fCost;           ///< Intersection cost of the object, from the cost function
             Side   eSide;           ///< Temporary variable used during classification.  Indicates which side of the split object is on
             ObjectInfo* pNext;      ///< Next object in the list
         };
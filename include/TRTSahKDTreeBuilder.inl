@@ -72,6 +72,7 @@ namespace TinyRT
         {
             pObjects->GetObjectAABB( i, pObjectInfo[i].bbox );
             pObjectInfo[i].nObject = i;
+            pObjectInfo[i].fCost = m_costFunc( i );
             pObjectInfo[i].pNext = &pObjectInfo[i+1];
             rootAABB.Merge( pObjectInfo[i].bbox );
         }
@@ -81,6 +82,9 @@ namespace TinyRT
         rObjectList.pHead = pObjectInfo;
 
         // create candidate split planes
+        //  Events are radix sorted on their position, then their type, so the key packs the type below the position
+        RadixSorter<uint64,SplitEvent> sorter;
+        ScopedArray<uint64> sortKeys( new uint64[2*nObjects] );
 
         // assign split events axis by axis
         for( uint axis=0; axis<3; axis++ )
@@ -119,7 +123,10 @@ namespace TinyRT
                 pObj = pObj->pNext;
             }
 
-            std::sort( pFirstEvent, pEvents, SortSplits() );
+            nEvents = static_cast<uint>( pEvents - pFirstEvent );
+            for( uint i=0; i<nEvents; i++ )
+                sortKeys[i] = ( static_cast<uint64>( FloatToRadixKey( pFirstEvent[i].fPosition ) ) << 2 ) | pFirstEvent[i].nEventType;
+            sorter.Sort( &sortKeys[0], pFirstEvent, nEvents );
             pEventLists[axis].pHead = pFirstEvent;
 
             while( pFirstEvent != pEvents )
@@ -263,7 +270,7 @@ namespace TinyRT
         ObjectInfo* pObj = rObjects.pHead;
         while( pObj )
         {
-            fTotalCost += m_costFunc( pObj->nObject );
+            fTotalCost += pObj->fCost;
             pObj = pObj->pNext;
         }
 
@@ -297,7 +304,7 @@ namespace TinyRT
 
                 do
                 {
-                    fCostThisPlane[pSplit->nEventType] += m_costFunc( pSplit->pObj->nObject );
+                    fCostThisPlane[pSplit->nEventType] += pSplit->pObj->fCost;
                     pSplit = pSplit->pNext;
 
                 } while( pSplit != NULL && pSplit->fPosition == fPlanePos );
@@ -517,6 +524,7 @@ namespace TinyRT
             TRT_ASSERT( oldBox.Contains( pL->bbox ) && oldBox.Contains( pR->bbox ) );
                         
             pR->nObject = pL->nObject; // copy object reference from old 'BOTH' list into new 'RIGHT' list
+            pR->fCost = pL->fCost;
 
             pLEnd = pL;      // keep a chase pointer so we can concatenate onto the lists at the end
             pREnd = pR;
@@ -35,7 +35,7 @@ namespace TinyRT
         /// Allocates memory
         uint8* Alloc( size_t nSize ) 
         {
-            nSize = (TRT_SIMD_ALIGNMENT + nSize) & ~(TRT_SIMD_ALIGNMENT); // round allocation size up to next multiple of SIMD align
+            nSize = RoundSize( nSize );
 
             // no space.  fail
             if( ((m_pNextAddr-m_pBaseAddr) + nSize) > m_nSize )
@@ -46,7 +46,7 @@ namespace TinyRT
             m_pNextAddr += nSize;
 
             // add a pool referene for each allocation
-            m_nRefCount++;
+            AtomicAdd( &m_nRefCount, 1 );
 
             return pAllocation;
         }
@@ -59,11 +59,10 @@ namespace TinyRT
             Release();
         }
 
-        /// Releases a reference to the pool
+        /// Releases a reference to the pool.  References may be released from any thread
         void Release()
         {
-            m_nRefCount--;
-            if( m_nRefCount == 0 )
+            if( AtomicAdd( &m_nRefCount, -1 ) == 1 )
             {
                 TinyRT::AlignedFree( m_pBaseAddr );
                 delete this;
@@ -72,6 +71,9 @@ namespace TinyRT
 
         inline size_t GetSize() const { return m_nSize; };
 
+        /// Rounds an allocation size up to the next multiple of the SIMD alignment
+        static inline size_t RoundSize( size_t nSize ) { return ( nSize + TRT_SIMD_ALIGNMENT - 1 ) & ~static_cast<size_t>( TRT_SIMD_ALIGNMENT - 1 ); };
+
     private:
 
         friend class ScratchMemory;
@@ -85,7 +87,7 @@ namespace TinyRT
         uint8* m_pBaseAddr;
         uint8* m_pNextAddr;
         size_t m_nSize;
-        size_t m_nRefCount;
+        volatile int32 m_nRefCount;
     };
 
 
@@ -98,7 +100,7 @@ namespace TinyRT
     ///  Using the scoped 'ScratchArray' template is an effective way to guarantee this.
     /// 
     ///  Scratch memory allocations are not thread safe.  If multiple threads are in use, each thread should use its own
-    ///   ScratchMemory instance.
+    ///   ScratchMemory instance.  Threads which cannot easily pass one around may use 'ThreadScratchMemory' instead.
     ///   
     //=====================================================================================================================
     class ScratchMemory
@@ -120,9 +122,10 @@ namespace TinyRT
             uint8* pMem = m_pStackPool->Alloc( nBytes );
             if( !pMem )
             {
-                // grow the pool and try again
+                // grow the pool and try again.  The new pool must have room for the rounded size, or the retry fails too
                 size_t nNewSize = m_pStackPool->GetSize()*2;
-                size_t nSize = ( nBytes > nNewSize ) ? nBytes : nNewSize; 
+                size_t nRounded = ScratchPool::RoundSize( nBytes );
+                size_t nSize = ( nRounded > nNewSize ) ? nRounded : nNewSize;
                 m_pStackPool->Release();
 
                 CreatePool( nSize );
@@ -144,6 +147,25 @@ namespace TinyRT
 
 
 
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Manages a ScratchMemory instance for each thread
+    ///
+    ///  The first call to 'Get' on a particular thread creates a scratch memory for that thread.  Subsequent calls on the
+    ///   same thread return the same instance, so the memory grows to the thread's high-water mark and is then re-used.
+    ///   No locks are taken, since each thread only ever touches its own instance.
+    ///
+    ///  On POSIX systems, the thread's scratch memory is destroyed automatically when the thread exits.  On Windows,
+    ///   threads which exit before the process does should call 'Release' to avoid leaking it.
+    ///
+    /// \sa ScratchMemory
+    /// \sa ThreadLocalInstance
+    //=====================================================================================================================
+    class ThreadScratchMemory : public ThreadLocalInstance<ScratchMemory>
+    {
+    };
+
+
     //=====================================================================================================================
     /// \ingroup TinyRT
     /// \brief A simple scoped array wrapper which uses TinyRT::ScratchMemory for allocation
@@ -0,0 +1,337 @@
+//=====================================================================================================================
+//
+//   TRTSerialization.h
+//
+//   Binary file format for pre-built acceleration structures
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_SERIALIZATION_H_
+#define _TRT_SERIALIZATION_H_
+
+#include <stdio.h>
+#ifdef _MSC_VER
+    #include <stddef.h> // for uintptr_t.  Older versions of VC++ do not provide stdint.h
+#else
+    #include <stdint.h> // for uintptr_t
+#endif
+
+namespace TinyRT
+{
+
+    /// Identifies a TinyRT acceleration structure file ('TRTS').  Files written on a machine with different endianness will not match
+    #define TRT_SERIALIZED_MAGIC 0x53545254
+
+    /// Version of the file format.  This must be incremented whenever the layout of the file, or of any serialized node type, changes
+    #define TRT_SERIALIZED_VERSION 1
+
+    /// Alignment of each section in the file, relative to the start of the file
+    #define TRT_SERIALIZED_ALIGNMENT 64
+
+    /// Types of acceleration structures which may be serialized
+    enum SerializedStructureType
+    {
+        SERIALIZED_AABBTREE     = 1,
+        SERIALIZED_QUADAABBTREE = 2,
+        SERIALIZED_KDTREE       = 3
+    };
+
+    /// Sections in a serialized file.  The meaning of each section depends on the structure type
+    enum SerializedSectionType
+    {
+        SERIALIZED_SECTION_NODES   = 0,     ///< Node array
+        SERIALIZED_SECTION_LEAVES  = 1,     ///< Leaf object ranges (QuadAABBTree) or object reference lists (KDTree)
+        SERIALIZED_SECTION_REMAP   = 2,     ///< Optional object remap table.  See 'RemapRecorder'
+        SERIALIZED_SECTION_COUNT   = 4
+    };
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Location of one section of a serialized file
+    //=====================================================================================================================
+    struct SerializedSection
+    {
+        uint64 nOffset;     ///< Offset from the start of the file, in bytes.  0 if the section is absent
+        uint64 nSize;       ///< Size of the section, in bytes
+    };
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Header at the start of a serialized acceleration structure
+    ///
+    ///  A serialized file consists of this header, followed by a set of sections, each of which is a raw copy of one of
+    ///   the structure's arrays.  All references between nodes are stored as indices, so the file can be used in place,
+    ///   at any address, without copying or fixing up pointers.  The node and object ID sizes are recorded so that
+    ///   files written with a different build configuration are rejected, rather than misinterpreted.
+    //=====================================================================================================================
+    struct SerializedTreeHeader
+    {
+        uint32 nMagic;              ///< Always TRT_SERIALIZED_MAGIC
+        uint32 nVersion;            ///< Always TRT_SERIALIZED_VERSION
+        uint32 nStructureType;      ///< One of the SerializedStructureType values
+        uint32 nObjIdSize;          ///< Size of the structure's obj_id type
+        uint32 nNodeSize;           ///< Size of the structure's node type
+        uint32 nStackDepth;         ///< Stack depth required for traversal
+        uint32 nParams[4];          ///< Structure-specific values
+        float  fBox[6];             ///< Root bounding box (min, then max).  Only used by some structures
+        SerializedSection sections[SERIALIZED_SECTION_COUNT];
+    };
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Computes the layout of a serialized acceleration structure
+    ///
+    ///  The caller fills in the structure-specific fields of the header, as well as the sizes of each section.  The
+    ///   remaining header fields, and the section offsets, are filled in by this function.
+    ///
+    /// \param rHeader      Header for the file.  Section offsets are computed by this function
+    /// \param pSections    Data for each section.  NULL entries (or sections with a size of 0) are omitted
+    /// \return The total size of the serialized data, in bytes
+    //=====================================================================================================================
+    inline uint64 LayoutSerializedTree( SerializedTreeHeader& rHeader, const void* pSections[SERIALIZED_SECTION_COUNT] )
+    {
+        rHeader.nMagic = TRT_SERIALIZED_MAGIC;
+        rHeader.nVersion = TRT_SERIALIZED_VERSION;
+
+        // lay out the sections after the header
+        uint64 nOffset = sizeof(SerializedTreeHeader);
+        for( uint32 i=0; i<SERIALIZED_SECTION_COUNT; i++ )
+        {
+            if( rHeader.sections[i].nSize == 0 || !pSections[i] )
+            {
+                rHeader.sections[i].nOffset = 0;
+                rHeader.sections[i].nSize = 0;
+                continue;
+            }
+
+            nOffset = ( nOffset + TRT_SERIALIZED_ALIGNMENT-1 ) & ~(uint64)(TRT_SERIALIZED_ALIGNMENT-1);
+            rHeader.sections[i].nOffset = nOffset;
+            nOffset += rHeader.sections[i].nSize;
+        }
+
+        return nOffset;
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Writes a serialized acceleration structure to a file
+    /// \param pFileName    Name of the file to write
+    /// \param rHeader      Header for the file.  See 'LayoutSerializedTree'
+    /// \param pSections    Data for each section
+    /// \return False if the file could not be written
+    //=====================================================================================================================
+    inline bool WriteSerializedTree( const char* pFileName, SerializedTreeHeader& rHeader, const void* pSections[SERIALIZED_SECTION_COUNT] )
+    {
+        LayoutSerializedTree( rHeader, pSections );
+
+        FILE* pFile = fopen( pFileName, "wb" );
+        if( !pFile )
+            return false;
+
+        bool bOK = ( fwrite( &rHeader, sizeof(rHeader), 1, pFile ) == 1 );
+
+        uint64 nWritten = sizeof(SerializedTreeHeader);
+        for( uint32 i=0; i<SERIALIZED_SECTION_COUNT && bOK; i++ )
+        {
+            if( rHeader.sections[i].nSize == 0 )
+                continue;
+
+            // pad up to the start of the section
+            const uint8 pad[TRT_SERIALIZED_ALIGNMENT] = { 0 };
+            size_t nPad = static_cast<size_t>( rHeader.sections[i].nOffset - nWritten );
+            if( nPad > 0 )
+                bOK = ( fwrite( pad, nPad, 1, pFile ) == 1 );
+
+            size_t nBytes = static_cast<size_t>( rHeader.sections[i].nSize );
+            bOK = bOK && ( fwrite( pSections[i], nBytes, 1, pFile ) == 1 );
+            nWritten = rHeader.sections[i].nOffset + nBytes;
+        }
+
+        return ( fclose( pFile ) == 0 ) && bOK;
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Copies a serialized acceleration structure into a memory buffer
+    ///
+    ///  The data is identical to what 'WriteSerializedTree' writes to a file.  This is used to place trees in memory
+    ///   that is shared between processes.  The header is written last, so a reader which validates it never sees
+    ///   partially written sections.  Readers in other processes should still wait for the segment to be published
+    ///   (see 'SharedMemory::Publish') rather than polling the header.
+    ///
+    /// \param pBuffer      Buffer to receive the data.  May be NULL, to query the required size
+    /// \param nBufferSize  Size of the buffer
+    /// \param rHeader      Header for the file.  See 'LayoutSerializedTree'
+    /// \param pSections    Data for each section
+    /// \return The size of the serialized data.  If this is larger than 'nBufferSize', nothing is written
+    //=====================================================================================================================
+    inline size_t CopySerializedTree( void* pBuffer, size_t nBufferSize, SerializedTreeHeader& rHeader, const void* pSections[SERIALIZED_SECTION_COUNT] )
+    {
+        size_t nSize = static_cast<size_t>( LayoutSerializedTree( rHeader, pSections ) );
+        if( !pBuffer || nBufferSize < nSize )
+            return nSize;
+
+        uint8* pBytes = reinterpret_cast<uint8*>( pBuffer );
+        memset( pBytes, 0, nSize );
+        for( uint32 i=0; i<SERIALIZED_SECTION_COUNT; i++ )
+        {
+            if( rHeader.sections[i].nSize != 0 )
+                memcpy( pBytes + rHeader.sections[i].nOffset, pSections[i], static_cast<size_t>( rHeader.sections[i].nSize ) );
+        }
+
+        MemoryFence();
+        memcpy( pBytes, &rHeader, sizeof(rHeader) );
+        return nSize;
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Validates a serialized acceleration structure
+    ///
+    /// \param pData        Start of the serialized data.  Must be aligned to at least TRT_SIMD_ALIGNMENT bytes (memory mapped files always are)
+    /// \param nSize        Size of the serialized data
+    /// \param nType        Expected structure type
+    /// \param nNodeSize    Expected size of the structure's nodes
+    /// \param nObjIdSize   Expected size of the structure's object IDs
+    /// \return The file header, or NULL if the data is not a valid file of the expected type
+    //=====================================================================================================================
+    inline const SerializedTreeHeader* ReadSerializedTreeHeader( const void* pData, size_t nSize, uint32 nType, uint32 nNodeSize, uint32 nObjIdSize )
+    {
+        if( !pData || nSize < sizeof(SerializedTreeHeader) )
+            return NULL;
+        if( ( reinterpret_cast<uintptr_t>( pData ) & (TRT_SIMD_ALIGNMENT-1) ) != 0 )
+            return NULL;
+
+        const SerializedTreeHeader* pHeader = reinterpret_cast<const SerializedTreeHeader*>( pData );
+        if( pHeader->nMagic != TRT_SERIALIZED_MAGIC || pHeader->nVersion != TRT_SERIALIZED_VERSION ||
+            pHeader->nStructureType != nType || pHeader->nNodeSize != nNodeSize || pHeader->nObjIdSize != nObjIdSize )
+            return NULL;
+
+        // make sure every section lies within the data
+        for( uint32 i=0; i<SERIALIZED_SECTION_COUNT; i++ )
+        {
+            const SerializedSection& rSection = pHeader->sections[i];
+            if( rSection.nSize == 0 )
+                continue;
+            if( ( rSection.nOffset % TRT_SERIALIZED_ALIGNMENT ) != 0 || rSection.nOffset > nSize || rSection.nSize > nSize - rSection.nOffset )
+                return NULL;
+        }
+
+        return pHeader;
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Locates a section in a serialized acceleration structure
+    /// \param pHeader  Header returned by 'ReadSerializedTreeHeader'
+    /// \param nSection One of the SerializedSectionType values
+    /// \param rnBytes  Receives the size of the section
+    /// \return A pointer to the section data, or NULL if the section is absent
+    //=====================================================================================================================
+    inline const void* GetSerializedSection( const SerializedTreeHeader* pHeader, uint32 nSection, size_t& rnBytes )
+    {
+        const SerializedSection& rSection = pHeader->sections[nSection];
+        rnBytes = static_cast<size_t>( rSection.nSize );
+        if( rSection.nSize == 0 )
+            return NULL;
+
+        return reinterpret_cast<const uint8*>( pHeader ) + rSection.nOffset;
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Retrieves the object remap table from a serialized acceleration structure
+    ///
+    ///  Object-order structures (such as AABB trees) re-arrange their object sets during construction.  When a tree
+    ///   is saved together with a remap table, the same arrangement can be applied to a freshly loaded object set by
+    ///   passing this table to its 'RemapObjects' method.
+    ///
+    /// \param pData        Start of the serialized data
+    /// \param nSize        Size of the serialized data
+    /// \param rnObjects    Receives the number of entries in the table
+    /// \return The remap table, or NULL if the file does not contain one, or if its object IDs are not of type obj_id
+    //=====================================================================================================================
+    template< class obj_id >
+    inline const obj_id* GetSerializedObjectRemap( const void* pData, size_t nSize, size_t& rnObjects )
+    {
+        rnObjects = 0;
+        if( !pData || nSize < sizeof(SerializedTreeHeader) )
+            return NULL;
+
+        const SerializedTreeHeader* pHeader = reinterpret_cast<const SerializedTreeHeader*>( pData );
+        pHeader = ReadSerializedTreeHeader( pData, nSize, pHeader->nStructureType, pHeader->nNodeSize, sizeof(obj_id) );
+        if( !pHeader )
+            return NULL;
+
+        size_t nBytes;
+        const void* pRemap = GetSerializedSection( pHeader, SERIALIZED_SECTION_REMAP, nBytes );
+        rnObjects = nBytes / sizeof(obj_id);
+        return reinterpret_cast<const obj_id*>( pRemap );
+    }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief An object set wrapper which records the re-arrangements made by tree construction
+    ///
+    ///  Building an AABB tree re-orders the objects in the object set.  A tree which is loaded from a file is only valid
+    ///   if its objects are in the same order as when it was built.  To record the ordering, the tree can be built over
+    ///   a RemapRecorder which wraps the real object set.  AABBTree and QuadAABBTree provide 'Build' overloads which
+    ///   accept a RemapRecorder, so the tree is of the underlying object set type, and can be saved along with the
+    ///   recorded remap table.
+    ///
+    ///  This class implements the ObjectSet_C concept.
+    ///
+    /// \param ObjectSet_T Must implement the ObjectSet_C concept
+    //=====================================================================================================================
+    template< class ObjectSet_T >
+    class RemapRecorder
+    {
+    public:
+
+        typedef typename ObjectSet_T::obj_id obj_id;
+
+        inline RemapRecorder( ObjectSet_T* pObjects ) : m_pObjects( pObjects ), m_remap( pObjects->GetObjectCount() )
+        {
+            for( obj_id i=0; i<m_remap.size(); i++ )
+                m_remap[i] = i;
+        };
+
+        /// Returns the wrapped object set
+        inline ObjectSet_T* GetObjectSet() const { return m_pObjects; };
+
+        /// Returns an array containing, for each position in the object set, the original ID of the object now at that position
+        inline const obj_id* GetRemap() const { return m_remap.empty() ? NULL : &m_remap[0]; };
+
+        template< class Ray_T, class HitInfo_T >
+        inline bool RayIntersect( Ray_T& rRay, HitInfo_T& rHitInfo, obj_id nObject ) const { return m_pObjects->RayIntersect( rRay, rHitInfo, nObject ); };
+
+        template< class Ray_T, class HitInfo_T >
+        inline bool RayIntersect( Ray_T& rRay, HitInfo_T& rHitInfo, obj_id nFirst, obj_id nLast ) const { return m_pObjects->RayIntersect( rRay, rHitInfo, nFirst, nLast ); };
+
+        inline obj_id GetObjectCount() const { return m_pObjects->GetObjectCount(); };
+        inline void GetObjectAABB( obj_id nObject, AxisAlignedBox& rBox ) const { m_pObjects->GetObjectAABB( nObject, rBox ); };
+        inline void GetAABB( AxisAlignedBox& rBox ) const { m_pObjects->GetAABB( rBox ); };
+        inline float GetObjectCost( obj_id nObject ) const { return m_pObjects->GetObjectCost( nObject ); };
+
+        /// Re-arranges the wrapped object set, and records the re-arrangement
+        inline void RemapObjects( obj_id* pObjectRemap )
+        {
+            m_pObjects->RemapObjects( pObjectRemap );
+            RemapArray( &m_remap[0], m_remap.size(), pObjectRemap );
+        };
+
+    private:
+
+        ObjectSet_T* m_pObjects;
+        std::vector<obj_id> m_remap;
+    };
+
+}
+
+#endif // _TRT_SERIALIZATION_H_
@@ -0,0 +1,240 @@
+//=====================================================================================================================
+//
+//   TRTSharedMemory.h
+//
+//   Definition of class: TinyRT::SharedMemory
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_SHAREDMEMORY_H_
+#define _TRT_SHAREDMEMORY_H_
+
+// This header is not included by TinyRT.h, because it pulls in platform headers.  Include it after TinyRT.h.
+// On POSIX systems, older C libraries require linking with -lrt for shm_open
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+/// Size of the block at the start of each segment which holds its 'ready' flag.  The caller's data begins after it
+#define TRT_SHARED_MEMORY_HEADER_SIZE 64
+
+/// Value of the 'ready' flag once the creator has published the segment ('TRDY')
+#define TRT_SHARED_MEMORY_READY 0x59445254
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A named block of memory which is shared between processes
+    ///
+    ///  This is intended for sharing acceleration structures (and the meshes they are built over) between processes.
+    ///   One process creates the segment and fills it, using the trees' 'SaveToBuffer' methods, and the other processes
+    ///   open read-only views of it and use the 'Attach' methods.  Since all node links are stored as indices, the
+    ///   segment may be mapped at a different address in each process.  The caller's data begins TRT_SHARED_MEMORY_HEADER_SIZE
+    ///   bytes after a page boundary, so data placed at TRT_SERIALIZED_ALIGNMENT offsets within it meets the alignment
+    ///   requirements of 'Attach'.
+    ///
+    ///  Other processes can see the segment as soon as it is created, before it has been filled.  The creator must
+    ///   call 'Publish' once all of the data is written, and 'Open' fails until it has done so.  Worker processes which
+    ///   may start before the creator is finished should retry 'Open' until it succeeds.
+    ///
+    ///  On POSIX systems, the segment persists until 'Remove' is called, even if no process has it open.  Names must
+    ///   begin with a slash (for example: "/my_scene").  On Windows, the segment is destroyed when the last process
+    ///   closes it, so the creating process must keep it open for as long as the data is needed.
+    //=====================================================================================================================
+    class SharedMemory
+    {
+    public:
+
+        inline SharedMemory( ) : m_pData( NULL ), m_nSize( 0 ), m_bWritable( false ), m_hMapping( NULL ) {};
+
+        inline ~SharedMemory( ) { Close(); };
+
+        /// \brief Creates a new, zero-filled segment, and maps it for writing.  Returns false if the segment already exists
+        ///  or could not be created.  Other processes cannot open the segment until 'Publish' is called
+        inline bool Create( const char* pName, size_t nSize )
+        {
+            Close();
+            nSize += TRT_SHARED_MEMORY_HEADER_SIZE;
+
+#ifdef _WIN32
+            HANDLE hMapping = CreateFileMappingA( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, static_cast<DWORD>( static_cast<uint64>( nSize ) >> 32 ),
+                                                  static_cast<DWORD>( nSize ), pName );
+            if( !hMapping )
+                return false;
+            if( GetLastError() == ERROR_ALREADY_EXISTS )
+            {
+                CloseHandle( hMapping );
+                return false;
+            }
+
+            m_pData = MapViewOfFile( hMapping, FILE_MAP_WRITE, 0, 0, nSize );
+            if( !m_pData )
+            {
+                CloseHandle( hMapping );
+                return false;
+            }
+            m_hMapping = hMapping;
+#else
+            int fd = shm_open( pName, O_RDWR | O_CREAT | O_EXCL, 0644 );
+            if( fd < 0 )
+                return false;
+
+            void* pData = MAP_FAILED;
+            if( ftruncate( fd, static_cast<off_t>( nSize ) ) == 0 )
+                pData = mmap( NULL, nSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+            close( fd );
+
+            if( pData == MAP_FAILED )
+            {
+                shm_unlink( pName );
+                return false;
+            }
+            m_pData = pData;
+#endif
+            m_nSize = nSize;
+            m_bWritable = true;
+            return true;
+        };
+
+        /// \brief Marks a segment created by this process as ready, allowing other processes to open it.  
+        ///  This must be called after all of the segment's data has been written.  Returns false if the segment was not created by this object
+        inline bool Publish( )
+        {
+            if( !m_bWritable )
+                return false;
+
+            // the data must be visible before the flag is
+            MemoryFence();
+            *GetReadyFlag() = TRT_SHARED_MEMORY_READY;
+            MemoryFence();
+            return true;
+        };
+
+        /// \brief Maps an existing segment for reading.  Returns false if the segment does not exist, 
+        ///   or if its creator has not yet called 'Publish'.  Callers which may race with the creator should retry
+        inline bool Open( const char* pName )
+        {
+            Close();
+
+#ifdef _WIN32
+            HANDLE hMapping = OpenFileMappingA( FILE_MAP_READ, FALSE, pName );
+            if( !hMapping )
+                return false;
+
+            m_pData = MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 );
+            if( !m_pData )
+            {
+                CloseHandle( hMapping );
+                return false;
+            }
+
+            // the view size is rounded up to a whole page, which is as close as Windows will tell us
+            MEMORY_BASIC_INFORMATION info;
+            VirtualQuery( m_pData, &info, sizeof(info) );
+            m_nSize = info.RegionSize;
+            m_hMapping = hMapping;
+#else
+            int fd = shm_open( pName, O_RDONLY, 0 );
+            if( fd < 0 )
+                return false;
+
+            struct stat st;
+            if( fstat( fd, &st ) == 0 && st.st_size > 0 )
+            {
+                void* pData = mmap( NULL, static_cast<size_t>( st.st_size ), PROT_READ, MAP_SHARED, fd, 0 );
+                if( pData != MAP_FAILED )
+                {
+                    m_pData = pData;
+                    m_nSize = static_cast<size_t>( st.st_size );
+                }
+            }
+            close( fd );
+#endif
+            m_bWritable = false;
+            if( !m_pData )
+                return false;
+
+            if( m_nSize < TRT_SHARED_MEMORY_HEADER_SIZE || *GetReadyFlag() != TRT_SHARED_MEMORY_READY )
+            {
+                Close();
+                return false;
+            }
+
+            // the flag must be seen before the data is read
+            MemoryFence();
+            return true;
+        };
+
+        /// Unmaps the segment.  The segment itself is not removed.  Any structures which were attached to it become invalid
+        inline void Close( )
+        {
+            if( !m_pData )
+                return;
+
+#ifdef _WIN32
+            UnmapViewOfFile( m_pData );
+            CloseHandle( m_hMapping );
+            m_hMapping = NULL;
+#else
+            munmap( m_pData, m_nSize );
+#endif
+            m_pData = NULL;
+            m_nSize = 0;
+            m_bWritable = false;
+        };
+
+        /// \brief Removes a named segment.  Processes which have it mapped may continue to use it
+        /// On Windows, this does nothing, since segments are removed when the last process closes them
+        static inline bool Remove( const char* pName )
+        {
+#ifdef _WIN32
+            return true;
+#else
+            return shm_unlink( pName ) == 0;
+#endif
+        };
+
+        /// Returns the start of the caller's data in the segment, or NULL if no segment is mapped
+        inline const void* GetData() const { return m_pData ? reinterpret_cast<const uint8*>( m_pData ) + TRT_SHARED_MEMORY_HEADER_SIZE : NULL; };
+
+        /// Returns the start of the caller's data in the segment, or NULL if the segment is not mapped for writing
+        inline void* GetWritableData() { return m_bWritable ? reinterpret_cast<uint8*>( m_pData ) + TRT_SHARED_MEMORY_HEADER_SIZE : NULL; };
+
+        /// Returns the size of the caller's data in the segment
+        inline size_t GetSize() const { return m_pData ? m_nSize - TRT_SHARED_MEMORY_HEADER_SIZE : 0; };
+
+    private:
+
+        /// Disallow copies
+        inline SharedMemory( const SharedMemory& ) {};
+        inline SharedMemory& operator=( const SharedMemory& ) { return *this; };
+
+        /// Returns the flag, at the start of the mapped segment, which is set by 'Publish'
+        inline volatile uint32* GetReadyFlag() const { return reinterpret_cast<volatile uint32*>( m_pData ); };
+
+        void* m_pData;
+        size_t m_nSize;
+        bool m_bWritable;
+        void* m_hMapping;   ///< Handle of the file mapping object (Windows only)
+    };
+
+}
+
+#endif // _TRT_SHAREDMEMORY_H_
@@ -53,6 +53,9 @@ namespace TinyRT
         /// Rearranges the order of faces in the mesh
         inline void RemapObjects( const obj_id* pObjectRemap ) ;
 
+        /// Adds the vertex positions and index data to a hash.  Used by BuildCache to identify the mesh
+        inline void HashContents( ContentHash& rHash ) const;
+
         /// Performs an intersection test between this object and a ray, returning true if a hit was found
         template< typename Ray_T >
         inline bool RayIntersect( Ray_T& rRay, TriangleRayHit& rRayHit, uint32 nObject ) const;
@@ -61,6 +64,16 @@ namespace TinyRT
         template< typename Ray_T >
         inline bool RayIntersect( Ray_T& rRay, TriangleRayHit& rRayHit, uint32 nFirstObject, uint32 nLastObject ) const;
 
+        /// \brief Performs an intersection test between a ray and a list of objects, returning true if a hit was found
+        /// The triangles are gathered into groups and tested several at a time.  This is used for KD-tree leaves (see SimdLeafIntersector)
+        template< typename Ray_T >
+        inline bool RayIntersectList( Ray_T& rRay, TriangleRayHit& rRayHit, const uint32* pObjects, uint32 nObjects ) const;
+
+        /// Prefetches the index data for a series of faces.  The vertices are not prefetched, since their addresses depend on the indices
+        inline void PrefetchObjects( uint32 nFirstObject, uint32 nLastObject ) const { 
+            PrefetchMemory( m_pIndices + 3*nFirstObject, 3*( nLastObject - nFirstObject )*sizeof(Index_T) ); 
+        };
+
 
         /// Accessor for the vertex array
         inline const Position_T& VertexPosition( uint32 i ) const { return *reinterpret_cast<const Position_T*>( m_pVertices+i*m_nVertexStride ); };
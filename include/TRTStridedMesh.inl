@@ -84,6 +84,19 @@ namespace TinyRT
         TinyRT::RemapArray( reinterpret_cast<Indices*>( m_pIndices ), m_nFaces, pObjectRemap );
     }
 
+    //=====================================================================================================================
+    /// Only the vertex positions are hashed, since the rest of each vertex is not used by TinyRT
+    //=====================================================================================================================
+    template< class uint_t >
+    inline void StridedMesh< uint_t >::HashContents( ContentHash& rHash ) const
+    {
+        rHash.AddValue( m_nVertices );
+        rHash.AddValue( m_nFaces );
+        for( Index_T i=0; i<m_nVertices; i++ )
+            rHash.Add( &VertexPosition(i), sizeof(Position_T) );
+        rHash.Add( m_pIndices, 3*m_nFaces*sizeof(Index_T) );
+    }
+
     //=====================================================================================================================
     //=====================================================================================================================
     template< class uint_t >
@@ -176,5 +189,14 @@ namespace TinyRT
         return bHit;        
     }
 
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class uint_t >
+    template< typename Ray_T >
+    bool StridedMesh< uint_t >::RayIntersectList( Ray_T& rRay, TriangleRayHit& rRayHit, const uint32* pObjects, uint32 nObjects ) const
+    {
+        return RayTriangleListTest( *this, rRay, rRayHit, pObjects, nObjects );
+    }
+
 }
 
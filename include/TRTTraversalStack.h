@@ -0,0 +1,99 @@
+//=====================================================================================================================
+//
+//   TRTTraversalStack.h
+//
+//   Definition of class: TinyRT::TraversalStack
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_TRAVERSALSTACK_H_
+#define _TRT_TRAVERSALSTACK_H_
+
+#include "TRTScratchMemory.h"
+
+/// Tree depth for which the traversal functions keep their stacks on the call stack.  Deeper trees fall back to
+///  scratch memory.  TRT clients may #define TRT_INLINE_STACK_DEPTH to override its value
+#ifndef TRT_INLINE_STACK_DEPTH
+#define TRT_INLINE_STACK_DEPTH 64
+#endif
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A traversal stack with a fixed inline capacity, which falls back to scratch memory if it is too small
+    ///
+    ///  Traversal stacks are sized using the depth bound stored in the tree.  If that bound fits in the inline array,
+    ///   no scratch memory is touched at all, which avoids the pool bookkeeping for each ray.  Trees which are deeper
+    ///   than expected still work, they simply pay for a scratch allocation.
+    ///
+    ///  Like ScratchArray, a TraversalStack is meant to be constructed on the stack, so that scratch allocations are
+    ///   released in LIFO order.
+    ///
+    /// \param T  Type of the stack entries.  Should be a POD type, since the inline array is always constructed
+    /// \param N  Number of entries in the inline array
+    /// \sa ScratchArray
+    //=====================================================================================================================
+    template< class T, size_t N >
+    class TraversalStack
+    {
+    public:
+
+        /// Creates a stack with room for 'nSize' entries.  Scratch memory is only used if 'nSize' exceeds N
+        inline TraversalStack( ScratchMemory& rScratch, size_t nSize ) : m_pPool( NULL )
+        {
+            if( nSize <= N )
+                m_pSpace = m_entries;
+            else
+                AllocateScratch( rScratch, nSize );
+        };
+
+        /// Creates a stack with room for 'nSize' entries.  If 'nSize' exceeds N, the calling thread's scratch memory is used
+        inline explicit TraversalStack( size_t nSize ) : m_pPool( NULL )
+        {
+            if( nSize <= N )
+                m_pSpace = m_entries;
+            else
+                AllocateScratch( ThreadScratchMemory::Get(), nSize );
+        };
+
+        inline ~TraversalStack() 
+        {
+            if( m_pPool )
+                m_pPool->Free( reinterpret_cast<uint8*>( m_pSpace ) );
+        };
+
+        /// Returns true if the stack is using the inline array
+        inline bool IsInline() const { return m_pPool == NULL; };
+
+        inline operator T*() { return m_pSpace; };
+        inline operator const T*() const { return m_pSpace; };
+
+    private:
+
+        inline void AllocateScratch( ScratchMemory& rScratch, size_t nSize )
+        {
+            std::pair<uint8*,ScratchPool*> mem = rScratch.Allocate<T>( nSize );
+            m_pSpace = reinterpret_cast<T*>( mem.first );
+            m_pPool = mem.second;
+        }
+
+        // disallow copy and assignment
+        TraversalStack( const TraversalStack<T,N>& s ) {};
+        TraversalStack& operator=( const TraversalStack<T,N>& s ) { return *this; };
+
+        T* m_pSpace;
+        ScratchPool* m_pPool;
+        T m_entries[N];
+    };
+
+}
+
+#endif // _TRT_TRAVERSALSTACK_H_
@@ -0,0 +1,106 @@
+//=====================================================================================================================
+//
+//   TRTTraversalStats.h
+//
+//   Definition of classes: TinyRT::NullTraversalStats, TinyRT::TraversalStats
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_TRAVERSALSTATS_H_
+#define _TRT_TRAVERSALSTATS_H_
+
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A traversal statistics policy which does not record anything
+    ///
+    ///  This is the policy used by the raycasting functions when no statistics object is passed.  All of its methods
+    ///   are empty, so the instrumentation in the traversal loops compiles away entirely
+    ///
+    ///  This class implements the TraversalStats_C concept
+    //=====================================================================================================================
+    class NullTraversalStats
+    {
+    public:
+
+        TRT_FORCEINLINE void CountRay() {};
+        TRT_FORCEINLINE void CountInnerNode() {};
+        TRT_FORCEINLINE void CountLeaf() {};
+        TRT_FORCEINLINE void CountBoxTests( uint32 ) {};
+        TRT_FORCEINLINE void CountPrimitiveTests( uint32 ) {};
+        TRT_FORCEINLINE void CountMailboxRejection() {};
+        TRT_FORCEINLINE void CountStackDepth( size_t ) {};
+    };
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief A traversal statistics policy which counts the work done by the raycasting functions
+    ///
+    ///  The counters are plain integers, so an instance must not be shared between threads.  Multi-threaded clients
+    ///   should give each thread its own instance (for example, one declared inside the parallel region), and sum them
+    ///   with 'Accumulate' after the threads are finished.
+    ///
+    ///  The test against the bounding box of a KD tree or grid is counted as a box test.  For grids, each non-empty cell
+    ///   is counted as a leaf, and no inner nodes are counted.
+    ///
+    ///  This class implements the TraversalStats_C concept
+    //=====================================================================================================================
+    class TraversalStats
+    {
+    public:
+
+        inline TraversalStats( ) { Reset(); };
+
+        /// Sets all counters to zero
+        inline void Reset()
+        {
+            nRays = 0;
+            nInnerNodes = 0;
+            nLeafs = 0;
+            nBoxTests = 0;
+            nPrimitiveTests = 0;
+            nMailboxRejections = 0;
+            nMaxStackDepth = 0;
+        };
+
+        /// Adds the counts from another instance to this one.  The stack depth is the larger of the two
+        inline void Accumulate( const TraversalStats& rStats )
+        {
+            nRays              += rStats.nRays;
+            nInnerNodes        += rStats.nInnerNodes;
+            nLeafs             += rStats.nLeafs;
+            nBoxTests          += rStats.nBoxTests;
+            nPrimitiveTests    += rStats.nPrimitiveTests;
+            nMailboxRejections += rStats.nMailboxRejections;
+            nMaxStackDepth      = std::max( nMaxStackDepth, rStats.nMaxStackDepth );
+        };
+
+        TRT_FORCEINLINE void CountRay() { nRays++; };
+        TRT_FORCEINLINE void CountInnerNode() { nInnerNodes++; };
+        TRT_FORCEINLINE void CountLeaf() { nLeafs++; };
+        TRT_FORCEINLINE void CountBoxTests( uint32 nTests ) { nBoxTests += nTests; };
+        TRT_FORCEINLINE void CountPrimitiveTests( uint32 nTests ) { nPrimitiveTests += nTests; };
+        TRT_FORCEINLINE void CountMailboxRejection() { nMailboxRejections++; };
+        TRT_FORCEINLINE void CountStackDepth( size_t nDepth ) { nMaxStackDepth = std::max( nMaxStackDepth, static_cast<uint32>( nDepth ) ); };
+
+        uint64 nRays;               ///< Number of rays traced
+        uint64 nInnerNodes;         ///< Number of inner nodes visited
+        uint64 nLeafs;              ///< Number of leaf nodes (or grid cells) visited
+        uint64 nBoxTests;           ///< Number of ray-box tests performed against tree nodes
+        uint64 nPrimitiveTests;     ///< Number of ray-object intersection tests performed
+        uint64 nMailboxRejections;  ///< Number of ray-object tests that were skipped because the mailbox had already seen the object
+        uint32 nMaxStackDepth;      ///< Largest number of entries on the traversal stack
+    };
+
+}
+
+#endif // _TRT_TRAVERSALSTATS_H_
@@ -0,0 +1,50 @@
+//=====================================================================================================================
+//
+//   TRTTreeHandles.h
+//
+//   Definition of structs: TinyRT::CompactTreeHandles, TinyRT::LargeTreeHandles
+//
+//   Part of the TinyRT Raytracing Library.
+//   Author: Joshua Barczak
+//
+//   Copyright 2009 Joshua Barczak.  All rights reserved.
+//   See  Doc/LICENSE.txt for terms and conditions.
+//
+//=====================================================================================================================
+
+#ifndef _TRT_TREEHANDLES_H_
+#define _TRT_TREEHANDLES_H_
+
+
+namespace TinyRT
+{
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Selects 32-bit node handles for KDTree and QuadAABBTree
+    ///
+    ///  This is the default.  KDTree packs its child links and object reference indices into 30 bits, and QuadAABBTree
+    ///   uses the high bit of its handles to mark leaves.  This limits a KD tree to 2^30 nodes or object references, and
+    ///   a QBVH to 2^31 nodes or leaves.  The trees' 'Build' methods return false, and leave the tree empty, if these
+    ///   limits are exceeded.  The tree must then be built again using LargeTreeHandles.
+    //=====================================================================================================================
+    struct CompactTreeHandles
+    {
+        typedef uint32 Handle;  ///< Type used for node handles, and for the links stored in the nodes
+    };
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Selects 64-bit node handles for KDTree and QuadAABBTree, for scenes which exceed the limits of CompactTreeHandles
+    ///
+    ///  The node layouts are the same, with wider link fields.  KD tree nodes grow from 8 to 16 bytes, and QBVH nodes
+    ///   from 128 to 144 bytes, so this should only be used when it is needed.
+    //=====================================================================================================================
+    struct LargeTreeHandles
+    {
+        typedef uint64 Handle;  ///< Type used for node handles, and for the links stored in the nodes
+    };
+
+}
+
+#endif // _TRT_TREEHANDLES_H_
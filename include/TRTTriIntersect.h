@@ -104,6 +104,84 @@ namespace TinyRT
     
         return nMask;
     }
+
+    //=====================================================================================================================
+    /// \ingroup TinyRT
+    /// \brief Tests a ray against a list of triangles in an indexed mesh, several at a time
+    ///
+    ///  Groups of triangles are gathered into SoA form and tested with RayTriangleTestSimd.  The triangles left over
+    ///   at the end of the list are tested one at a time.  Used to implement BasicMesh::RayIntersectList and 
+    ///   StridedMesh::RayIntersectList
+    ///
+    /// \param rMesh        The mesh.  This is used as the vertex accessor, and must provide 'Index( nFace, i )',
+    ///                      'VertexPosition( nIndex )', and a single-triangle 'RayIntersect' method
+    /// \param rRay         The ray to be tested.  Its maximum distance is shortened to the nearest hit
+    /// \param rHitInfo     Receives the triangle index and barycentric coordinates of the nearest hit
+    /// \param pObjects     List of triangle indices to test
+    /// \param nObjects     Number of triangles in the list
+    ///
+    /// \return True if a hit was found, false otherwise
+    //=====================================================================================================================
+    template< class Mesh_T, typename Ray_T, typename HitInfo_T >
+    bool RayTriangleListTest( const Mesh_T& rMesh, Ray_T& rRay, HitInfo_T& rHitInfo, const uint32* pObjects, uint32 nObjects )
+    {
+        SimdVecf P0[3];
+        SimdVecf P1[3];
+        SimdVecf P2[3];
+        TRT_SIMDALIGN float pTHit[ SimdVecf::WIDTH ];
+        TRT_SIMDALIGN float pUV[2][ SimdVecf::WIDTH ];
+
+        const Vec3f& rOrigin = rRay.Origin();
+        const Vec3f& rDirection = rRay.Direction();
+        SimdVecf vOrigin[3]    = { SimdVecf( rOrigin[0] ), SimdVecf( rOrigin[1] ), SimdVecf( rOrigin[2] ) };
+        SimdVecf vDirection[3] = { SimdVecf( rDirection[0] ), SimdVecf( rDirection[1] ), SimdVecf( rDirection[2] ) }; 
+
+        bool bHit=false;
+        const uint32* pEnd = pObjects + nObjects;
+        while( pEnd - pObjects >= SimdVecf::WIDTH )
+        {
+            // gather a group of triangles into SoA form
+            for( uint32 i=0; i<SimdVecf::WIDTH; i++ )
+            {
+                const typename Mesh_T::Position_T& v0 = rMesh.VertexPosition( rMesh.Index( pObjects[i], 0 ) );
+                const typename Mesh_T::Position_T& v1 = rMesh.VertexPosition( rMesh.Index( pObjects[i], 1 ) );
+                const typename Mesh_T::Position_T& v2 = rMesh.VertexPosition( rMesh.Index( pObjects[i], 2 ) );
+                for(int j=0; j<3; j++ )
+                {
+                    P0[j].values[i] = v0[j];
+                    P1[j].values[i] = v1[j];
+                    P2[j].values[i] = v2[j];
+                }
+            }
+
+            // Ray/triangle intersection test (N triangles at once)
+            int nMask = RayTriangleTestSimd( P0, P1, P2, vOrigin, vDirection, pTHit, pUV );
+            
+            // Scan the triangle list and look for hits
+            int j=0;
+            while( nMask )
+            {
+                if( (nMask & 1) && rRay.IsDistanceValid( pTHit[j] ) )
+                {
+                    rHitInfo.nTriIdx = pObjects[j];
+                    rRay.SetMaxDistance( pTHit[j] );
+                    rHitInfo.vUVCoords[0] = pUV[0][j];
+                    rHitInfo.vUVCoords[1] = pUV[1][j];
+                    bHit = true;
+                }
+                j++;
+                nMask >>= 1;
+            }
+
+            pObjects += SimdVecf::WIDTH;
+        }
+
+        // single-ray test against remaining triangles
+        while( pObjects != pEnd )
+            bHit = rMesh.RayIntersect( rRay, rHitInfo, *pObjects++ ) || bHit;
+
+        return bHit;        
+    }
 }
 
 #endif // _TRT_TRIINTERSECT_H_
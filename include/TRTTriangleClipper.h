@@ -51,6 +51,9 @@ namespace TinyRT
                                                          uint nAxis,
                                                          AxisAlignedBox& rLeftSideOut, 
                                                          AxisAlignedBox& rRightSideOut );
+
+        /// Adds the clipper type to a hash.  Used by BuildCache to identify the build parameters
+        static inline void HashParameters( ContentHash& rHash ) { rHash.AddString( "TriangleClipper" ); };
     };
     
 }
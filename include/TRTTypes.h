@@ -25,9 +25,11 @@ namespace TinyRT
     typedef unsigned char   uint8;
     typedef unsigned short  uint16;
     typedef unsigned int    uint32;
+    typedef unsigned long long uint64;
     typedef char    int8;
     typedef short   int16;
     typedef int     int32;
+    typedef long long int64;
     typedef void*   Handle;
 
     typedef unsigned int uint;
@@ -25,9 +25,20 @@ namespace TinyRT
     ///
     ///  This class implements the UniformGrid_C concept
     ///
-    /// \param ObjectSet_T Must implement the ObjectSet_C concept
+    ///  Cell contents are stored as ranges in a single global object list.  Grids in which most cells are occupied
+    ///   store a dense table of per-cell offsets.  Grids which are mostly empty instead store the occupied cells in
+    ///   an open-addressed hash table, so that memory usage is proportional to the number of occupied cells, 
+    ///   rather than the total number of cells.
+    ///
+    ///  The grid also maintains an occupancy pyramid, which records, for progressively larger blocks of cells, whether
+    ///   any cell in the block contains objects.  Traversal uses this to skip over runs of empty cells.
+    ///
+    /// \param ObjectSet_T  Must implement the ObjectSet_C concept
+    /// \param CellOffset_T Integer type used to store offsets into the object list.  The default (32 bits) is large enough
+    ///                       for all but the most enormous grids.  Use size_t if the grid will contain more than 4G references.
+    ///                       Build fails if the grid has more object references than this type can represent
     //=====================================================================================================================
-    template< class ObjectSet_T >
+    template< class ObjectSet_T, class CellOffset_T = uint32 >
     class UniformGrid
     {
     public:
@@ -39,6 +50,11 @@ namespace TinyRT
         typedef uint32 UnsignedCellIndex;
         typedef int32 SignedCellIndex;
 
+        /// Maximum number of levels in the occupancy pyramid (including the per-cell level)
+        enum { MAX_PYRAMID_LEVELS = 5 };
+
+        inline UniformGrid() : m_nCellOffsets(0), m_nObjectRefs(0), m_nSparseCells(0), m_nSparseShift(0), m_nOccupancyBytes(0), m_nPyramidLevels(0) {};
+
         /// Returns the bounding box of the grid
         inline const AxisAlignedBox& GetBoundingBox() const { return m_boundingBox; };
 
@@ -46,35 +62,41 @@ namespace TinyRT
         inline const Vec3<uint32>& GetCellCounts() const { return m_cellCounts; };
 
         /// Returns the number of objects in a cell 
-        inline size_t GetCellObjectCount( const Vec3<uint32>& rCell ) const { 
-            const size_t* pCell = &m_cellOffsets[AddressCell(rCell)];        
-            return pCell[1] - pCell[0]; 
-        };
-
+        inline size_t GetCellObjectCount( const Vec3<uint32>& rCell ) const;
 
         /// Retrieves iterators for the list of objects in a particular cell
-        inline void GetCellObjectList( const Vec3<uint32>& rCell, CellIterator& hCellStart, CellIterator& hCellEnd ) const { 
-        
-            // check the bit array first, before accessing the cell offset table
-            // In big grids, most cells tend to be empty, so this results in less cache pollution
-            size_t nCellAddr = AddressCell(rCell);
-            if( m_cellMasks[nCellAddr/8] & (1<< (nCellAddr%8)) )
-            {
-                const size_t* pCellOffs = &m_cellOffsets[nCellAddr];
-                hCellStart = m_objectList + pCellOffs[0];
-                hCellEnd = m_objectList + pCellOffs[1];
-                return;
-            }
-        
-            hCellStart = 0;
-            hCellEnd = 0;
-        };
+        inline void GetCellObjectList( const Vec3<uint32>& rCell, CellIterator& hCellStart, CellIterator& hCellEnd ) const;
+
+        /// Returns the edge length (in cells) of the largest empty block containing a particular cell, or 0 if the cell is occupied
+        inline uint32 GetEmptyBlockSize( const Vec3<uint32>& rCell ) const;
 
-        /// Rebuilds the grid from an object set
-        void Build( ObjectSet_T* pObjects, float fLambda );
+        /// Tests whether the grid is using the hashed (sparse) cell representation
+        inline bool IsSparse() const { return m_nSparseCells != 0; };
+
+        /// \brief Rebuilds the grid from an object set.  
+        /// Returns false, and leaves the grid empty, if the grid has too many object references for CellOffset_T
+        bool Build( ObjectSet_T* pObjects, float fLambda, float fSparseOccupancy = 0.125f );
+
+        /// Returns the amount of memory used by the grid
+        void GetMemoryUsage( size_t& rnBytesUsed, size_t& rnBytesAllocated ) const;
         
     private:
 
+        /// Entry in the sparse cell table
+        struct SparseCell
+        {
+            uint32 nCell;           ///< Address of the cell (as returned by 'AddressCell')
+            CellOffset_T nOffset;   ///< Offset of the cell's objects in the object list
+            CellOffset_T nCount;    ///< Number of objects in the cell
+        };
+
+        /// Dimensions of one level in the occupancy pyramid
+        struct PyramidLevel
+        {
+            Vec3<uint32> vCounts;   ///< Number of blocks along each axis
+            uint32 nWH;             ///< vCounts.x*vCounts.y
+            size_t nFirstBit;       ///< Location of the level's first bit in the occupancy array
+        };
 
         /// Computes the address of a cell given its 3D cell coordinates
         inline size_t AddressCell( const Vec3<uint32>& rCell ) const { 
@@ -83,14 +105,41 @@ namespace TinyRT
             return nCell;
         };
 
-        // The grid is represented by storing each cell's offset into the object list.  The object count
-        //  for cell i is offset[i+1] - offset[i].  The cell offset array contains an extra (bogus) entry to avoid
-        //  the need to check boundary conditions
+        /// Tests a bit in the occupancy array
+        inline bool IsOccupied( size_t nBit ) const { return ( m_occupancy[nBit/8] & (1<<(nBit%8)) ) != 0; };
 
-        ScopedArray< size_t > m_cellOffsets;   ///< Offset of cell i's object references in the object list.  
-        ScopedArray< obj_id > m_objectList;    ///< Global list of object references
+        /// Locates an occupied cell in the sparse cell table
+        inline const SparseCell* FindSparseCell( size_t nCellAddr ) const;
 
-        ScopedArray< uint8 > m_cellMasks;   ///< Bit array indicating, for each cell, whether it actually has objects in it
+        /// Sets up the sparse cell table
+        void BuildSparseCells( const size_t* pCellOffsets, size_t nCells, size_t nOccupiedCells );
+
+        /// Sets up the occupancy pyramid
+        void BuildOccupancyPyramid( const size_t* pCellOffsets );
+
+        /// Releases the grid's storage, and gives it an empty bounding box, so that no ray enters it
+        void MakeEmpty();
+
+        // In the dense representation, the grid is represented by storing each cell's offset into the object list.  
+        //  The object count for cell i is offset[i+1] - offset[i].  The cell offset array contains an extra (bogus) 
+        //  entry to avoid the need to check boundary conditions
+        
+        ScopedArray< CellOffset_T > m_cellOffsets;   ///< Offset of cell i's object references in the object list.  Empty for sparse grids
+        ScopedArray< SparseCell > m_sparseCells;     ///< Hash table of occupied cells.  Empty for dense grids
+        ScopedArray< obj_id > m_objectList;          ///< Global list of object references
+
+        /// Bit arrays indicating, for each cell and each pyramid block, whether it actually has objects in it.
+        ///  In big grids, most cells tend to be empty, so checking this first results in less cache pollution
+        ScopedArray< uint8 > m_occupancy;  
+
+        size_t m_nCellOffsets;      ///< Size of the cell offset array
+        size_t m_nObjectRefs;       ///< Size of the object list
+        size_t m_nSparseCells;      ///< Size of the sparse cell table (always a power of two)
+        uint32 m_nSparseShift;      ///< Shift used by the sparse cell hash function
+        size_t m_nOccupancyBytes;   ///< Size of the occupancy array
+
+        PyramidLevel m_pyramid[MAX_PYRAMID_LEVELS];
+        uint32 m_nPyramidLevels;
 
         AxisAlignedBox m_boundingBox;
 
@@ -32,12 +32,91 @@ namespace TinyRT
     //=====================================================================================================================
 
     //=====================================================================================================================
-    /// \param pObjects The object set for this grid
-    /// \param fLambda  Parameter that loosely controls the number of objects per cell.  
-    ///                   Lower values mean more objects per cell
     //=====================================================================================================================
-    template< class ObjectSet_T >
-    void UniformGrid<ObjectSet_T>::Build( ObjectSet_T* pObjects, float fLambda )
+    template< class ObjectSet_T, class CellOffset_T >
+    inline size_t UniformGrid<ObjectSet_T,CellOffset_T>::GetCellObjectCount( const Vec3<uint32>& rCell ) const
+    {
+        size_t nCellAddr = AddressCell(rCell);
+        if( !IsSparse() )
+        {
+            const CellOffset_T* pCell = &m_cellOffsets[nCellAddr];        
+            return pCell[1] - pCell[0]; 
+        }
+        
+        if( !IsOccupied( nCellAddr ) )
+            return 0;
+
+        return FindSparseCell( nCellAddr )->nCount;
+    }
+
+    //=====================================================================================================================
+    /// \param rCell        The cell whose objects are desired
+    /// \param hCellStart   Receives an iterator to the first object in the cell
+    /// \param hCellEnd     Receives an iterator one past the last object in the cell
+    //=====================================================================================================================
+    template< class ObjectSet_T, class CellOffset_T >
+    inline void UniformGrid<ObjectSet_T,CellOffset_T>::GetCellObjectList( const Vec3<uint32>& rCell, CellIterator& hCellStart, CellIterator& hCellEnd ) const
+    {
+        // check the bit array first, before accessing the cell offset table
+        // In big grids, most cells tend to be empty, so this results in less cache pollution
+        size_t nCellAddr = AddressCell(rCell);
+        if( IsOccupied( nCellAddr ) )
+        {
+            if( !IsSparse() )
+            {
+                const CellOffset_T* pCellOffs = &m_cellOffsets[nCellAddr];
+                hCellStart = m_objectList + pCellOffs[0];
+                hCellEnd = m_objectList + pCellOffs[1];
+            }
+            else
+            {
+                const SparseCell* pCell = FindSparseCell( nCellAddr );
+                hCellStart = m_objectList + pCell->nOffset;
+                hCellEnd = hCellStart + pCell->nCount;
+            }
+            return;
+        }
+    
+        hCellStart = 0;
+        hCellEnd = 0;
+    }
+
+    //=====================================================================================================================
+    /// The returned block size is always a power of two.  Blocks are aligned to multiples of their size, and may extend
+    ///   past the boundaries of the grid.  
+    /// \param rCell    The cell to test
+    /// \return 0 if the cell contains objects, otherwise the edge length of the largest empty block containing the cell
+    //=====================================================================================================================
+    template< class ObjectSet_T, class CellOffset_T >
+    inline uint32 UniformGrid<ObjectSet_T,CellOffset_T>::GetEmptyBlockSize( const Vec3<uint32>& rCell ) const
+    {
+        if( IsOccupied( AddressCell( rCell ) ) )
+            return 0;
+
+        uint32 nSize = 1;
+        for( uint32 i=1; i<m_nPyramidLevels; i++ )
+        {
+            const PyramidLevel& rLevel = m_pyramid[i];
+            size_t nBlock = (rCell.z >> i)*rLevel.nWH + (rCell.y >> i)*rLevel.vCounts.x + (rCell.x >> i);
+            if( IsOccupied( rLevel.nFirstBit + nBlock ) )
+                break;
+
+            nSize <<= 1;
+        }
+
+        return nSize;
+    }
+
+    //=====================================================================================================================
+    /// \param pObjects         The object set for this grid
+    /// \param fLambda          Parameter that loosely controls the number of objects per cell.  
+    ///                           Lower values mean more objects per cell
+    /// \param fSparseOccupancy If the fraction of occupied cells is below this value, the grid will use a hashed representation
+    ///                           for the occupied cells, instead of a dense offset table.  Set to 0 to always use a dense table
+    /// \return False if the grid has more object references than CellOffset_T can represent.  The grid is left empty
+    //=====================================================================================================================
+    template< class ObjectSet_T, class CellOffset_T >
+    bool UniformGrid<ObjectSet_T,CellOffset_T>::Build( ObjectSet_T* pObjects, float fLambda, float fSparseOccupancy )
     {
         
         // get the global bounding box of the object set
@@ -120,32 +199,54 @@ namespace TinyRT
         //  we want to be able to compute the object count in cell i as cellOffsets[i+1] - cellOffsets[i]
 
         size_t nCellOffsets = nCells + 1;
-        m_cellOffsets.reallocate( nCellOffsets );
-        m_cellOffsets[0] = 0;
+        ScopedArray< size_t > cellOffsets( new size_t[nCellOffsets] );
+        cellOffsets[0] = 0;
         
+        size_t nOccupiedCells = 0;
         for( size_t i=1; i<nCellOffsets; i++ )
         {
-            m_cellOffsets[i] = m_cellOffsets[i-1] + cellObjectCounts[i-1];
+            cellOffsets[i] = cellOffsets[i-1] + cellObjectCounts[i-1];
+            if( cellObjectCounts[i-1] > 0 )
+                nOccupiedCells++;
         }
 
-        TRT_ASSERT( m_cellOffsets[nCellOffsets-1] == cellRefs.size() );
-        TRT_ASSERT( nCells % 8 == 0 );
+        m_nObjectRefs = cellOffsets[nCellOffsets-1];
+        TRT_ASSERT( m_nObjectRefs == cellRefs.size() );
 
-        // build occupied cells mask
-        m_cellMasks.reallocate( nCells/8 );
-        memset( m_cellMasks, 0, nCells/8 );
-        for( size_t i=0; i<nCells; i++ )
+        // the offsets would wrap around if the offset type is too small for this grid
+        if( static_cast<size_t>( static_cast<CellOffset_T>( m_nObjectRefs ) ) != m_nObjectRefs )
         {
-            if( cellObjectCounts[i] > 0 )
-                m_cellMasks[ i/8 ] |= ( 1 << (i%8) );
+            MakeEmpty();
+            return false;
         }
 
+        // choose a representation for the cell table
+        if( nOccupiedCells < fSparseOccupancy*nCells )
+        {
+            m_cellOffsets.reallocate(0);
+            m_nCellOffsets = 0;
+            BuildSparseCells( cellOffsets, nCells, nOccupiedCells );
+        }
+        else
+        {
+            m_cellOffsets.reallocate( nCellOffsets );
+            m_nCellOffsets = nCellOffsets;
+            for( size_t i=0; i<nCellOffsets; i++ )
+                m_cellOffsets[i] = static_cast<CellOffset_T>( cellOffsets[i] );
+            
+            m_sparseCells.reallocate(0);
+            m_nSparseCells = 0;
+        }
+
+        // build occupied cells masks
+        BuildOccupancyPyramid( cellOffsets );
+
         // ----------------------------------------------------------------------------------------------------------------
         // step three.  Sweep the cell references, and insert each object into all cells it appears in
         // ----------------------------------------------------------------------------------------------------------------
 
         // Allocate the object reference array        
-        m_objectList.reallocate( m_cellOffsets[nCellOffsets-1] );
+        m_objectList.reallocate( m_nObjectRefs );
         
         // sweep the cell reference array, object by object, and fill all cells with the objects they contain
         std::vector<size_t>::iterator itRefs = cellRefs.begin(); 
@@ -158,11 +259,45 @@ namespace TinyRT
             while( itRefs != itLast )
             {
                 size_t nCell = (*itRefs++);
-                m_objectList[ m_cellOffsets[nCell] + (--cellObjectCounts[nCell]) ] = nObjID;
+                m_objectList[ cellOffsets[nCell] + (--cellObjectCounts[nCell]) ] = nObjID;
             }
         }
 
+        return true;
+    }
 
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class ObjectSet_T, class CellOffset_T >
+    void UniformGrid<ObjectSet_T,CellOffset_T>::MakeEmpty()
+    {
+        m_boundingBox = AxisAlignedBox( Vec3f( std::numeric_limits<float>::max() ), 
+                                        Vec3f( -std::numeric_limits<float>::max() ) );
+        m_cellCounts = Vec3<uint32>( 0, 0, 0 );
+        m_nWH = 0;
+
+        m_cellOffsets.reallocate(0);
+        m_sparseCells.reallocate(0);
+        m_objectList.reallocate(0);
+        m_occupancy.reallocate(0);
+        m_nCellOffsets = 0;
+        m_nObjectRefs = 0;
+        m_nSparseCells = 0;
+        m_nSparseShift = 0;
+        m_nOccupancyBytes = 0;
+        m_nPyramidLevels = 0;
+    }
+
+    //=====================================================================================================================
+    //=====================================================================================================================
+    template< class ObjectSet_T, class CellOffset_T >
+    void UniformGrid<ObjectSet_T,CellOffset_T>::GetMemoryUsage( size_t& rnBytesUsed, size_t& rnBytesAllocated ) const
+    {
+        rnBytesUsed = m_nCellOffsets*sizeof(CellOffset_T) + 
+                      m_nSparseCells*sizeof(SparseCell) + 
+                      m_nObjectRefs*sizeof(obj_id) + 
+                      m_nOccupancyBytes;
+        rnBytesAllocated = rnBytesUsed;
     }
 
     //=====================================================================================================================
@@ -176,4 +311,123 @@ namespace TinyRT
     //            Private Methods
     //
     //=====================================================================================================================
+
+    //=====================================================================================================================
+    /// This method must only be called for cells which are known to be occupied.  The lookup will not terminate otherwise
+    //=====================================================================================================================
+    template< class ObjectSet_T, class CellOffset_T >
+    inline const typename UniformGrid<ObjectSet_T,CellOffset_T>::SparseCell* 
+        UniformGrid<ObjectSet_T,CellOffset_T>::FindSparseCell( size_t nCellAddr ) const
+    {
+        TRT_ASSERT( IsOccupied( nCellAddr ) );
+
+        // multiplicative hashing, with linear probing
+        size_t nMask = m_nSparseCells-1;
+        size_t nSlot = ( static_cast<uint32>(nCellAddr) * 2654435761u ) >> m_nSparseShift;
+        while( m_sparseCells[nSlot].nCell != nCellAddr )
+            nSlot = (nSlot+1) & nMask;
+
+        return &m_sparseCells[nSlot];
+    }
+
+    //=====================================================================================================================
+    /// \param pCellOffsets     Dense array of cell offsets.  There are nCells+1 entries
+    /// \param nCells           Total number of cells in the grid
+    /// \param nOccupiedCells   Number of cells that contain objects
+    //=====================================================================================================================
+    template< class ObjectSet_T, class CellOffset_T >
+    void UniformGrid<ObjectSet_T,CellOffset_T>::BuildSparseCells( const size_t* pCellOffsets, size_t nCells, size_t nOccupiedCells )
+    {
+        // size the table for a load factor of at most 3/4.  Every lookup is for an occupied cell, so 
+        //  probe sequences are short even at fairly high loads
+        uint32 nBits = 1;
+        while( (static_cast<size_t>(1) << nBits) * 3 < nOccupiedCells * 4 )
+            nBits++;
+
+        m_nSparseCells = static_cast<size_t>(1) << nBits;
+        m_nSparseShift = 32 - nBits;
+        m_sparseCells.reallocate( m_nSparseCells );
+        
+        // mark all slots as free.  No real cell can have this address, since cell addresses are less than nCells
+        for( size_t i=0; i<m_nSparseCells; i++ )
+            m_sparseCells[i].nCell = 0xffffffff;
+
+        size_t nMask = m_nSparseCells-1;
+        for( size_t i=0; i<nCells; i++ )
+        {
+            if( pCellOffsets[i+1] == pCellOffsets[i] )
+                continue;
+
+            size_t nSlot = ( static_cast<uint32>(i) * 2654435761u ) >> m_nSparseShift;
+            while( m_sparseCells[nSlot].nCell != 0xffffffff )
+                nSlot = (nSlot+1) & nMask;
+
+            m_sparseCells[nSlot].nCell = static_cast<uint32>( i );
+            m_sparseCells[nSlot].nOffset = static_cast<CellOffset_T>( pCellOffsets[i] );
+            m_sparseCells[nSlot].nCount = static_cast<CellOffset_T>( pCellOffsets[i+1] - pCellOffsets[i] );
+        }
+    }
+
+    //=====================================================================================================================
+    /// Level 0 of the pyramid contains one bit per cell.  Each successive level halves the resolution of the previous one,
+    ///  and each bit is set if any of the corresponding (up to 8) bits in the level below are set
+    /// \param pCellOffsets     Dense array of cell offsets.  
+    //=====================================================================================================================
+    template< class ObjectSet_T, class CellOffset_T >
+    void UniformGrid<ObjectSet_T,CellOffset_T>::BuildOccupancyPyramid( const size_t* pCellOffsets )
+    {
+        // choose the level dimensions.  Stop once the coarsest level is down to a single block
+        size_t nBits = 0;
+        m_nPyramidLevels = 0;
+        Vec3<uint32> vCounts = m_cellCounts;
+        while( m_nPyramidLevels < MAX_PYRAMID_LEVELS )
+        {
+            PyramidLevel& rLevel = m_pyramid[m_nPyramidLevels++];
+            rLevel.vCounts = vCounts;
+            rLevel.nWH = vCounts.x*vCounts.y;
+            rLevel.nFirstBit = nBits;
+            nBits += rLevel.nWH*vCounts.z;
+
+            if( vCounts.x == 1 && vCounts.y == 1 && vCounts.z == 1 )
+                break;
+
+            vCounts = Vec3<uint32>( (vCounts.x+1)/2, (vCounts.y+1)/2, (vCounts.z+1)/2 );
+        }
+
+        m_nOccupancyBytes = (nBits+7)/8;
+        m_occupancy.reallocate( m_nOccupancyBytes );
+        memset( m_occupancy, 0, m_nOccupancyBytes );
+
+        // level 0 comes directly from the cell table
+        size_t nCells = m_pyramid[0].nWH*m_cellCounts.z;
+        for( size_t i=0; i<nCells; i++ )
+        {
+            if( pCellOffsets[i+1] > pCellOffsets[i] )
+                m_occupancy[ i/8 ] |= ( 1 << (i%8) );
+        }
+
+        // remaining levels are built by OR-ing together blocks in the level below
+        for( uint32 l=1; l<m_nPyramidLevels; l++ )
+        {
+            const PyramidLevel& rFine = m_pyramid[l-1];
+            const PyramidLevel& rCoarse = m_pyramid[l];
+
+            Vec3<uint32> c;
+            for( c.z = 0; c.z < rFine.vCounts.z; c.z++ )
+            {
+                for( c.y = 0; c.y < rFine.vCounts.y; c.y++ )
+                {
+                    for( c.x = 0; c.x < rFine.vCounts.x; c.x++ )
+                    {
+                        if( IsOccupied( rFine.nFirstBit + c.z*rFine.nWH + c.y*rFine.vCounts.x + c.x ) )
+                        {
+                            size_t nBit = rCoarse.nFirstBit + (c.z/2)*rCoarse.nWH + (c.y/2)*rCoarse.vCounts.x + (c.x/2);
+                            m_occupancy[ nBit/8 ] |= ( 1 << (nBit%8) );
+                        }
+                    }
+                }
+            }
+        }
+    }
+
 }
@@ -40,6 +40,8 @@ raytracing kernel.
 
 #include <vector>
 #include <limits>
+#include <algorithm>
+#include <functional>
 #include <float.h>
 #include <string.h> // for memcpy
 
@@ -72,15 +74,24 @@ raytracing kernel.
 #include "TRTMalloc.h"
 #include "TRTSimd.h"
 #include "TRTMath.h"
+#include "TRTParallel.h"
 #include "TRTScratchMemory.h"
+#include "TRTTraversalStack.h"
+#include "TRTTraversalStats.h"
+#include "TRTPrefetch.h"
 
 
 // Utility classes
 #include "TRTAxisAlignedBox.h"
 #include "TRTPacketFrustum.h"
 #include "TRTPerspectiveCamera.h"
+#include "TRTAffineTransform.h"
 #include "TRTScopedArray.h"
+#include "TRTRadixSort.h"
+#include "TRTTreeHandles.h"
 #include "TRTObjectUtils.h"
+#include "TRTContentHash.h"
+#include "TRTSerialization.h"
 
 
 // Analysis utilities
@@ -89,7 +100,7 @@ raytracing kernel.
 
 // Rays
 #include "TRTRay.h"
-#include "TRTEPsilonRay.h"
+#include "TRTEpsilonRay.h"
 
 // Basic intersection testing
 #include "TRTTriIntersect.h"
@@ -100,6 +111,8 @@ raytracing kernel.
 #include "TRTFifoMailbox.h"
 #include "TRTDirectMapMailbox.h"
 #include "TRTSimdFifoMailbox.h"
+#include "TRTRayStampMailbox.h"
+#include "TRTHashedRayStampMailbox.h"
 
 // Object sets
 #include "TRTBasicMesh.h"
@@ -113,8 +126,12 @@ raytracing kernel.
 
 // QBVH
 #include "TRTQuadAABBTree.h"
+#include "TRTAABBTreeCollapser.h"
 #include "TRTMultiBVHTraversal.h"
 
+// Refitting
+#include "TRTSAHQualityMonitor.h"
+
 
 // Uniform Grids
 #include "TRTUniformGrid.h"
@@ -122,10 +139,19 @@ raytracing kernel.
 
 // KD Trees
 #include "TRTKDTree.h"
+#include "TRTKDTreeRopes.h"
 #include "TRTKDTraversal.h"
 #include "TRTSahKDTreeBuilder.h"
 #include "TRTBoxClipper.h"
 
+// Bounding Interval Hierarchies
+#include "TRTBIHTree.h"
+#include "TRTBIHTreeBuilder.h"
+#include "TRTBIHTraversal.h"
+
+// Instancing
+#include "TRTInstanceSet.h"
+
 
 
 #endif